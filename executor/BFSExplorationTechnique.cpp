@@ -20,4 +20,27 @@ std::optional<state::StatePtr> BFSExplorationTechnique::get_next()
     return s;
 }
 
+std::vector<state::StatePtr> BFSExplorationTechnique::evict()
+{
+    // the newest (deepest) states are at the front of the queue
+    std::vector<state::StatePtr> res;
+    size_t                       n = m_active.size() / 2;
+    while (res.size() < n) {
+        res.push_back(m_active.front());
+        m_active.pop_front();
+    }
+    return res;
+}
+
+std::vector<state::StatePtr> BFSExplorationTechnique::queued() const
+{
+    return std::vector<state::StatePtr>(m_active.begin(), m_active.end());
+}
+
+void BFSExplorationTechnique::restore(std::vector<state::StatePtr> states,
+                                      expr::ExprReader&)
+{
+    m_active.assign(states.begin(), states.end());
+}
+
 } // namespace naaz::executor
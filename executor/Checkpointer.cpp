@@ -0,0 +1,253 @@
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#include "Checkpointer.hpp"
+
+#include "../expr/ExprBuilder.hpp"
+#include "../expr/ExprSerializer.hpp"
+#include "../util/config.hpp"
+#include "../util/ioutil.hpp"
+
+#define exprBuilder naaz::expr::ExprBuilder::The()
+
+namespace naaz::executor
+{
+
+#define SYMBOLS_FILE    "symbols.bin"
+#define CHECKPOINT_FILE "checkpoint.bin"
+#define DATA_PREFIX     "data_"
+
+static expr::ExprReader::FloatFormatLookup no_float_formats =
+    [](int32_t size) { return nullptr; };
+
+static void check_exists(const std::filesystem::path& path)
+{
+    if (!std::filesystem::exists(path)) {
+        err("Checkpointer") << "unable to find " << path << std::endl;
+        exit_fail();
+    }
+}
+
+// number of symbols used by the checkpoint in dir
+static uint32_t checkpoint_symbols(const std::filesystem::path& dir)
+{
+    std::ifstream    in(dir / CHECKPOINT_FILE, std::ios::binary);
+    expr::ExprReader r(in, no_float_formats);
+    return r.read_uint();
+}
+
+Checkpointer::~Checkpointer() { wait(); }
+
+void Checkpointer::enable(const std::filesystem::path& dir,
+                          const std::filesystem::path& resumed_from)
+{
+    std::error_code ec;
+    std::filesystem::create_directories(dir);
+    m_dir  = dir;
+    m_last = std::chrono::steady_clock::now();
+
+    bool resumed = !resumed_from.empty() &&
+                   std::filesystem::equivalent(dir, resumed_from, ec);
+    m_files.clear();
+    m_used.clear();
+    m_next_file = 0;
+    for (const auto& entry : std::filesystem::directory_iterator(dir)) {
+        std::string name = entry.path().filename();
+        if (!name.starts_with(DATA_PREFIX))
+            continue;
+        if (!resumed) {
+            std::filesystem::remove(entry.path(), ec);
+            continue;
+        }
+        // the files of the resumed checkpoint are kept, the new ones do not
+        // reuse their names
+        uint64_t n =
+            std::strtoull(name.c_str() + strlen(DATA_PREFIX), nullptr, 10);
+        m_files.insert(name);
+        m_next_file = std::max(m_next_file, n + 1);
+    }
+
+    if (!resumed) {
+        std::filesystem::remove(dir / SYMBOLS_FILE, ec);
+        std::filesystem::remove(dir / CHECKPOINT_FILE, ec);
+        m_num_symbols = 0;
+        return;
+    }
+
+    // the symbols appended after the resumed checkpoint (by a checkpoint that
+    // was never renamed) are dropped
+    m_num_symbols = checkpoint_symbols(dir);
+
+    std::ifstream    in(dir / SYMBOLS_FILE, std::ios::binary);
+    expr::ExprReader r(in, no_float_formats);
+    for (uint32_t i = 0; i < m_num_symbols; ++i) {
+        r.read_str();
+        r.read_uint();
+    }
+    uint64_t size = in.tellg();
+    in.close();
+    std::filesystem::resize_file(dir / SYMBOLS_FILE, size);
+}
+
+bool Checkpointer::due() const
+{
+    if (!enabled() || m_busy)
+        return false;
+    return std::chrono::steady_clock::now() - m_last >=
+           std::chrono::seconds(g_config.checkpoint_interval);
+}
+
+void Checkpointer::write(std::string content)
+{
+    wait();
+
+    // the symbol table is not thread safe, the new symbols are serialized
+    // here
+    std::ostringstream symbols;
+    std::ostringstream header;
+    {
+        expr::ExprWriter w(symbols);
+        for (uint32_t id = m_num_symbols; id < exprBuilder.num_symbols();
+             ++id) {
+            w.write_str(exprBuilder.get_sym_name(id));
+            w.write_uint(exprBuilder.get_sym(id)->size());
+        }
+        m_num_symbols = exprBuilder.num_symbols();
+
+        expr::ExprWriter h(header);
+        h.write_uint(m_num_symbols);
+    }
+
+    // the files of the previous checkpoints that this one does not use
+    std::vector<std::string> unused;
+    for (const auto& name : m_files) {
+        if (!m_used.contains(name))
+            unused.push_back(name);
+    }
+    m_files = std::move(m_used);
+    m_used.clear();
+
+    m_busy   = true;
+    m_last   = std::chrono::steady_clock::now();
+    m_writer = std::thread([this, symbols = symbols.str(),
+                            header = header.str(), content = std::move(content),
+                            pending = std::move(m_pending),
+                            unused  = std::move(unused)]() {
+        bool ok = true;
+        for (const auto& [name, data] : pending) {
+            std::ofstream data_out(m_dir / name, std::ios::binary);
+            data_out << data;
+            data_out.close();
+            ok = ok && data_out;
+        }
+
+        std::ofstream sym_out(m_dir / SYMBOLS_FILE,
+                              std::ios::binary | std::ios::app);
+        sym_out << symbols;
+        sym_out.close();
+
+        auto          tmp = m_dir / CHECKPOINT_FILE ".tmp";
+        std::ofstream out(tmp, std::ios::binary);
+        out << header << content;
+        out.close();
+        if (!ok || !sym_out || !out) {
+            err("Checkpointer") << "unable to write the checkpoint in "
+                                << m_dir << std::endl;
+            exit_fail();
+        }
+        std::filesystem::rename(tmp, m_dir / CHECKPOINT_FILE);
+
+        std::error_code ec;
+        for (const auto& name : unused)
+            std::filesystem::remove(m_dir / name, ec);
+        m_busy = false;
+    });
+    m_pending.clear();
+}
+
+void Checkpointer::wait()
+{
+    if (m_writer.joinable())
+        m_writer.join();
+}
+
+std::string Checkpointer::new_file_name()
+{
+    std::string name =
+        DATA_PREFIX + std::to_string(m_next_file++) + std::string(".bin");
+    m_used.insert(name);
+    return name;
+}
+
+std::string Checkpointer::add_file(std::string content)
+{
+    std::string name = new_file_name();
+    m_pending.emplace_back(name, std::move(content));
+    return name;
+}
+
+std::string Checkpointer::link_file(const std::filesystem::path& path)
+{
+    std::string name = new_file_name();
+
+    // the file is immutable, a hard link is enough (if both are on the same
+    // file system)
+    std::error_code ec;
+    std::filesystem::create_hard_link(path, m_dir / name, ec);
+    if (ec)
+        std::filesystem::copy_file(path, m_dir / name, ec);
+    if (ec) {
+        err("Checkpointer") << "unable to copy " << path << " in " << m_dir
+                            << std::endl;
+        exit_fail();
+    }
+    return name;
+}
+
+bool Checkpointer::use_file(const std::string& name)
+{
+    if (!m_files.contains(name) && !m_used.contains(name))
+        return false;
+    m_used.insert(name);
+    return true;
+}
+
+void Checkpointer::load_symbols(const std::filesystem::path& dir)
+{
+    check_exists(dir / CHECKPOINT_FILE);
+    check_exists(dir / SYMBOLS_FILE);
+
+    uint32_t         n = checkpoint_symbols(dir);
+    std::ifstream    in(dir / SYMBOLS_FILE, std::ios::binary);
+    expr::ExprReader r(in, no_float_formats);
+    for (uint32_t id = 0; id < n; ++id) {
+        std::string name = r.read_str();
+        if (exprBuilder.mk_sym(name, r.read_uint())->id() != id) {
+            err("Checkpointer") << "load_symbols(): the symbol " << name
+                                << " already exists with a different id"
+                                << std::endl;
+            exit_fail();
+        }
+    }
+}
+
+std::string Checkpointer::load(const std::filesystem::path& dir)
+{
+    check_exists(dir / CHECKPOINT_FILE);
+
+    std::ifstream    in(dir / CHECKPOINT_FILE, std::ios::binary);
+    expr::ExprReader r(in, no_float_formats);
+    r.read_uint();
+    return std::string((std::istreambuf_iterator<char>(in)),
+                       std::istreambuf_iterator<char>());
+}
+
+std::filesystem::path Checkpointer::file_path(const std::filesystem::path& dir,
+                                              const std::string&           name)
+{
+    check_exists(dir / name);
+    return dir / name;
+}
+
+} // namespace naaz::executor
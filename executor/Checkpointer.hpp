@@ -0,0 +1,78 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <set>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace naaz::executor
+{
+
+// Writes the checkpoints of an exploration in a directory:
+//  - symbols.bin, the symbol table of the ExprBuilder in id order. The file
+//    is append-only, every checkpoint writes only the new symbols
+//  - checkpoint.bin, the number of symbols it uses followed by the content
+//    serialized by the ExecutorManager. It is written to a temporary file and
+//    renamed, a crash never leaves a partial checkpoint
+//  - data_<n>.bin, the data files referenced by the checkpoint (e.g., the
+//    serialized states, the spilled batches). A data file is never modified,
+//    the following checkpoints refer to it instead of writing its content
+//    again. It is removed after the first checkpoint that does not use it
+// The content is serialized in memory by the exploration, and written to disk
+// by a background thread. A checkpoint is not due while the previous one is
+// being written
+class Checkpointer
+{
+    std::filesystem::path                 m_dir;
+    uint32_t                              m_num_symbols;
+    std::chrono::steady_clock::time_point m_last;
+    std::thread                           m_writer;
+    std::atomic<bool>                     m_busy;
+
+    // the data files in the directory, and the ones used by the next
+    // checkpoint. The new files are written with it
+    std::set<std::string>                            m_files;
+    std::set<std::string>                            m_used;
+    std::vector<std::pair<std::string, std::string>> m_pending;
+    uint64_t                                         m_next_file;
+
+    std::string new_file_name();
+
+  public:
+    Checkpointer() : m_num_symbols(0), m_busy(false), m_next_file(0) {}
+    ~Checkpointer();
+
+    // if dir is the directory of the resumed checkpoint, the new checkpoints
+    // extend its symbol table. Otherwise, the directory is cleared
+    void enable(const std::filesystem::path& dir,
+                const std::filesystem::path& resumed_from);
+    bool enabled() const { return !m_dir.empty(); }
+
+    // true if checkpoint_interval seconds passed since the previous one
+    bool due() const;
+    void write(std::string content);
+    void wait();
+
+    // the data files used by the next checkpoint. add_file() writes a new
+    // one, link_file() links (or copies) a file that is not modified
+    // anymore, use_file() keeps one of the previous checkpoints (false if it
+    // does not exist). They return the name of the file in the checkpoint
+    std::string add_file(std::string content);
+    std::string link_file(const std::filesystem::path& path);
+    bool        use_file(const std::string& name);
+
+    // create the symbols of the checkpoint in dir, with the same ids. It must
+    // be called before the creation of any other symbol
+    static void load_symbols(const std::filesystem::path& dir);
+    // the content of the checkpoint in dir
+    static std::string load(const std::filesystem::path& dir);
+    // the path of a data file of the checkpoint in dir
+    static std::filesystem::path file_path(const std::filesystem::path& dir,
+                                           const std::string&           name);
+};
+
+} // namespace naaz::executor
@@ -3,6 +3,8 @@
 
 #include "../third_party/xxHash/xxh3.h"
 
+#include <algorithm>
+
 namespace naaz::executor
 {
 
@@ -19,7 +21,7 @@ static uint64_t get_context_checksum(state::StatePtr state)
 }
 
 CovExplorationTechnique::CovExplorationTechnique(state::StatePtr initial_state)
-    : ExplorationTechnique(initial_state)
+    : ExplorationTechnique(initial_state), m_sharing(false)
 {
     m_new_addr_queue.push_back(initial_state);
     m_visited_addrs.insert(initial_state->pc());
@@ -37,8 +39,10 @@ void CovExplorationTechnique::add_actives(std::vector<state::StatePtr> states)
         else
             m_other_queue.push_back(s);
 
-        m_visited_addrs.insert(s->pc());
-        m_visited_contexts.insert(context_chk);
+        if (m_visited_addrs.insert(s->pc()).second && m_sharing)
+            m_new_addrs.insert(s->pc());
+        if (m_visited_contexts.insert(context_chk).second && m_sharing)
+            m_new_contexts.insert(context_chk);
     }
 }
 
@@ -65,6 +69,104 @@ std::optional<state::StatePtr> CovExplorationTechnique::get_next()
     return {};
 }
 
+std::vector<state::StatePtr> CovExplorationTechnique::evict()
+{
+    // the states that do not reach new code nor new contexts go first, the
+    // ones that reach new code are never evicted
+    size_t n = (m_new_context_queue.size() + m_other_queue.size()) / 2;
+
+    std::vector<state::StatePtr> res;
+    for (auto queue : {&m_other_queue, &m_new_context_queue}) {
+        size_t k = std::min(n - res.size(), queue->size());
+        res.insert(res.end(), queue->begin(), queue->begin() + k);
+        queue->erase(queue->begin(), queue->begin() + k);
+    }
+    return res;
+}
+
+std::vector<state::StatePtr> CovExplorationTechnique::queued() const
+{
+    std::vector<state::StatePtr> res;
+    for (auto queue : {&m_new_addr_queue, &m_new_context_queue, &m_other_queue})
+        res.insert(res.end(), queue->begin(), queue->end());
+    return res;
+}
+
+static void save_set(expr::ExprWriter& w, const std::set<uint64_t>& set)
+{
+    uint64_t prev = 0;
+    w.write_uint(set.size());
+    for (auto v : set) {
+        w.write_uint(v - prev);
+        prev = v;
+    }
+}
+
+static std::set<uint64_t> restore_set(expr::ExprReader& r)
+{
+    std::set<uint64_t> res;
+    uint64_t           v = 0;
+    uint64_t           n = r.read_uint();
+    for (uint64_t i = 0; i < n; ++i) {
+        v += r.read_uint();
+        res.insert(res.end(), v);
+    }
+    return res;
+}
+
+void CovExplorationTechnique::save(expr::ExprWriter& w) const
+{
+    w.write_uint(m_new_addr_queue.size());
+    w.write_uint(m_new_context_queue.size());
+    save_set(w, m_visited_addrs);
+    save_set(w, m_visited_contexts);
+}
+
+void CovExplorationTechnique::restore(std::vector<state::StatePtr> states,
+                                      expr::ExprReader&            r)
+{
+    size_t n_new_addr    = r.read_uint();
+    size_t n_new_context = r.read_uint();
+    m_visited_addrs      = restore_set(r);
+    m_visited_contexts   = restore_set(r);
+
+    auto it = states.begin();
+    m_new_addr_queue.assign(it, it + n_new_addr);
+    it += n_new_addr;
+    m_new_context_queue.assign(it, it + n_new_context);
+    it += n_new_context;
+    m_other_queue.assign(it, states.end());
+}
+
+bool CovExplorationTechnique::save_coverage(expr::ExprWriter& w)
+{
+    // the first call shares all the coverage found so far
+    if (!m_sharing) {
+        m_sharing = true;
+        save_set(w, m_visited_addrs);
+        save_set(w, m_visited_contexts);
+        return true;
+    }
+    if (m_new_addrs.empty() && m_new_contexts.empty())
+        return false;
+
+    save_set(w, m_new_addrs);
+    save_set(w, m_new_contexts);
+    m_new_addrs.clear();
+    m_new_contexts.clear();
+    return true;
+}
+
+void CovExplorationTechnique::merge_coverage(expr::ExprReader& r)
+{
+    // the queued states keep their queue, the next ones that reach the
+    // coverage of the other workers are not ranked as new
+    auto addrs    = restore_set(r);
+    auto contexts = restore_set(r);
+    m_visited_addrs.insert(addrs.begin(), addrs.end());
+    m_visited_contexts.insert(contexts.begin(), contexts.end());
+}
+
 size_t CovExplorationTechnique::num_states() const
 {
     return m_new_addr_queue.size() + m_new_context_queue.size() +
@@ -14,6 +14,12 @@ class CovExplorationTechnique final : public ExplorationTechnique
     std::set<uint64_t> m_visited_addrs;
     std::set<uint64_t> m_visited_contexts;
 
+    // the coverage not shared with the other workers yet. It is tracked
+    // after the first save_coverage()
+    bool               m_sharing;
+    std::set<uint64_t> m_new_addrs;
+    std::set<uint64_t> m_new_contexts;
+
     std::vector<state::StatePtr> m_new_addr_queue;
     std::vector<state::StatePtr> m_new_context_queue;
     std::vector<state::StatePtr> m_other_queue;
@@ -22,7 +28,14 @@ class CovExplorationTechnique final : public ExplorationTechnique
     CovExplorationTechnique(state::StatePtr initial_state);
 
     virtual void add_actives(std::vector<state::StatePtr> states);
+    virtual void restore(std::vector<state::StatePtr> states,
+                         expr::ExprReader&            r);
     virtual std::optional<state::StatePtr> get_next();
+    virtual std::vector<state::StatePtr>   evict();
+    virtual std::vector<state::StatePtr>   queued() const;
+    virtual void                           save(expr::ExprWriter& w) const;
+    virtual bool                           save_coverage(expr::ExprWriter& w);
+    virtual void                           merge_coverage(expr::ExprReader& r);
 
     virtual size_t num_states() const;
 };
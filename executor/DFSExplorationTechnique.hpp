@@ -20,7 +20,11 @@ class DFSExplorationTechnique final : public ExplorationTechnique
     }
 
     virtual void add_actives(std::vector<state::StatePtr> states);
+    virtual void restore(std::vector<state::StatePtr> states,
+                         expr::ExprReader&            r);
     virtual std::optional<state::StatePtr> get_next();
+    virtual std::vector<state::StatePtr>   evict();
+    virtual std::vector<state::StatePtr>   queued() const;
 
     virtual size_t num_states() const
     {
@@ -0,0 +1,309 @@
+#include <algorithm>
+#include <deque>
+
+#include "DirectedExplorationTechnique.hpp"
+
+namespace naaz::executor
+{
+
+// bound on the blocks lifted to recover the CFG
+static const size_t MAX_LIFTED_BLOCKS = 1 << 15;
+
+bool DirectedExplorationTechnique::comes_later(const Entry& a, const Entry& b)
+{
+    // std heap functions keep the greatest element on top
+    if (a.dist != b.dist)
+        return a.dist > b.dist;
+    return a.tie > b.tie;
+}
+
+DirectedExplorationTechnique::DirectedExplorationTechnique(
+    state::StatePtr initial_state)
+    : ExplorationTechnique(initial_state), m_num_lifted(0), m_dirty(false),
+      m_last_pc(initial_state->pc()), m_rand(0x42424242)
+{
+    push(initial_state);
+}
+
+DirectedExplorationTechnique::Node&
+DirectedExplorationTechnique::get_node(uint64_t addr)
+{
+    auto [it, inserted] = m_nodes.try_emplace(addr);
+    if (inserted && m_targets.contains(addr))
+        it->second.dist_target = 0;
+    return it->second;
+}
+
+void DirectedExplorationTechnique::discover(uint64_t addr)
+{
+    // lift all the blocks statically reachable from addr
+    std::vector<uint64_t> worklist = {addr};
+    while (!worklist.empty() && m_num_lifted < MAX_LIFTED_BLOCKS) {
+        uint64_t block_addr = worklist.back();
+        worklist.pop_back();
+        if (get_node(block_addr).lifted)
+            continue;
+
+        lift_node(block_addr, worklist);
+    }
+}
+
+void DirectedExplorationTechnique::lift_node(uint64_t               addr,
+                                             std::vector<uint64_t>& o_succs)
+{
+    // the references to the elements of an unordered_map are stable
+    Node& node  = get_node(addr);
+    node.lifted = true;
+    node.end    = addr;
+    m_num_lifted++;
+
+    if (m_initial_state->get_linked_model(addr) != nullptr) {
+        node.terminator = MODEL;
+        relax(addr, 0, &Node::dist_ret);
+        return;
+    }
+
+    const uint8_t* data;
+    uint64_t       size;
+    if (!m_initial_state->get_code_at(addr, &data, &size)) {
+        node.terminator = NO_CODE;
+        return;
+    }
+
+    auto lifter = m_initial_state->lifter();
+    const csleigh_TranslationResult* tr =
+        lifter->lift(addr, data, size)->transl();
+    if (tr->instructions_count == 0) {
+        node.terminator = NO_CODE;
+        return;
+    }
+
+    auto is_ram = [&](const csleigh_Varnode& v) {
+        return csleigh_AddrSpace_getId(v.space) == lifter->ram_space_id();
+    };
+
+    Terminator terminator = FALLTHROUGH;
+    for (uint32_t i = 0; i < tr->instructions_count; ++i) {
+        const csleigh_Translation& t = tr->instructions[i];
+        for (uint32_t j = 0; j < t.ops_count; ++j) {
+            const csleigh_PcodeOp& op = t.ops[j];
+            switch (op.opcode) {
+                case csleigh_CPUI_BRANCH:
+                case csleigh_CPUI_CBRANCH:
+                    // the branches in the const space are relative to the
+                    // p-code of the instruction
+                    if (!is_ram(op.inputs[0]))
+                        break;
+                    add_edge(addr, op.inputs[0].offset, false);
+                    o_succs.push_back(op.inputs[0].offset);
+                    if (op.opcode == csleigh_CPUI_BRANCH)
+                        terminator = JUMP;
+                    break;
+                case csleigh_CPUI_CALL:
+                    if (!is_ram(op.inputs[0]))
+                        break;
+                    add_edge(addr, op.inputs[0].offset, true);
+                    o_succs.push_back(op.inputs[0].offset);
+                    terminator = CALL;
+                    break;
+                case csleigh_CPUI_BRANCHIND:
+                    terminator = INDIRECT_JUMP;
+                    break;
+                case csleigh_CPUI_CALLIND:
+                    terminator = INDIRECT_CALL;
+                    break;
+                case csleigh_CPUI_RETURN:
+                    terminator = RETURN;
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+
+    const csleigh_Translation& last =
+        tr->instructions[tr->instructions_count - 1];
+    node.terminator = terminator;
+    node.end        = last.address.offset + last.length;
+
+    // a call continues at the return address once the callee returns
+    if (terminator == FALLTHROUGH || terminator == CALL ||
+        terminator == INDIRECT_CALL) {
+        add_edge(addr, node.end, false);
+        o_succs.push_back(node.end);
+    }
+    if (terminator == RETURN)
+        relax(addr, 0, &Node::dist_ret);
+
+    auto target = m_targets.lower_bound(addr);
+    if (target != m_targets.end() && *target < node.end)
+        relax(addr, 0, &Node::dist_target);
+}
+
+void DirectedExplorationTechnique::add_edge(uint64_t src, uint64_t dst,
+                                            bool is_call)
+{
+    Node& src_node = get_node(src);
+    if (std::find(src_node.succs.begin(), src_node.succs.end(), dst) !=
+        src_node.succs.end())
+        return;
+    src_node.succs.push_back(dst);
+
+    Node& dst_node = get_node(dst);
+    if (is_call)
+        dst_node.call_preds.push_back(src);
+    else
+        dst_node.preds.push_back(src);
+
+    if (dst_node.dist_target != UINT64_MAX)
+        relax(src, dst_node.dist_target + 1, &Node::dist_target);
+    if (!is_call && dst_node.dist_ret != UINT64_MAX)
+        relax(src, dst_node.dist_ret + 1, &Node::dist_ret);
+}
+
+void DirectedExplorationTechnique::relax(uint64_t addr, uint64_t dist,
+                                         uint64_t Node::*field)
+{
+    // the distances only decrease when edges and targets are added, propagate
+    // the new distance to the predecessors
+    bool follow_calls = field == &Node::dist_target;
+
+    std::deque<std::pair<uint64_t, uint64_t>> worklist = {{addr, dist}};
+    while (!worklist.empty()) {
+        auto [block_addr, block_dist] = worklist.front();
+        worklist.pop_front();
+
+        Node& node = m_nodes.at(block_addr);
+        if (block_dist >= node.*field)
+            continue;
+        node.*field = block_dist;
+        m_dirty     = true;
+
+        for (auto pred : node.preds)
+            worklist.push_back({pred, block_dist + 1});
+        if (follow_calls)
+            for (auto pred : node.call_preds)
+                worklist.push_back({pred, block_dist + 1});
+    }
+}
+
+uint64_t DirectedExplorationTechnique::distance(state::StatePtr s) const
+{
+    auto lookup = [&](uint64_t addr, uint64_t Node::*field) {
+        auto it = m_nodes.find(addr);
+        return it == m_nodes.end() ? UINT64_MAX : it->second.*field;
+    };
+
+    // the target can be reached also after returning to one of the callers
+    uint64_t dist        = lookup(s->pc(), &Node::dist_target);
+    uint64_t dist_to_ret = lookup(s->pc(), &Node::dist_ret);
+    for (auto retaddr : s->stacktrace()) {
+        if (dist_to_ret == UINT64_MAX)
+            break;
+        dist_to_ret += 1;
+
+        uint64_t ret_dist = lookup(retaddr, &Node::dist_target);
+        if (ret_dist != UINT64_MAX)
+            dist = std::min(dist, dist_to_ret + ret_dist);
+
+        uint64_t ret_dist_to_ret = lookup(retaddr, &Node::dist_ret);
+        if (ret_dist_to_ret == UINT64_MAX)
+            break;
+        dist_to_ret += ret_dist_to_ret;
+    }
+    return dist;
+}
+
+void DirectedExplorationTechnique::push(state::StatePtr s)
+{
+    discover(s->pc());
+
+    m_queue.push_back({.dist = distance(s), .tie = m_rand(), .state = s});
+    std::push_heap(m_queue.begin(), m_queue.end(), comes_later);
+}
+
+void DirectedExplorationTechnique::set_targets(
+    const std::vector<uint64_t>& find)
+{
+    m_targets = std::set<uint64_t>(find.begin(), find.end());
+
+    std::vector<uint64_t> target_blocks;
+    for (auto& [addr, node] : m_nodes) {
+        node.dist_target = UINT64_MAX;
+
+        auto target = m_targets.lower_bound(addr);
+        if (target == m_targets.end())
+            continue;
+        if (*target == addr || *target < node.end)
+            target_blocks.push_back(addr);
+    }
+    for (auto addr : target_blocks)
+        relax(addr, 0, &Node::dist_target);
+    m_dirty = true;
+}
+
+void DirectedExplorationTechnique::add_actives(
+    std::vector<state::StatePtr> states)
+{
+    // the successors of an indirect jump or call are edges of the CFG
+    auto src = m_nodes.find(m_last_pc);
+    if (src != m_nodes.end() && (src->second.terminator == INDIRECT_JUMP ||
+                                 src->second.terminator == INDIRECT_CALL)) {
+        bool is_call = src->second.terminator == INDIRECT_CALL;
+        for (auto s : states) {
+            discover(s->pc());
+            add_edge(m_last_pc, s->pc(), is_call);
+        }
+    }
+
+    for (auto s : states)
+        push(s);
+}
+
+std::optional<state::StatePtr> DirectedExplorationTechnique::get_next()
+{
+    if (m_queue.empty())
+        return {};
+
+    if (m_dirty) {
+        // some distances changed, update the priority of the queued states
+        for (auto& entry : m_queue)
+            entry.dist = distance(entry.state);
+        std::make_heap(m_queue.begin(), m_queue.end(), comes_later);
+        m_dirty = false;
+    }
+
+    std::pop_heap(m_queue.begin(), m_queue.end(), comes_later);
+    auto s = m_queue.back().state;
+    m_queue.pop_back();
+
+    m_last_pc = s->pc();
+    return s;
+}
+
+void DirectedExplorationTechnique::restore(std::vector<state::StatePtr> states,
+                                           expr::ExprReader&)
+{
+    // the CFG is recovered again from the states
+    m_queue.clear();
+    for (auto s : states)
+        push(s);
+}
+
+std::vector<state::StatePtr> DirectedExplorationTechnique::queued() const
+{
+    std::vector<state::StatePtr> res;
+    for (auto& entry : m_queue)
+        res.push_back(entry.state);
+    return res;
+}
+
+uint64_t DirectedExplorationTechnique::block_distance(uint64_t addr) const
+{
+    auto it = m_nodes.find(addr);
+    return it == m_nodes.end() ? UINT64_MAX : it->second.dist_target;
+}
+
+template class ExecutorManager<DirectedExplorationTechnique>;
+
+} // namespace naaz::executor
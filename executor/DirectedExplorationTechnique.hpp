@@ -0,0 +1,92 @@
+#pragma once
+
+#include <random>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+#include "ExplorationTechnique.hpp"
+#include "ExecutorManager.hpp"
+
+namespace naaz::executor
+{
+
+// Directed search toward the find addresses. The technique recovers an
+// inter-procedural CFG from the lifted blocks (the direct branches and calls,
+// plus the indirect edges taken by the states), and keeps the distance of
+// every block from the targets. The states with the smallest distance are
+// executed first, the ties are broken randomly
+class DirectedExplorationTechnique final : public ExplorationTechnique
+{
+    enum Terminator : uint8_t {
+        FALLTHROUGH,
+        JUMP,
+        INDIRECT_JUMP,
+        CALL,
+        INDIRECT_CALL,
+        RETURN,
+        MODEL,
+        NO_CODE
+    };
+
+    struct Node {
+        bool       lifted     = false;
+        Terminator terminator = FALLTHROUGH;
+        uint64_t   end        = 0;
+        // distance from the targets, and from the end of the function
+        uint64_t dist_target = UINT64_MAX;
+        uint64_t dist_ret    = UINT64_MAX;
+
+        std::vector<uint64_t> succs;
+        std::vector<uint64_t> preds;
+        // the callers, they do not reach the end of the function
+        std::vector<uint64_t> call_preds;
+    };
+
+    struct Entry {
+        uint64_t        dist;
+        uint64_t        tie;
+        state::StatePtr state;
+    };
+
+    std::unordered_map<uint64_t, Node> m_nodes;
+    std::set<uint64_t>                 m_targets;
+    size_t                             m_num_lifted;
+    std::vector<Entry>                 m_queue;
+    bool                               m_dirty;
+    uint64_t                           m_last_pc;
+    std::mt19937_64                    m_rand;
+
+    static bool comes_later(const Entry& a, const Entry& b);
+
+    Node& get_node(uint64_t addr);
+    void  discover(uint64_t addr);
+    void  lift_node(uint64_t addr, std::vector<uint64_t>& o_succs);
+    void  add_edge(uint64_t src, uint64_t dst, bool is_call);
+    void  relax(uint64_t addr, uint64_t dist, uint64_t Node::*field);
+
+    uint64_t distance(state::StatePtr s) const;
+    void     push(state::StatePtr s);
+
+  public:
+    DirectedExplorationTechnique(state::StatePtr initial_state);
+
+    virtual void set_targets(const std::vector<uint64_t>& find);
+    virtual void add_actives(std::vector<state::StatePtr> states);
+    virtual void restore(std::vector<state::StatePtr> states,
+                         expr::ExprReader&            r);
+    virtual std::optional<state::StatePtr> get_next();
+    virtual std::vector<state::StatePtr>   queued() const;
+
+    virtual size_t num_states() const
+    {
+        return m_queue.size() + ExplorationTechnique::num_states();
+    }
+
+    // distance of the block at `addr` from the targets (UINT64_MAX if unknown)
+    uint64_t block_distance(uint64_t addr) const;
+};
+
+typedef ExecutorManager<DirectedExplorationTechnique> DirectedExecutorManager;
+
+} // namespace naaz::executor
@@ -0,0 +1,139 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+#include "EdgeCoverage.hpp"
+
+#include "../util/ioutil.hpp"
+#include "../util/strutil.hpp"
+
+namespace naaz::executor
+{
+
+EdgeCoverage::EdgeCoverage()
+    : m_own_map(new uint8_t[EDGE_MAP_SIZE]()), m_num_edges(0)
+{
+    m_map = m_own_map.get();
+}
+
+void EdgeCoverage::attach(uint8_t* map)
+{
+    memcpy(map, m_map, EDGE_MAP_SIZE);
+    m_map = map;
+    m_own_map.reset();
+}
+
+uint64_t EdgeCoverage::block_id(uint64_t addr)
+{
+    // the finalizer of MurmurHash3, the ids of close blocks look unrelated
+    addr ^= addr >> 33;
+    addr *= 0xff51afd7ed558ccdUL;
+    addr ^= addr >> 33;
+    addr *= 0xc4ceb9fe1a85ec53UL;
+    addr ^= addr >> 33;
+    return addr & (EDGE_MAP_SIZE - 1);
+}
+
+bool EdgeCoverage::hit(uint64_t edge)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    uint8_t&                    count  = m_map[edge];
+    bool                        is_new = count == 0;
+    if (count != UINT8_MAX)
+        count++;
+    if (is_new)
+        m_num_edges++;
+    return is_new;
+}
+
+void EdgeCoverage::add_block(uint64_t addr, uint64_t size)
+{
+    m_blocks.emplace(addr, size);
+}
+
+void EdgeCoverage::write_drcov(const std::filesystem::path& path,
+                               const loader::AddressSpace&  as,
+                               const std::string&           module_path) const
+{
+    uint64_t base = UINT64_MAX;
+    uint64_t end  = 0;
+    for (const auto& segment : as.segments()) {
+        base = std::min(base, segment.addr());
+        end  = std::max(end, segment.addr() + segment.size());
+    }
+
+    // the entries of the BB table are {u32 offset, u16 size, u16 module id}
+    std::vector<uint8_t> bbs;
+    uint64_t             num_bbs = 0;
+    for (auto [addr, size] : m_blocks) {
+        if (addr < base || addr >= end || addr - base > UINT32_MAX)
+            continue;
+        uint32_t offset = addr - base;
+        uint16_t size_  = std::min(size, (uint64_t)UINT16_MAX);
+        uint16_t module = 0;
+        bbs.insert(bbs.end(), (uint8_t*)&offset, (uint8_t*)&offset + 4);
+        bbs.insert(bbs.end(), (uint8_t*)&size_, (uint8_t*)&size_ + 2);
+        bbs.insert(bbs.end(), (uint8_t*)&module, (uint8_t*)&module + 2);
+        num_bbs++;
+    }
+
+    std::ofstream out(path, std::ios::binary);
+    out << "DRCOV VERSION: 2\n"
+        << "DRCOV FLAVOR: naaz\n"
+        << "Module Table: version 2, count 1\n"
+        << "Columns: id, base, end, entry, checksum, timestamp, path\n"
+        << string_format("  0, 0x%016lx, 0x%016lx, 0x%016lx, 0x%08x, "
+                         "0x%08x, %s\n",
+                         (unsigned long)base, (unsigned long)end, 0UL, 0, 0,
+                         module_path.c_str())
+        << "BB Table: " << num_bbs << " bbs\n";
+    out.write((const char*)bbs.data(), bbs.size());
+    out.close();
+    if (!out) {
+        err("EdgeCoverage") << "unable to write " << path << std::endl;
+        exit_fail();
+    }
+}
+
+void EdgeCoverage::save(expr::ExprWriter& w) const
+{
+    w.write_uint(m_num_edges);
+    uint64_t prev = 0;
+    for (uint64_t i = 0; i < EDGE_MAP_SIZE; ++i) {
+        if (m_map[i] == 0)
+            continue;
+        w.write_uint(i - prev);
+        w.write_uint(m_map[i]);
+        prev = i;
+    }
+
+    w.write_uint(m_blocks.size());
+    prev = 0;
+    for (auto [addr, size] : m_blocks) {
+        w.write_uint(addr - prev);
+        w.write_uint(size);
+        prev = addr;
+    }
+}
+
+void EdgeCoverage::restore(expr::ExprReader& r)
+{
+    memset(m_map, 0, EDGE_MAP_SIZE);
+    m_num_edges = r.read_uint();
+    uint64_t i  = 0;
+    for (uint64_t n = 0; n < m_num_edges; ++n) {
+        i += r.read_uint();
+        m_map[i] = r.read_uint();
+    }
+
+    m_blocks.clear();
+    uint64_t addr = 0;
+    uint64_t n    = r.read_uint();
+    for (uint64_t k = 0; k < n; ++k) {
+        addr += r.read_uint();
+        m_blocks.emplace(addr, r.read_uint());
+    }
+}
+
+} // namespace naaz::executor
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+
+#include "../expr/ExprSerializer.hpp"
+#include "../loader/AddressSpace.hpp"
+
+// the edge map has 2^EDGE_MAP_SIZE_POW2 bytes (the AFL default)
+#define EDGE_MAP_SIZE_POW2 16
+#define EDGE_MAP_SIZE      (1UL << EDGE_MAP_SIZE_POW2)
+
+namespace naaz::executor
+{
+
+// AFL-style edge coverage. Every basic block has a pseudo-random id (a hash of
+// its address), and the edge from the block prev to the block cur increments
+// the byte (prev_id >> 1) ^ cur_id of a flat map (saturating at 255). The map
+// has the layout of the AFL trace bits, so it can live in a shared memory
+// segment read by another process (see attach()). The first address and the
+// size of the executed blocks are kept to export the coverage. The edges can
+// be hit by the exploration and by the workers of the StateEmitter at the
+// same time
+class EdgeCoverage
+{
+    std::unique_ptr<uint8_t[]>   m_own_map;
+    uint8_t*                     m_map;
+    uint64_t                     m_num_edges;
+    std::map<uint64_t, uint64_t> m_blocks;
+    mutable std::mutex           m_mutex;
+
+  public:
+    EdgeCoverage();
+
+    // move the map in the EDGE_MAP_SIZE bytes at map (e.g., a shared memory
+    // segment), that must outlive the object
+    void attach(uint8_t* map);
+
+    static uint64_t block_id(uint64_t addr);
+    // the location of an edge from the block prev_id, as AFL (prev_loc)
+    static uint64_t prev_location(uint64_t prev_id) { return prev_id >> 1; }
+
+    // the byte of the edge from prev_loc to the block cur_id
+    static uint64_t edge(uint64_t prev_loc, uint64_t cur_id)
+    {
+        return (prev_loc ^ cur_id) & (EDGE_MAP_SIZE - 1);
+    }
+
+    // increment the edge. True if the edge was never hit before
+    bool hit(uint64_t edge);
+    bool seen(uint64_t edge) const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_map[edge] != 0;
+    }
+    void add_block(uint64_t addr, uint64_t size);
+
+    const uint8_t* map() const { return m_map; }
+    uint64_t       num_edges() const { return m_num_edges; }
+    const std::map<uint64_t, uint64_t>& blocks() const { return m_blocks; }
+
+    // drcov (version 2) log of the executed blocks in the segments of as, as
+    // a single module named module_path (e.g., for lighthouse)
+    void write_drcov(const std::filesystem::path& path,
+                     const loader::AddressSpace&  as,
+                     const std::string&           module_path) const;
+
+    // checkpoints: the non-zero bytes of the map and the blocks
+    void save(expr::ExprWriter& w) const;
+    void restore(expr::ExprReader& r);
+};
+
+} // namespace naaz::executor
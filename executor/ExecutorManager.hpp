@@ -1,37 +1,385 @@
 #pragma once
 
+#include <filesystem>
+#include <fstream>
+#include <map>
 #include <optional>
+#include <sstream>
+#include <string>
+#include <unordered_map>
 #include <vector>
+#include <unistd.h>
 
+#include "Checkpointer.hpp"
+#include "EdgeCoverage.hpp"
 #include "PCodeExecutor.hpp"
+#include "StateEmitter.hpp"
+#include "StateMerger.hpp"
+#include "StateSpiller.hpp"
+#include "WorkerPool.hpp"
+#include "../expr/ExprSerializer.hpp"
+#include "../solver/QueryLog.hpp"
 #include "../state/State.hpp"
+#include "../util/config.hpp"
+#include "../util/stats.hpp"
 
 #define DBG_PRINT_NUM_STATES 0
 
+// the memory usage and the checkpoint timer are checked every
+// PERIODIC_CHECK_INTERVAL basic blocks
+#define PERIODIC_CHECK_INTERVAL 256
+
 namespace naaz::executor
 {
 
 template <class ExplorationPolicy> class ExecutorManager
 {
-    PCodeExecutor     m_executor;
-    ExplorationPolicy m_exploration;
+    PCodeExecutor                      m_executor;
+    ExplorationPolicy                  m_exploration;
+    // the targets of the current exploration (FIND/AVOID flags)
+    models::HookTable                  m_targets;
+    state::StatePtr                    m_entry_state;
+    StateSpiller                       m_spiller;
+    Checkpointer                       m_checkpointer;
+    std::filesystem::path              m_resumed_from;
+    EdgeCoverage                       m_coverage;
+    bool                               m_track_coverage;
+    StateEmitter                       m_emitter;
+    uint64_t                           m_num_executed;
+
+    // in a worker of explore_distributed(), the channel to the coordinator,
+    // and whether the coordinator stopped the exploration
+    WorkerChannel* m_channel;
+    bool           m_stopped;
+    uint64_t       m_num_remote_states;
+
+    // the queued states written in a data file of the checkpoints, and the
+    // number of states of the files. A state is not modified while it is
+    // queued, the following checkpoints refer to the file
+    struct SavedState {
+        std::weak_ptr<state::State> state;
+        std::string                 file;
+        uint64_t                    index;
+    };
+    std::unordered_map<const state::State*, SavedState> m_saved;
+    std::map<std::string, uint64_t>                     m_saved_files;
+
+    // the states held by the merger (if any) are saved in the checkpoints
+    // with the queued ones
+    void periodic_checks(const StateMerger* merger = nullptr)
+    {
+        STATS_MAX(PEAK_STATES, m_exploration.num_states() -
+                                   m_exploration.num_exited() -
+                                   m_exploration.num_avoided());
+        if (++m_num_executed % PERIODIC_CHECK_INTERVAL != 0)
+            return;
+        if (m_channel != nullptr)
+            handle_coordinator();
+        if (m_spiller.over_budget())
+            m_spiller.spill(m_exploration.evict());
+        if (m_checkpointer.due())
+            checkpoint(merger ? merger->held()
+                              : std::vector<state::StatePtr>());
+    }
+
+    void start_checkpoints()
+    {
+        if (!g_config.checkpoint_dir.empty() && !m_checkpointer.enabled())
+            m_checkpointer.enable(g_config.checkpoint_dir, m_resumed_from);
+    }
+
+    void checkpoint(const std::vector<state::StatePtr>& held)
+    {
+        // the index of the next test must count the states being emitted
+        m_emitter.wait_idle();
+
+        std::ostringstream out;
+        {
+            expr::ExprWriter w(out);
+            w.write_uint(m_emitter.next_index());
+            write_saved_states(w, m_exploration.queued());
+            m_exploration.save(w);
+            write_states(w, held);
+            m_spiller.save(w, m_checkpointer);
+            m_coverage.save(w);
+        }
+        m_checkpointer.write(out.str());
+    }
+
+    static void write_states(expr::ExprWriter&                   w,
+                             const std::vector<state::StatePtr>& states)
+    {
+        w.write_uint(states.size());
+        for (auto s : states)
+            s->serialize(w);
+    }
+
+    const SavedState* find_saved(const state::StatePtr& s) const
+    {
+        auto it = m_saved.find(s.get());
+        if (it == m_saved.end() || it->second.state.lock() != s)
+            return nullptr;
+        return &it->second;
+    }
+
+    // the queued states are referenced by (data file, index). Only the
+    // states that are not in a file yet are serialized, in a new one. The
+    // states of a file that is mostly dead (less than half of its states
+    // still queued) are written again, so the file can be dropped
+    void write_saved_states(expr::ExprWriter&                   w,
+                            const std::vector<state::StatePtr>& states)
+    {
+        std::map<std::string, uint64_t> used;
+        for (auto s : states) {
+            if (auto saved = find_saved(s))
+                used[saved->file]++;
+        }
+
+        std::vector<state::StatePtr> fresh;
+        for (auto s : states) {
+            auto saved = find_saved(s);
+            if (saved == nullptr ||
+                used[saved->file] * 2 < m_saved_files[saved->file] ||
+                !m_checkpointer.use_file(saved->file))
+                fresh.push_back(s);
+        }
+        if (!fresh.empty()) {
+            auto file = m_checkpointer.add_file(serialize_states(fresh));
+            for (uint64_t i = 0; i < fresh.size(); ++i)
+                m_saved[fresh[i].get()] = {fresh[i], file, i};
+            m_saved_files[file] = fresh.size();
+        }
+
+        std::map<std::string, uint64_t> files;
+        w.write_uint(states.size());
+        for (auto s : states) {
+            const SavedState& saved = m_saved.at(s.get());
+            w.write_str(saved.file);
+            w.write_uint(saved.index);
+            files[saved.file] = m_saved_files[saved.file];
+        }
+
+        // the files that are not used anymore are removed by the checkpoint
+        m_saved_files = std::move(files);
+        for (auto it = m_saved.begin(); it != m_saved.end();) {
+            if (it->second.state.expired() ||
+                !m_saved_files.contains(it->second.file))
+                it = m_saved.erase(it);
+            else
+                ++it;
+        }
+    }
+
+    std::vector<state::StatePtr>
+    read_saved_states(expr::ExprReader& r, const std::filesystem::path& dir)
+    {
+        std::map<std::string, std::vector<state::StatePtr>> files;
+        std::vector<state::StatePtr>                        states;
+        uint64_t                                            n = r.read_uint();
+        for (uint64_t i = 0; i < n; ++i) {
+            std::string file  = r.read_str();
+            uint64_t    index = r.read_uint();
+            if (!files.contains(file)) {
+                std::ifstream in(Checkpointer::file_path(dir, file),
+                                 std::ios::binary);
+                expr::ExprReader file_r(in, float_formats());
+                files[file] = read_states(file_r);
+            }
+
+            auto s = files[file].at(index);
+            states.push_back(s);
+            m_saved[s.get()]    = {s, file, index};
+            m_saved_files[file] = files[file].size();
+        }
+        return states;
+    }
+
+    expr::ExprReader::FloatFormatLookup float_formats() const
+    {
+        auto lifter = m_entry_state->lifter();
+        return [lifter](int32_t size) {
+            return lifter->get_float_format(size);
+        };
+    }
+
+    std::string serialize_states(const std::vector<state::StatePtr>& states)
+    {
+        std::ostringstream out;
+        {
+            expr::ExprWriter w(out);
+            write_states(w, states);
+        }
+        return out.str();
+    }
+
+    std::vector<state::StatePtr> deserialize_states(const std::string& data)
+    {
+        std::istringstream in(data);
+        expr::ExprReader   r(in, float_formats());
+        return read_states(r);
+    }
+
+    // send the coverage found since the previous call, if any
+    void share_coverage()
+    {
+        std::ostringstream out;
+        bool               found;
+        {
+            expr::ExprWriter w(out);
+            found = m_exploration.save_coverage(w);
+        }
+        if (found)
+            m_channel->send(WorkerChannel::COVERAGE, out.str());
+    }
+
+    void merge_coverage(const std::string& data)
+    {
+        std::istringstream in(data);
+        expr::ExprReader   r(in, float_formats());
+        m_exploration.merge_coverage(r);
+    }
+
+    // a worker answers the messages of the coordinator while it is busy. The
+    // pending messages are read before sending the coverage, the coordinator
+    // may be blocked sending them
+    void handle_coordinator()
+    {
+        while (!m_stopped && m_channel->ready()) {
+            auto msg = m_channel->recv();
+            if (msg.type == WorkerChannel::DONATE) {
+                auto states = m_exploration.evict();
+                m_channel->send(WorkerChannel::STATES,
+                                states.empty() ? ""
+                                               : serialize_states(states));
+            } else if (msg.type == WorkerChannel::COVERAGE)
+                merge_coverage(msg.payload);
+            else if (msg.type == WorkerChannel::STOP)
+                m_stopped = true;
+        }
+        if (!m_stopped)
+            share_coverage();
+    }
+
+    // an idle worker waits for the states donated by the other workers.
+    // Return nothing when the coordinator stops the exploration
+    std::vector<state::StatePtr> wait_for_states()
+    {
+        share_coverage();
+        m_channel->send(WorkerChannel::IDLE);
+        while (1) {
+            auto msg = m_channel->recv();
+            if (msg.type == WorkerChannel::STATES)
+                return deserialize_states(msg.payload);
+            if (msg.type == WorkerChannel::COVERAGE)
+                merge_coverage(msg.payload);
+            else if (msg.type == WorkerChannel::DONATE)
+                m_channel->send(WorkerChannel::STATES);
+            else if (msg.type == WorkerChannel::STOP) {
+                m_stopped = true;
+                return {};
+            }
+        }
+    }
+
+    [[noreturn]] void run_worker(uint32_t index, WorkerChannel channel,
+                                 const std::vector<uint64_t>& find,
+                                 const std::vector<uint64_t>& avoid)
+    {
+        m_channel = &channel;
+
+        // the first worker starts from the initial state, the others wait
+        // for the states of the first one
+        if (index != 0)
+            while (m_exploration.get_next().has_value())
+                ;
+
+        auto s = explore(find, avoid);
+        if (s.has_value()) {
+            channel.send(WorkerChannel::FOUND, serialize_states({*s}));
+            while (!m_stopped) {
+                auto msg = channel.recv();
+                if (msg.type == WorkerChannel::DONATE)
+                    channel.send(WorkerChannel::STATES);
+                else if (msg.type == WorkerChannel::STOP)
+                    m_stopped = true;
+            }
+        }
+
+        channel.send(WorkerChannel::STATS, std::to_string(num_states()));
+        m_spiller.clear();
+        _exit(0);
+    }
+
+    std::vector<state::StatePtr> read_states(expr::ExprReader& r)
+    {
+        std::vector<state::StatePtr> states;
+        uint64_t                     n = r.read_uint();
+        for (uint64_t i = 0; i < n; ++i) {
+            auto s = m_entry_state->clone();
+            s->deserialize(r);
+            states.push_back(s);
+        }
+        return states;
+    }
 
   public:
     ExecutorManager(state::StatePtr initial_state)
-        : m_exploration(initial_state), m_executor(initial_state->lifter())
+        : m_exploration(initial_state), m_executor(initial_state->lifter()),
+          m_entry_state(initial_state), m_track_coverage(false),
+          m_num_executed(0), m_channel(nullptr), m_stopped(false),
+          m_num_remote_states(0)
+    {
+    }
+
+    // continue the exploration from the checkpoint in dir. The symbols of the
+    // checkpoint must be already loaded (see Checkpointer::load_symbols), and
+    // the initial state must be the entry state of the same binary
+    void resume(const std::filesystem::path& dir)
     {
+        std::istringstream in(Checkpointer::load(dir));
+        expr::ExprReader   r(in, float_formats());
+
+        m_emitter.set_next_index(r.read_uint());
+        auto queued = read_saved_states(r, dir);
+        m_exploration.restore(queued, r);
+        // the merger does not survive the checkpoint, its states are queued
+        m_exploration.add_actives(read_states(r));
+        m_spiller.restore(r, m_entry_state, dir);
+        m_coverage.restore(r);
+        m_resumed_from = dir;
     }
 
     std::optional<state::StatePtr> explore(std::vector<uint64_t> find,
                                            std::vector<uint64_t> avoid)
     {
-        std::set<uint64_t> find_set(find.begin(), find.end());
-        std::set<uint64_t> avoid_set(avoid.begin(), avoid.end());
+        // the targets of a previous exploration are dropped
+        m_targets = models::HookTable();
+        for (auto addr : find)
+            m_targets.set_flags(addr, models::HookTable::FIND);
+        for (auto addr : avoid)
+            m_targets.set_flags(addr, models::HookTable::AVOID);
+        m_exploration.set_targets(find);
+        start_checkpoints();
 
+        // with merge_states, the active states wait in the merger for a few
+        // blocks before reaching the exploration technique
+        StateMerger merger;
         while (1) {
             std::optional<state::StatePtr> s = m_exploration.get_next();
-            if (!s.has_value())
-                break;
+            // the state is executed in place, its data file is stale
+            if (s.has_value() && !m_saved.empty())
+                m_saved.erase(s->get());
+            if (!s.has_value()) {
+                if (!merger.empty())
+                    m_exploration.add_actives(merger.flush());
+                else if (!m_spiller.empty())
+                    m_exploration.add_actives(m_spiller.reload());
+                else if (m_channel != nullptr && !m_stopped)
+                    m_exploration.add_actives(wait_for_states());
+                else
+                    break;
+                continue;
+            }
 
             ExecutorResult next_states =
                 m_executor.execute_basic_block(s.value());
@@ -41,14 +389,31 @@ template <class ExplorationPolicy> class ExecutorManager
 
             std::vector<state::StatePtr> active;
             for (auto s : next_states.active) {
-                if (find_set.contains(s->pc())) {
+                const models::HookTable::Hook* hook = m_targets.lookup(s->pc());
+                if (hook == nullptr)
+                    active.push_back(s);
+                else if (hook->flags & models::HookTable::FIND) {
+                    // with lazy solving, s can be a pending child of a
+                    // CBRANCH that was never checked
+                    solver::QueryOriginScope origin(
+                        solver::QueryOrigin::CBRANCH);
                     if (s->satisfiable() == solver::CheckResult::SAT)
                         return s;
-                } else if (!avoid_set.contains(s->pc()))
+                } else if (!(hook->flags & models::HookTable::AVOID))
                     active.push_back(s);
             }
 
-            m_exploration.add_actives(active);
+            if (g_config.merge_states) {
+                // the released states are queued under their own origin
+                auto released = merger.step(active);
+                m_exploration.add_successors(released,
+                                             merger.held_last_step());
+            } else {
+                m_exploration.add_actives(active);
+            }
+            periodic_checks(&merger);
+            if (m_stopped)
+                break;
 #if DBG_PRINT_NUM_STATES
             std::cout << "num states: " << m_exploration.num_states()
                       << " (e: " << m_exploration.num_exited()
@@ -60,6 +425,28 @@ template <class ExplorationPolicy> class ExecutorManager
         return {};
     }
 
+    // explore() on num_workers processes (see WorkerPool). The found state,
+    // if any, is the first one reported by a worker. The states generated by
+    // the workers are counted by num_states()
+    std::optional<state::StatePtr>
+    explore_distributed(std::vector<uint64_t> find, std::vector<uint64_t> avoid,
+                        uint32_t num_workers)
+    {
+        WorkerPool pool;
+        if (auto worker = pool.spawn(num_workers))
+            run_worker(worker->first, worker->second, find, avoid);
+
+        // the initial state belongs to the first worker
+        while (m_exploration.get_next().has_value())
+            ;
+
+        std::optional<std::string> found = pool.coordinate();
+        m_num_remote_states += pool.num_states();
+        if (!found.has_value())
+            return {};
+        return deserialize_states(*found).at(0);
+    }
+
     std::optional<state::StatePtr> explore(uint64_t find_addr)
     {
         std::vector<uint64_t> find_addrs;
@@ -69,22 +456,36 @@ template <class ExplorationPolicy> class ExecutorManager
         return explore(find_addrs, avoid_addrs);
     }
 
-    void gen_paths(void (*callback)(state::StatePtr))
+    void gen_paths(StateEmitter::Callback callback)
     {
-        // Generate states, and call the `callback` when a state exits
+        // Generate states, and call the `callback` with the state and its
+        // index when a state exits (see StateEmitter). The indexes continue
+        // after a resume. The edge coverage is tracked with
+        // emit_new_coverage_only (only the states credited with new edges are
+        // emitted) or track_coverage()
+        if (g_config.emit_new_coverage_only || m_track_coverage) {
+            m_executor.set_coverage(&m_coverage);
+            m_emitter.set_coverage(&m_coverage);
+        }
+        start_checkpoints();
+        m_emitter.start(callback);
         while (1) {
             std::optional<state::StatePtr> s = m_exploration.get_next();
-            if (!s.has_value())
-                break;
+            if (!s.has_value()) {
+                if (m_spiller.empty())
+                    break;
+                m_exploration.add_actives(m_spiller.reload());
+                continue;
+            }
 
             ExecutorResult next_states =
                 m_executor.execute_basic_block(s.value());
 
             for (auto s : next_states.exited)
-                if (s->satisfiable() == solver::CheckResult::SAT)
-                    callback(s);
+                m_emitter.push(s);
 
             m_exploration.add_actives(next_states.active);
+            periodic_checks();
 #if DBG_PRINT_NUM_STATES
             std::cout << "num states: " << m_exploration.num_states()
                       << " (e: " << m_exploration.num_exited()
@@ -92,9 +493,21 @@ template <class ExplorationPolicy> class ExecutorManager
                       << std::endl;
 #endif
         }
+        m_emitter.finish();
     }
 
-    size_t num_states() const { return m_exploration.num_states(); }
+    // track the edge coverage of gen_paths even without
+    // emit_new_coverage_only, e.g., to export it
+    void track_coverage() { m_track_coverage = true; }
+
+    EdgeCoverage&       coverage() { return m_coverage; }
+    const EdgeCoverage& coverage() const { return m_coverage; }
+
+    size_t num_states() const
+    {
+        return m_exploration.num_states() + m_spiller.num_spilled() +
+               m_num_remote_states;
+    }
 };
 
 } // namespace naaz::executor
@@ -3,6 +3,7 @@
 #include <optional>
 #include <vector>
 #include "../state/State.hpp"
+#include "../expr/ExprSerializer.hpp"
 
 namespace naaz::executor
 {
@@ -19,7 +20,43 @@ class ExplorationTechnique
 
     virtual std::optional<state::StatePtr> get_next() = 0;
 
+    // the find addresses of the exploration, ignored by the undirected
+    // techniques
+    virtual void set_targets(const std::vector<uint64_t>& find) {}
+
     virtual void add_actives(std::vector<state::StatePtr> states) = 0;
+
+    // the successors of the state returned by get_next. The held ones wait
+    // in the StateMerger and are queued later with add_actives, the
+    // techniques that place the states by their origin (e.g., RandomPath)
+    // keep a place for them
+    virtual void add_successors(std::vector<state::StatePtr>        active,
+                                const std::vector<state::StatePtr>& held)
+    {
+        add_actives(active);
+    }
+
+    // remove about half of the queued states, the least promising ones, to be
+    // spilled to disk. The techniques that do not support it return nothing
+    virtual std::vector<state::StatePtr> evict() { return {}; }
+
+    // distributed explorations (see WorkerPool). save_coverage() writes the
+    // coverage found since its previous call, and returns false if there is
+    // none. merge_coverage() reads the coverage found by another worker. The
+    // techniques that do not rank the states by coverage share nothing
+    virtual bool save_coverage(expr::ExprWriter& w) { return false; }
+    virtual void merge_coverage(expr::ExprReader& r) {}
+
+    // checkpoints. queued() returns the queued states (without removing
+    // them), and save() writes the bookkeeping of the technique. restore()
+    // replaces the queue with the states returned by queued(), in the same
+    // order, and reads back the bookkeeping
+    virtual std::vector<state::StatePtr> queued() const = 0;
+    virtual void                         save(expr::ExprWriter& w) const {}
+
+    virtual void restore(std::vector<state::StatePtr> states,
+                         expr::ExprReader&            r) = 0;
+
     void         add_exited(state::StatePtr s);
     void         add_avoided(state::StatePtr s);
 
@@ -0,0 +1,215 @@
+#include <cerrno>
+#include <filesystem>
+#include <set>
+#include <stdexcept>
+#include <unistd.h>
+
+#include "JobServer.hpp"
+#include "ExecutorManager.hpp"
+#include "RandDFSExplorationTechnique.hpp"
+#include "BFSExplorationTechnique.hpp"
+#include "DFSExplorationTechnique.hpp"
+#include "CovExplorationTechnique.hpp"
+#include "DirectedExplorationTechnique.hpp"
+#include "RandomPathExplorationTechnique.hpp"
+
+#include "../expr/ExprBuilder.hpp"
+#include "../solver/ConstraintManager.hpp"
+#include "../util/strutil.hpp"
+#include "../util/parseutil.hpp"
+
+#define MAX_REQUEST_SIZE (1024UL * 1024UL)
+
+using json = nlohmann::json;
+
+namespace naaz::executor
+{
+
+typedef JobServer::clock_type clock_type;
+
+static double ms_since(clock_type::time_point t)
+{
+    return std::chrono::duration<double, std::milli>(clock_type::now() - t)
+        .count();
+}
+
+// output directory and number of test cases of the gen_paths job of the
+// thread (the callback of gen_paths cannot capture them)
+static thread_local std::string g_outdir;
+static thread_local uint64_t    g_num_testcases;
+
+static std::vector<uint64_t> parse_addrs(const json& j)
+{
+    std::vector<uint64_t> res;
+    if (j.is_null())
+        return res;
+    if (!j.is_array())
+        throw std::invalid_argument("the addresses must be an array");
+
+    for (const auto& a : j) {
+        if (a.is_number_unsigned()) {
+            res.push_back(a.get<uint64_t>());
+            continue;
+        }
+        uint64_t addr;
+        if (!a.is_string() ||
+            !parse_uint(a.get<std::string>().c_str(), &addr))
+            throw std::invalid_argument("invalid address " + a.dump());
+        res.push_back(addr);
+    }
+    return res;
+}
+
+template <class ExplorationPolicy>
+static void run_job(state::StatePtr entry_state, const json& req, json& res)
+{
+    ExecutorManager<ExplorationPolicy> em(entry_state);
+    std::string outdir = req.at("output").get<std::string>();
+
+    if (req.at("type") == "find") {
+        std::optional<state::StatePtr> s = em.explore(
+            parse_addrs(req.value("find", json())),
+            parse_addrs(req.value("avoid", json())));
+        res["found"]      = s.has_value();
+        res["num_states"] = em.num_states() + (s.has_value() ? 1 : 0);
+        if (s.has_value())
+            s.value()->dump(outdir);
+        return;
+    }
+
+    g_outdir        = outdir;
+    g_num_testcases = 0;
+    em.gen_paths([](state::StatePtr s, uint64_t n_testcase) {
+        std::string o = string_format("%s/%06lu", g_outdir.c_str(),
+                                      (unsigned long)n_testcase);
+        std::filesystem::create_directories(o);
+        if (s->dump(o))
+            g_num_testcases++;
+    });
+    res["num_states"]    = em.num_states();
+    res["num_testcases"] = g_num_testcases;
+}
+
+json JobServer::handle_request(const json& req)
+{
+    json res;
+    auto start = clock_type::now();
+
+    std::string type = req.at("type").get<std::string>();
+    if (type != "find" && type != "gen_paths")
+        throw std::invalid_argument("unknown job type " + type);
+    if (type == "find" && parse_addrs(req.value("find", json())).empty())
+        throw std::invalid_argument("find jobs need some find addresses");
+
+    std::string technique =
+        req.value("technique", type == "find" ? "rand_dfs" : "cov");
+    std::set<std::string> admissible_techniques{"dfs", "rand_dfs", "bfs",
+                                                "cov", "directed",
+                                                "random_path"};
+    if (!admissible_techniques.contains(technique))
+        throw std::invalid_argument(technique +
+                                    " is not an admissible technique");
+
+    std::filesystem::create_directories(req.at("output").get<std::string>());
+
+    // the binary is loaded once per process, the following jobs reuse the
+    // address space and the lifter (with its block cache)
+    auto        load_start  = clock_type::now();
+    std::string binpath     = req.at("binary").get<std::string>();
+    bool        cached      = false;
+    auto        entry_state = m_entry_state(binpath, &cached);
+    res["cached"]           = cached;
+
+    std::vector<std::string> program_args{binpath};
+    for (const auto& arg : req.value("args", json::array()))
+        program_args.push_back(arg.get<std::string>());
+    entry_state->set_argv(program_args);
+    if (req.contains("state_json"))
+        entry_state->init_from_json(req.at("state_json").get<std::string>());
+    double load_ms = ms_since(load_start);
+
+    auto explore_start = clock_type::now();
+    if (technique == "bfs")
+        run_job<BFSExplorationTechnique>(entry_state, req, res);
+    else if (technique == "dfs")
+        run_job<DFSExplorationTechnique>(entry_state, req, res);
+    else if (technique == "rand_dfs")
+        run_job<RandDFSExplorationTechnique>(entry_state, req, res);
+    else if (technique == "directed")
+        run_job<DirectedExplorationTechnique>(entry_state, req, res);
+    else if (technique == "random_path")
+        run_job<RandomPathExplorationTechnique>(entry_state, req, res);
+    else
+        run_job<CovExplorationTechnique>(entry_state, req, res);
+
+    res["status"]               = "ok";
+    res["timing"]["load_ms"]    = load_ms;
+    res["timing"]["explore_ms"] = ms_since(explore_start);
+    res["timing"]["job_ms"]     = ms_since(start);
+    return res;
+}
+
+// the request ends at the first newline (or when the client shuts down the
+// writing side of the connection)
+static std::optional<std::string> read_request(int fd)
+{
+    std::string req;
+    char        buf[4096];
+    while (req.find('\n') == std::string::npos) {
+        ssize_t n = read(fd, buf, sizeof(buf));
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        req.append(buf, n);
+        if (req.size() > MAX_REQUEST_SIZE)
+            return {};
+    }
+    return req.substr(0, req.find('\n'));
+}
+
+static void write_response(int fd, const json& res)
+{
+    std::string out = res.dump() + "\n";
+    size_t      off = 0;
+    while (off < out.size()) {
+        ssize_t n = write(fd, out.data() + off, out.size() - off);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        off += n;
+    }
+}
+
+json JobServer::serve(int fd, uint64_t id, clock_type::time_point received)
+{
+    double queue_ms = ms_since(received);
+
+    json res;
+    auto req = read_request(fd);
+    try {
+        if (!req.has_value())
+            throw std::invalid_argument("the request is too large");
+        res = handle_request(json::parse(*req));
+    } catch (const std::exception& e) {
+        res           = json();
+        res["status"] = "error";
+        res["error"]  = e.what();
+    }
+
+    // the states of the job are gone, release the expressions that only the
+    // caches still reference (e.g., the symbols of its argv)
+    solver::ConstraintManager::collect_garbage();
+    expr::ExprBuilder::The().collect_garbage();
+
+    res["id"]                 = id;
+    res["timing"]["queue_ms"] = queue_ms;
+    res["timing"]["total_ms"] = ms_since(received);
+
+    write_response(fd, res);
+    close(fd);
+    return res;
+}
+
+} // namespace naaz::executor
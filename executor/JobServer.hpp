@@ -0,0 +1,40 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <nlohmann/json.hpp>
+
+#include "../state/State.hpp"
+
+namespace naaz::executor
+{
+
+// Runs the jobs of naaz_server (see tools/naaz_server.cpp), one per
+// connection. The job is a JSON object terminated by a newline, the answer is
+// a JSON object on a single line. The entry state of the binary of a job is
+// built by the EntryState function, which sets o_cached if it reused a loaded
+// binary. Every job releases the cached data of its expressions when it ends.
+// The engine failures must raise fatal_error (see set_fail_throws), the job is
+// answered with an error
+class JobServer
+{
+  public:
+    typedef std::chrono::steady_clock clock_type;
+    typedef state::StatePtr (*EntryState)(const std::string& binary,
+                                          bool*              o_cached);
+
+  private:
+    EntryState m_entry_state;
+
+  public:
+    JobServer(EntryState entry_state) : m_entry_state(entry_state) {}
+
+    // run a job, it throws if the request is invalid or the job fails
+    nlohmann::json handle_request(const nlohmann::json& req);
+
+    // read the job of the connection, run it, write the answer and close fd.
+    // The answer is returned
+    nlohmann::json serve(int fd, uint64_t id, clock_type::time_point received);
+};
+
+} // namespace naaz::executor
@@ -6,7 +6,9 @@
 #include "../expr/ExprBuilder.hpp"
 #include "../util/ioutil.hpp"
 #include "../util/config.hpp"
+#include "../util/stats.hpp"
 #include "../state/Platform.hpp"
+#include "../solver/QueryLog.hpp"
 
 #define DBG_OPS         0
 #define DBG_PRINT_BLOCK 0
@@ -17,7 +19,7 @@ namespace naaz::executor
 {
 
 PCodeExecutor::PCodeExecutor(std::shared_ptr<lifter::PCodeLifter> lifter)
-    : m_lifter(lifter)
+    : m_lifter(lifter), m_coverage(nullptr)
 {
     m_ram_space_id   = lifter->ram_space_id();
     m_regs_space_id  = lifter->regs_space_id();
@@ -758,21 +760,41 @@ void PCodeExecutor::execute_pcodeop(ExecutionContext& ctx, csleigh_PcodeOp op)
             // std::cout << "cond: " << cond->to_string() << std::endl;
             // std::cout << "pi: " << ctx.state->pi()->to_string() << std::endl;
 
+            // constant condition, no need to fork
+            if (is_false_const(cond))
+                break;
+            if (is_false_const(neg_cond)) {
+                ctx.state->set_pc(dst_addr);
+                ctx.successors.active.push_back(ctx.state);
+                ctx.state = nullptr;
+                break;
+            }
+
+            if (g_config.lazy_solving && ctx.at_block_end) {
+                // both the successors are pending children of the current
+                // state. They are materialized when (and if) they are
+                // scheduled
+                uint64_t fallthrough_addr =
+                    ctx.transl.address.offset + ctx.transl.length;
+                ctx.successors.active.push_back(
+                    state::State::fork(ctx.state, dst_addr, cond));
+                ctx.successors.active.push_back(
+                    state::State::fork(ctx.state, fallthrough_addr, neg_cond));
+                ctx.state = nullptr;
+                break;
+            }
+
             state::StatePtr other_state = ctx.state->clone();
 
             if (g_config.lazy_solving) {
-                if (!is_false_const(neg_cond)) {
-                    ctx.state->solver().add(neg_cond);
-                } else
-                    ctx.state = nullptr;
+                ctx.state->solver().add(neg_cond);
 
-                if (!is_false_const(cond)) {
-                    other_state->set_pc(dst_addr);
-                    other_state->solver().add(cond);
-                    ctx.successors.active.push_back(other_state);
-                }
+                other_state->set_pc(dst_addr);
+                other_state->solver().add(cond);
+                ctx.successors.active.push_back(other_state);
             } else {
-                solver::CheckResult sat_cond =
+                solver::QueryOriginScope origin(solver::QueryOrigin::CBRANCH);
+                solver::CheckResult      sat_cond =
                     other_state->solver().check_sat_and_add_if_sat(cond);
                 if (sat_cond == solver::CheckResult::UNKNOWN) {
                     info("PCodeExecutor")
@@ -866,7 +888,8 @@ void PCodeExecutor::execute_pcodeop(ExecutionContext& ctx, csleigh_PcodeOp op)
 
 state::StatePtr PCodeExecutor::execute_instruction(state::StatePtr     state,
                                                    csleigh_Translation t,
-                                                   ExecutorResult& o_successors)
+                                                   ExecutorResult& o_successors,
+                                                   bool last_in_block)
 {
     state::MapMemory tmp_storage(
         "tmp", state::MapMemory::UninitReadBehavior::THROW_ERR);
@@ -876,6 +899,7 @@ state::StatePtr PCodeExecutor::execute_instruction(state::StatePtr     state,
         if (ctx.state == nullptr)
             break;
         csleigh_PcodeOp op = t.ops[i];
+        ctx.at_block_end   = last_in_block && i == t.ops_count - 1;
         try {
             execute_pcodeop(ctx, op);
         } catch (UnsatStateException e) {
@@ -886,23 +910,27 @@ state::StatePtr PCodeExecutor::execute_instruction(state::StatePtr     state,
     return ctx.state;
 }
 
-ExecutorResult PCodeExecutor::execute_basic_block(state::StatePtr state)
+ExecutorResult PCodeExecutor::execute_block(state::StatePtr state)
 {
+    STATS_TIMER(EXECUTE);
     ExecutorResult successors;
 
-    if (state->is_linked_function(state->pc())) {
-        auto model = state->get_linked_model(state->pc());
+    // a single lookup in the hook table for every block
+    const models::Model* model = state->get_linked_model(state->pc());
+    if (model != nullptr) {
         try {
             model->exec(state, successors);
         } catch (UnsatStateException e) {
             successors.active.clear();
             successors.exited.clear();
         }
+        for (auto succ : successors.active)
+            succ->apply_implied_values();
         return successors;
     }
 
-    uint8_t* data;
-    uint64_t size;
+    const uint8_t* data;
+    uint64_t       size;
 
     if (!state->get_code_at(state->pc(), &data, &size)) {
         err("PCodeExecutor")
@@ -919,6 +947,11 @@ ExecutorResult PCodeExecutor::execute_basic_block(state::StatePtr state)
             << "unable to translate code @ 0x" << state->pc() << std::endl;
         exit_fail();
     }
+    if (m_coverage != nullptr) {
+        auto last = tr->instructions[tr->instructions_count - 1];
+        m_coverage->add_block(state->pc(), last.address.offset + last.length -
+                                               state->pc());
+    }
 #if DBG_PRINT_BLOCK
     block->pp();
 #endif
@@ -926,7 +959,8 @@ ExecutorResult PCodeExecutor::execute_basic_block(state::StatePtr state)
     for (uint32_t i = 0; i < tr->instructions_count; ++i) {
         csleigh_Translation t = tr->instructions[i];
         state->set_pc(t.address.offset);
-        state = execute_instruction(state, t, successors);
+        state = execute_instruction(state, t, successors,
+                                    i == tr->instructions_count - 1);
         if (state == nullptr)
             break;
     }
@@ -940,7 +974,29 @@ ExecutorResult PCodeExecutor::execute_basic_block(state::StatePtr state)
         successors.active.push_back(state);
     }
 
+    for (auto succ : successors.active)
+        succ->apply_implied_values();
     return successors;
 }
 
+ExecutorResult PCodeExecutor::execute_basic_block(state::StatePtr state)
+{
+    if (m_coverage == nullptr)
+        return execute_block(state);
+
+    // a new edge is marked (and credited) once the state is known to be
+    // satisfiable, with lazy solving the state can be an infeasible pending
+    // child (see StateEmitter::credit). The successors inherit the new edges
+    // of the state
+    uint64_t id   = EdgeCoverage::block_id(state->pc());
+    uint64_t edge = EdgeCoverage::edge(state->prev_location(), id);
+    if (m_coverage->seen(edge))
+        m_coverage->hit(edge);
+    else
+        state->add_new_edge(edge);
+    state->set_prev_location(EdgeCoverage::prev_location(id));
+
+    return execute_block(state);
+}
+
 }; // namespace naaz::executor
@@ -3,6 +3,7 @@
 #include <vector>
 #include <memory>
 
+#include "EdgeCoverage.hpp"
 #include "Executor.hpp"
 #include "../lifter/PCodeLifter.hpp"
 #include "../state/MapMemory.hpp"
@@ -15,6 +16,7 @@ namespace naaz::executor
 class PCodeExecutor
 {
     std::shared_ptr<lifter::PCodeLifter> m_lifter;
+    EdgeCoverage*                        m_coverage;
 
     uint32_t m_ram_space_id;
     uint32_t m_regs_space_id;
@@ -27,6 +29,9 @@ class PCodeExecutor
         csleigh_Translation& transl;
         ExecutorResult&      successors;
 
+        // true while executing the last P-Code op of the basic block
+        bool at_block_end = false;
+
         ExecutionContext(state::StatePtr state_, state::MapMemory& tmp_storage_,
                          csleigh_Translation& transl_,
                          ExecutorResult&      successors_)
@@ -45,11 +50,17 @@ class PCodeExecutor
     void execute_pcodeop(ExecutionContext& ctx, csleigh_PcodeOp op);
     state::StatePtr execute_instruction(state::StatePtr     state,
                                         csleigh_Translation t,
-                                        ExecutorResult&     o_successors);
+                                        ExecutorResult&     o_successors,
+                                        bool                last_in_block);
+    ExecutorResult  execute_block(state::StatePtr state);
 
   public:
     PCodeExecutor(std::shared_ptr<lifter::PCodeLifter> lifter);
 
+    // record the edges and the blocks executed by execute_basic_block() in
+    // coverage (nullptr: disabled), that must outlive the executor
+    void set_coverage(EdgeCoverage* coverage) { m_coverage = coverage; }
+
     ExecutorResult execute_basic_block(state::StatePtr state);
 };
 
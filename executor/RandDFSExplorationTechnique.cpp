@@ -42,6 +42,26 @@ std::optional<state::StatePtr> RandDFSExplorationTechnique::get_next()
     return s;
 }
 
+std::vector<state::StatePtr> RandDFSExplorationTechnique::evict()
+{
+    // the oldest states are at the bottom of the stack
+    size_t                       n = m_active.size() / 2;
+    std::vector<state::StatePtr> res(m_active.begin(), m_active.begin() + n);
+    m_active.erase(m_active.begin(), m_active.begin() + n);
+    return res;
+}
+
+std::vector<state::StatePtr> RandDFSExplorationTechnique::queued() const
+{
+    return m_active;
+}
+
+void RandDFSExplorationTechnique::restore(std::vector<state::StatePtr> states,
+                                        expr::ExprReader&)
+{
+    m_active = std::move(states);
+}
+
 template class ExecutorManager<RandDFSExplorationTechnique>;
 
 } // namespace naaz::executor
@@ -0,0 +1,237 @@
+#include "RandomPathExplorationTechnique.hpp"
+
+namespace naaz::executor
+{
+
+RandomPathExplorationTechnique::RandomPathExplorationTechnique(
+    state::StatePtr initial_state)
+    : ExplorationTechnique(initial_state), m_selected(nullptr),
+      m_num_active(1), m_rand(0x42424242)
+{
+    m_root = make_leaf(initial_state, false);
+}
+
+RandomPathExplorationTechnique::~RandomPathExplorationTechnique() { clear(); }
+
+void RandomPathExplorationTechnique::clear()
+{
+    // the tree can be very deep, do not destroy it recursively
+    std::vector<std::unique_ptr<Node>> nodes;
+    nodes.push_back(std::move(m_root));
+    while (!nodes.empty()) {
+        auto node = std::move(nodes.back());
+        nodes.pop_back();
+        if (node == nullptr)
+            continue;
+        nodes.push_back(std::move(node->children[0]));
+        nodes.push_back(std::move(node->children[1]));
+    }
+    m_parked.clear();
+}
+
+std::unique_ptr<RandomPathExplorationTechnique::Node>&
+RandomPathExplorationTechnique::owner(Node* node)
+{
+    if (node->parent == nullptr)
+        return m_root;
+    if (node->parent->children[0].get() == node)
+        return node->parent->children[0];
+    return node->parent->children[1];
+}
+
+std::unique_ptr<RandomPathExplorationTechnique::Node>
+RandomPathExplorationTechnique::make_leaf(state::StatePtr state, bool parked)
+{
+    auto leaf       = std::make_unique<Node>();
+    leaf->state     = state;
+    leaf->parked    = parked;
+    leaf->num_ready = parked ? 0 : 1;
+    if (parked)
+        m_parked[state.get()] = leaf.get();
+    return leaf;
+}
+
+std::unique_ptr<RandomPathExplorationTechnique::Node>
+RandomPathExplorationTechnique::build_subtree(
+    std::vector<std::unique_ptr<Node>>& leaves, size_t begin, size_t end)
+{
+    // more than two successors (e.g., a symbolic jump) are arranged in a
+    // balanced subtree
+    if (end - begin == 1)
+        return std::move(leaves[begin]);
+
+    auto   node               = std::make_unique<Node>();
+    size_t mid                = begin + (end - begin) / 2;
+    node->children[0]         = build_subtree(leaves, begin, mid);
+    node->children[1]         = build_subtree(leaves, mid, end);
+    node->children[0]->parent = node.get();
+    node->children[1]->parent = node.get();
+    node->num_ready =
+        node->children[0]->num_ready + node->children[1]->num_ready;
+    return node;
+}
+
+void RandomPathExplorationTechnique::update_ready(Node* node, int64_t delta)
+{
+    for (; node != nullptr; node = node->parent)
+        node->num_ready += delta;
+}
+
+void RandomPathExplorationTechnique::remove_leaf(Node* leaf)
+{
+    update_ready(leaf->parent, -(int64_t)leaf->num_ready);
+
+    Node* parent = leaf->parent;
+    if (parent == nullptr) {
+        m_root.reset();
+        return;
+    }
+
+    // the parent is replaced by the sibling of the leaf, so every internal
+    // node has two children and the removal does not leave dead paths
+    auto& sibling = parent->children[0].get() == leaf ? parent->children[1]
+                                                      : parent->children[0];
+    auto subtree    = std::move(sibling);
+    subtree->parent = parent->parent;
+    owner(parent)   = std::move(subtree);
+}
+
+void RandomPathExplorationTechnique::add_actives(
+    std::vector<state::StatePtr> states)
+{
+    add_successors(states, {});
+}
+
+void RandomPathExplorationTechnique::add_successors(
+    std::vector<state::StatePtr>        active,
+    const std::vector<state::StatePtr>& held)
+{
+    Node* selected = m_selected;
+    m_selected     = nullptr;
+
+    std::vector<std::unique_ptr<Node>> leaves;
+    for (auto s : active) {
+        auto it = m_parked.find(s.get());
+        if (it == m_parked.end()) {
+            leaves.push_back(make_leaf(s, false));
+        } else {
+            // a state released by the merger goes back to its own leaf, not
+            // under the selected one
+            it->second->parked = false;
+            update_ready(it->second, 1);
+            m_parked.erase(it);
+        }
+        m_num_active++;
+    }
+    for (auto s : held)
+        leaves.push_back(make_leaf(s, true));
+
+    if (leaves.empty()) {
+        if (selected != nullptr)
+            remove_leaf(selected);
+        return;
+    }
+
+    auto   subtree = build_subtree(leaves, 0, leaves.size());
+    size_t ready   = subtree->num_ready;
+    if (selected != nullptr) {
+        // the successors take the place of the executed state
+        Node* parent    = selected->parent;
+        subtree->parent = parent;
+        owner(selected) = std::move(subtree);
+        update_ready(parent, ready);
+    } else if (m_root == nullptr) {
+        m_root = std::move(subtree);
+    } else {
+        auto root                 = std::make_unique<Node>();
+        root->children[0]         = std::move(m_root);
+        root->children[1]         = std::move(subtree);
+        root->children[0]->parent = root.get();
+        root->children[1]->parent = root.get();
+        root->num_ready           = root->children[0]->num_ready + ready;
+        m_root                    = std::move(root);
+    }
+}
+
+std::optional<state::StatePtr> RandomPathExplorationTechnique::get_next()
+{
+    // the previous state was not followed by its successors (e.g., it
+    // reached a find address), its leaf is dead
+    if (m_selected != nullptr) {
+        remove_leaf(m_selected);
+        m_selected = nullptr;
+    }
+
+    // only parked states (if any) are left
+    if (m_root == nullptr || m_root->num_ready == 0)
+        return {};
+
+    Node*    node  = m_root.get();
+    uint64_t bits  = 0;
+    int      nbits = 0;
+    while (!node->is_leaf()) {
+        if (node->children[0]->num_ready == 0) {
+            node = node->children[1].get();
+            continue;
+        }
+        if (node->children[1]->num_ready == 0) {
+            node = node->children[0].get();
+            continue;
+        }
+        if (nbits == 0) {
+            bits  = m_rand();
+            nbits = 64;
+        }
+        node = node->children[bits & 1].get();
+        bits >>= 1;
+        nbits--;
+    }
+
+    auto s      = node->state;
+    node->state = nullptr;
+    m_selected  = node;
+    update_ready(node, -1);
+    m_num_active--;
+    return s;
+}
+
+std::vector<state::StatePtr> RandomPathExplorationTechnique::queued() const
+{
+    std::vector<state::StatePtr> res;
+    std::vector<const Node*>     nodes = {m_root.get()};
+    while (!nodes.empty()) {
+        const Node* node = nodes.back();
+        nodes.pop_back();
+        if (node == nullptr)
+            continue;
+        if (node->is_leaf()) {
+            // the parked states are saved with the ones held by the merger
+            if (node->state != nullptr && !node->parked)
+                res.push_back(node->state);
+            continue;
+        }
+        nodes.push_back(node->children[1].get());
+        nodes.push_back(node->children[0].get());
+    }
+    return res;
+}
+
+void RandomPathExplorationTechnique::restore(
+    std::vector<state::StatePtr> states, expr::ExprReader&)
+{
+    // the shape of the tree is not saved, the states restart from a balanced
+    // tree
+    clear();
+    m_selected   = nullptr;
+    m_num_active = states.size();
+
+    std::vector<std::unique_ptr<Node>> leaves;
+    for (auto s : states)
+        leaves.push_back(make_leaf(s, false));
+    if (!leaves.empty())
+        m_root = build_subtree(leaves, 0, leaves.size());
+}
+
+template class ExecutorManager<RandomPathExplorationTechnique>;
+
+} // namespace naaz::executor
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <memory>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+#include "ExplorationTechnique.hpp"
+#include "ExecutorManager.hpp"
+
+namespace naaz::executor
+{
+
+// KLEE-style random path selection. The technique keeps the binary tree of
+// the forks, and selects the next state walking from the root to a leaf with
+// a coin flip at every internal node. Hence, the probability of selecting a
+// state halves at every fork on its path, favoring the states in the shallow
+// subtrees over the ones in subtrees that fork a lot (e.g., input-dependent
+// loops). The states held by the StateMerger keep their leaf (parked) until
+// they are released, and the walk skips the subtrees without ready leaves
+class RandomPathExplorationTechnique final : public ExplorationTechnique
+{
+    struct Node {
+        Node*                 parent = nullptr;
+        std::unique_ptr<Node> children[2];
+        // set only in the leaves
+        state::StatePtr state;
+        bool            parked = false;
+        // the leaves of the subtree that can be selected
+        size_t num_ready = 0;
+
+        bool is_leaf() const { return children[0] == nullptr; }
+    };
+
+    std::unique_ptr<Node> m_root;
+    // the leaf of the state returned by get_next, it is replaced by the
+    // successors of the state in add_actives
+    Node*                                          m_selected;
+    std::unordered_map<const state::State*, Node*> m_parked;
+    size_t                                         m_num_active;
+    std::mt19937_64                                m_rand;
+
+    std::unique_ptr<Node>& owner(Node* node);
+    std::unique_ptr<Node>  make_leaf(state::StatePtr state, bool parked);
+    void                   update_ready(Node* node, int64_t delta);
+    void                   remove_leaf(Node* leaf);
+    void                   clear();
+
+    // a balanced subtree with leaves[begin, end)
+    std::unique_ptr<Node>
+    build_subtree(std::vector<std::unique_ptr<Node>>& leaves, size_t begin,
+                  size_t end);
+
+  public:
+    RandomPathExplorationTechnique(state::StatePtr initial_state);
+    ~RandomPathExplorationTechnique();
+
+    virtual void add_actives(std::vector<state::StatePtr> states);
+    virtual void add_successors(std::vector<state::StatePtr>        active,
+                                const std::vector<state::StatePtr>& held);
+    virtual void restore(std::vector<state::StatePtr> states,
+                         expr::ExprReader&            r);
+    virtual std::optional<state::StatePtr> get_next();
+    virtual std::vector<state::StatePtr>   queued() const;
+
+    virtual size_t num_states() const
+    {
+        return m_num_active + ExplorationTechnique::num_states();
+    }
+};
+
+typedef ExecutorManager<RandomPathExplorationTechnique>
+    RandomPathExecutorManager;
+
+} // namespace naaz::executor
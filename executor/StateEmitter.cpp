@@ -0,0 +1,146 @@
+#include <algorithm>
+#include <sstream>
+
+#include "StateEmitter.hpp"
+
+#include "../solver/QueryLog.hpp"
+#include "../util/config.hpp"
+#include "../util/ioutil.hpp"
+
+namespace naaz::executor
+{
+
+bool StateEmitter::credit(const state::StatePtr& s)
+{
+    // the workers credit the states in any order: the first satisfiable
+    // state that reached an edge takes it
+    bool credited = false;
+    for (const auto& [edge, _] : s->new_edges())
+        credited = m_coverage->hit(edge) || credited;
+    return credited;
+}
+
+void StateEmitter::emit(state::StatePtr s)
+{
+    solver::QueryOriginScope origin(solver::QueryOrigin::DUMP);
+    auto                     start = std::chrono::steady_clock::now();
+
+    bool new_coverage_only = m_coverage && g_config.emit_new_coverage_only;
+    if (new_coverage_only) {
+        // no solving if another state already reached all its new edges
+        bool unseen = false;
+        for (const auto& [edge, _] : s->new_edges())
+            unseen = unseen || !m_coverage->seen(edge);
+        if (!unseen)
+            return;
+    }
+    if (s->satisfiable() != solver::CheckResult::SAT)
+        return;
+    if (m_coverage && !credit(s) && new_coverage_only)
+        return;
+    uint64_t index = m_next_index++;
+    m_callback(s, index);
+    report(index, std::chrono::duration_cast<std::chrono::microseconds>(
+                      std::chrono::steady_clock::now() - start));
+}
+
+void StateEmitter::report(uint64_t index, std::chrono::microseconds latency)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_num_emitted++;
+    m_total_latency += latency;
+    m_max_latency = std::max(m_max_latency, latency);
+
+    // a single write, the lines of the workers are not interleaved
+    std::ostringstream line;
+    line << "test case " << index << " emitted in " << latency.count()
+         << " us" << std::endl;
+    info("StateEmitter") << line.str();
+}
+
+void StateEmitter::work()
+{
+    while (1) {
+        state::StatePtr s;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_not_empty.wait(lock,
+                             [this] { return m_stop || !m_queue.empty(); });
+            if (m_queue.empty())
+                return;
+            s = std::move(m_queue.front());
+            m_queue.pop_front();
+            m_num_busy++;
+        }
+        m_not_full.notify_one();
+
+        emit(s);
+        s = nullptr;
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_num_busy--;
+        }
+        m_idle.notify_all();
+    }
+}
+
+void StateEmitter::start(Callback callback)
+{
+    m_callback = callback;
+    m_stop     = false;
+    for (uint32_t i = 0; i < g_config.emit_workers; ++i)
+        m_workers.emplace_back(&StateEmitter::work, this);
+}
+
+void StateEmitter::push(state::StatePtr s)
+{
+    if (m_workers.empty()) {
+        emit(s);
+        return;
+    }
+
+    // the workers must not race on the data of the parent of a pending child
+    s->materialize();
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_not_full.wait(lock, [this] {
+        return m_queue.size() < g_config.emit_queue_size;
+    });
+    m_queue.push_back(std::move(s));
+    lock.unlock();
+    m_not_empty.notify_one();
+}
+
+void StateEmitter::wait_idle()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_idle.wait(lock, [this] { return m_queue.empty() && m_num_busy == 0; });
+}
+
+void StateEmitter::finish()
+{
+    if (!m_workers.empty()) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_not_empty.notify_all();
+        for (auto& w : m_workers)
+            w.join();
+        m_workers.clear();
+    }
+
+    if (m_num_emitted == 0)
+        return;
+    info("StateEmitter") << "emitted " << m_num_emitted
+                         << " test cases, latency avg "
+                         << m_total_latency.count() / m_num_emitted
+                         << " us, max " << m_max_latency.count() << " us"
+                         << std::endl;
+    m_num_emitted   = 0;
+    m_total_latency = std::chrono::microseconds(0);
+    m_max_latency   = std::chrono::microseconds(0);
+}
+
+} // namespace naaz::executor
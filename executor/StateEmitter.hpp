@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "EdgeCoverage.hpp"
+#include "../state/State.hpp"
+
+namespace naaz::executor
+{
+
+// Emits the exited states of gen_paths: the satisfiable ones are passed to
+// the callback with their index. With emit_workers > 0, the states are pushed
+// in a queue of at most emit_queue_size states, drained by a pool of worker
+// threads. Every worker has its own solver (Z3Solver is per thread). push()
+// blocks while the queue is full, so the exploration does not outrun the
+// workers. The states are released as soon as they are emitted. Without
+// workers, the states are emitted by push(). The emission latency (solving
+// and callback) of every test case is reported, with a summary in finish().
+// With a coverage map, the new edges of a satisfiable state are marked in it
+// before the callback (see State::new_edges), with emit_new_coverage_only
+// the states that reached no new edge are not emitted
+class StateEmitter
+{
+  public:
+    typedef void (*Callback)(state::StatePtr, uint64_t);
+
+  private:
+    Callback                    m_callback;
+    EdgeCoverage*               m_coverage;
+    std::atomic<uint64_t>       m_next_index;
+    std::deque<state::StatePtr> m_queue;
+    size_t                      m_num_busy;
+    bool                        m_stop;
+    std::mutex                  m_mutex;
+    std::condition_variable     m_not_empty;
+    std::condition_variable     m_not_full;
+    std::condition_variable     m_idle;
+    std::vector<std::thread>    m_workers;
+
+    // emission latency statistics, guarded by m_mutex
+    uint64_t                  m_num_emitted;
+    std::chrono::microseconds m_total_latency;
+    std::chrono::microseconds m_max_latency;
+
+    // mark the new edges of s, true if some of them were not hit before
+    bool credit(const state::StatePtr& s);
+    void emit(state::StatePtr s);
+    void report(uint64_t index, std::chrono::microseconds latency);
+    void work();
+
+  public:
+    StateEmitter()
+        : m_callback(nullptr), m_coverage(nullptr), m_next_index(0),
+          m_num_busy(0), m_stop(false), m_num_emitted(0), m_total_latency(0),
+          m_max_latency(0)
+    {
+    }
+    ~StateEmitter() { finish(); }
+
+    // the coverage map (nullptr: disabled), that must outlive the emitter
+    void set_coverage(EdgeCoverage* coverage) { m_coverage = coverage; }
+
+    void start(Callback callback);
+    void push(state::StatePtr s);
+    // wait for the emission of the pushed states
+    void wait_idle();
+    // wait_idle(), stop the workers and report the latency summary
+    void finish();
+
+    uint64_t next_index() const { return m_next_index; }
+    void     set_next_index(uint64_t index) { m_next_index = index; }
+};
+
+} // namespace naaz::executor
@@ -0,0 +1,69 @@
+#include "StateMerger.hpp"
+
+#include "../util/config.hpp"
+
+namespace naaz::executor
+{
+
+std::vector<state::StatePtr>
+StateMerger::step(std::vector<state::StatePtr> states)
+{
+    m_time++;
+
+    for (auto s : states) {
+        bool merged = false;
+        for (auto& held : m_held) {
+            if (held.state->pc() != s->pc())
+                continue;
+            if (held.state->merge(*s, g_config.merge_max_cost)) {
+                merged = true;
+                m_num_merged++;
+                break;
+            }
+        }
+        if (!merged)
+            m_held.push_back({.state    = s,
+                              .added    = m_time,
+                              .deadline = m_time + g_config.merge_window});
+    }
+
+    std::vector<state::StatePtr> released;
+    for (auto it = m_held.begin(); it != m_held.end();) {
+        if (it->deadline > m_time) {
+            ++it;
+            continue;
+        }
+        released.push_back(it->state);
+        it = m_held.erase(it);
+    }
+    return released;
+}
+
+std::vector<state::StatePtr> StateMerger::flush()
+{
+    std::vector<state::StatePtr> released;
+    for (auto& held : m_held)
+        released.push_back(held.state);
+    m_held.clear();
+    return released;
+}
+
+std::vector<state::StatePtr> StateMerger::held() const
+{
+    std::vector<state::StatePtr> res;
+    for (auto& held : m_held)
+        res.push_back(held.state);
+    return res;
+}
+
+std::vector<state::StatePtr> StateMerger::held_last_step() const
+{
+    std::vector<state::StatePtr> res;
+    for (auto& held : m_held) {
+        if (held.added == m_time)
+            res.push_back(held.state);
+    }
+    return res;
+}
+
+} // namespace naaz::executor
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <vector>
+
+#include "../state/State.hpp"
+
+namespace naaz::executor
+{
+
+// Holds the active states for a few executed blocks (merge_window), and merges
+// the states that reach the same program point in the meantime (see
+// State::merge). It collapses the forks of the short input-dependent diamonds
+// (e.g., small if/else blocks) into a single state
+class StateMerger
+{
+    struct HeldState {
+        state::StatePtr state;
+        uint64_t        added;
+        uint64_t        deadline;
+    };
+
+    std::vector<HeldState> m_held;
+    uint64_t               m_time;
+    size_t                 m_num_merged;
+
+  public:
+    StateMerger() : m_time(0), m_num_merged(0) {}
+
+    // called after the execution of a block with its active successors.
+    // Return the states whose window expired
+    std::vector<state::StatePtr> step(std::vector<state::StatePtr> states);
+    // release all the held states
+    std::vector<state::StatePtr> flush();
+    // the held states, without releasing them
+    std::vector<state::StatePtr> held() const;
+    // the states of the last step() that are held (i.e., not merged or
+    // released)
+    std::vector<state::StatePtr> held_last_step() const;
+
+    bool   empty() const { return m_held.empty(); }
+    size_t num_held() const { return m_held.size(); }
+    size_t num_merged() const { return m_num_merged; }
+};
+
+} // namespace naaz::executor
@@ -0,0 +1,184 @@
+#include <atomic>
+#include <fstream>
+#include <unistd.h>
+
+#include "StateSpiller.hpp"
+#include "Checkpointer.hpp"
+
+#include "../expr/ExprBuilder.hpp"
+#include "../expr/ExprSerializer.hpp"
+#include "../util/config.hpp"
+#include "../util/ioutil.hpp"
+#include "../util/strutil.hpp"
+#include "../util/sysutil.hpp"
+
+// after a spill, the next one waits for the RSS to grow by 1/16 of the budget
+#define SPILL_HYSTERESIS_FRACTION 16
+
+namespace naaz::executor
+{
+
+static void write_batch(const std::filesystem::path&      path,
+                        const std::vector<state::StatePtr>& states)
+{
+    std::ofstream out(path, std::ios::binary);
+    if (!out) {
+        err("StateSpiller") << "unable to create " << path << std::endl;
+        exit_fail();
+    }
+
+    expr::ExprWriter w(out);
+    for (auto s : states)
+        s->spill(w);
+    out.close();
+    if (!out) {
+        err("StateSpiller") << "unable to write " << path << std::endl;
+        exit_fail();
+    }
+}
+
+StateSpiller::~StateSpiller() { clear(); }
+
+void StateSpiller::clear()
+{
+    m_batches.clear();
+    m_num_spilled = 0;
+    m_spilled_rss = 0;
+    if (m_dir.empty())
+        return;
+
+    std::error_code ec;
+    std::filesystem::remove_all(m_dir, ec);
+    m_dir.clear();
+}
+
+bool StateSpiller::over_budget() const
+{
+    if (g_config.max_memory == 0)
+        return false;
+
+    uint64_t budget = g_config.max_memory * 1024UL * 1024UL;
+    uint64_t rss    = get_rss();
+    return rss > budget &&
+           rss > m_spilled_rss + budget / SPILL_HYSTERESIS_FRACTION;
+}
+
+std::filesystem::path StateSpiller::new_batch_path()
+{
+    if (m_dir.empty()) {
+        // a directory for each spiller of the process
+        static std::atomic<uint32_t> n_spillers = 0;
+        m_dir = std::filesystem::path(g_config.spill_dir) /
+                string_format("naaz_spill_%d_%u", getpid(),
+                              (uint32_t)n_spillers++);
+        std::filesystem::create_directories(m_dir);
+    }
+
+    return m_dir /
+           string_format("batch_%lu.bin", (unsigned long)m_num_batches++);
+}
+
+void StateSpiller::spill(std::vector<state::StatePtr> states)
+{
+    if (states.empty())
+        return;
+
+    Batch batch;
+    batch.path = new_batch_path();
+    write_batch(batch.path, states);
+
+    m_num_spilled += states.size();
+    batch.states = std::move(states);
+    m_batches.push_back(std::move(batch));
+
+    // the expressions used only by the spilled states are dead now
+    expr::ExprBuilder::The().collect_garbage();
+    release_free_memory();
+    m_spilled_rss = get_rss();
+}
+
+std::vector<state::StatePtr> StateSpiller::reload()
+{
+    if (m_batches.empty())
+        return {};
+
+    Batch batch = std::move(m_batches.back());
+    m_batches.pop_back();
+
+    std::ifstream in(batch.path, std::ios::binary);
+    if (!in) {
+        err("StateSpiller") << "unable to open " << batch.path << std::endl;
+        exit_fail();
+    }
+
+    auto             lifter = batch.states.front()->lifter();
+    expr::ExprReader r(in, [lifter](int32_t size) {
+        return lifter->get_float_format(size);
+    });
+    for (auto s : batch.states)
+        s->unspill(r);
+    in.close();
+
+    std::error_code ec;
+    std::filesystem::remove(batch.path, ec);
+
+    m_num_spilled -= batch.states.size();
+    return batch.states;
+}
+
+void StateSpiller::save(expr::ExprWriter& w, Checkpointer& checkpointer)
+{
+    w.write_uint(m_batches.size());
+    for (auto& batch : m_batches) {
+        w.write_uint(batch.states.size());
+        for (auto s : batch.states)
+            s->serialize_shell(w);
+
+        // the batch file is not modified until it is reloaded
+        if (batch.checkpoint_file.empty() ||
+            !checkpointer.use_file(batch.checkpoint_file))
+            batch.checkpoint_file = checkpointer.link_file(batch.path);
+        w.write_str(batch.checkpoint_file);
+    }
+}
+
+void StateSpiller::restore(expr::ExprReader& r, state::StatePtr entry_state,
+                           const std::filesystem::path& dir)
+{
+    for (auto& batch : m_batches) {
+        std::error_code ec;
+        std::filesystem::remove(batch.path, ec);
+    }
+    m_batches.clear();
+    m_num_spilled = 0;
+
+    uint64_t n = r.read_uint();
+    for (uint64_t i = 0; i < n; ++i) {
+        Batch    batch;
+        uint64_t n_states = r.read_uint();
+        for (uint64_t j = 0; j < n_states; ++j) {
+            auto s = entry_state->clone();
+            s->deserialize_shell(r);
+            batch.states.push_back(s);
+        }
+
+        batch.checkpoint_file = r.read_str();
+        batch.path            = new_batch_path();
+        auto src = Checkpointer::file_path(dir, batch.checkpoint_file);
+
+        std::error_code ec;
+        std::filesystem::create_hard_link(src, batch.path, ec);
+        if (ec)
+            std::filesystem::copy_file(src, batch.path, ec);
+        if (ec) {
+            err("StateSpiller") << "unable to write " << batch.path
+                                << std::endl;
+            exit_fail();
+        }
+
+        m_num_spilled += batch.states.size();
+        m_batches.push_back(std::move(batch));
+    }
+}
+
+} // namespace naaz::executor
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <filesystem>
+#include <vector>
+
+#include "../state/State.hpp"
+#include "../expr/ExprSerializer.hpp"
+
+namespace naaz::executor
+{
+
+class Checkpointer;
+
+// Moves the queued states to disk when the process exceeds the memory budget
+// (max_memory), and brings them back when the exploration runs out of states.
+// The states spilled together are written to a single file, so that the
+// expressions they share are written once. The batches are reloaded in LIFO
+// order. The RSS rarely drops after a spill (the allocator keeps some of the
+// freed pages), a new spill waits for it to grow past the RSS measured after
+// the previous one
+class StateSpiller
+{
+    struct Batch {
+        std::filesystem::path        path;
+        std::vector<state::StatePtr> states;
+        // the data file of the checkpoints with the content of the batch
+        std::string checkpoint_file;
+    };
+
+    std::filesystem::path m_dir;
+    std::vector<Batch>    m_batches;
+    uint64_t              m_num_batches;
+    size_t                m_num_spilled;
+    uint64_t              m_spilled_rss;
+
+    std::filesystem::path new_batch_path();
+
+  public:
+    StateSpiller() : m_num_batches(0), m_num_spilled(0), m_spilled_rss(0) {}
+    ~StateSpiller();
+
+    // true if the process uses more memory than the budget, and its memory
+    // grew by a fraction of the budget since the last spill
+    bool over_budget() const;
+
+    void                         spill(std::vector<state::StatePtr> states);
+    std::vector<state::StatePtr> reload();
+    // drop the spilled states and remove their files
+    void                         clear();
+
+    // checkpoints: the shells of the spilled states, and the batch files
+    // linked in the checkpoint directory once. The states are restored as
+    // clones of entry_state from the checkpoint in dir
+    void save(expr::ExprWriter& w, Checkpointer& checkpointer);
+    void restore(expr::ExprReader& r, state::StatePtr entry_state,
+                 const std::filesystem::path& dir);
+
+    bool   empty() const { return m_batches.empty(); }
+    size_t num_spilled() const { return m_num_spilled; }
+};
+
+} // namespace naaz::executor
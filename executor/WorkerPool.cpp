@@ -0,0 +1,206 @@
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "WorkerPool.hpp"
+
+#include "../util/ioutil.hpp"
+
+namespace naaz::executor
+{
+
+#define HEADER_SIZE (1 + sizeof(uint64_t))
+
+static void write_all(int fd, const char* data, size_t size)
+{
+    while (size > 0) {
+        ssize_t n = write(fd, data, size);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0) {
+            err("WorkerChannel") << "send(): " << strerror(errno) << std::endl;
+            exit_fail();
+        }
+        data += n;
+        size -= n;
+    }
+}
+
+static void read_all(int fd, char* data, size_t size)
+{
+    while (size > 0) {
+        ssize_t n = read(fd, data, size);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0) {
+            err("WorkerChannel")
+                << "recv(): the other side closed the channel" << std::endl;
+            exit_fail();
+        }
+        data += n;
+        size -= n;
+    }
+}
+
+void WorkerChannel::send(Type type, const std::string& payload)
+{
+    char     header[HEADER_SIZE];
+    uint64_t size = payload.size();
+    header[0]     = type;
+    memcpy(header + 1, &size, sizeof(size));
+    write_all(m_fd, header, HEADER_SIZE);
+    write_all(m_fd, payload.data(), payload.size());
+}
+
+WorkerChannel::Message WorkerChannel::recv()
+{
+    char     header[HEADER_SIZE];
+    uint64_t size;
+    read_all(m_fd, header, HEADER_SIZE);
+    memcpy(&size, header + 1, sizeof(size));
+
+    Message msg;
+    msg.type = (Type)header[0];
+    msg.payload.resize(size);
+    read_all(m_fd, msg.payload.data(), size);
+    return msg;
+}
+
+bool WorkerChannel::ready() const
+{
+    struct pollfd pfd = {m_fd, POLLIN, 0};
+    return poll(&pfd, 1, 0) > 0;
+}
+
+std::optional<std::pair<uint32_t, WorkerChannel>>
+WorkerPool::spawn(uint32_t num_workers)
+{
+    for (uint32_t i = 0; i < num_workers; ++i) {
+        int fds[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+            err("WorkerPool") << "spawn(): " << strerror(errno) << std::endl;
+            exit_fail();
+        }
+
+        pid_t pid = fork();
+        if (pid < 0) {
+            err("WorkerPool") << "spawn(): " << strerror(errno) << std::endl;
+            exit_fail();
+        }
+        if (pid == 0) {
+            // the worker keeps only its side of its own channel
+            for (auto& w : m_workers)
+                close(w.channel.fd());
+            m_workers.clear();
+            close(fds[0]);
+            return std::pair{i, WorkerChannel(fds[1])};
+        }
+
+        close(fds[1]);
+        m_workers.push_back(Worker{pid, WorkerChannel(fds[0]), false, false});
+    }
+    return {};
+}
+
+std::optional<std::string> WorkerPool::coordinate()
+{
+    // the donated states that wait for an idle worker
+    std::vector<std::string>   stash;
+    std::optional<std::string> found;
+    size_t                     next_donor = 0;
+
+    while (!found.has_value()) {
+        for (auto& w : m_workers) {
+            if (stash.empty())
+                break;
+            if (!w.idle)
+                continue;
+            w.channel.send(WorkerChannel::STATES, stash.back());
+            stash.pop_back();
+            w.idle = false;
+        }
+
+        size_t num_idle  = 0;
+        size_t num_asked = 0;
+        for (const auto& w : m_workers) {
+            num_idle += w.idle;
+            num_asked += w.asked;
+        }
+        if (num_idle == m_workers.size() && num_asked == 0)
+            break;
+
+        // a donation for every idle worker, asked to the busy ones in turn
+        for (size_t i = 0; i < m_workers.size() && num_asked < num_idle; ++i) {
+            Worker& w = m_workers[(next_donor + i) % m_workers.size()];
+            if (w.idle || w.asked)
+                continue;
+            w.channel.send(WorkerChannel::DONATE);
+            w.asked = true;
+            num_asked++;
+        }
+        next_donor = (next_donor + 1) % m_workers.size();
+
+        std::vector<struct pollfd> fds;
+        for (const auto& w : m_workers)
+            fds.push_back({w.channel.fd(), POLLIN, 0});
+        if (poll(fds.data(), fds.size(), -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            err("WorkerPool") << "coordinate(): " << strerror(errno)
+                              << std::endl;
+            exit_fail();
+        }
+
+        for (size_t i = 0; i < fds.size(); ++i) {
+            if (fds[i].revents == 0)
+                continue;
+
+            Worker& w   = m_workers[i];
+            auto    msg = w.channel.recv();
+            if (msg.type == WorkerChannel::IDLE) {
+                w.idle = true;
+            } else if (msg.type == WorkerChannel::STATES) {
+                w.asked = false;
+                if (!msg.payload.empty())
+                    stash.push_back(std::move(msg.payload));
+            } else if (msg.type == WorkerChannel::COVERAGE) {
+                for (auto& other : m_workers) {
+                    if (&other != &w)
+                        other.channel.send(WorkerChannel::COVERAGE,
+                                           msg.payload);
+                }
+            } else if (msg.type == WorkerChannel::FOUND) {
+                found = std::move(msg.payload);
+                break;
+            }
+        }
+    }
+
+    stop();
+    return found;
+}
+
+void WorkerPool::stop()
+{
+    for (auto& w : m_workers)
+        w.channel.send(WorkerChannel::STOP);
+
+    // the messages sent before the STOP are dropped
+    for (auto& w : m_workers) {
+        while (1) {
+            auto msg = w.channel.recv();
+            if (msg.type == WorkerChannel::STATS) {
+                m_num_states += std::stoull(msg.payload);
+                break;
+            }
+        }
+        close(w.channel.fd());
+        waitpid(w.pid, nullptr, 0);
+    }
+    m_workers.clear();
+}
+
+} // namespace naaz::executor
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+namespace naaz::executor
+{
+
+// A socket between the coordinator and a worker of a distributed exploration.
+// A message is a type, the length of the payload (8 bytes) and the payload
+class WorkerChannel
+{
+  public:
+    enum Type : uint8_t {
+        // states to explore (to a worker), or donated states (to the
+        // coordinator). The payload is empty if the worker has none to give
+        STATES,
+        // the worker ran out of states
+        IDLE,
+        // ask a worker to donate about half of its queued states
+        DONATE,
+        // a worker reached a find address, the payload is the state
+        FOUND,
+        // the exploration is over, the worker answers with STATS and exits
+        STOP,
+        // the number of states generated by the worker
+        STATS,
+        // the coverage found by a worker (see
+        // ExplorationTechnique::save_coverage), relayed to the other ones
+        COVERAGE,
+    };
+
+    struct Message {
+        Type        type;
+        std::string payload;
+    };
+
+  private:
+    int m_fd;
+
+  public:
+    WorkerChannel(int fd) : m_fd(fd) {}
+
+    int fd() const { return m_fd; }
+
+    void    send(Type type, const std::string& payload = "");
+    Message recv();
+    // true if a message is waiting to be received
+    bool    ready() const;
+};
+
+// Runs an exploration on several processes. spawn() forks the workers, that
+// explore their queue (see ExecutorManager::explore_distributed) while the
+// parent process coordinates them: when a worker runs out of states, the
+// coordinator asks a busy one to donate some of its queued states, and
+// forwards them to the idle one. The coverage found by a worker is relayed to
+// the other ones, so that the techniques that rank the states by coverage
+// behave as in a single process. The exploration ends when a worker finds a
+// target, or when all the workers are idle and no state is in transit
+class WorkerPool
+{
+    struct Worker {
+        pid_t         pid;
+        WorkerChannel channel;
+        bool          idle;
+        // a DONATE was sent, and the answer was not received yet
+        bool          asked;
+    };
+
+    std::vector<Worker> m_workers;
+    uint64_t            m_num_states;
+
+    void stop();
+
+  public:
+    WorkerPool() : m_num_states(0) {}
+
+    // fork num_workers workers. In a worker, return its index and the channel
+    // to the coordinator. In the coordinator, return nothing
+    std::optional<std::pair<uint32_t, WorkerChannel>>
+    spawn(uint32_t num_workers);
+
+    // run the coordinator until the end of the exploration. Return the
+    // payload of the FOUND message, if any. The workers have exited when it
+    // returns
+    std::optional<std::string> coordinate();
+
+    // the states generated by all the workers
+    uint64_t num_states() const { return m_num_states; }
+};
+
+} // namespace naaz::executor
@@ -74,9 +74,9 @@ uint64_t ITEExpr::hash() const
     void* raw_guard   = (void*)m_guard.get();
     void* raw_iftrue  = (void*)m_iftrue.get();
     void* raw_iffalse = (void*)m_iffalse.get();
-    XXH64_update(&state, raw_guard, sizeof(void*));
-    XXH64_update(&state, raw_iftrue, sizeof(void*));
-    XXH64_update(&state, raw_iffalse, sizeof(void*));
+    XXH64_update(&state, &raw_guard, sizeof(void*));
+    XXH64_update(&state, &raw_iftrue, sizeof(void*));
+    XXH64_update(&state, &raw_iffalse, sizeof(void*));
     return XXH64_digest(&state);
 }
 
@@ -90,6 +90,40 @@ bool ITEExpr::eq(ExprPtr other) const
            m_iftrue == other_->m_iftrue && m_iffalse == other_->m_iffalse;
 }
 
+// ***************
+// * ArrayReadExpr
+// ***************
+
+uint64_t ArrayReadExpr::hash() const
+{
+    XXH64_state_t state;
+    XXH64_reset(&state, 0);
+    void* raw_updates = (void*)m_updates.get();
+    void* raw_index   = (void*)m_index.get();
+    XXH64_update(&state, &raw_updates, sizeof(void*));
+    XXH64_update(&state, &raw_index, sizeof(void*));
+    return XXH64_digest(&state);
+}
+
+bool ArrayReadExpr::eq(ExprPtr other) const
+{
+    if (other->kind() != ekind)
+        return false;
+
+    auto other_ = std::static_pointer_cast<const ArrayReadExpr>(other);
+    return m_updates == other_->m_updates && m_index == other_->m_index;
+}
+
+std::vector<ExprPtr> ArrayReadExpr::children() const
+{
+    std::vector<ExprPtr> res{m_index};
+    for (auto u = m_updates; u != nullptr; u = u->next()) {
+        res.push_back(u->index());
+        res.push_back(u->value());
+    }
+    return res;
+}
+
 // ***************
 // * ExtractExpr
 // ***************
@@ -101,7 +135,7 @@ uint64_t ExtractExpr::hash() const
     XXH64_update(&state, &m_high, sizeof(m_high));
     XXH64_update(&state, &m_low, sizeof(m_low));
     void* raw_expr = (void*)m_expr.get();
-    XXH64_update(&state, raw_expr, sizeof(void*));
+    XXH64_update(&state, &raw_expr, sizeof(void*));
     return XXH64_digest(&state);
 }
 
@@ -126,7 +160,7 @@ uint64_t ConcatExpr::hash() const
     XXH64_update(&state, &m_size, sizeof(m_size));
     for (const auto& child : m_children) {
         void* raw_child = (void*)child.get();
-        XXH64_update(&state, raw_child, sizeof(void*));
+        XXH64_update(&state, &raw_child, sizeof(void*));
     }
     return XXH64_digest(&state);
 }
@@ -166,7 +200,7 @@ uint64_t ZextExpr::hash() const
     XXH64_reset(&state, 0);
     XXH64_update(&state, &m_size, sizeof(m_size));
     void* raw_expr = (void*)m_expr.get();
-    XXH64_update(&state, raw_expr, sizeof(void*));
+    XXH64_update(&state, &raw_expr, sizeof(void*));
     return XXH64_digest(&state);
 }
 
@@ -197,7 +231,7 @@ uint64_t SextExpr::hash() const
     XXH64_reset(&state, 0);
     XXH64_update(&state, &m_size, sizeof(m_size));
     void* raw_expr = (void*)m_expr.get();
-    XXH64_update(&state, raw_expr, sizeof(void*));
+    XXH64_update(&state, &raw_expr, sizeof(void*));
     return XXH64_digest(&state);
 }
 
@@ -220,7 +254,7 @@ uint64_t NegExpr::hash() const
     XXH64_reset(&state, 0);
     XXH64_update(&state, &m_size, sizeof(m_size));
     void* raw_expr = (void*)m_expr.get();
-    XXH64_update(&state, raw_expr, sizeof(void*));
+    XXH64_update(&state, &raw_expr, sizeof(void*));
     return XXH64_digest(&state);
 }
 
@@ -243,7 +277,7 @@ uint64_t NotExpr::hash() const
     XXH64_reset(&state, 0);
     XXH64_update(&state, &m_size, sizeof(m_size));
     void* raw_expr = (void*)m_expr.get();
-    XXH64_update(&state, raw_expr, sizeof(void*));
+    XXH64_update(&state, &raw_expr, sizeof(void*));
     return XXH64_digest(&state);
 }
 
@@ -267,8 +301,8 @@ uint64_t ShlExpr::hash() const
     XXH64_update(&state, &m_size, sizeof(m_size));
     void* raw_expr = (void*)m_expr.get();
     void* raw_val  = (void*)m_val.get();
-    XXH64_update(&state, raw_expr, sizeof(void*));
-    XXH64_update(&state, raw_val, sizeof(void*));
+    XXH64_update(&state, &raw_expr, sizeof(void*));
+    XXH64_update(&state, &raw_val, sizeof(void*));
     return XXH64_digest(&state);
 }
 
@@ -293,8 +327,8 @@ uint64_t LShrExpr::hash() const
     XXH64_update(&state, &m_size, sizeof(m_size));
     void* raw_expr = (void*)m_expr.get();
     void* raw_val  = (void*)m_val.get();
-    XXH64_update(&state, raw_expr, sizeof(void*));
-    XXH64_update(&state, raw_val, sizeof(void*));
+    XXH64_update(&state, &raw_expr, sizeof(void*));
+    XXH64_update(&state, &raw_val, sizeof(void*));
     return XXH64_digest(&state);
 }
 
@@ -319,8 +353,8 @@ uint64_t AShrExpr::hash() const
     XXH64_update(&state, &m_size, sizeof(m_size));
     void* raw_expr = (void*)m_expr.get();
     void* raw_val  = (void*)m_val.get();
-    XXH64_update(&state, raw_expr, sizeof(void*));
-    XXH64_update(&state, raw_val, sizeof(void*));
+    XXH64_update(&state, &raw_expr, sizeof(void*));
+    XXH64_update(&state, &raw_val, sizeof(void*));
     return XXH64_digest(&state);
 }
 
@@ -345,7 +379,7 @@ uint64_t AddExpr::hash() const
     XXH64_update(&state, (void*)&m_size, sizeof(m_size));
     for (const auto& child : m_children) {
         void* raw_child = (void*)child.get();
-        XXH64_update(&state, raw_child, sizeof(void*));
+        XXH64_update(&state, &raw_child, sizeof(void*));
     }
     return XXH64_digest(&state);
 }
@@ -378,7 +412,7 @@ uint64_t MulExpr::hash() const
     XXH64_update(&state, (void*)&m_size, sizeof(m_size));
     for (const auto& child : m_children) {
         void* raw_child = (void*)child.get();
-        XXH64_update(&state, raw_child, sizeof(void*));
+        XXH64_update(&state, &raw_child, sizeof(void*));
     }
     return XXH64_digest(&state);
 }
@@ -527,7 +561,7 @@ uint64_t AndExpr::hash() const
     XXH64_update(&state, (void*)&m_size, sizeof(m_size));
     for (const auto& child : m_children) {
         void* raw_child = (void*)child.get();
-        XXH64_update(&state, raw_child, sizeof(void*));
+        XXH64_update(&state, &raw_child, sizeof(void*));
     }
     return XXH64_digest(&state);
 }
@@ -560,7 +594,7 @@ uint64_t OrExpr::hash() const
     XXH64_update(&state, (void*)&m_size, sizeof(m_size));
     for (const auto& child : m_children) {
         void* raw_child = (void*)child.get();
-        XXH64_update(&state, raw_child, sizeof(void*));
+        XXH64_update(&state, &raw_child, sizeof(void*));
     }
     return XXH64_digest(&state);
 }
@@ -593,7 +627,7 @@ uint64_t XorExpr::hash() const
     XXH64_update(&state, (void*)&m_size, sizeof(m_size));
     for (const auto& child : m_children) {
         void* raw_child = (void*)child.get();
-        XXH64_update(&state, raw_child, sizeof(void*));
+        XXH64_update(&state, &raw_child, sizeof(void*));
     }
     return XXH64_digest(&state);
 }
@@ -643,7 +677,7 @@ uint64_t BoolNotExpr::hash() const
     XXH64_state_t state;
     XXH64_reset(&state, 0);
     void* raw_expr = (void*)m_expr.get();
-    XXH64_update(&state, raw_expr, sizeof(void*));
+    XXH64_update(&state, &raw_expr, sizeof(void*));
     return XXH64_digest(&state);
 }
 
@@ -660,13 +694,15 @@ bool BoolNotExpr::eq(ExprPtr other) const
 // * BoolAndExpr
 // ***************
 
+BoolAndExpr::~BoolAndExpr() { ExprBuilder::The().release_conjuncts(m_exprs); }
+
 uint64_t BoolAndExpr::hash() const
 {
     XXH64_state_t state;
     XXH64_reset(&state, 0);
     for (const auto& child : m_exprs) {
         void* raw_child = (void*)child.get();
-        XXH64_update(&state, raw_child, sizeof(void*));
+        XXH64_update(&state, &raw_child, sizeof(void*));
     }
     return XXH64_digest(&state);
 }
@@ -696,7 +732,7 @@ uint64_t BoolOrExpr::hash() const
     XXH64_reset(&state, 0);
     for (const auto& child : m_exprs) {
         void* raw_child = (void*)child.get();
-        XXH64_update(&state, raw_child, sizeof(void*));
+        XXH64_update(&state, &raw_child, sizeof(void*));
     }
     return XXH64_digest(&state);
 }
@@ -726,9 +762,9 @@ bool BoolOrExpr::eq(ExprPtr other) const
         XXH64_state_t state;                                                   \
         XXH64_reset(&state, 0);                                                \
         void* raw_lhs = (void*)m_lhs.get();                                    \
-        XXH64_update(&state, raw_lhs, sizeof(void*));                          \
+        XXH64_update(&state, &raw_lhs, sizeof(void*));                         \
         void* raw_rhs = (void*)m_rhs.get();                                    \
-        XXH64_update(&state, raw_rhs, sizeof(void*));                          \
+        XXH64_update(&state, &raw_rhs, sizeof(void*));                         \
         return XXH64_digest(&state);                                           \
     }                                                                          \
     bool NAME::eq(ExprPtr other) const                                         \
@@ -777,7 +813,7 @@ uint64_t BVToFPExpr::hash() const
     XXH64_reset(&state, 0);
     XXH64_update(&state, (void*)m_ff.get(), sizeof(void*));
     void* raw_expr = (void*)m_expr.get();
-    XXH64_update(&state, raw_expr, sizeof(void*));
+    XXH64_update(&state, &raw_expr, sizeof(void*));
     return XXH64_digest(&state);
 }
 
@@ -799,7 +835,7 @@ uint64_t FPToBVExpr::hash() const
     XXH64_state_t state;
     XXH64_reset(&state, 0);
     void* raw_expr = (void*)m_expr.get();
-    XXH64_update(&state, raw_expr, sizeof(void*));
+    XXH64_update(&state, &raw_expr, sizeof(void*));
     return XXH64_digest(&state);
 }
 
@@ -821,7 +857,7 @@ uint64_t FPConvert::hash() const
     XXH64_state_t state;
     XXH64_reset(&state, 0);
     void* raw_expr = (void*)m_expr.get();
-    XXH64_update(&state, raw_expr, sizeof(void*));
+    XXH64_update(&state, &raw_expr, sizeof(void*));
     XXH64_update(&state, (void*)m_ff.get(), sizeof(void*));
     return XXH64_digest(&state);
 }
@@ -844,7 +880,7 @@ uint64_t IntToFPExpr::hash() const
     XXH64_state_t state;
     XXH64_reset(&state, 0);
     void* raw_expr = (void*)m_expr.get();
-    XXH64_update(&state, raw_expr, sizeof(void*));
+    XXH64_update(&state, &raw_expr, sizeof(void*));
     XXH64_update(&state, (void*)m_ff.get(), sizeof(void*));
     return XXH64_digest(&state);
 }
@@ -867,7 +903,7 @@ uint64_t FPIsNAN::hash() const
     XXH64_state_t state;
     XXH64_reset(&state, 0);
     void* raw_expr = (void*)m_expr.get();
-    XXH64_update(&state, raw_expr, sizeof(void*));
+    XXH64_update(&state, &raw_expr, sizeof(void*));
     return XXH64_digest(&state);
 }
 
@@ -889,7 +925,7 @@ uint64_t FPNegExpr::hash() const
     XXH64_state_t state;
     XXH64_reset(&state, 0);
     void* raw_expr = (void*)m_expr.get();
-    XXH64_update(&state, (void*)m_expr.get(), sizeof(void*));
+    XXH64_update(&state, &raw_expr, sizeof(void*));
     return XXH64_digest(&state);
 }
 
@@ -912,7 +948,7 @@ uint64_t FPAddExpr::hash() const
     XXH64_reset(&state, 0);
     for (const auto& child : m_children) {
         void* raw_child = (void*)child.get();
-        XXH64_update(&state, raw_child, sizeof(void*));
+        XXH64_update(&state, &raw_child, sizeof(void*));
     }
     return XXH64_digest(&state);
 }
@@ -942,7 +978,7 @@ uint64_t FPMulExpr::hash() const
     XXH64_reset(&state, 0);
     for (const auto& child : m_children) {
         void* raw_child = (void*)child.get();
-        XXH64_update(&state, raw_child, sizeof(void*));
+        XXH64_update(&state, &raw_child, sizeof(void*));
     }
     return XXH64_digest(&state);
 }
@@ -970,8 +1006,10 @@ uint64_t FPDivExpr::hash() const
 {
     XXH64_state_t state;
     XXH64_reset(&state, 0);
-    XXH64_update(&state, (void*)m_lhs.get(), sizeof(void*));
-    XXH64_update(&state, (void*)m_rhs.get(), sizeof(void*));
+    void* raw_lhs = (void*)m_lhs.get();
+    void* raw_rhs = (void*)m_rhs.get();
+    XXH64_update(&state, &raw_lhs, sizeof(void*));
+    XXH64_update(&state, &raw_rhs, sizeof(void*));
     XXH64_update(&state, (void*)m_ff.get(), sizeof(void*));
     return XXH64_digest(&state);
 }
@@ -22,6 +22,11 @@ std::string expr_to_string(ExprPtr e);
 
 class Expr
 {
+  private:
+    // creation order of the expression, assigned by the ExprBuilder. It is
+    // used to sort the operands of commutative operations deterministically
+    uint64_t m_order = 0;
+
   public:
     enum Kind {
         SYM,
@@ -32,6 +37,7 @@ class Expr
         ZEXT,
         SEXT,
         ITE,
+        ARRAY_READ,
 
         // arithmetic
         SHL,
@@ -202,6 +208,80 @@ class ITEExpr final : public BVExpr
 };
 typedef std::shared_ptr<const ITEExpr> ITEExprPtr;
 
+// a write (index, value) of an array of bitvectors. The writes form an
+// immutable list shared among the expressions that read the array, the most
+// recent write is the head of the list (KLEE-style update list). The last node
+// can be the symbolic base of the array (see ExprBuilder::mk_array_base): its
+// value is the symbol that names the array, its index is zero
+class ArrayUpdate;
+typedef std::shared_ptr<const ArrayUpdate> ArrayUpdatePtr;
+
+class ArrayUpdate final
+{
+  private:
+    BVExprPtr      m_index;
+    BVExprPtr      m_value;
+    ArrayUpdatePtr m_next;
+    size_t         m_length;
+    bool           m_is_base;
+    SymExprPtr     m_base;
+
+  public:
+    ArrayUpdate(BVExprPtr index, BVExprPtr value, ArrayUpdatePtr next,
+                bool is_base = false)
+        : m_index(index), m_value(value), m_next(next), m_is_base(is_base)
+    {
+        m_length = (next ? next->length() : 0) + (is_base ? 0 : 1);
+        if (is_base)
+            m_base = std::static_pointer_cast<const SymExpr>(value);
+        else if (next)
+            m_base = next->base();
+    }
+
+    BVExprPtr      index() const { return m_index; }
+    BVExprPtr      value() const { return m_value; }
+    ArrayUpdatePtr next() const { return m_next; }
+    size_t         length() const { return m_length; }
+    bool           is_base() const { return m_is_base; }
+    // the symbolic base of the list, nullptr if it is zero
+    SymExprPtr     base() const { return m_base; }
+};
+
+// read at "index" of the array defined by an update list. Not written
+// indexes are zero, or the bytes of the symbolic base of the list
+class ArrayReadExpr final : public BVExpr
+{
+  private:
+    static const Kind ekind = Kind::ARRAY_READ;
+
+    ArrayUpdatePtr m_updates;
+    BVExprPtr      m_index;
+
+  protected:
+    ArrayReadExpr(ArrayUpdatePtr updates, BVExprPtr index)
+        : m_updates(updates), m_index(index)
+    {
+    }
+
+  public:
+    virtual const Kind kind() const { return ekind; };
+    virtual size_t     size() const { return m_updates->value()->size(); };
+    virtual ExprPtr    clone() const
+    {
+        return ExprPtr(new ArrayReadExpr(m_updates, m_index));
+    }
+
+    virtual uint64_t             hash() const;
+    virtual bool                 eq(ExprPtr other) const;
+    virtual std::vector<ExprPtr> children() const;
+
+    ArrayUpdatePtr updates() const { return m_updates; }
+    BVExprPtr      index() const { return m_index; }
+
+    friend class ExprBuilder;
+};
+typedef std::shared_ptr<const ArrayReadExpr> ArrayReadExprPtr;
+
 class ExtractExpr final : public BVExpr
 {
   private:
@@ -919,6 +999,10 @@ class BoolAndExpr final : public BoolExpr
     BoolAndExpr(const std::vector<BoolExprPtr>& exprs) : m_exprs(exprs) {}
 
   public:
+    // the nested conjunctions are released without recursion (see
+    // ExprBuilder::release_conjuncts)
+    ~BoolAndExpr();
+
     virtual const Kind kind() const { return ekind; };
     virtual ExprPtr clone() const { return ExprPtr(new BoolAndExpr(m_exprs)); }
 
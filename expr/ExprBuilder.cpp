@@ -1,4 +1,5 @@
 #include "../util/ioutil.hpp"
+#include "../util/stats.hpp"
 
 #include "ExprBuilder.hpp"
 
@@ -9,6 +10,8 @@ namespace naaz::expr
 
 ConstExprPtr ExprBuilder::const_cache(uint64_t val, size_t size)
 {
+    std::lock_guard<std::recursive_mutex> lock(m_mutex);
+
     auto key = std::make_pair(val, size);
     if (m_consts.contains(key))
         return m_consts[key];
@@ -25,43 +28,121 @@ ConstExprPtr ExprBuilder::const_cache(uint64_t val, size_t size)
 
 ExprPtr ExprBuilder::get_or_create(const Expr& e)
 {
-    // Get a cached expression or create a new one
-    uint64_t hash = e.hash();
+    // Get a cached expression or create a new one. The kind is not part of the
+    // hash of the expressions, mix it here
+    STATS_TIMER(HASH_CONS);
+    std::lock_guard<std::recursive_mutex> lock(m_mutex);
+
+    uint64_t hash = e.hash() ^ ((uint64_t)e.kind() * 0x9e3779b97f4a7c15UL);
     if (!m_exprs.contains(hash)) {
         ExprPtr r = e.clone();
+        const_cast<Expr*>(r.get())->m_order = m_expr_order++;
 
         std::vector<WeakExprPtr> bucket;
         bucket.push_back(r);
         m_exprs.emplace(hash, bucket);
+        m_num_exprs++;
+        STATS_MAX(EXPR_TABLE_SIZE, m_num_exprs);
         return r;
     }
 
     std::vector<WeakExprPtr>& bucket = m_exprs.at(hash);
 
     // remove invalid weakrefs
+    size_t bucket_size = bucket.size();
     bucket.erase(std::remove_if(bucket.begin(), bucket.end(),
                                 [](WeakExprPtr we) { return we.expired(); }),
                  bucket.end());
+    m_num_exprs -= bucket_size - bucket.size();
 
-    for (auto& r : m_exprs.at(hash)) {
-        if (e.eq(r.lock()))
-            return r.lock();
+    // the last reference of an entry can be dropped by another thread at any
+    // time (without m_mutex), lock it once
+    for (auto& r : bucket) {
+        if (ExprPtr p = r.lock(); p && e.eq(p))
+            return p;
     }
     ExprPtr r = e.clone();
+    const_cast<Expr*>(r.get())->m_order = m_expr_order++;
     bucket.push_back(r);
+    m_num_exprs++;
+    STATS_MAX(EXPR_TABLE_SIZE, m_num_exprs);
     return r;
 }
 
+template <typename T> void ExprBuilder::sort_operands(std::vector<T>& exprs)
+{
+    // sort the operands of a commutative operation by creation order,
+    // constants last. We are trying to reduce the number of equivalent
+    // expressions, and the order must not depend on memory addresses
+    std::sort(exprs.begin(), exprs.end(), [](const T& e1, const T& e2) {
+        bool e1_const = e1->kind() == Expr::Kind::CONST;
+        bool e2_const = e2->kind() == Expr::Kind::CONST;
+        if (e1_const != e2_const)
+            return e2_const;
+        return e1->m_order < e2->m_order;
+    });
+}
+
 void ExprBuilder::collect_garbage()
 {
-    for (auto& [hash, bucket] : m_exprs) {
+    std::lock_guard<std::recursive_mutex> lock(m_mutex);
+    auto                                  it = m_exprs.begin();
+    while (it != m_exprs.end()) {
+        auto&  bucket      = it->second;
+        size_t bucket_size = bucket.size();
         bucket.erase(
             std::remove_if(bucket.begin(), bucket.end(),
                            [](WeakExprPtr we) { return we.expired(); }),
             bucket.end());
+        m_num_exprs -= bucket_size - bucket.size();
+        if (bucket.empty())
+            it = m_exprs.erase(it);
+        else
+            ++it;
     }
 }
 
+void ExprBuilder::release_conjuncts(std::vector<BoolExprPtr>& exprs)
+{
+    auto unique_and = [](const BoolExprPtr& e) {
+        return e.use_count() == 1 && e->kind() == Expr::Kind::BOOL_AND;
+    };
+    if (std::none_of(exprs.begin(), exprs.end(), unique_and))
+        return;
+
+    // get_or_create revives the expressions of the table only under m_mutex,
+    // an expression with a single reference cannot gain a new one here
+    std::lock_guard<std::recursive_mutex> lock(m_mutex);
+
+    std::vector<BoolExprPtr> stack;
+    stack.swap(exprs);
+    while (!stack.empty()) {
+        BoolExprPtr e = std::move(stack.back());
+        stack.pop_back();
+        if (!unique_and(e))
+            continue;
+
+        // e is released with no conjuncts at the end of the iteration
+        auto& nested =
+            const_cast<BoolAndExpr*>(static_cast<const BoolAndExpr*>(e.get()))
+                ->m_exprs;
+        for (auto& c : nested)
+            stack.push_back(std::move(c));
+        nested.clear();
+    }
+}
+
+SymExprPtr ExprBuilder::sym_expr(SymInfo& info)
+{
+    SymExprPtr res = info.expr.lock();
+    if (res == nullptr) {
+        SymExpr e(info.id, info.size);
+        res       = std::static_pointer_cast<const SymExpr>(get_or_create(e));
+        info.expr = res;
+    }
+    return res;
+}
+
 static inline void check_size_or_fail(const std::string& op_name, BVExprPtr lhs,
                                       BVExprPtr rhs)
 {
@@ -84,13 +165,28 @@ static inline void check_fp_type_or_fail(const std::string& op_name,
 const std::string& ExprBuilder::get_sym_name(uint32_t id) const
 {
     // It raises an exeption if the id does not name a symbol
+    std::lock_guard<std::recursive_mutex> lock(m_mutex);
     return m_sym_id_to_name.at(id);
 }
 
 uint32_t ExprBuilder::get_sym_id(const std::string& name) const
 {
     // It raises an exeption if the name is not a symbol
-    return m_symbols.at(name)->id();
+    std::lock_guard<std::recursive_mutex> lock(m_mutex);
+    return m_symbols.at(name).id;
+}
+
+SymExprPtr ExprBuilder::get_sym(uint32_t id)
+{
+    // It raises an exeption if the id does not name a symbol
+    std::lock_guard<std::recursive_mutex> lock(m_mutex);
+    return sym_expr(m_symbols.at(m_sym_id_to_name.at(id)));
+}
+
+uint32_t ExprBuilder::num_symbols() const
+{
+    std::lock_guard<std::recursive_mutex> lock(m_mutex);
+    return m_sym_ids;
 }
 
 BoolConstPtr ExprBuilder::mk_true() { return BoolConst::true_expr(); }
@@ -99,26 +195,24 @@ BoolConstPtr ExprBuilder::mk_false() { return BoolConst::false_expr(); }
 
 SymExprPtr ExprBuilder::mk_sym(const std::string& name, size_t size)
 {
-    if (m_symbols.contains(name)) {
-        auto sym = m_symbols[name];
-        if (sym->size() != size) {
+    std::lock_guard<std::recursive_mutex> lock(m_mutex);
+    auto it = m_symbols.find(name);
+    if (it != m_symbols.end()) {
+        if (it->second.size != size) {
             err("ExprBuilder")
                 << "mk_sym(): symbol \"" << name << "\" was created with size "
-                << sym->size()
+                << it->second.size
                 << " and now you are trying to create a new one with size "
                 << size << std::endl;
             exit_fail();
         }
-        return sym;
+        return sym_expr(it->second);
     }
 
-    uint32_t   sym_id = m_sym_ids++;
-    SymExpr    e(sym_id, size);
-    SymExprPtr res = std::static_pointer_cast<const SymExpr>(get_or_create(e));
-
-    m_symbols[name]          = res;
+    uint32_t sym_id          = m_sym_ids++;
     m_sym_id_to_name[sym_id] = name;
-    return res;
+    return sym_expr(
+        m_symbols.emplace(name, SymInfo{sym_id, size, {}}).first->second);
 }
 
 ConstExprPtr ExprBuilder::mk_const(const BVConst& val)
@@ -282,6 +376,63 @@ BVExprPtr ExprBuilder::mk_ite(BoolExprPtr guard, BVExprPtr iftrue,
     return std::static_pointer_cast<const BVExpr>(get_or_create(e));
 }
 
+ArrayUpdatePtr ExprBuilder::mk_array_base(SymExprPtr base, size_t index_size)
+{
+    return std::make_shared<const ArrayUpdate>(mk_const(0, index_size), base,
+                                               nullptr, true);
+}
+
+ArrayUpdatePtr ExprBuilder::mk_array_update(ArrayUpdatePtr updates,
+                                            BVExprPtr index, BVExprPtr value)
+{
+    if (updates) {
+        check_size_or_fail("array_update", updates->index(), index);
+        check_size_or_fail("array_update", updates->value(), value);
+
+        // the previous write to the same index is dead
+        if (updates->index() == index && !updates->is_base())
+            updates = updates->next();
+    }
+    return std::make_shared<const ArrayUpdate>(index, value, updates);
+}
+
+BVExprPtr ExprBuilder::mk_array_read(ArrayUpdatePtr updates, BVExprPtr index)
+{
+    if (!updates) {
+        err("ExprBuilder") << "mk_array_read(): empty update list" << std::endl;
+        exit_fail();
+    }
+    check_size_or_fail("array_read", updates->index(), index);
+
+    // read-over-write: skip the updates whose index is provably different,
+    // stop at the first one that may alias. Thanks to the linear form, the
+    // difference of two indexes is a constant if they differ by a constant
+    size_t value_size = updates->value()->size();
+    for (auto u = updates; u != nullptr; u = u->next()) {
+        if (u->is_base()) {
+            // a byte of the symbolic base
+            ArrayReadExpr e(u, index);
+            return std::static_pointer_cast<const BVExpr>(get_or_create(e));
+        }
+        if (u->index() == index)
+            return u->value();
+        if (index->kind() == Expr::Kind::CONST &&
+            u->index()->kind() == Expr::Kind::CONST)
+            continue;
+
+        BVExprPtr diff = mk_sub(index, u->index());
+        if (diff->kind() != Expr::Kind::CONST) {
+            ArrayReadExpr e(u, index);
+            return std::static_pointer_cast<const BVExpr>(get_or_create(e));
+        }
+
+        auto diff_ = std::static_pointer_cast<const ConstExpr>(diff);
+        if (diff_->val().is_zero())
+            return u->value();
+    }
+    return mk_const(0, value_size);
+}
+
 BVExprPtr ExprBuilder::mk_concat(BVExprPtr left, BVExprPtr right)
 {
     // pattern sext(EXPR)[high:EXPR.size] # EXPR ==> sext(EXPR)
@@ -496,6 +647,15 @@ BVExprPtr ExprBuilder::mk_neg(BVExprPtr expr)
         return mk_const(tmp);
     }
 
+    if (expr->kind() == Expr::Kind::ADD || expr->kind() == Expr::Kind::NEG ||
+        expr->kind() == Expr::Kind::MUL) {
+        // keep the linear form, e.g. -(a + 2) => (-a) + (-2)
+        std::map<BVExprPtr, BVConst> terms;
+        BVConst                      constant(0UL, expr->size());
+        linear_terms(expr, BVConst("-1", expr->size()), terms, constant);
+        return mk_linear(terms, constant);
+    }
+
     NegExpr e(expr);
     return std::static_pointer_cast<const BVExpr>(get_or_create(e));
 }
@@ -514,102 +674,159 @@ BVExprPtr ExprBuilder::mk_not(BVExprPtr expr)
     return std::static_pointer_cast<const BVExpr>(get_or_create(e));
 }
 
-BVExprPtr ExprBuilder::mk_add(BVExprPtr lhs, BVExprPtr rhs)
+void ExprBuilder::linear_terms(BVExprPtr e, const BVConst& coeff,
+                               std::map<BVExprPtr, BVConst>& o_terms,
+                               BVConst&                      o_constant)
 {
-    check_size_or_fail("add", lhs, rhs);
-
-    std::vector<BVExprPtr> addends;
+    switch (e->kind()) {
+        case Expr::Kind::CONST: {
+            auto    e_ = std::static_pointer_cast<const ConstExpr>(e);
+            BVConst tmp(e_->val());
+            tmp.mul(coeff);
+            o_constant.add(tmp);
+            return;
+        }
+        case Expr::Kind::ADD: {
+            auto e_ = std::static_pointer_cast<const AddExpr>(e);
+            for (auto addend : e_->addends())
+                linear_terms(addend, coeff, o_terms, o_constant);
+            return;
+        }
+        case Expr::Kind::NEG: {
+            auto    e_ = std::static_pointer_cast<const NegExpr>(e);
+            BVConst neg_coeff(coeff);
+            neg_coeff.neg();
+            linear_terms(e_->expr(), neg_coeff, o_terms, o_constant);
+            return;
+        }
+        case Expr::Kind::MUL: {
+            auto e_ = std::static_pointer_cast<const MulExpr>(e);
+
+            BVConst                mul_coeff(coeff);
+            std::vector<BVExprPtr> factors;
+            for (auto el : e_->els()) {
+                if (el->kind() == Expr::Kind::CONST)
+                    mul_coeff.mul(
+                        std::static_pointer_cast<const ConstExpr>(el)->val());
+                else
+                    factors.push_back(el);
+            }
+            if (factors.size() == e_->els().size())
+                break;
+            if (factors.size() == 1) {
+                linear_terms(factors.back(), mul_coeff, o_terms, o_constant);
+                return;
+            }
 
-    // flatten args
-    if (lhs->kind() == Expr::Kind::ADD) {
-        auto lhs_ = std::static_pointer_cast<const AddExpr>(lhs);
-        for (auto child : lhs_->addends())
-            addends.push_back(child);
-    } else {
-        addends.push_back(lhs);
+            MulExpr term(factors);
+            linear_terms(
+                std::static_pointer_cast<const BVExpr>(get_or_create(term)),
+                mul_coeff, o_terms, o_constant);
+            return;
+        }
+        default:
+            break;
     }
 
-    if (rhs->kind() == Expr::Kind::ADD) {
-        auto rhs_ = std::static_pointer_cast<const AddExpr>(rhs);
-        for (auto child : rhs_->addends())
-            addends.push_back(child);
-    } else {
-        addends.push_back(rhs);
-    }
+    if (!o_terms.contains(e))
+        o_terms.emplace(e, coeff);
+    else
+        o_terms.at(e).add(coeff);
+}
 
-    std::vector<BVExprPtr> children;
+BVExprPtr ExprBuilder::mk_scaled(BVExprPtr term, const BVConst& coeff)
+{
+    if (coeff.is_one())
+        return term;
 
-    // constant propagation
-    BVConst concrete_val((uint64_t)0UL, addends.at(0)->size());
-    for (auto addend : addends) {
-        if (addend->kind() == Expr::Kind::CONST) {
-            auto addend_ = std::static_pointer_cast<const ConstExpr>(addend);
-            concrete_val.add(addend_->val());
-        } else {
-            children.push_back(addend);
-        }
+    if (coeff.has_all_bit_set()) {
+        NegExpr e(term);
+        return std::static_pointer_cast<const BVExpr>(get_or_create(e));
     }
 
-    // remove 'add with negated'
-    std::vector<BVExprPtr>   pruned_children;
-    std::map<BVExprPtr, int> negated_exprs;
-    std::map<BVExprPtr, int> normal_exprs;
-    for (auto exp : children) {
-        if (exp->kind() == Expr::Kind::NEG) {
-            auto exp_ = std::static_pointer_cast<const NegExpr>(exp);
-            if (normal_exprs.contains(exp_->expr())) {
-                if (normal_exprs[exp_->expr()] == 1)
-                    normal_exprs.erase(exp_->expr());
-                else
-                    normal_exprs[exp_->expr()] -= 1;
-            } else if (!negated_exprs.contains(exp_->expr()))
-                negated_exprs[exp_->expr()] = 1;
-            else
-                negated_exprs[exp_->expr()] += 1;
-        } else {
-            if (negated_exprs.contains(exp)) {
-                if (negated_exprs[exp] == 1)
-                    negated_exprs.erase(exp);
-                else
-                    negated_exprs[exp] -= 1;
-            } else if (!normal_exprs.contains(exp))
-                normal_exprs[exp] = 1;
-            else
-                normal_exprs[exp] += 1;
-        }
-    }
-    for (auto pair : negated_exprs) {
-        if (pair.second > 1)
-            pruned_children.push_back(mk_mul(
-                mk_neg(pair.first), mk_const(pair.second, pair.first->size())));
-        else
-            pruned_children.push_back(mk_neg(pair.first));
+    std::vector<BVExprPtr> els;
+    if (term->kind() == Expr::Kind::MUL) {
+        auto term_ = std::static_pointer_cast<const MulExpr>(term);
+        els        = term_->els();
+    } else {
+        els.push_back(term);
     }
-    for (auto pair : normal_exprs)
-        if (pair.second > 1)
-            pruned_children.push_back(
-                mk_mul(pair.first, mk_const(pair.second, pair.first->size())));
-        else
-            pruned_children.push_back(pair.first);
+    els.push_back(mk_const(coeff));
+    sort_operands(els);
+
+    MulExpr e(els);
+    return std::static_pointer_cast<const BVExpr>(get_or_create(e));
+}
+
+BVExprPtr ExprBuilder::mk_linear(const std::map<BVExprPtr, BVConst>& terms,
+                                 const BVConst&                      constant)
+{
+    std::vector<BVExprPtr> children;
+    for (const auto& [term, coeff] : terms)
+        if (!coeff.is_zero())
+            children.push_back(mk_scaled(term, coeff));
 
     // final checks
-    if (pruned_children.size() == 0)
-        return mk_const(concrete_val);
+    if (children.size() == 0)
+        return mk_const(constant);
 
-    if (!concrete_val.is_zero())
-        pruned_children.push_back(mk_const(concrete_val));
+    if (!constant.is_zero())
+        children.push_back(mk_const(constant));
 
-    if (pruned_children.size() == 1)
-        return pruned_children.back();
+    if (children.size() == 1)
+        return children.back();
 
-    // sort children by address (commutative! We are trying to reduce the
-    // number of equivalent expressions)
-    std::sort(pruned_children.begin(), pruned_children.end());
+    // sort children (commutative! We are trying to reduce the number of
+    // equivalent expressions)
+    sort_operands(children);
 
-    AddExpr e(pruned_children);
+    AddExpr e(children);
     return std::static_pointer_cast<const BVExpr>(get_or_create(e));
 }
 
+ExprBuilder::LinearForm ExprBuilder::linear_form(BVExprPtr e)
+{
+    LinearForm res;
+    res.constant = BVConst(0UL, e->size());
+
+    std::map<BVExprPtr, BVConst> terms;
+    linear_terms(e, BVConst(1UL, e->size()), terms, res.constant);
+
+    // drop the terms that cancelled out, and sort the others by creation
+    // order (i.e., deterministically)
+    for (const auto& [term, coeff] : terms)
+        if (!coeff.is_zero())
+            res.terms.push_back({term, coeff});
+    std::sort(res.terms.begin(), res.terms.end(),
+              [](const auto& t1, const auto& t2) {
+                  return t1.first->m_order < t2.first->m_order;
+              });
+    return res;
+}
+
+BVExprPtr ExprBuilder::mk_add(BVExprPtr lhs, BVExprPtr rhs)
+{
+    check_size_or_fail("add", lhs, rhs);
+
+    // constant propagation
+    if (lhs->kind() == Expr::Kind::CONST && rhs->kind() == Expr::Kind::CONST) {
+        auto    lhs_ = std::static_pointer_cast<const ConstExpr>(lhs);
+        auto    rhs_ = std::static_pointer_cast<const ConstExpr>(rhs);
+        BVConst tmp(lhs_->val());
+        tmp.add(rhs_->val());
+        return mk_const(tmp);
+    }
+
+    // the addends are flattened, the coefficients of equal terms summed (this
+    // also removes 'add with negated') and the constants folded
+    std::map<BVExprPtr, BVConst> terms;
+    BVConst                      constant(0UL, lhs->size());
+    BVConst                      one(1UL, lhs->size());
+    linear_terms(lhs, one, terms, constant);
+    linear_terms(rhs, one, terms, constant);
+    return mk_linear(terms, constant);
+}
+
 BVExprPtr ExprBuilder::mk_mul(BVExprPtr lhs, BVExprPtr rhs)
 {
     check_size_or_fail("mul", lhs, rhs);
@@ -650,15 +867,23 @@ BVExprPtr ExprBuilder::mk_mul(BVExprPtr lhs, BVExprPtr rhs)
     if (children.size() == 0 || concrete_val.is_zero())
         return mk_const(concrete_val);
 
+    if (children.size() == 1 && !concrete_val.is_one()) {
+        // linear term, the constant is distributed over sums
+        std::map<BVExprPtr, BVConst> terms;
+        BVConst                      constant(0UL, concrete_val.size());
+        linear_terms(children.back(), concrete_val, terms, constant);
+        return mk_linear(terms, constant);
+    }
+
     if (!concrete_val.is_one())
         children.push_back(mk_const(concrete_val));
 
     if (children.size() == 1)
         return children.back();
 
-    // sort children by address (commutative! We are trying to reduce the
-    // number of equivalent expressions)
-    std::sort(children.begin(), children.end());
+    // sort children (commutative! We are trying to reduce the number of
+    // equivalent expressions)
+    sort_operands(children);
 
     MulExpr e(children);
     return std::static_pointer_cast<const BVExpr>(get_or_create(e));
@@ -855,9 +1080,9 @@ BVExprPtr ExprBuilder::mk_and(BVExprPtr lhs, BVExprPtr rhs)
     if (children.size() == 1)
         return children.back();
 
-    // sort children by address (commutative! We are trying to reduce the
-    // number of equivalent expressions)
-    std::sort(children.begin(), children.end());
+    // sort children (commutative! We are trying to reduce the number of
+    // equivalent expressions)
+    sort_operands(children);
 
     AndExpr e(children);
     return std::static_pointer_cast<const BVExpr>(get_or_create(e));
@@ -912,9 +1137,9 @@ BVExprPtr ExprBuilder::mk_or(BVExprPtr lhs, BVExprPtr rhs)
     if (children.size() == 1)
         return children.back();
 
-    // sort children by address (commutative! We are trying to reduce the
-    // number of equivalent expressions)
-    std::sort(children.begin(), children.end());
+    // sort children (commutative! We are trying to reduce the number of
+    // equivalent expressions)
+    sort_operands(children);
 
     OrExpr e(children);
     return std::static_pointer_cast<const BVExpr>(get_or_create(e));
@@ -978,9 +1203,9 @@ BVExprPtr ExprBuilder::mk_xor(BVExprPtr lhs, BVExprPtr rhs)
     if (pruned_children.size() == 1)
         return pruned_children.back();
 
-    // sort children by address (commutative! We are trying to reduce the
-    // number of equivalent expressions)
-    std::sort(pruned_children.begin(), pruned_children.end());
+    // sort children (commutative! We are trying to reduce the number of
+    // equivalent expressions)
+    sort_operands(pruned_children);
 
     XorExpr e(pruned_children);
     return std::static_pointer_cast<const BVExpr>(get_or_create(e));
@@ -1151,46 +1376,41 @@ BoolExprPtr ExprBuilder::mk_eq(BVExprPtr lhs, BVExprPtr rhs)
         return lhs_->val().eq(rhs_->val()) ? mk_true() : mk_false();
     }
 
-    // (a - b == 0) => (a == b)
-    if (lhs->kind() == Expr::Kind::ADD && rhs->kind() == Expr::Kind::CONST) {
-        auto lhs_ = std::static_pointer_cast<const AddExpr>(lhs);
-        auto rhs_ = std::static_pointer_cast<const ConstExpr>(rhs);
+    if (lhs == rhs)
+        return mk_true();
 
-        if (rhs_->val().is_zero()) {
-            BVExprPtr              rhs = nullptr;
-            std::vector<BVExprPtr> other_exprs;
-            for (auto a : lhs_->addends()) {
-                if (rhs == nullptr && a->kind() == Expr::Kind::NEG) {
-                    rhs = std::static_pointer_cast<const NegExpr>(a)->expr();
-                } else if (a->kind() == Expr::Kind::CONST) {
-                    if (rhs != nullptr)
-                        other_exprs.push_back(mk_neg(rhs));
-                    rhs = mk_neg(a);
-                } else {
-                    other_exprs.push_back(a);
-                }
-            }
+    // canonical linear form: (lhs - rhs == 0) => (terms == constant)
+    std::map<BVExprPtr, BVConst> terms;
+    BVConst                      constant(0UL, lhs->size());
+    linear_terms(lhs, BVConst(1UL, lhs->size()), terms, constant);
+    linear_terms(rhs, BVConst("-1", lhs->size()), terms, constant);
+    std::erase_if(terms, [](const auto& t) { return t.second.is_zero(); });
+
+    if (terms.size() == 0)
+        return constant.is_zero() ? mk_true() : mk_false();
+
+    // the coefficient of the first term (in creation order) is positive
+    auto first = std::min_element(
+        terms.begin(), terms.end(), [](const auto& t1, const auto& t2) {
+            return t1.first->m_order < t2.first->m_order;
+        });
+    if (first->second.get_bit(first->second.size() - 1) == 0)
+        constant.neg();
+    else
+        for (auto& [term, coeff] : terms)
+            coeff.neg();
 
-            if (rhs != nullptr) {
-                assert(other_exprs.size() > 0 &&
-                       "mk_eq(): invalid number of other exprs");
-                if (other_exprs.size() == 1) {
-                    EqExpr e(other_exprs.at(0), rhs);
-                    return std::static_pointer_cast<const BoolExpr>(
-                        get_or_create(e));
-                } else {
-                    AddExpr ae(other_exprs);
-                    auto    ae_expr = std::static_pointer_cast<const BVExpr>(
-                        get_or_create(ae));
-                    EqExpr e(ae_expr, rhs);
-                    return std::static_pointer_cast<const BoolExpr>(
-                        get_or_create(e));
-                }
-            }
+    // (a - b == 0) => (a == b)
+    if (terms.size() == 2 && constant.is_zero()) {
+        auto second = first == terms.begin() ? std::next(terms.begin())
+                                             : terms.begin();
+        if (first->second.is_one() && second->second.has_all_bit_set()) {
+            EqExpr e(first->first, second->first);
+            return std::static_pointer_cast<const BoolExpr>(get_or_create(e));
         }
     }
 
-    EqExpr e(lhs, rhs);
+    EqExpr e(mk_linear(terms, BVConst(0UL, lhs->size())), mk_const(constant));
     return std::static_pointer_cast<const BoolExpr>(get_or_create(e));
 }
 
@@ -1206,35 +1426,42 @@ BoolExprPtr ExprBuilder::mk_bool_and_no_simpl(std::set<BoolExprPtr> exprs)
     if (exprs.size() == 1)
         return *exprs.begin();
 
-    BoolAndExpr e(exprs);
+    // the set is ordered by address, the conjuncts are sorted by creation
+    // order so that the query does not change across runs
+    std::vector<BoolExprPtr> sorted(exprs.begin(), exprs.end());
+    sort_operands(sorted);
+
+    BoolAndExpr e(sorted);
     return std::static_pointer_cast<const BoolExpr>(get_or_create(e));
 }
 
 BoolExprPtr ExprBuilder::mk_bool_and(BoolExprPtr e1, BoolExprPtr e2)
 {
-    std::set<BoolExprPtr> exprs;
+    const BoolExprPtr exprs[] = {e1, e2};
+    return mk_bool_and(exprs);
+}
 
-    // flatten args
-    if (e1->kind() == Expr::Kind::BOOL_AND) {
-        auto e1_ = std::static_pointer_cast<const BoolAndExpr>(e1);
-        for (auto e : e1_->exprs())
-            exprs.insert(e);
-    } else {
-        exprs.insert(e1);
-    }
+BoolExprPtr ExprBuilder::mk_bool_and(std::span<const BoolExprPtr> exprs)
+{
+    std::vector<BoolExprPtr> flattened;
+    flattened.reserve(exprs.size());
 
-    if (e2->kind() == Expr::Kind::BOOL_AND) {
-        auto e2_ = std::static_pointer_cast<const BoolAndExpr>(e2);
-        for (auto e : e2_->exprs())
-            exprs.insert(e);
-    } else {
-        exprs.insert(e2);
+    // flatten args
+    for (auto e : exprs) {
+        if (e->kind() == Expr::Kind::BOOL_AND) {
+            auto e_ = std::static_pointer_cast<const BoolAndExpr>(e);
+            flattened.insert(flattened.end(), e_->exprs().begin(),
+                             e_->exprs().end());
+        } else {
+            flattened.push_back(e);
+        }
     }
 
     std::vector<BoolExprPtr> actual_exprs;
+    actual_exprs.reserve(flattened.size());
 
     // constant propagation
-    for (auto e : exprs) {
+    for (auto e : flattened) {
         if (e->kind() == Expr::Kind::BOOL_CONST) {
             auto e_ = std::static_pointer_cast<const BoolConst>(e);
             if (!e_->is_true())
@@ -1244,6 +1471,13 @@ BoolExprPtr ExprBuilder::mk_bool_and(BoolExprPtr e1, BoolExprPtr e2)
         }
     }
 
+    // sort actual_exprs (commutative! We are trying to reduce the number of
+    // equivalent expressions) and drop duplicates, only once for all the
+    // conjuncts
+    sort_operands(actual_exprs);
+    actual_exprs.erase(std::unique(actual_exprs.begin(), actual_exprs.end()),
+                       actual_exprs.end());
+
     // final checks
     if (actual_exprs.size() == 0)
         return mk_true();
@@ -1251,10 +1485,6 @@ BoolExprPtr ExprBuilder::mk_bool_and(BoolExprPtr e1, BoolExprPtr e2)
     if (actual_exprs.size() == 1)
         return actual_exprs.back();
 
-    // sort actual_exprs by address (commutative! We are trying to reduce the
-    // number of equivalent expressions)
-    std::sort(actual_exprs.begin(), actual_exprs.end());
-
     BoolAndExpr e(actual_exprs);
     return std::static_pointer_cast<const BoolExpr>(get_or_create(e));
 }
@@ -1300,9 +1530,9 @@ BoolExprPtr ExprBuilder::mk_bool_or(BoolExprPtr e1, BoolExprPtr e2)
     if (actual_exprs.size() == 1)
         return actual_exprs.back();
 
-    // sort actual_exprs by address (commutative! We are trying to reduce the
-    // number of equivalent expressions)
-    std::sort(actual_exprs.begin(), actual_exprs.end());
+    // sort actual_exprs (commutative! We are trying to reduce the number of
+    // equivalent expressions)
+    sort_operands(actual_exprs);
 
     BoolOrExpr e(actual_exprs);
     return std::static_pointer_cast<const BoolExpr>(get_or_create(e));
@@ -1542,9 +1772,9 @@ FPExprPtr ExprBuilder::mk_fp_add(FPExprPtr lhs, FPExprPtr rhs)
     if (pruned_children.size() == 1)
         return pruned_children.back();
 
-    // sort children by address (commutative! We are trying to reduce the
-    // number of equivalent expressions)
-    std::sort(pruned_children.begin(), pruned_children.end());
+    // sort children (commutative! We are trying to reduce the number of
+    // equivalent expressions)
+    sort_operands(pruned_children);
 
     FPAddExpr e(pruned_children);
     return std::static_pointer_cast<const FPExpr>(get_or_create(e));
@@ -1601,9 +1831,9 @@ FPExprPtr ExprBuilder::mk_fp_mul(FPExprPtr lhs, FPExprPtr rhs)
     if (children.size() == 1)
         return children.back();
 
-    // sort children by address (commutative! We are trying to reduce the
-    // number of equivalent expressions)
-    std::sort(children.begin(), children.end());
+    // sort children (commutative! We are trying to reduce the number of
+    // equivalent expressions)
+    sort_operands(children);
 
     FPMulExpr e(children);
     return std::static_pointer_cast<const FPExpr>(get_or_create(e));
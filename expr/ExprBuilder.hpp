@@ -4,6 +4,8 @@
 
 #include <vector>
 #include <map>
+#include <mutex>
+#include <span>
 
 namespace naaz::expr
 {
@@ -11,28 +13,73 @@ namespace naaz::expr
 class ExprBuilder
 {
   private:
+    // a symbol keeps its id when its expression is freed (e.g., at the end
+    // of a naaz_server job), the expression is rebuilt on demand
+    struct SymInfo {
+        uint32_t                     id;
+        size_t                       size;
+        std::weak_ptr<const SymExpr> expr;
+    };
+
     std::map<uint64_t, std::vector<WeakExprPtr>>        m_exprs;
     std::map<std::pair<uint64_t, size_t>, ConstExprPtr> m_consts;
     std::map<uint32_t, std::string>                     m_sym_id_to_name;
-    std::map<std::string, SymExprPtr>                   m_symbols;
+    std::map<std::string, SymInfo>                      m_symbols;
     uint32_t                                            m_sym_ids;
+    uint64_t                                            m_expr_order;
+    // the entries of m_exprs (the expired ones until they are pruned)
+    uint64_t                                            m_num_exprs;
+
+    // the tables are shared by the threads that build expressions (e.g., the
+    // workers of the StateEmitter)
+    mutable std::recursive_mutex m_mutex;
 
     ConstExprPtr const_cache(uint64_t val, size_t size);
     ExprPtr      get_or_create(const Expr& e);
+    SymExprPtr   sym_expr(SymInfo& info);
+
+    template <typename T> static void sort_operands(std::vector<T>& exprs);
+
+    // arithmetic expressions are kept in a canonical linear form, i.e., a sum
+    // of (coefficient * term) plus a constant
+    void      linear_terms(BVExprPtr e, const BVConst& coeff,
+                           std::map<BVExprPtr, BVConst>& o_terms,
+                           BVConst&                      o_constant);
+    BVExprPtr mk_scaled(BVExprPtr term, const BVConst& coeff);
+    BVExprPtr mk_linear(const std::map<BVExprPtr, BVConst>& terms,
+                        const BVConst&                      constant);
 
-    ExprBuilder() : m_sym_ids(0) {}
+    ExprBuilder() : m_sym_ids(0), m_expr_order(0), m_num_exprs(0) {}
 
   public:
     static ExprBuilder& The()
     {
-        static ExprBuilder eb;
-        return eb;
+        // never destroyed, the expressions of the static caches are released
+        // after the other statics at exit
+        static ExprBuilder* eb = new ExprBuilder();
+        return *eb;
     }
 
+    // drop the expired entries of the expression table
     void collect_garbage();
 
+    // release the conjuncts of a conjunction that is being destroyed. The
+    // nested conjunctions that are not referenced elsewhere (e.g., the chain
+    // built by ConstraintManager::add) are emptied iteratively
+    void release_conjuncts(std::vector<BoolExprPtr>& exprs);
+
     const std::string& get_sym_name(uint32_t id) const;
     uint32_t           get_sym_id(const std::string& name) const;
+    // the symbols have the ids [0, num_symbols())
+    SymExprPtr         get_sym(uint32_t id);
+    uint32_t           num_symbols() const;
+
+    // terms (sorted) and constant of the canonical linear form of "e"
+    struct LinearForm {
+        std::vector<std::pair<BVExprPtr, BVConst>> terms;
+        BVConst                                    constant;
+    };
+    LinearForm linear_form(BVExprPtr e);
 
     BoolConstPtr mk_true();
     BoolConstPtr mk_false();
@@ -46,6 +93,15 @@ class ExprBuilder
     BVExprPtr    mk_sext(BVExprPtr e, uint32_t n);
     BVExprPtr    mk_ite(BoolExprPtr guard, BVExprPtr iftrue, BVExprPtr iffalse);
 
+    // arrays. The read is resolved if the index is (or is not) provably equal
+    // to the indexes of the updates. An array with a symbolic base (named by
+    // the symbol base, of the size of the values) has unconstrained values
+    // where it is not written, instead of zero
+    ArrayUpdatePtr mk_array_base(SymExprPtr base, size_t index_size);
+    ArrayUpdatePtr mk_array_update(ArrayUpdatePtr updates, BVExprPtr index,
+                                   BVExprPtr value);
+    BVExprPtr      mk_array_read(ArrayUpdatePtr updates, BVExprPtr index);
+
     // arithmetic
     BVExprPtr mk_shl(BVExprPtr expr, BVExprPtr val);
     BVExprPtr mk_lshr(BVExprPtr expr, BVExprPtr val);
@@ -78,6 +134,7 @@ class ExprBuilder
 
     BoolExprPtr mk_bool_and_no_simpl(std::set<BoolExprPtr> exprs);
     BoolExprPtr mk_bool_and(BoolExprPtr e1, BoolExprPtr e2);
+    BoolExprPtr mk_bool_and(std::span<const BoolExprPtr> exprs);
     BoolExprPtr mk_bool_or(BoolExprPtr e1, BoolExprPtr e2);
 
     // floating point
@@ -0,0 +1,518 @@
+#include "ExprSerializer.hpp"
+#include "ExprBuilder.hpp"
+
+#include "../util/ioutil.hpp"
+
+#define exprBuilder naaz::expr::ExprBuilder::The()
+
+namespace naaz::expr
+{
+
+// records of the stream
+enum Tag : uint8_t { EXPR_DEF, UPDATES_DEF, REF, NONE, BASE_DEF };
+
+void ExprWriter::write_byte(uint8_t b) { m_out.put((char)b); }
+
+void ExprWriter::write_uint(uint64_t v)
+{
+    while (v >= 0x80) {
+        write_byte((uint8_t)(v & 0x7f) | 0x80);
+        v >>= 7;
+    }
+    write_byte((uint8_t)v);
+}
+
+void ExprWriter::write_str(const std::string& s)
+{
+    write_uint(s.size());
+    m_out.write(s.data(), s.size());
+}
+
+void ExprWriter::write_const(const BVConst& c)
+{
+    write_uint(c.size());
+    if (c.size() <= 64) {
+        write_uint(c.as_u64());
+        return;
+    }
+    for (auto b : c.as_data())
+        write_byte(b);
+}
+
+static int32_t float_format_size(ExprPtr e)
+{
+    return std::static_pointer_cast<const FPExpr>(e)->ff()->getSize();
+}
+
+uint64_t ExprWriter::define(ExprPtr e)
+{
+    auto it = m_expr_ids.find(e);
+    if (it != m_expr_ids.end())
+        return it->second;
+
+    // the children are defined before the expression
+    std::vector<uint64_t> children_ids;
+    uint64_t              updates_id = 0;
+    if (e->kind() == Expr::Kind::ARRAY_READ) {
+        auto e_ = std::static_pointer_cast<const ArrayReadExpr>(e);
+        // 0 is the empty list
+        updates_id = define(e_->updates()) + 1;
+        children_ids.push_back(define(e_->index()));
+    } else {
+        for (auto child : e->children())
+            children_ids.push_back(define(child));
+    }
+
+    write_byte(Tag::EXPR_DEF);
+    write_uint(e->kind());
+    switch (e->kind()) {
+        case Expr::Kind::SYM: {
+            auto e_ = std::static_pointer_cast<const SymExpr>(e);
+            write_str(e_->name());
+            write_uint(e_->size());
+            break;
+        }
+        case Expr::Kind::CONST:
+            write_const(std::static_pointer_cast<const ConstExpr>(e)->val());
+            break;
+        case Expr::Kind::BOOL_CONST:
+            write_uint(std::static_pointer_cast<const BoolConst>(e)->is_true());
+            break;
+        case Expr::Kind::FP_CONST: {
+            auto e_ = std::static_pointer_cast<const FPConstExpr>(e);
+            write_uint(float_format_size(e));
+            write_uint(e_->val().val());
+            break;
+        }
+        case Expr::Kind::ARRAY_READ:
+            write_uint(updates_id);
+            write_uint(children_ids.at(0));
+            break;
+        default:
+            write_uint(children_ids.size());
+            for (auto id : children_ids)
+                write_uint(id);
+
+            // the parameters that are not children
+            if (e->kind() == Expr::Kind::EXTRACT) {
+                auto e_ = std::static_pointer_cast<const ExtractExpr>(e);
+                write_uint(e_->high());
+                write_uint(e_->low());
+            } else if (e->kind() == Expr::Kind::ZEXT ||
+                       e->kind() == Expr::Kind::SEXT) {
+                write_uint(std::static_pointer_cast<const BVExpr>(e)->size());
+            } else if (e->kind() == Expr::Kind::BV_TO_FP ||
+                       e->kind() == Expr::Kind::FP_CONVERT ||
+                       e->kind() == Expr::Kind::FP_INT_TO_FP) {
+                write_uint(float_format_size(e));
+            }
+            break;
+    }
+
+    uint64_t id = m_expr_ids.size();
+    m_expr_ids.emplace(e, id);
+    return id;
+}
+
+uint64_t ExprWriter::define(ArrayUpdatePtr u)
+{
+    auto it = m_update_ids.find(u);
+    if (it != m_update_ids.end())
+        return it->second;
+
+    if (u->is_base()) {
+        // the symbol of the base and the size of the indexes
+        uint64_t base_id = define(u->value());
+        write_byte(Tag::BASE_DEF);
+        write_uint(base_id);
+        write_uint(u->index()->size());
+    } else {
+        uint64_t next_id  = u->next() ? define(u->next()) + 1 : 0;
+        uint64_t index_id = define(u->index());
+        uint64_t value_id = define(u->value());
+
+        write_byte(Tag::UPDATES_DEF);
+        write_uint(next_id);
+        write_uint(index_id);
+        write_uint(value_id);
+    }
+
+    uint64_t id = m_update_ids.size();
+    m_update_ids.emplace(u, id);
+    return id;
+}
+
+void ExprWriter::write_expr(ExprPtr e)
+{
+    uint64_t id = define(e);
+    write_byte(Tag::REF);
+    write_uint(id);
+}
+
+void ExprWriter::write_updates(ArrayUpdatePtr u)
+{
+    if (u == nullptr) {
+        write_byte(Tag::NONE);
+        return;
+    }
+    uint64_t id = define(u);
+    write_byte(Tag::REF);
+    write_uint(id);
+}
+
+uint8_t ExprReader::read_byte()
+{
+    int c = m_in.get();
+    if (c == std::char_traits<char>::eof()) {
+        err("ExprReader") << "unexpected end of the stream" << std::endl;
+        exit_fail();
+    }
+    return (uint8_t)c;
+}
+
+uint64_t ExprReader::read_uint()
+{
+    uint64_t v     = 0;
+    uint32_t shift = 0;
+    while (1) {
+        uint8_t b = read_byte();
+        v |= (uint64_t)(b & 0x7f) << shift;
+        if (!(b & 0x80))
+            break;
+        shift += 7;
+    }
+    return v;
+}
+
+std::string ExprReader::read_str()
+{
+    std::string s(read_uint(), '\0');
+    m_in.read(s.data(), s.size());
+    if (!m_in) {
+        err("ExprReader") << "unexpected end of the stream" << std::endl;
+        exit_fail();
+    }
+    return s;
+}
+
+BVConst ExprReader::read_const()
+{
+    ssize_t size = read_uint();
+    if (size <= 64)
+        return BVConst(read_uint(), size);
+
+    std::vector<uint8_t> data((size + 7) / 8);
+    for (auto& b : data)
+        b = read_byte();
+    BVConst c(data);
+    if (c.size() != size)
+        c.extract(size - 1, 0);
+    return c;
+}
+
+// n-ary expression built with a binary builder function
+template <typename T>
+static ExprPtr fold(const std::vector<ExprPtr>& c,
+                    std::shared_ptr<const T> (ExprBuilder::*mk)(
+                        std::shared_ptr<const T>, std::shared_ptr<const T>))
+{
+    auto res = std::static_pointer_cast<const T>(c.at(0));
+    for (size_t i = 1; i < c.size(); ++i)
+        res =
+            (exprBuilder.*mk)(res, std::static_pointer_cast<const T>(c.at(i)));
+    return res;
+}
+
+ExprPtr ExprReader::expr_at(uint64_t id) const
+{
+    if (id >= m_exprs.size()) {
+        err("ExprReader") << "invalid expression reference " << id
+                          << std::endl;
+        exit_fail();
+    }
+    return m_exprs.at(id);
+}
+
+FloatFormatPtr ExprReader::float_format(int32_t size) const
+{
+    FloatFormatPtr ff = m_float_format(size);
+    if (ff == nullptr) {
+        err("ExprReader") << "no float format of size " << size << std::endl;
+        exit_fail();
+    }
+    return ff;
+}
+
+void ExprReader::read_expr_definition()
+{
+    auto kind = (Expr::Kind)read_uint();
+
+    ExprPtr res;
+    switch (kind) {
+        case Expr::Kind::SYM: {
+            std::string name = read_str();
+            m_exprs.push_back(exprBuilder.mk_sym(name, read_uint()));
+            return;
+        }
+        case Expr::Kind::CONST:
+            m_exprs.push_back(exprBuilder.mk_const(read_const()));
+            return;
+        case Expr::Kind::BOOL_CONST:
+            m_exprs.push_back(read_uint() ? exprBuilder.mk_true()
+                                          : exprBuilder.mk_false());
+            return;
+        case Expr::Kind::FP_CONST: {
+            FloatFormatPtr ff  = float_format(read_uint());
+            uint64_t       val = read_uint();
+            m_exprs.push_back(exprBuilder.mk_fp_const(FPConst(ff, val)));
+            return;
+        }
+        case Expr::Kind::ARRAY_READ: {
+            uint64_t updates_id = read_uint();
+            auto     index      = std::static_pointer_cast<const BVExpr>(
+                expr_at(read_uint()));
+            if (updates_id == 0 || updates_id > m_updates.size()) {
+                err("ExprReader") << "invalid array read" << std::endl;
+                exit_fail();
+            }
+            m_exprs.push_back(
+                exprBuilder.mk_array_read(m_updates.at(updates_id - 1), index));
+            return;
+        }
+        default:
+            break;
+    }
+
+    std::vector<ExprPtr> c(read_uint());
+    for (auto& child : c)
+        child = expr_at(read_uint());
+    if (c.empty()) {
+        err("ExprReader") << "expression without children" << std::endl;
+        exit_fail();
+    }
+
+    auto bv = [&](size_t i) {
+        return std::static_pointer_cast<const BVExpr>(c.at(i));
+    };
+    auto bl = [&](size_t i) {
+        return std::static_pointer_cast<const BoolExpr>(c.at(i));
+    };
+    auto fp = [&](size_t i) {
+        return std::static_pointer_cast<const FPExpr>(c.at(i));
+    };
+
+    switch (kind) {
+        case Expr::Kind::EXTRACT: {
+            uint32_t high = read_uint();
+            uint32_t low  = read_uint();
+            res           = exprBuilder.mk_extract(bv(0), high, low);
+            break;
+        }
+        case Expr::Kind::CONCAT:
+            res = fold<BVExpr>(c, &ExprBuilder::mk_concat);
+            break;
+        case Expr::Kind::ZEXT:
+            res = exprBuilder.mk_zext(bv(0), read_uint());
+            break;
+        case Expr::Kind::SEXT:
+            res = exprBuilder.mk_sext(bv(0), read_uint());
+            break;
+        case Expr::Kind::ITE:
+            res = exprBuilder.mk_ite(bl(0), bv(1), bv(2));
+            break;
+        case Expr::Kind::SHL:
+            res = exprBuilder.mk_shl(bv(0), bv(1));
+            break;
+        case Expr::Kind::LSHR:
+            res = exprBuilder.mk_lshr(bv(0), bv(1));
+            break;
+        case Expr::Kind::ASHR:
+            res = exprBuilder.mk_ashr(bv(0), bv(1));
+            break;
+        case Expr::Kind::NEG:
+            res = exprBuilder.mk_neg(bv(0));
+            break;
+        case Expr::Kind::NOT:
+            res = exprBuilder.mk_not(bv(0));
+            break;
+        case Expr::Kind::AND:
+            res = fold<BVExpr>(c, &ExprBuilder::mk_and);
+            break;
+        case Expr::Kind::OR:
+            res = fold<BVExpr>(c, &ExprBuilder::mk_or);
+            break;
+        case Expr::Kind::XOR:
+            res = fold<BVExpr>(c, &ExprBuilder::mk_xor);
+            break;
+        case Expr::Kind::ADD:
+            res = fold<BVExpr>(c, &ExprBuilder::mk_add);
+            break;
+        case Expr::Kind::MUL:
+            res = fold<BVExpr>(c, &ExprBuilder::mk_mul);
+            break;
+        case Expr::Kind::SDIV:
+            res = exprBuilder.mk_sdiv(bv(0), bv(1));
+            break;
+        case Expr::Kind::UDIV:
+            res = exprBuilder.mk_udiv(bv(0), bv(1));
+            break;
+        case Expr::Kind::SREM:
+            res = exprBuilder.mk_srem(bv(0), bv(1));
+            break;
+        case Expr::Kind::UREM:
+            res = exprBuilder.mk_urem(bv(0), bv(1));
+            break;
+        case Expr::Kind::BOOL_NOT:
+            res = exprBuilder.mk_not(bl(0));
+            break;
+        case Expr::Kind::ULT:
+            res = exprBuilder.mk_ult(bv(0), bv(1));
+            break;
+        case Expr::Kind::ULE:
+            res = exprBuilder.mk_ule(bv(0), bv(1));
+            break;
+        case Expr::Kind::UGT:
+            res = exprBuilder.mk_ugt(bv(0), bv(1));
+            break;
+        case Expr::Kind::UGE:
+            res = exprBuilder.mk_uge(bv(0), bv(1));
+            break;
+        case Expr::Kind::SLT:
+            res = exprBuilder.mk_slt(bv(0), bv(1));
+            break;
+        case Expr::Kind::SLE:
+            res = exprBuilder.mk_sle(bv(0), bv(1));
+            break;
+        case Expr::Kind::SGT:
+            res = exprBuilder.mk_sgt(bv(0), bv(1));
+            break;
+        case Expr::Kind::SGE:
+            res = exprBuilder.mk_sge(bv(0), bv(1));
+            break;
+        case Expr::Kind::EQ:
+            res = exprBuilder.mk_eq(bv(0), bv(1));
+            break;
+        case Expr::Kind::BOOL_AND: {
+            std::vector<BoolExprPtr> exprs;
+            for (size_t i = 0; i < c.size(); ++i)
+                exprs.push_back(bl(i));
+            res = exprBuilder.mk_bool_and(exprs);
+            break;
+        }
+        case Expr::Kind::BOOL_OR:
+            res = fold<BoolExpr>(c, &ExprBuilder::mk_bool_or);
+            break;
+        case Expr::Kind::BV_TO_FP:
+            res = exprBuilder.mk_bv_to_fp(float_format(read_uint()), bv(0));
+            break;
+        case Expr::Kind::FP_TO_BV:
+            res = exprBuilder.mk_fp_to_bv(fp(0));
+            break;
+        case Expr::Kind::FP_CONVERT:
+            res = exprBuilder.mk_fp_convert(fp(0), float_format(read_uint()));
+            break;
+        case Expr::Kind::FP_INT_TO_FP:
+            res = exprBuilder.mk_int_to_fp(bv(0), float_format(read_uint()));
+            break;
+        case Expr::Kind::FP_IS_NAN:
+            res = exprBuilder.mk_fp_is_nan(fp(0));
+            break;
+        case Expr::Kind::FP_NEG:
+            res = exprBuilder.mk_fp_neg(fp(0));
+            break;
+        case Expr::Kind::FP_ADD:
+            res = fold<FPExpr>(c, &ExprBuilder::mk_fp_add);
+            break;
+        case Expr::Kind::FP_MUL:
+            res = fold<FPExpr>(c, &ExprBuilder::mk_fp_mul);
+            break;
+        case Expr::Kind::FP_DIV:
+            res = exprBuilder.mk_fp_div(fp(0), fp(1));
+            break;
+        case Expr::Kind::FP_LT:
+            res = exprBuilder.mk_fp_lt(fp(0), fp(1));
+            break;
+        case Expr::Kind::FP_EQ:
+            res = exprBuilder.mk_fp_eq(fp(0), fp(1));
+            break;
+        default:
+            err("ExprReader") << "unexpected kind " << kind << std::endl;
+            exit_fail();
+    }
+    m_exprs.push_back(res);
+}
+
+bool ExprReader::read_definition(uint8_t tag)
+{
+    if (tag == Tag::EXPR_DEF) {
+        read_expr_definition();
+        return true;
+    }
+    if (tag == Tag::UPDATES_DEF) {
+        uint64_t next_id = read_uint();
+        auto index =
+            std::static_pointer_cast<const BVExpr>(expr_at(read_uint()));
+        auto value =
+            std::static_pointer_cast<const BVExpr>(expr_at(read_uint()));
+        if (next_id > m_updates.size()) {
+            err("ExprReader") << "invalid update reference" << std::endl;
+            exit_fail();
+        }
+        ArrayUpdatePtr next = next_id ? m_updates.at(next_id - 1) : nullptr;
+        m_updates.push_back(exprBuilder.mk_array_update(next, index, value));
+        return true;
+    }
+    if (tag == Tag::BASE_DEF) {
+        ExprPtr  base       = expr_at(read_uint());
+        uint64_t index_size = read_uint();
+        if (base->kind() != Expr::Kind::SYM) {
+            err("ExprReader") << "invalid array base" << std::endl;
+            exit_fail();
+        }
+        m_updates.push_back(exprBuilder.mk_array_base(
+            std::static_pointer_cast<const SymExpr>(base), index_size));
+        return true;
+    }
+    return false;
+}
+
+ExprPtr ExprReader::read_expr()
+{
+    uint8_t tag = read_byte();
+    while (read_definition(tag))
+        tag = read_byte();
+
+    if (tag != Tag::REF) {
+        err("ExprReader") << "expected an expression" << std::endl;
+        exit_fail();
+    }
+    return expr_at(read_uint());
+}
+
+BVExprPtr ExprReader::read_bv_expr()
+{
+    return std::static_pointer_cast<const BVExpr>(read_expr());
+}
+
+BoolExprPtr ExprReader::read_bool_expr()
+{
+    return std::static_pointer_cast<const BoolExpr>(read_expr());
+}
+
+ArrayUpdatePtr ExprReader::read_updates()
+{
+    uint8_t tag = read_byte();
+    while (read_definition(tag))
+        tag = read_byte();
+
+    if (tag == Tag::NONE)
+        return nullptr;
+    uint64_t id = read_uint();
+    if (tag != Tag::REF || id >= m_updates.size()) {
+        err("ExprReader") << "expected an update list" << std::endl;
+        exit_fail();
+    }
+    return m_updates.at(id);
+}
+
+} // namespace naaz::expr
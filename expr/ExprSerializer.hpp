@@ -0,0 +1,77 @@
+#pragma once
+
+#include <functional>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Expr.hpp"
+
+namespace naaz::expr
+{
+
+// Compact binary encoding of the expressions. Every expression (and array
+// update) is defined in the stream once, before its first reference, and then
+// referred to by its index: the sharing of the DAG is preserved. The integers
+// are written as LEB128 varints. The values written with an ExprWriter must be
+// read back, in the same order, with an ExprReader
+class ExprWriter
+{
+    std::ostream& m_out;
+
+    // the written expressions are kept alive, their addresses must not be
+    // reused while the writer exists
+    std::unordered_map<ExprPtr, uint64_t>        m_expr_ids;
+    std::unordered_map<ArrayUpdatePtr, uint64_t> m_update_ids;
+
+    void     write_byte(uint8_t b);
+    uint64_t define(ExprPtr e);
+    uint64_t define(ArrayUpdatePtr u);
+
+  public:
+    ExprWriter(std::ostream& out) : m_out(out) {}
+
+    void write_uint(uint64_t v);
+    void write_str(const std::string& s);
+    void write_const(const BVConst& c);
+    void write_expr(ExprPtr e);
+    // the update list can be empty (nullptr)
+    void write_updates(ArrayUpdatePtr u);
+};
+
+class ExprReader
+{
+  public:
+    // the float formats are not serialized, they are looked up by size
+    typedef std::function<FloatFormatPtr(int32_t)> FloatFormatLookup;
+
+  private:
+    std::istream&               m_in;
+    FloatFormatLookup           m_float_format;
+    std::vector<ExprPtr>        m_exprs;
+    std::vector<ArrayUpdatePtr> m_updates;
+
+    uint8_t        read_byte();
+    bool           read_definition(uint8_t tag);
+    void           read_expr_definition();
+    ExprPtr        expr_at(uint64_t id) const;
+    FloatFormatPtr float_format(int32_t size) const;
+
+  public:
+    ExprReader(std::istream& in, FloatFormatLookup float_format)
+        : m_in(in), m_float_format(float_format)
+    {
+    }
+
+    uint64_t       read_uint();
+    std::string    read_str();
+    BVConst        read_const();
+    ExprPtr        read_expr();
+    BVExprPtr      read_bv_expr();
+    BoolExprPtr    read_bool_expr();
+    ArrayUpdatePtr read_updates();
+};
+
+} // namespace naaz::expr
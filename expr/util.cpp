@@ -2,6 +2,7 @@
 
 #include "../util/ioutil.hpp"
 #include "../util/strutil.hpp"
+#include "../util/stats.hpp"
 
 #include "util.hpp"
 #include "ExprBuilder.hpp"
@@ -29,6 +30,25 @@ bool is_false_const(BoolExprPtr e)
     return !e_->is_true();
 }
 
+SymExprPtr array_base_value(SymExprPtr base, uint64_t index)
+{
+    return exprBuilder.mk_sym(
+        string_format("%s@0x%lx", base->name().c_str(), index), base->size());
+}
+
+std::pair<BVExprPtr, BVConst> split_base_offset(BVExprPtr e)
+{
+    if (e->kind() == Expr::Kind::ADD) {
+        // the constant is always the last addend of a sum
+        auto e_   = std::static_pointer_cast<const AddExpr>(e);
+        auto last = e_->addends().back();
+        if (last->kind() == Expr::Kind::CONST)
+            return {exprBuilder.mk_sub(e, last),
+                    std::static_pointer_cast<const ConstExpr>(last)->val()};
+    }
+    return {e, BVConst(0UL, e->size())};
+}
+
 static ExprPtr evaluate_inner(ExprPtr                            e,
                               const std::map<uint32_t, BVConst>& assignments,
                               bool                         model_completion,
@@ -101,6 +121,53 @@ static ExprPtr evaluate_inner(ExprPtr                            e,
             res = exprBuilder.mk_ite(eval_guard, eval_iftrue, eval_iffalse);
             break;
         }
+        case Expr::Kind::ARRAY_READ: {
+            auto e_ = std::static_pointer_cast<const ArrayReadExpr>(e);
+            auto eval_index =
+                std::static_pointer_cast<const BVExpr>(evaluate_inner(
+                    e_->index(), assignments, model_completion, cache));
+
+            // rebuild the update list starting from the oldest write
+            std::vector<ArrayUpdatePtr> updates;
+            for (auto u = e_->updates(); u != nullptr; u = u->next())
+                updates.push_back(u);
+
+            ArrayUpdatePtr eval_updates = nullptr;
+            for (auto it = updates.rbegin(); it != updates.rend(); ++it) {
+                if ((*it)->is_base()) {
+                    eval_updates = *it;
+                    continue;
+                }
+                auto eval_idx =
+                    std::static_pointer_cast<const BVExpr>(evaluate_inner(
+                        (*it)->index(), assignments, model_completion, cache));
+                auto eval_val =
+                    std::static_pointer_cast<const BVExpr>(evaluate_inner(
+                        (*it)->value(), assignments, model_completion, cache));
+                eval_updates = exprBuilder.mk_array_update(eval_updates,
+                                                           eval_idx, eval_val);
+            }
+            res = exprBuilder.mk_array_read(eval_updates, eval_index);
+
+            // a concrete byte of the symbolic base, in the model
+            if (res->kind() == Expr::Kind::ARRAY_READ) {
+                auto r = std::static_pointer_cast<const ArrayReadExpr>(res);
+                if (r->updates()->is_base() &&
+                    r->index()->kind() == Expr::Kind::CONST) {
+                    SymExprPtr value = array_base_value(
+                        std::static_pointer_cast<const SymExpr>(
+                            r->updates()->value()),
+                        std::static_pointer_cast<const ConstExpr>(r->index())
+                            ->val()
+                            .as_u64());
+                    if (assignments.contains(value->id()))
+                        res = exprBuilder.mk_const(assignments.at(value->id()));
+                    else if (model_completion)
+                        res = exprBuilder.mk_const(0, r->size());
+                }
+            }
+            break;
+        }
         case Expr::Kind::SHL: {
             auto e_ = std::static_pointer_cast<const ShlExpr>(e);
             auto eval_expr =
@@ -503,9 +570,29 @@ static ExprPtr evaluate_inner(ExprPtr                            e,
 ExprPtr evaluate(ExprPtr e, const std::map<uint32_t, BVConst>& assignments,
                  bool model_completion)
 {
+    STATS_TIMER(EVALUATE);
     std::map<uint64_t, ExprPtr> cache;
-    auto res = evaluate_inner(e, assignments, model_completion, cache);
-    return res;
+
+    // evaluate the children before their parents with an explicit stack,
+    // evaluate_inner finds them in the cache and does not recurse on deep
+    // expressions (e.g., a chain of nested conjunctions)
+    std::vector<std::pair<ExprPtr, bool>> stack = {{e, false}};
+    while (!stack.empty()) {
+        auto [cur, expanded] = stack.back();
+        stack.pop_back();
+        if (cache.contains((uint64_t)cur.get()))
+            continue;
+        if (expanded) {
+            evaluate_inner(cur, assignments, model_completion, cache);
+            continue;
+        }
+        stack.push_back({cur, true});
+        for (auto& child : cur->children()) {
+            if (!cache.contains((uint64_t)child.get()))
+                stack.push_back({child, false});
+        }
+    }
+    return cache.at((uint64_t)e.get());
 }
 
 static std::string to_string_inner(ExprPtr                         e,
@@ -571,6 +658,13 @@ static std::string to_string_inner(ExprPtr                         e,
                                     to_string_inner(e_->iffalse(), cache).c_str());
             break;
         }
+        case Expr::Kind::ARRAY_READ: {
+            auto e_ = std::static_pointer_cast<const ArrayReadExpr>(e);
+            res     = string_format(
+                "Array<%lu>[%s]", e_->updates()->length(),
+                to_string_inner(e_->index(), cache).c_str());
+            break;
+        }
         case Expr::Kind::SHL: {
             auto e_ = std::static_pointer_cast<const ShlExpr>(e);
             res     = string_format("( %s << %s )",
@@ -13,6 +13,13 @@ ExprPtr evaluate(ExprPtr e, const std::map<uint32_t, BVConst>& assignments,
 bool    is_true_const(BoolExprPtr e);
 bool    is_false_const(BoolExprPtr e);
 
+// the symbol that holds, in the models of the solver, the value of the
+// symbolic base of an array at index (see ExprBuilder::mk_array_base)
+SymExprPtr array_base_value(SymExprPtr base, uint64_t index);
+
+// split an expression in a base and a constant offset (e == base + offset)
+std::pair<BVExprPtr, BVConst> split_base_offset(BVExprPtr e);
+
 std::string expr_to_string(ExprPtr e);
 
 } // namespace naaz::expr
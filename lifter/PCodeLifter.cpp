@@ -8,6 +8,7 @@
 #include "PCodeLifter.hpp"
 #include "../util/ioutil.hpp"
 #include "../util/strutil.hpp"
+#include "../util/stats.hpp"
 
 namespace naaz::lifter
 {
@@ -154,9 +155,11 @@ PCodeLifter::~PCodeLifter() { csleigh_destroyContext(m_ctx); }
 const PCodeBlock* PCodeLifter::lift(uint64_t addr, const uint8_t* data,
                                     size_t data_size)
 {
+    std::lock_guard<std::mutex> lock(m_mutex);
     if (m_blocks.contains(addr))
         return m_blocks.at(addr).get();
 
+    STATS_TIMER(LIFT);
     csleigh_TranslationResult* r =
         csleigh_translate(m_ctx, data, data_size, addr, 0, true);
     if (!r) {
@@ -225,7 +228,11 @@ std::vector<csleigh_Register> PCodeLifter::regs() const
     return res;
 }
 
-void PCodeLifter::clear_block_cache() { m_blocks.clear(); }
+void PCodeLifter::clear_block_cache()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_blocks.clear();
+}
 
 uint32_t PCodeLifter::ram_space_id() const
 {
@@ -2,6 +2,7 @@
 
 #include <map>
 #include <memory>
+#include <mutex>
 
 #include "../arch/Arch.hpp"
 #include "../expr/FPConst.hpp"
@@ -42,6 +43,10 @@ class PCodeLifter
     std::vector<FloatFormatPtr>                     m_float_formats;
     std::map<uint64_t, std::unique_ptr<PCodeBlock>> m_blocks;
 
+    // the lifter can be shared by threads (e.g., the jobs of naaz_server),
+    // the translation and the block cache are guarded by m_mutex
+    std::mutex m_mutex;
+
   public:
     PCodeLifter(const Arch& arch);
     ~PCodeLifter();
@@ -1,6 +1,8 @@
 #include "AddressSpace.hpp"
 #include "../util/ioutil.hpp"
 
+#include <algorithm>
+#include <atomic>
 #include <cstring>
 
 namespace naaz::loader
@@ -29,33 +31,36 @@ const std::string& Symbol::type_to_string(Type t)
 }
 
 Segment::Segment(Segment&& other)
-    : m_name(other.m_name), m_addr(other.m_addr), m_size(other.m_size),
-      m_data(std::move(other.m_data)), m_perm(other.m_perm)
+    : m_name(std::move(other.m_name)), m_addr(other.m_addr),
+      m_size(other.m_size), m_perm(other.m_perm),
+      m_mapped(std::move(other.m_mapped)),
+      m_data(other.m_data.exchange(nullptr))
 {
 }
 
 Segment::Segment(const std::string& name, uint64_t addr, const uint8_t* data,
                  size_t size, uint8_t perm)
-    : m_name(name), m_addr(addr), m_size(size), m_perm(perm)
+    : m_name(name), m_addr(addr), m_size(size), m_perm(perm),
+      m_data(new uint8_t[size])
 {
-    m_data = std::unique_ptr<uint8_t[]>{
-        new uint8_t[size]() // parenthesis are crucial to zero-initialize the
-                            // buffer
-    };
-    memcpy(m_data.get(), data, size);
+    memcpy(m_data.load(), data, size);
 }
 
 Segment::Segment(const std::string& name, uint64_t addr, size_t size,
                  uint8_t perm)
-    : m_name(name), m_addr(addr), m_size(size), m_perm(perm)
+    : m_name(name), m_addr(addr), m_size(size), m_perm(perm), m_data(nullptr)
 {
-    m_data = std::unique_ptr<uint8_t[]>{
-        new uint8_t[size]() // parenthesis are crucial to zero-initialize the
-                            // buffer
-    };
+    // zero, allocated on the first write
 }
 
-Segment::~Segment() {}
+Segment::Segment(const std::string& name, uint64_t addr,
+                 std::shared_ptr<const uint8_t> data, size_t size, uint8_t perm)
+    : m_name(name), m_addr(addr), m_size(size), m_perm(perm), m_mapped(data),
+      m_data(nullptr)
+{
+}
+
+Segment::~Segment() { delete[] m_data.load(); }
 
 bool Segment::contains(uint64_t addr) const
 {
@@ -71,7 +76,8 @@ std::optional<uint8_t> Segment::read(uint64_t addr) const
 {
     if (!contains(addr))
         return {};
-    return m_data[addr - m_addr];
+    const uint8_t* d = data();
+    return d ? d[addr - m_addr] : 0;
 }
 
 bool Segment::get_ref(uint64_t addr, uint8_t** o_data, size_t* o_size)
@@ -79,11 +85,108 @@ bool Segment::get_ref(uint64_t addr, uint8_t** o_data, size_t* o_size)
     if (!contains(addr))
         return false;
 
-    *o_data = m_data.get() + (addr - m_addr);
+    uint8_t* d = m_data.load(std::memory_order_acquire);
+    if (d == nullptr) {
+        // the caller could modify the content, copy it (or allocate the
+        // zeros). If another thread races, the first copy wins
+        uint8_t* copy = new uint8_t[m_size]();
+        if (m_mapped)
+            memcpy(copy, m_mapped.get(), m_size);
+        if (m_data.compare_exchange_strong(d, copy, std::memory_order_acq_rel))
+            d = copy;
+        else
+            delete[] copy;
+    }
+
+    *o_data = d + (addr - m_addr);
+    *o_size = (m_size - (addr - m_addr));
+    return true;
+}
+
+bool Segment::get_ref(uint64_t addr, const uint8_t** o_data,
+                      size_t* o_size) const
+{
+    if (!contains(addr))
+        return false;
+
+    const uint8_t* d = data();
+    if (d == nullptr) {
+        // a zero segment that was never written, a shared page of zeros
+        static const uint8_t zeros[4096] = {};
+        *o_data = zeros;
+        *o_size = std::min(m_size - (addr - m_addr), sizeof(zeros));
+        return true;
+    }
+
+    *o_data = d + (addr - m_addr);
     *o_size = (m_size - (addr - m_addr));
     return true;
 }
 
+// identifies the content of an AddressSpace in the lookup caches
+static std::atomic<uint64_t> address_space_id = 0;
+
+AddressSpace::AddressSpace() : m_id(++address_space_id) {}
+
+void AddressSpace::index_segment(size_t segment)
+{
+    const Segment& seg = m_segments.at(segment);
+    if (seg.size() == 0)
+        return;
+
+    // index only the addresses that are not in the previous segments
+    uint64_t              min_addr = seg.addr();
+    uint64_t              max_addr = seg.addr() + seg.size() - 1;
+    std::vector<Interval> intervals;
+    bool                  covered = false;
+    for (const auto& i : m_index) {
+        if (i.max_addr < min_addr || i.min_addr > max_addr)
+            continue;
+        if (i.min_addr > min_addr)
+            intervals.push_back({min_addr, i.min_addr - 1, segment});
+        if (i.max_addr >= max_addr) {
+            covered = true;
+            break;
+        }
+        min_addr = i.max_addr + 1;
+    }
+    if (!covered)
+        intervals.push_back({min_addr, max_addr, segment});
+
+    m_index.insert(m_index.end(), intervals.begin(), intervals.end());
+    std::sort(m_index.begin(), m_index.end(),
+              [](const Interval& a, const Interval& b) {
+                  return a.min_addr < b.min_addr;
+              });
+    m_id = ++address_space_id;
+}
+
+std::optional<AddressSpace::Interval>
+AddressSpace::lookup(uint64_t addr) const
+{
+    // the consecutive lookups are often in the same interval
+    thread_local struct {
+        uint64_t as_id = 0;
+        Interval interval;
+    } last_hit;
+    if (last_hit.as_id == m_id && addr >= last_hit.interval.min_addr &&
+        addr <= last_hit.interval.max_addr)
+        return last_hit.interval;
+
+    auto it = std::upper_bound(
+        m_index.begin(), m_index.end(), addr,
+        [](uint64_t a, const Interval& i) { return a < i.min_addr; });
+    if (it == m_index.begin())
+        return {};
+    --it;
+    if (addr > it->max_addr)
+        return {};
+
+    last_hit.as_id    = m_id;
+    last_hit.interval = *it;
+    return *it;
+}
+
 Segment& AddressSpace::register_segment(const std::string& name, uint64_t addr,
                                         std::vector<uint8_t> data, uint8_t perm)
 {
@@ -95,6 +198,7 @@ Segment& AddressSpace::register_segment(const std::string& name, uint64_t addr,
                                         uint8_t perm)
 {
     m_segments.emplace_back(name, addr, data, size, perm);
+    index_segment(m_segments.size() - 1);
     return m_segments.back();
 }
 
@@ -102,65 +206,101 @@ Segment& AddressSpace::register_segment(const std::string& name, uint64_t addr,
                                         size_t size, uint8_t perm)
 {
     m_segments.emplace_back(name, addr, size, perm);
+    index_segment(m_segments.size() - 1);
     return m_segments.back();
 }
 
-std::optional<uint8_t> AddressSpace::read_byte(uint64_t addr) const
+Segment& AddressSpace::register_segment(const std::string& name, uint64_t addr,
+                                        std::shared_ptr<const uint8_t> data,
+                                        size_t size, uint8_t perm)
+{
+    m_segments.emplace_back(name, addr, data, size, perm);
+    index_segment(m_segments.size() - 1);
+    return m_segments.back();
+}
+
+bool AddressSpace::read(uint64_t addr, uint8_t* buf, size_t len) const
+{
+    while (len > 0) {
+        auto interval = lookup(addr);
+        if (!interval.has_value())
+            return false;
+
+        // copy the bytes up to the end of the interval
+        const Segment& seg  = m_segments.at(interval->segment);
+        uint64_t       left = interval->max_addr - addr;
+        size_t         n    = left >= len - 1 ? len : left + 1;
+        if (seg.data() != nullptr)
+            memcpy(buf, seg.data() + (addr - seg.addr()), n);
+        else
+            memset(buf, 0, n);
+        buf += n;
+        addr += n;
+        len -= n;
+    }
+    return true;
+}
+
+static uint64_t from_bytes(const uint8_t* buf, size_t len, Endianess end)
 {
-    for (auto& s : m_segments) {
-        if (s.contains(addr))
-            return s.read(addr);
+    uint64_t res = 0;
+    for (size_t i = 0; i < len; ++i) {
+        size_t shift = end == Endianess::BIG ? len - i - 1 : i;
+        res |= (uint64_t)buf[i] << (shift * 8);
     }
-    return {};
+    return res;
+}
+
+std::optional<uint8_t> AddressSpace::read_byte(uint64_t addr) const
+{
+    auto interval = lookup(addr);
+    if (!interval.has_value())
+        return {};
+    return m_segments.at(interval->segment).read(addr);
 }
 
 std::optional<uint16_t> AddressSpace::read_word(uint64_t  addr,
                                                 Endianess end) const
 {
-    for (auto& s : m_segments) {
-        if (s.contains(addr) && s.contains(addr + 1)) {
-            uint8_t b1 = s.read(addr).value();
-            uint8_t b2 = s.read(addr + 1).value();
-            return end == Endianess::BIG ? ((uint16_t)b1 << 8U) | b2
-                                         : ((uint16_t)b2 << 8U) | b1;
-        }
-    }
-    return {};
+    uint8_t buf[2];
+    if (!read(addr, buf, sizeof(buf)))
+        return {};
+    return from_bytes(buf, sizeof(buf), end);
 }
 
 std::optional<uint32_t> AddressSpace::read_dword(uint64_t  addr,
                                                  Endianess end) const
 {
-    std::optional<uint16_t> w1 = read_word(addr);
-    std::optional<uint16_t> w2 = read_word(addr + 2);
-
-    if (!w1.has_value() || !w2.has_value())
+    uint8_t buf[4];
+    if (!read(addr, buf, sizeof(buf)))
         return {};
-
-    return end == Endianess::BIG ? ((uint32_t)w1.value() << 16U) | w2.value()
-                                 : ((uint32_t)w2.value() << 16U) | w1.value();
+    return from_bytes(buf, sizeof(buf), end);
 }
 
 std::optional<uint64_t> AddressSpace::read_qword(uint64_t  addr,
                                                  Endianess end) const
 {
-    std::optional<uint32_t> d1 = read_dword(addr);
-    std::optional<uint32_t> d2 = read_dword(addr + 4);
-
-    if (!d1.has_value() || !d2.has_value())
+    uint8_t buf[8];
+    if (!read(addr, buf, sizeof(buf)))
         return {};
+    return from_bytes(buf, sizeof(buf), end);
+}
 
-    return end == Endianess::BIG ? ((uint64_t)d1.value() << 32U) | d2.value()
-                                 : ((uint64_t)d2.value() << 32U) | d1.value();
+bool AddressSpace::get_ref(uint64_t addr, const uint8_t** o_buf,
+                           size_t* o_size) const
+{
+    auto interval = lookup(addr);
+    if (!interval.has_value())
+        return false;
+    return m_segments.at(interval->segment).get_ref(addr, o_buf, o_size);
 }
 
-bool AddressSpace::get_ref(uint64_t addr, uint8_t** o_buf, size_t* o_size)
+const Segment* AddressSpace::get_segment(uint64_t addr) const
 {
-    for (auto& s : m_segments) {
-        if (s.contains(addr))
-            return s.get_ref(addr, o_buf, o_size);
-    }
-    return false;
+    auto interval = lookup(addr);
+    if (!interval.has_value())
+        return nullptr;
+    return &m_segments.at(interval->segment);
 }
 
 void AddressSpace::register_symbol(uint64_t addr, const std::string& name,
@@ -1,9 +1,11 @@
 #pragma once
 
+#include <atomic>
 #include <optional>
 #include <cstdint>
 #include <vector>
 #include <map>
+#include <memory>
 
 #include "../arch/Arch.hpp"
 
@@ -36,23 +38,44 @@ class Symbol
 class Segment
 {
   private:
-    std::string                m_name;
-    uint64_t                   m_addr;
-    std::unique_ptr<uint8_t[]> m_data;
-    size_t                     m_size;
-    uint8_t                    m_perm;
+    std::string m_name;
+    uint64_t    m_addr;
+    size_t      m_size;
+    uint8_t     m_perm;
+
+    // the content is either owned by the segment (m_data), read-only memory
+    // shared with others (e.g., a mapping of the binary), or zero (e.g.,
+    // .bss). The first get_ref() that asks for a writable reference allocates
+    // m_data, a copy of the mapped memory or zeros. The segments are shared
+    // among the threads, the copy is published atomically
+    std::shared_ptr<const uint8_t> m_mapped;
+    std::atomic<uint8_t*>          m_data;
 
   public:
     Segment(Segment&& other);
     Segment(const std::string& name, uint64_t addr, const uint8_t* data,
             size_t size, uint8_t perm);
     Segment(const std::string& name, uint64_t addr, size_t size, uint8_t perm);
+    Segment(const std::string& name, uint64_t addr,
+            std::shared_ptr<const uint8_t> data, size_t size, uint8_t perm);
     ~Segment();
 
     bool                   contains(uint64_t addr) const;
     std::optional<uint8_t> read(uint64_t addr) const;
     bool get_ref(uint64_t addr, uint8_t** o_data, size_t* o_size);
+    bool get_ref(uint64_t addr, const uint8_t** o_data, size_t* o_size) const;
 
+    bool is_mapped() const
+    {
+        return m_mapped != nullptr &&
+               m_data.load(std::memory_order_acquire) == nullptr;
+    }
+    // nullptr if the segment is zero (and it was never written)
+    const uint8_t* data() const
+    {
+        uint8_t* data = m_data.load(std::memory_order_acquire);
+        return data ? data : m_mapped.get();
+    }
     const std::string& name() const { return m_name; }
     uint64_t           addr() const { return m_addr; }
     size_t             size() const { return m_size; }
@@ -82,12 +105,24 @@ class Relocation
 class AddressSpace
 {
   private:
+    // disjoint intervals of addresses sorted by the first address, each one
+    // mapped to the first registered segment that contains it
+    struct Interval {
+        uint64_t min_addr, max_addr;
+        size_t   segment;
+    };
+
     std::vector<Segment>                    m_segments;
+    std::vector<Interval>                   m_index;
     std::map<uint64_t, std::vector<Symbol>> m_symbols;
     std::vector<Relocation>                 m_relocs;
+    uint64_t                                m_id;
+
+    void                    index_segment(size_t segment);
+    std::optional<Interval> lookup(uint64_t addr) const;
 
   public:
-    AddressSpace() {}
+    AddressSpace();
 
     Segment& register_segment(const std::string& name, uint64_t addr,
                               std::vector<uint8_t> data, uint8_t perm);
@@ -95,6 +130,12 @@ class AddressSpace
                               const uint8_t* data, size_t size, uint8_t perm);
     Segment& register_segment(const std::string& name, uint64_t addr,
                               size_t size, uint8_t perm);
+    Segment& register_segment(const std::string& name, uint64_t addr,
+                              std::shared_ptr<const uint8_t> data, size_t size,
+                              uint8_t perm);
+
+    // read len bytes in buf. False if some of the bytes are not mapped
+    bool read(uint64_t addr, uint8_t* buf, size_t len) const;
 
     std::optional<uint8_t>  read_byte(uint64_t addr) const;
     std::optional<uint16_t> read_word(uint64_t  addr,
@@ -104,7 +145,9 @@ class AddressSpace
     std::optional<uint64_t> read_qword(uint64_t  addr,
                                        Endianess end = Endianess::LITTLE) const;
 
-    bool get_ref(uint64_t addr, uint8_t** o_buf, size_t* o_size);
+    bool get_ref(uint64_t addr, const uint8_t** o_buf, size_t* o_size) const;
+
+    const Segment* get_segment(uint64_t addr) const;
 
     void register_symbol(uint64_t addr, const std::string& name,
                          Symbol::Type type);
@@ -1,5 +1,10 @@
 #include "BFDLoader.hpp"
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include "../state/State.hpp"
 #include "../util/ioutil.hpp"
 #include "../arch/x86_64.hpp"
@@ -9,7 +14,7 @@ namespace naaz::loader
 {
 
 BFDLoader::BFDLoader(const std::filesystem::path& filename)
-    : m_filename(filename), m_arch(NULL), m_obj(NULL)
+    : m_filename(filename), m_arch(NULL), m_obj(NULL), m_file_size(0)
 {
     m_obj = bfd_openr(filename.c_str(), nullptr);
     if (m_obj == nullptr) {
@@ -62,6 +67,7 @@ BFDLoader::BFDLoader(const std::filesystem::path& filename)
             exit_fail();
     }
 
+    map_file();
     load_sections();
     load_symtab();
     load_dyn_symtab();
@@ -70,6 +76,42 @@ BFDLoader::BFDLoader(const std::filesystem::path& filename)
     deduce_syscall_abi();
 }
 
+void BFDLoader::map_file()
+{
+    // the sections stored as they are in the file reference a read-only
+    // mapping of the file. If the mapping fails, they are copied
+    int fd = open(m_filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        return;
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        size_t size = st.st_size;
+        void*  addr = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr != MAP_FAILED) {
+            m_file_map  = std::shared_ptr<const uint8_t>(
+                (const uint8_t*)addr,
+                [size](const uint8_t* p) { munmap((void*)p, size); });
+            m_file_size = size;
+        }
+    }
+    close(fd);
+}
+
+bool BFDLoader::is_mappable(asection* bfd_sec) const
+{
+    // the content of the section must be in the file, without relocations to
+    // apply and not compressed
+    flagword flags = bfd_section_flags(bfd_sec);
+    if (m_file_map == nullptr || !(flags & SEC_HAS_CONTENTS) ||
+        (flags & SEC_RELOC) || bfd_is_section_compressed(m_obj, bfd_sec))
+        return false;
+    if (bfd_sec->filepos < 0)
+        return false;
+    return (uint64_t)bfd_sec->filepos + bfd_section_size(bfd_sec) <=
+           m_file_size;
+}
+
 void BFDLoader::load_sections()
 {
     for (asection* bfd_sec = m_obj->sections; bfd_sec != (asection*)NULL;
@@ -85,9 +127,24 @@ void BFDLoader::load_sections()
             perm |= PERM_EXEC;
 
         std::string sec_name(bfd_section_name(bfd_sec));
-        Segment&    segment = m_address_space->register_segment(
-               sec_name, bfd_section_vma(bfd_sec), bfd_section_size(bfd_sec),
-               perm);
+        if (is_mappable(bfd_sec)) {
+            // the segment shares the ownership of the mapping
+            std::shared_ptr<const uint8_t> data(
+                m_file_map, m_file_map.get() + bfd_sec->filepos);
+            m_address_space->register_segment(sec_name,
+                                              bfd_section_vma(bfd_sec), data,
+                                              bfd_section_size(bfd_sec), perm);
+            continue;
+        }
+
+        // without content (e.g., .bss), zero until it is written
+        Segment& segment = m_address_space->register_segment(
+            sec_name, bfd_section_vma(bfd_sec), bfd_section_size(bfd_sec),
+            perm);
+        if (!(bfd_section_flags(bfd_sec) & SEC_HAS_CONTENTS))
+            continue;
+
+        // relocated or compressed
 
         uint8_t* seg_data;
         size_t   seg_size;
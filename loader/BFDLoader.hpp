@@ -23,7 +23,11 @@ class BFDLoader : public Loader
     SyscallABI                           m_syscall_abi;
     std::shared_ptr<AddressSpace>        m_address_space;
     std::shared_ptr<lifter::PCodeLifter> m_lifter;
+    std::shared_ptr<const uint8_t>       m_file_map;
+    size_t                               m_file_size;
 
+    void map_file();
+    bool is_mappable(asection* bfd_sec) const;
     void load_sections();
 
     void process_symtable(asymbol* symtab[], size_t number_of_symbols);
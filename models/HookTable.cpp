@@ -0,0 +1,86 @@
+#include "HookTable.hpp"
+
+namespace naaz::models
+{
+
+static inline size_t slot_index(uint64_t addr, size_t mask)
+{
+    // fibonacci hashing, the addresses of the hooks are often close
+    return (size_t)((addr * 0x9e3779b97f4a7c15UL) >> 32) & mask;
+}
+
+HookTable::HookTable() : m_size(0) { m_slots.resize(64); }
+
+void HookTable::grow()
+{
+    std::vector<Slot> old_slots(m_slots.size() * 2);
+    std::swap(old_slots, m_slots);
+
+    size_t mask = m_slots.size() - 1;
+    for (const auto& slot : old_slots) {
+        if (!slot.used)
+            continue;
+        size_t i = slot_index(slot.hook.addr, mask);
+        while (m_slots[i].used)
+            i = (i + 1) & mask;
+        m_slots[i] = slot;
+    }
+}
+
+HookTable::Slot& HookTable::get_or_create(uint64_t addr)
+{
+    // keep the load factor below 1/2
+    if ((m_size + 1) * 2 > m_slots.size())
+        grow();
+
+    size_t mask = m_slots.size() - 1;
+    size_t i    = slot_index(addr, mask);
+    while (m_slots[i].used) {
+        if (m_slots[i].hook.addr == addr)
+            return m_slots[i];
+        i = (i + 1) & mask;
+    }
+
+    // the slots are never freed, an address without model and flags is not
+    // returned by lookup()
+    m_slots[i] = {.used = true,
+                  .hook = {.addr = addr, .model = nullptr, .flags = 0}};
+    m_size++;
+    return m_slots[i];
+}
+
+const HookTable::Hook* HookTable::lookup(uint64_t addr) const
+{
+    if (m_size == 0)
+        return nullptr;
+
+    size_t mask = m_slots.size() - 1;
+    size_t i    = slot_index(addr, mask);
+    while (m_slots[i].used) {
+        const Hook& hook = m_slots[i].hook;
+        if (hook.addr == addr)
+            return hook.model == nullptr && hook.flags == 0 ? nullptr : &hook;
+        i = (i + 1) & mask;
+    }
+    return nullptr;
+}
+
+void HookTable::set_model(uint64_t addr, const Model* model)
+{
+    get_or_create(addr).hook.model = model;
+    m_owned_models.erase(addr);
+}
+
+void HookTable::set_model(uint64_t addr, std::shared_ptr<const Model> model)
+{
+    // the table keeps the model alive while it is hooked
+    set_model(addr, model.get());
+    m_owned_models.emplace(addr, model);
+}
+
+void HookTable::set_flags(uint64_t addr, uint8_t flags)
+{
+    get_or_create(addr).hook.flags |= flags;
+}
+
+} // namespace naaz::models
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "Model.hpp"
+
+namespace naaz::models
+{
+
+// model that calls a user-defined function
+class CallbackModel final : public Model
+{
+  public:
+    typedef std::function<void(state::StatePtr, executor::ExecutorResult&)>
+        Callback;
+
+  private:
+    Callback m_callback;
+
+  public:
+    CallbackModel(const std::string& name, Callback callback)
+        : Model(name, CallConv::CDECL), m_callback(callback)
+    {
+    }
+
+    virtual void exec(state::StatePtr           s,
+                      executor::ExecutorResult& o_successors) const
+    {
+        m_callback(s, o_successors);
+    }
+};
+
+// the addresses that need special handling: the linked functions and the
+// user hooks (a model executed in place of the code at the address) in the
+// table shared by a state and its successors, the targets of an exploration
+// (flags) in the table of the ExecutorManager. It is an open addressing hash
+// table, a single lookup tells if there is something to do at an address
+class HookTable
+{
+  public:
+    enum Flag : uint8_t { FIND = 1, AVOID = 2 };
+
+    struct Hook {
+        uint64_t     addr;
+        const Model* model;
+        uint8_t      flags;
+    };
+
+  private:
+    struct Slot {
+        bool used;
+        Hook hook;
+    };
+
+    std::vector<Slot> m_slots;
+    size_t            m_size;
+
+    // the models of the callbacks, released when they are unhooked
+    std::map<uint64_t, std::shared_ptr<const Model>> m_owned_models;
+
+    Slot& get_or_create(uint64_t addr);
+    void  grow();
+
+  public:
+    HookTable();
+
+    // nullptr if there is nothing to do at the address
+    const Hook* lookup(uint64_t addr) const;
+
+    // the model replaces (and releases, if owned) the previous one
+    void set_model(uint64_t addr, const Model* model);
+    void set_model(uint64_t addr, std::shared_ptr<const Model> model);
+    void set_flags(uint64_t addr, uint8_t flags);
+};
+
+} // namespace naaz::models
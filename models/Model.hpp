@@ -36,10 +36,6 @@ class Model
                       executor::ExecutorResult& o_successors) const = 0;
 };
 
-struct LinkedFunctions {
-    std::map<uint64_t, const Model*> links;
-};
-
 } // namespace models
 
 } // namespace naaz
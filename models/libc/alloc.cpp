@@ -42,8 +42,7 @@ void calloc::exec(state::StatePtr           s,
     auto size_ = resolve_size(s, size) * resolve_size(s, nmemb);
 
     auto ptr = s->allocate(size_);
-    for (uint64_t i = 0; i < size_; ++i)
-        s->write(ptr + i, expr::ExprBuilder::The().mk_const(0, 8));
+    s->zero_range(ptr, size_);
 
     s->arch().set_return_int_value(
         m_call_conv, *s,
@@ -60,9 +59,16 @@ void realloc::exec(state::StatePtr           s,
     auto size    = s->get_int_param(m_call_conv, 1);
     auto size_   = resolve_size(s, size);
 
-    auto ptr  = s->allocate(size_);
-    auto data = s->read_buf(old_ptr, size_);
-    s->write_buf(ptr, data);
+    auto ptr = s->allocate(size_);
+    if (old_ptr->kind() == expr::Expr::Kind::CONST) {
+        auto old_ptr_ = std::static_pointer_cast<const expr::ConstExpr>(old_ptr)
+                            ->val()
+                            .as_u64();
+        s->copy_range(ptr, old_ptr_, size_);
+    } else {
+        auto data = s->read_buf(old_ptr, size_);
+        s->write_buf(ptr, data);
+    }
 
     s->arch().set_return_int_value(
         m_call_conv, *s,
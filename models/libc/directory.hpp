@@ -32,6 +32,7 @@ GEN_MODEL_CLASS(calloc, CallConv::CDECL)
 GEN_MODEL_CLASS(realloc, CallConv::CDECL)
 GEN_MODEL_CLASS(free, CallConv::CDECL)
 GEN_MODEL_CLASS(memcpy, CallConv::CDECL)
+GEN_MODEL_CLASS(memset, CallConv::CDECL)
 GEN_MODEL_CLASS(memcmp, CallConv::CDECL)
 GEN_MODEL_CLASS(strcmp, CallConv::CDECL)
 GEN_MODEL_CLASS(strlen, CallConv::CDECL)
@@ -64,6 +65,7 @@ GEN_MODEL_CLASS(ptrace, CallConv::CDECL)
     l.register_model(libc::realloc::The().name(), &libc::realloc::The());      \
     l.register_model(libc::free::The().name(), &libc::free::The());            \
     l.register_model(libc::memcpy::The().name(), &libc::memcpy::The());        \
+    l.register_model(libc::memset::The().name(), &libc::memset::The());        \
     l.register_model(libc::memcmp::The().name(), &libc::memcmp::The());        \
     l.register_model(libc::strlen::The().name(), &libc::strlen::The());        \
     l.register_model(libc::strcmp::The().name(), &libc::strcmp::The());        \
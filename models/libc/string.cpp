@@ -37,7 +37,34 @@ void memcpy::exec(state::StatePtr           s,
     auto size_ =
         std::static_pointer_cast<const expr::ConstExpr>(size)->val().as_u64();
 
-    s->write_buf(dst_, s->read(src_, size_));
+    s->copy_range(dst_, src_, size_);
+    s->arch().handle_return(s, o_successors);
+}
+
+void memset::exec(state::StatePtr           s,
+                  executor::ExecutorResult& o_successors) const
+{
+    auto dst  = s->get_int_param(m_call_conv, 0);
+    auto c    = s->get_int_param(m_call_conv, 1);
+    auto size = s->get_int_param(m_call_conv, 2);
+
+    if (dst->kind() != expr::Expr::Kind::CONST) {
+        err("memset") << "dst is symbolic (FIXME)" << std::endl;
+        exit_fail();
+    }
+    if (size->kind() != expr::Expr::Kind::CONST) {
+        err("memset") << "size is symbolic (FIXME)" << std::endl;
+        exit_fail();
+    }
+
+    auto dst_ =
+        std::static_pointer_cast<const expr::ConstExpr>(dst)->val().as_u64();
+    auto size_ =
+        std::static_pointer_cast<const expr::ConstExpr>(size)->val().as_u64();
+
+    // the value is converted to unsigned char
+    s->fill(dst_, expr::ExprBuilder::The().mk_extract(c, 7, 0), size_);
+    s->arch().set_return_int_value(m_call_conv, *s, dst);
     s->arch().handle_return(s, o_successors);
 }
 
@@ -68,21 +95,23 @@ void memcmp::exec(state::StatePtr           s,
     auto size_ =
         std::static_pointer_cast<const expr::ConstExpr>(size)->val().as_u64();
 
-    auto expr = expr::ExprBuilder::The().mk_eq(s->read_buf(buf1_, size_),
-                                               s->read_buf(buf2_, size_));
-    // FIXME: this is wrong, the semantics of memcmp is slightly different
-    auto ret = expr::ExprBuilder::The().mk_ite(
-        expr, expr::ExprBuilder::The().mk_const(0, 8),
-        expr::ExprBuilder::The().mk_const(1, 8));
-    s->arch().set_return_int_value(m_call_conv, *s, ret);
+    std::vector<expr::BVExprPtr> bytes1(size_), bytes2(size_);
+    s->read_bytes(buf1_, bytes1);
+    s->read_bytes(buf2_, bytes2);
+    s->arch().set_return_int_value(
+        m_call_conv, *s, compare_bytes_expr(bytes1, bytes2, false, 32));
     s->arch().handle_return(s, o_successors);
 }
 
+static bool is_zero_byte(expr::BVExprPtr b)
+{
+    return b->kind() == expr::Expr::Kind::CONST &&
+           std::static_pointer_cast<const expr::ConstExpr>(b)->val().is_zero();
+}
+
 void strcmp::exec(state::StatePtr           s,
                   executor::ExecutorResult& o_successors) const
 {
-    // FIXME: the semantics of strcmp is different
-
     auto str1 = s->get_int_param(m_call_conv, 0);
     auto str2 = s->get_int_param(m_call_conv, 1);
 
@@ -101,46 +130,25 @@ void strcmp::exec(state::StatePtr           s,
     auto str2_ =
         std::static_pointer_cast<const expr::ConstExpr>(str2)->val().as_u64();
 
-    int               max_size = 256;
-    expr::BoolExprPtr res_expr = expr::ExprBuilder::The().mk_true();
+    // read up to the first position where the result is certainly decided
+    int                          max_size = 256;
+    std::vector<expr::BVExprPtr> bytes1, bytes2;
     while (max_size-- > 0) {
-        auto b1 = s->read(str1_, 1);
-        auto b2 = s->read(str2_, 1);
+        auto b1 = s->read(str1_++, 1);
+        auto b2 = s->read(str2_++, 1);
+        bytes1.push_back(b1);
+        bytes2.push_back(b2);
 
         auto c = expr::ExprBuilder::The().mk_eq(b1, b2);
-        if (c->kind() == expr::Expr::Kind::BOOL_CONST) {
-            auto c_ = std::static_pointer_cast<const expr::BoolConst>(c);
-            if (!c_->is_true()) {
-                s->arch().set_return_int_value(
-                    m_call_conv, *s, expr::ExprBuilder::The().mk_const(1, 8));
-                s->arch().handle_return(s, o_successors);
-                return;
-            }
-        }
-
-        res_expr = expr::ExprBuilder::The().mk_bool_and(res_expr, c);
-
-        if (b1->kind() == expr::Expr::Kind::CONST) {
-            auto b1_ = std::static_pointer_cast<const expr::ConstExpr>(b1);
-            if (b1_->val().as_u64() == 0)
-                break;
-        }
-
-        if (b2->kind() == expr::Expr::Kind::CONST) {
-            auto b2_ = std::static_pointer_cast<const expr::ConstExpr>(b2);
-            if (b2_->val().as_u64() == 0)
-                break;
-        }
-
-        str1_++;
-        str2_++;
+        if (c->kind() == expr::Expr::Kind::BOOL_CONST &&
+            !std::static_pointer_cast<const expr::BoolConst>(c)->is_true())
+            break;
+        if (is_zero_byte(b1) || is_zero_byte(b2))
+            break;
     }
 
     s->arch().set_return_int_value(
-        m_call_conv, *s,
-        expr::ExprBuilder::The().mk_ite(
-            res_expr, expr::ExprBuilder::The().mk_const(0, 8),
-            expr::ExprBuilder::The().mk_const(1, 8)));
+        m_call_conv, *s, compare_bytes_expr(bytes1, bytes2, true, 32));
     s->arch().handle_return(s, o_successors);
 }
 
@@ -154,9 +162,19 @@ void strlen::exec(state::StatePtr           s,
         exit_fail();
     }
 
-    int  max_forks = 32;
     auto str_addr =
         std::static_pointer_cast<const expr::ConstExpr>(str)->val().as_u64();
+    if (!g_config.fork_string_models) {
+        // too many symbolic bytes for a single expression, fork instead
+        auto len = strlen_expr(s, str_addr, s->arch().ptr_size());
+        if (len != nullptr) {
+            s->arch().set_return_int_value(m_call_conv, *s, len);
+            s->arch().handle_return(s, o_successors);
+            return;
+        }
+    }
+
+    int  max_forks        = 32;
     auto resolved_strings = resolve_string(s, str_addr, max_forks);
 
     for (const auto& e : resolved_strings) {
@@ -59,4 +59,55 @@ std::vector<resolved_string_t> resolve_string(state::StatePtr state,
     return res;
 }
 
+expr::BVExprPtr strlen_expr(state::StatePtr state, uint64_t str_addr,
+                            size_t ret_size, int max_symbolic)
+{
+    // read up to the first concrete terminator
+    std::vector<expr::BVExprPtr> bytes;
+    int                          num_symbolic = 0;
+    for (uint64_t i = 0;; ++i) {
+        auto b = state->read(str_addr + i, 1);
+        if (b->kind() == expr::Expr::Kind::CONST) {
+            if (std::static_pointer_cast<const expr::ConstExpr>(b)
+                    ->val()
+                    .is_zero())
+                break;
+        } else if (++num_symbolic > max_symbolic) {
+            return nullptr;
+        }
+        bytes.push_back(b);
+    }
+
+    // the concrete bytes that are not zero do not add a case
+    expr::BVExprPtr zero_byte = expr::ExprBuilder::The().mk_const(0UL, 8);
+    expr::BVExprPtr res =
+        expr::ExprBuilder::The().mk_const(bytes.size(), ret_size);
+    for (size_t i = bytes.size(); i-- > 0;)
+        res = expr::ExprBuilder::The().mk_ite(
+            expr::ExprBuilder::The().mk_eq(bytes.at(i), zero_byte),
+            expr::ExprBuilder::The().mk_const(i, ret_size), res);
+    return res;
+}
+
+expr::BVExprPtr compare_bytes_expr(const std::vector<expr::BVExprPtr>& b1,
+                                   const std::vector<expr::BVExprPtr>& b2,
+                                   bool stop_at_zero, size_t ret_size)
+{
+    expr::BVExprPtr zero_byte = expr::ExprBuilder::The().mk_const(0UL, 8);
+    expr::BVExprPtr res       = expr::ExprBuilder::The().mk_const(0, ret_size);
+    for (size_t i = std::min(b1.size(), b2.size()); i-- > 0;) {
+        if (stop_at_zero)
+            res = expr::ExprBuilder::The().mk_ite(
+                expr::ExprBuilder::The().mk_eq(b1.at(i), zero_byte),
+                expr::ExprBuilder::The().mk_const(0, ret_size), res);
+
+        auto diff = expr::ExprBuilder::The().mk_sub(
+            expr::ExprBuilder::The().mk_zext(b1.at(i), ret_size),
+            expr::ExprBuilder::The().mk_zext(b2.at(i), ret_size));
+        res = expr::ExprBuilder::The().mk_ite(
+            expr::ExprBuilder::The().mk_neq(b1.at(i), b2.at(i)), diff, res);
+    }
+    return res;
+}
+
 } // namespace naaz::models::libc
@@ -20,4 +20,18 @@ std::vector<resolved_string_t> resolve_string(state::StatePtr state,
                                               int             max_forks = 32,
                                               int             max_size  = -1);
 
+// the length of the string as an ite on the position of the terminator,
+// without forking. The string ends at the first concrete terminator, only its
+// symbolic bytes are bounded: nullptr if there are more than max_symbolic
+// (e.g., fall back to resolve_string)
+expr::BVExprPtr strlen_expr(state::StatePtr state, uint64_t str_addr,
+                            size_t ret_size, int max_symbolic = 256);
+
+// lexicographic comparison of two sequences of bytes (as unsigned char). The
+// result is the difference of the first pair of different bytes, or zero. If
+// stop_at_zero, the comparison ends at the first terminator (strcmp)
+expr::BVExprPtr compare_bytes_expr(const std::vector<expr::BVExprPtr>& b1,
+                                   const std::vector<expr::BVExprPtr>& b2,
+                                   bool stop_at_zero, size_t ret_size);
+
 } // namespace naaz::models::libc
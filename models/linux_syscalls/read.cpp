@@ -32,11 +32,10 @@ void read::exec(state::StatePtr s, executor::ExecutorResult& o_successors) const
     size_t size_ =
         std::static_pointer_cast<const expr::ConstExpr>(size)->val().as_u64();
 
-    auto data = s->fs().read(fd_, size_);
+    std::vector<expr::BVExprPtr> data(size_);
+    s->fs().read_bytes(fd_, data);
     if (fd_ == 0 && g_config.printable_stdin) {
-        for (size_t i = 0; i < size_; ++i) {
-            auto b =
-                expr::ExprBuilder::The().mk_extract(data, i * 8 + 7, i * 8);
+        for (const auto& b : data) {
             auto l = expr::ExprBuilder::The().mk_const(0x20ul, 8);
             auto h = expr::ExprBuilder::The().mk_const(0x7eul, 8);
             s->solver().add(expr::ExprBuilder::The().mk_uge(b, l));
@@ -44,7 +43,7 @@ void read::exec(state::StatePtr s, executor::ExecutorResult& o_successors) const
         }
     }
 
-    s->write_buf(buf_, data);
+    s->write_bytes(buf_, data);
     s->arch().set_syscall_return_value(
         *s, expr::ExprBuilder::The().mk_const(size_, s->arch().ptr_size()));
 }
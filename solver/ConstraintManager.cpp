@@ -1,18 +1,25 @@
 #include "ConstraintManager.hpp"
 
 #include "../expr/ExprBuilder.hpp"
+#include "../expr/util.hpp"
 
 #define exprBuilder naaz::expr::ExprBuilder::The()
 
+#define PI_MAX_DEPTH 64
+
 namespace naaz::solver
 {
 
 std::map<expr::ExprPtr, std::set<uint32_t>>
     ConstraintManager::g_involved_symbols;
 
+std::recursive_mutex ConstraintManager::g_involved_symbols_mutex;
+
 const std::set<uint32_t>&
 ConstraintManager::get_involved_inputs(expr::ExprPtr constraint)
 {
+    // the returned reference stays valid, std::map never moves its nodes
+    std::lock_guard<std::recursive_mutex> lock(g_involved_symbols_mutex);
     if (g_involved_symbols.contains(constraint)) {
         return g_involved_symbols.at(constraint);
     }
@@ -32,9 +39,45 @@ ConstraintManager::get_involved_inputs(expr::ExprPtr constraint)
     return g_involved_symbols[constraint];
 }
 
+void ConstraintManager::collect_garbage()
+{
+    // the cache keeps its keys alive. An entry referenced only by the cache
+    // is dropped, then the entries of its children, if they were referenced
+    // only by the dropped expression
+    std::lock_guard<std::recursive_mutex> lock(g_involved_symbols_mutex);
+
+    std::vector<expr::ExprPtr> worklist;
+    auto                       it = g_involved_symbols.begin();
+    while (it != g_involved_symbols.end()) {
+        if (it->first.use_count() > 1) {
+            ++it;
+            continue;
+        }
+        worklist = it->first->children();
+        it       = g_involved_symbols.erase(it);
+
+        while (!worklist.empty()) {
+            expr::ExprPtr e = std::move(worklist.back());
+            worklist.pop_back();
+
+            // referenced by the cache and by e
+            auto entry = g_involved_symbols.find(e);
+            if (entry == g_involved_symbols.end() || e.use_count() > 2)
+                continue;
+            for (auto& child : e->children())
+                worklist.push_back(child);
+            if (entry == it)
+                it = g_involved_symbols.erase(entry);
+            else
+                g_involved_symbols.erase(entry);
+        }
+    }
+}
+
 ConstraintManager::ConstraintManager(const ConstraintManager& other)
     : m_constraint_map(other.m_constraint_map),
-      m_constraints(other.m_constraints), m_dependencies(other.m_dependencies)
+      m_constraints(other.m_constraints), m_dependencies(other.m_dependencies),
+      m_pi(other.m_pi), m_pi_depth(other.m_pi_depth)
 {
 }
 
@@ -48,7 +91,50 @@ void ConstraintManager::add(expr::BoolExprPtr constraint)
             m_dependencies[sym].insert(sym_again);
     }
 
-    m_constraints.insert(constraint);
+    if (!m_constraints.insert(constraint).second || !m_pi)
+        return;
+
+    // extend the cached conjunction with the new constraint, without
+    // flattening it: the previous conjunction is shared with the copies of
+    // this manager. A chain that is too deep is rebuilt flat by pi()
+    if (expr::is_true_const(m_pi)) {
+        m_pi       = constraint;
+        m_pi_depth = 0;
+    } else if (m_pi_depth >= PI_MAX_DEPTH) {
+        m_pi.reset();
+    } else {
+        m_pi = exprBuilder.mk_bool_and_no_simpl({m_pi, constraint});
+        m_pi_depth++;
+    }
+}
+
+void ConstraintManager::substitute(
+    const std::map<uint32_t, expr::BVConst>& values)
+{
+    std::set<expr::BoolExprPtr> affected;
+    for (const auto& [sym, _] : values) {
+        if (!m_constraint_map.contains(sym))
+            continue;
+        for (expr::BoolExprPtr c : m_constraint_map.at(sym))
+            affected.insert(c);
+    }
+    if (affected.empty())
+        return;
+
+    // the dependency graph cannot be updated in place, rebuild everything
+    std::set<expr::BoolExprPtr> constraints;
+    constraints.swap(m_constraints);
+    m_constraint_map.clear();
+    m_dependencies.clear();
+    m_pi.reset();
+
+    for (expr::BoolExprPtr c : constraints) {
+        if (affected.contains(c))
+            c = std::static_pointer_cast<const expr::BoolExpr>(
+                expr::evaluate(c, values, false));
+        if (!expr::is_true_const(c))
+            add(c);
+    }
 }
 
 std::set<uint32_t>
@@ -80,12 +166,22 @@ ConstraintManager::get_dependencies(expr::ExprPtr constraint) const
     return res;
 }
 
-expr::BoolExprPtr ConstraintManager::pi(expr::ExprPtr expr) const
+std::set<uint32_t> ConstraintManager::get_dependencies(
+    const std::vector<expr::ExprPtr>& exprs) const
 {
-    std::set<uint32_t> involved_inputs = get_dependencies(expr);
+    std::set<uint32_t> res;
+    for (auto e : exprs) {
+        std::set<uint32_t> deps = get_dependencies(e);
+        res.insert(deps.begin(), deps.end());
+    }
+    return res;
+}
 
+expr::BoolExprPtr
+ConstraintManager::pi_of_symbols(const std::set<uint32_t>& symbols) const
+{
     std::set<expr::BoolExprPtr> constraints;
-    for (auto& sym : involved_inputs) {
+    for (auto& sym : symbols) {
         if (!m_constraint_map.contains(sym))
             continue;
         for (expr::BoolExprPtr c : m_constraint_map.at(sym))
@@ -97,19 +193,23 @@ expr::BoolExprPtr ConstraintManager::pi(expr::ExprPtr expr) const
     return exprBuilder.mk_bool_and_no_simpl(constraints);
 }
 
-expr::BoolExprPtr ConstraintManager::pi() const
+expr::BoolExprPtr ConstraintManager::pi(expr::ExprPtr expr) const
 {
-    if (m_constraints.size() == 0)
-        return exprBuilder.mk_true();
-
-    auto              it = m_constraints.begin();
-    expr::BoolExprPtr e  = *it;
-    it++;
-
-    for (; it != m_constraints.end(); it++)
-        e = exprBuilder.mk_bool_and(e, *it);
+    return pi_of_symbols(get_dependencies(expr));
+}
 
-    return e;
+expr::BoolExprPtr ConstraintManager::pi() const
+{
+    if (m_pi)
+        return m_pi;
+
+    // m_constraints is already sorted and without duplicates, build the
+    // conjunction with a single n-ary call
+    std::vector<expr::BoolExprPtr> constraints(m_constraints.begin(),
+                                               m_constraints.end());
+    m_pi       = exprBuilder.mk_bool_and(constraints);
+    m_pi_depth = 0;
+    return m_pi;
 }
 
 } // namespace naaz::solver
@@ -2,17 +2,22 @@
 
 #include <memory>
 #include <map>
+#include <mutex>
 #include <set>
+#include <vector>
 
 #include "../expr/Expr.hpp"
+#include "../expr/BVConst.hpp"
 
 namespace naaz::solver
 {
 
 class ConstraintManager
 {
-    // involved symbols cache. Shared among all constraint managers!
+    // involved symbols cache. Shared among all constraint managers (and
+    // threads, it is guarded by g_involved_symbols_mutex)!
     static std::map<expr::ExprPtr, std::set<uint32_t>> g_involved_symbols;
+    static std::recursive_mutex g_involved_symbols_mutex;
 
     static const std::set<uint32_t>&
     get_involved_inputs(expr::ExprPtr constraint);
@@ -24,16 +29,43 @@ class ConstraintManager
     // symbol depencency graph
     std::map<uint32_t, std::set<uint32_t>> m_dependencies;
 
+    // conjunction of all the constraints, built lazily by pi() and shared
+    // with the copies of this manager. add() extends it with a binary
+    // conjunction, its conjuncts can be nested conjunctions. After
+    // PI_MAX_DEPTH extensions it is rebuilt flat, the visits of pi() (e.g.,
+    // evaluate) recurse on the nesting
+    mutable expr::BoolExprPtr m_pi;
+    mutable uint32_t          m_pi_depth = 0;
+
   public:
     ConstraintManager() {}
     ConstraintManager(const ConstraintManager& other);
+    ConstraintManager(ConstraintManager&& other)                 = default;
+    ConstraintManager& operator=(const ConstraintManager& other) = default;
+    ConstraintManager& operator=(ConstraintManager&& other)      = default;
     ~ConstraintManager() {}
 
+    // drop the cached involved symbols of the expressions that are not used
+    // anymore (e.g., at the end of a naaz_server job)
+    static void collect_garbage();
+
     std::set<uint32_t> get_dependencies(expr::ExprPtr constraint) const;
+    std::set<uint32_t>
+    get_dependencies(const std::vector<expr::ExprPtr>& exprs) const;
+
+    const std::set<expr::BoolExprPtr>& constraints() const
+    {
+        return m_constraints;
+    }
 
     void              add(expr::BoolExprPtr constraint);
     expr::BoolExprPtr pi(expr::ExprPtr expr) const;
     expr::BoolExprPtr pi() const;
+    // the constraints on the given symbols (e.g., from get_dependencies)
+    expr::BoolExprPtr pi_of_symbols(const std::set<uint32_t>& symbols) const;
+
+    // replace the symbols with the given values in all the constraints
+    void substitute(const std::map<uint32_t, expr::BVConst>& values);
 };
 
 } // namespace naaz::solver
@@ -0,0 +1,154 @@
+#include <cstring>
+#include <sstream>
+#include <unistd.h>
+
+#include "QueryLog.hpp"
+
+#include "../util/ioutil.hpp"
+#include "../util/strutil.hpp"
+
+#define RECORD_BEGIN "; naaz-query "
+#define RECORD_END   "; naaz-query-end"
+
+namespace naaz::solver
+{
+
+static const char* g_origin_names[] = {"other",     "cbranch",   "sym_read",
+                                       "sym_write", "eval_upto", "bounds",
+                                       "dump"};
+
+const char* origin_name(QueryOrigin origin)
+{
+    return g_origin_names[(int)origin];
+}
+
+std::optional<QueryOrigin> parse_origin(const std::string& name)
+{
+    for (size_t i = 0; i < sizeof(g_origin_names) / sizeof(char*); ++i) {
+        if (name == g_origin_names[i])
+            return (QueryOrigin)i;
+    }
+    return {};
+}
+
+static thread_local QueryOrigin g_origin = QueryOrigin::OTHER;
+
+QueryOriginScope::QueryOriginScope(QueryOrigin origin)
+    : m_set(g_origin == QueryOrigin::OTHER)
+{
+    if (m_set)
+        g_origin = origin;
+}
+
+QueryOriginScope::~QueryOriginScope()
+{
+    if (m_set)
+        g_origin = QueryOrigin::OTHER;
+}
+
+QueryOrigin QueryOriginScope::current() { return g_origin; }
+
+QueryLog::~QueryLog()
+{
+    if (m_file != nullptr && m_pid == getpid())
+        gzclose(m_file);
+}
+
+void QueryLog::open(const std::filesystem::path& dir)
+{
+    std::error_code ec;
+    std::filesystem::create_directories(dir, ec);
+    if (!std::filesystem::is_directory(dir)) {
+        err("QueryLog") << "unable to create " << dir << std::endl;
+        exit_fail();
+    }
+    m_dir     = dir;
+    m_enabled = true;
+}
+
+void QueryLog::close()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_file != nullptr && m_pid == getpid())
+        gzclose(m_file);
+    m_file    = nullptr;
+    m_enabled = false;
+}
+
+void QueryLog::append(const Record& record)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (m_file == nullptr || m_pid != getpid()) {
+        // the file of the parent process (if any) is left to the parent
+        m_pid = getpid();
+
+        auto path = m_dir / string_format("queries.%d.smt2.gz", (int)m_pid);
+        m_file    = gzopen(path.c_str(), "ab");
+        if (m_file == nullptr) {
+            err("QueryLog") << "unable to open " << path << std::endl;
+            exit_fail();
+        }
+    }
+
+    std::string header = string_format(
+        RECORD_BEGIN "origin=%s result=%s wall_us=%lu\n",
+        origin_name(record.origin), record.result.c_str(),
+        (unsigned long)record.wall_us);
+    gzputs(m_file, header.c_str());
+    gzwrite(m_file, record.smt2.data(), record.smt2.size());
+    if (record.smt2.empty() || record.smt2.back() != '\n')
+        gzputs(m_file, "\n");
+    gzputs(m_file, RECORD_END "\n");
+    gzflush(m_file, Z_SYNC_FLUSH);
+}
+
+std::vector<QueryLog::Record> QueryLog::read(const std::filesystem::path& path)
+{
+    gzFile f = gzopen(path.c_str(), "rb");
+    if (f == nullptr) {
+        err("QueryLog") << "unable to open " << path << std::endl;
+        exit_fail();
+    }
+
+    // the tail of a log that was not closed is truncated, keep what was read
+    std::string data;
+    char        buf[1 << 16];
+    int         n;
+    while ((n = gzread(f, buf, sizeof(buf))) > 0)
+        data.append(buf, n);
+    gzclose(f);
+
+    std::vector<Record>   res;
+    std::istringstream    in(data);
+    std::string           line;
+    std::optional<Record> cur;
+    while (std::getline(in, line)) {
+        if (line.starts_with(RECORD_BEGIN)) {
+            Record r{QueryOrigin::OTHER, "", 0, ""};
+            for (const auto& field :
+                 split_at(line.substr(strlen(RECORD_BEGIN)), ' ')) {
+                size_t eq = field.find('=');
+                if (eq == std::string::npos)
+                    continue;
+                std::string key = field.substr(0, eq);
+                std::string val = field.substr(eq + 1);
+                if (key == "origin")
+                    r.origin = parse_origin(val).value_or(QueryOrigin::OTHER);
+                else if (key == "result")
+                    r.result = val;
+                else if (key == "wall_us")
+                    r.wall_us = std::stoull(val);
+            }
+            cur = r;
+        } else if (line == RECORD_END) {
+            if (cur.has_value())
+                res.push_back(std::move(*cur));
+            cur.reset();
+        } else if (cur.has_value())
+            cur->smt2 += line + "\n";
+    }
+    return res;
+}
+
+} // namespace naaz::solver
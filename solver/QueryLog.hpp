@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+#include <zlib.h>
+
+namespace naaz::solver
+{
+
+// the operation that sent a query to the solver (see QueryOriginScope)
+enum class QueryOrigin {
+    OTHER,
+    CBRANCH,
+    SYM_READ,
+    SYM_WRITE,
+    EVAL_UPTO,
+    BOUNDS,
+    DUMP,
+};
+
+const char*                origin_name(QueryOrigin origin);
+std::optional<QueryOrigin> parse_origin(const std::string& name);
+
+// The queries of the thread have the given origin while the object is alive,
+// unless an enclosing scope already set one (e.g., the eval_upto of a
+// symbolic read is a SYM_READ)
+class QueryOriginScope
+{
+    bool m_set;
+
+  public:
+    QueryOriginScope(QueryOrigin origin);
+    ~QueryOriginScope();
+
+    static QueryOrigin current();
+};
+
+// Append-only log of the queries sent to Z3 (see Z3Solver::solve), enabled by
+// open(). Every process writes the file queries.<pid>.smt2.gz in the log
+// directory, a sequence of records:
+//
+//   ; naaz-query origin=<origin> result=<sat|unsat|unknown> wall_us=<time>
+//   <the assertions, in SMT-LIB2>
+//   ; naaz-query-end
+//
+// The stream is flushed after every record, so the log of a process that did
+// not exit cleanly (e.g., a worker of explore_distributed) is still readable
+class QueryLog
+{
+  public:
+    struct Record {
+        QueryOrigin origin;
+        std::string result;
+        uint64_t    wall_us;
+        std::string smt2;
+    };
+
+  private:
+    std::mutex            m_mutex;
+    std::filesystem::path m_dir;
+    bool                  m_enabled;
+    gzFile                m_file;
+    // the process that opened m_file, a forked process opens its own
+    pid_t                 m_pid;
+
+    QueryLog() : m_enabled(false), m_file(nullptr), m_pid(0) {}
+
+  public:
+    ~QueryLog();
+
+    static QueryLog& The()
+    {
+        static QueryLog log;
+        return log;
+    }
+
+    // log the queries in dir (created if needed). Call it before starting
+    // the threads that query the solver
+    void open(const std::filesystem::path& dir);
+    // stop logging and close the file of the process. Call it when no thread
+    // queries the solver
+    void close();
+    bool enabled() const { return m_enabled; }
+    void append(const Record& record);
+
+    // the records of a log file
+    static std::vector<Record> read(const std::filesystem::path& path);
+};
+
+} // namespace naaz::solver
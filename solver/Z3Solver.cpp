@@ -2,7 +2,9 @@
 #include "../expr/util.hpp"
 #include "../util/ioutil.hpp"
 #include "../util/config.hpp"
+#include "../util/stats.hpp"
 
+#include "QueryLog.hpp"
 #include "Z3Solver.hpp"
 
 #define exprBuilder naaz::expr::ExprBuilder::The()
@@ -10,27 +12,58 @@
 namespace naaz::solver
 {
 
-Z3Solver::Z3Solver() : m_solver(m_ctx)
+Z3Solver::Z3Solver() : m_solver(m_ctx), m_arrays_prune(1024)
 {
     z3::params p(m_ctx);
     p.set(":timeout", g_config.z3_timeout);
     m_solver.set(p);
 }
 
+z3::check_result Z3Solver::solve()
+{
+    STATS_TIMER(SOLVER_CHECK);
+    auto             start = std::chrono::steady_clock::now();
+    z3::check_result r     = m_solver.check();
+    if (r == z3::unknown)
+        STATS_COUNT(SOLVER_UNKNOWN);
+
+    if (QueryLog::The().enabled()) {
+        auto     wall    = std::chrono::steady_clock::now() - start;
+        uint64_t wall_us =
+            std::chrono::duration_cast<std::chrono::microseconds>(wall).count();
+        const char* result =
+            r == z3::sat ? "sat" : (r == z3::unsat ? "unsat" : "unknown");
+        QueryLog::The().append(
+            {QueryOriginScope::current(), result, wall_us, m_solver.to_smt2()});
+    }
+    return r;
+}
+
 CheckResult Z3Solver::check(expr::BoolExprPtr query)
 {
     m_solver.reset();
-    if (query->kind() == expr::Expr::Kind::BOOL_AND) {
-        auto query_ = std::static_pointer_cast<const expr::BoolAndExpr>(query);
-        for (auto c : query_->exprs())
-            m_solver.add(to_z3(c).simplify());
-    } else
-        m_solver.add(to_z3(query).simplify());
+    m_base_reads.clear();
 
-    // std::cout << "query: " << query->to_string() << std::endl;
+    // every conjunct is a separate assertion. The path condition can be a
+    // chain of nested conjunctions (see ConstraintManager::add), walk it
+    // without recursion
+    std::vector<expr::BoolExprPtr> queue = {query};
+    std::set<expr::BoolExprPtr>    visited;
+    while (!queue.empty()) {
+        expr::BoolExprPtr c = queue.back();
+        queue.pop_back();
+        if (!visited.insert(c).second)
+            continue;
+        if (c->kind() != expr::Expr::Kind::BOOL_AND) {
+            m_solver.add(to_z3(c).simplify());
+            continue;
+        }
+        auto c_ = std::static_pointer_cast<const expr::BoolAndExpr>(c);
+        queue.insert(queue.end(), c_->exprs().begin(), c_->exprs().end());
+    }
 
     CheckResult res = CheckResult::UNKNOWN;
-    switch (m_solver.check()) {
+    switch (solve()) {
         case z3::unsat:
             res = CheckResult::UNSAT;
             break;
@@ -49,13 +82,14 @@ std::vector<expr::BVConst> Z3Solver::eval_upto(expr::BVExprPtr   val,
 {
     std::vector<expr::BVConst> res;
 
+    m_base_reads.clear();
     auto val_z3 = to_z3(val);
     auto pi_z3  = to_z3(pi);
 
     m_solver.reset();
     m_solver.add(pi_z3);
     while (n-- > 0) {
-        auto r = m_solver.check();
+        auto r = solve();
         if (r != z3::sat)
             break;
 
@@ -69,14 +103,98 @@ std::vector<expr::BVConst> Z3Solver::eval_upto(expr::BVExprPtr   val,
     return res;
 }
 
+std::optional<std::pair<uint64_t, uint64_t>>
+Z3Solver::bounds(expr::BVExprPtr val, expr::BoolExprPtr pi, uint64_t max_span)
+{
+    if (val->size() > 64) {
+        err("Z3Solver") << "bounds(): the expression is too big" << std::endl;
+        exit_fail();
+    }
+
+    m_base_reads.clear();
+    auto val_z3 = to_z3(val);
+    auto pi_z3  = to_z3(pi);
+
+    m_solver.reset();
+    m_solver.add(pi_z3);
+    if (solve() != z3::sat)
+        return {};
+
+    auto model_val = [&]() {
+        auto m = model();
+        return std::static_pointer_cast<const expr::ConstExpr>(
+                   expr::evaluate(val, m, true))
+            ->val()
+            .as_u64();
+    };
+    uint64_t v        = model_val();
+    uint64_t max_uint = val->size() == 64 ? UINT64_MAX
+                                          : ((1UL << val->size()) - 1UL);
+
+    // if the range fits in max_span, it is within max_span of v. A single
+    // query rules out the wider ranges (e.g., unconstrained pointers), the
+    // bounds are searched only in the window around v
+    uint64_t window_lo = v > max_span ? v - max_span : 0;
+    uint64_t window_hi = max_uint - v > max_span ? v + max_span : max_uint;
+    if (window_lo > 0 || window_hi < max_uint) {
+        m_solver.push();
+        m_solver.add(z3::ult(val_z3, m_ctx.bv_val(window_lo, val->size())) ||
+                     z3::ugt(val_z3, m_ctx.bv_val(window_hi, val->size())));
+        auto r = solve();
+        m_solver.pop();
+        if (r != z3::unsat)
+            return {};
+    }
+
+    // binary search, each model moves the bound beyond the middle point. The
+    // interval [min_lo, min_hi] always contains the minimum
+    uint64_t min_lo = window_lo, min_hi = v;
+    while (min_lo < min_hi) {
+        uint64_t mid = min_lo + (min_hi - min_lo) / 2;
+        m_solver.push();
+        m_solver.add(z3::ule(val_z3, m_ctx.bv_val(mid, val->size())));
+        auto r = solve();
+        if (r == z3::sat)
+            min_hi = model_val();
+        else if (r == z3::unsat)
+            min_lo = mid + 1;
+        m_solver.pop();
+        if (r == z3::unknown)
+            break;
+    }
+
+    uint64_t max_lo = v, max_hi = window_hi;
+    while (max_lo < max_hi) {
+        uint64_t mid = max_hi - (max_hi - max_lo) / 2;
+        m_solver.push();
+        m_solver.add(z3::uge(val_z3, m_ctx.bv_val(mid, val->size())));
+        auto r = solve();
+        if (r == z3::sat)
+            max_lo = model_val();
+        else if (r == z3::unsat)
+            max_hi = mid - 1;
+        m_solver.pop();
+        if (r == z3::unknown)
+            break;
+    }
+
+    // on timeouts, the safe side of the intervals
+    if (max_hi - min_lo > max_span)
+        return {};
+    return std::pair{min_lo, max_hi};
+}
+
 std::map<uint32_t, expr::BVConst> Z3Solver::model()
 {
     std::map<uint32_t, expr::BVConst> res;
 
     z3::model model = m_solver.get_model();
-    for (uint32_t i = 0; i < model.size(); i++) {
-        z3::func_decl v = model[i];
-        assert(v.arity() == 0);
+    for (uint32_t i = 0; i < model.num_consts(); i++) {
+        // the model of array reads can contain auxiliary functions, only the
+        // bitvector constants are symbols
+        z3::func_decl v = model.get_const_decl(i);
+        if (!v.range().is_bv())
+            continue;
 
         z3::expr val = model.get_const_interp(v);
 
@@ -84,6 +202,19 @@ std::map<uint32_t, expr::BVConst> Z3Solver::model()
                          (ssize_t)val.get_sort().bv_size());
         res.emplace(exprBuilder.get_sym_id(v.name().str()), bv);
     }
+
+    // the symbolic bases of the arrays at the indexes read by the query. The
+    // symbol of a base is assigned as well, its value is never used
+    for (const auto& r : m_base_reads) {
+        res.emplace(r.base->id(), expr::BVConst(0UL, r.base->size()));
+        z3::expr index = model.eval(r.index, true);
+        z3::expr val   = model.eval(z3::select(r.array, index), true);
+        auto     sym   = expr::array_base_value(r.base,
+                                                index.get_numeral_uint64());
+        res.insert_or_assign(sym->id(),
+                             expr::BVConst(val.get_decimal_string(1),
+                                           (ssize_t)val.get_sort().bv_size()));
+    }
     return res;
 }
 
@@ -106,11 +237,62 @@ static z3::sort get_fp_sort(z3::context& ctx, FloatFormatPtr ff)
     return ctx.fpa_sort(exp_size, fract_size);
 }
 
+// the expressions translated by a call of to_z3, and the arrays translated
+// by the solver
+struct ToZ3Cache {
+    std::map<expr::ExprPtr, z3::expr>                          exprs;
+    std::unordered_map<const expr::ArrayUpdate*, Z3ArrayTerm>& arrays;
+    std::vector<Z3BaseRead>&                                   base_reads;
+};
+
+static z3::expr to_z3_inner(z3::context& ctx, expr::ExprPtr e,
+                            ToZ3Cache& cache);
+
+// the symbolic base of an array (see ExprBuilder::mk_array_base)
+static z3::expr base_to_z3(z3::context& ctx, expr::SymExprPtr base,
+                           size_t index_size)
+{
+    return ctx.constant(base->name().c_str(),
+                        ctx.array_sort(ctx.bv_sort(index_size),
+                                       ctx.bv_sort(base->size())));
+}
+
+static z3::expr array_to_z3(z3::context& ctx, expr::ArrayUpdatePtr updates,
+                            ToZ3Cache& cache)
+{
+    // the nodes newer than the most recent one already translated are
+    // stored on its array
+    std::vector<expr::ArrayUpdatePtr> pending;
+    std::optional<z3::expr>           arr;
+    for (auto u = updates; u != nullptr; u = u->next()) {
+        auto it = cache.arrays.find(u.get());
+        if (it != cache.arrays.end() && !it->second.node.expired()) {
+            arr = it->second.array;
+            break;
+        }
+        pending.push_back(u);
+    }
+
+    // not written indexes are zero, or the bytes of the symbolic base
+    if (!arr.has_value() && !updates->base())
+        arr = z3::const_array(ctx.bv_sort(updates->index()->size()),
+                              ctx.bv_val(0, updates->value()->size()));
+    for (auto it = pending.rbegin(); it != pending.rend(); ++it) {
+        if ((*it)->is_base())
+            arr = base_to_z3(ctx, (*it)->base(), (*it)->index()->size());
+        else
+            arr = z3::store(*arr, to_z3_inner(ctx, (*it)->index(), cache),
+                            to_z3_inner(ctx, (*it)->value(), cache));
+        cache.arrays.insert_or_assign(it->get(), Z3ArrayTerm{*it, *arr});
+    }
+    return *arr;
+}
+
 static z3::expr to_z3_inner(z3::context& ctx, expr::ExprPtr e,
-                            std::map<expr::ExprPtr, z3::expr>& cache)
+                            ToZ3Cache& cache)
 {
-    if (cache.contains(e))
-        return cache.at(e);
+    if (cache.exprs.contains(e))
+        return cache.exprs.at(e);
 
     z3::expr res(ctx);
     switch (e->kind()) {
@@ -164,6 +346,15 @@ static z3::expr to_z3_inner(z3::context& ctx, expr::ExprPtr e,
                               to_z3_inner(ctx, e_->iffalse(), cache));
             break;
         }
+        case expr::Expr::Kind::ARRAY_READ: {
+            auto e_ = std::static_pointer_cast<const expr::ArrayReadExpr>(e);
+            z3::expr index = to_z3_inner(ctx, e_->index(), cache);
+            res = z3::select(array_to_z3(ctx, e_->updates(), cache), index);
+            if (auto base = e_->updates()->base())
+                cache.base_reads.push_back(
+                    {base, base_to_z3(ctx, base, e_->index()->size()), index});
+            break;
+        }
         case expr::Expr::Kind::SHL: {
             auto e_ = std::static_pointer_cast<const expr::ShlExpr>(e);
             res     = z3::shl(to_z3_inner(ctx, e_->expr(), cache),
@@ -402,15 +593,22 @@ static z3::expr to_z3_inner(z3::context& ctx, expr::ExprPtr e,
             exit_fail();
     }
 
-    cache.emplace(e, res);
+    cache.exprs.emplace(e, res);
     return res;
 }
 
 z3::expr Z3Solver::to_z3(expr::ExprPtr e)
 {
-    std::map<expr::ExprPtr, z3::expr> cache;
+    STATS_TIMER(TO_Z3);
+    ToZ3Cache cache{
+        .exprs = {}, .arrays = m_arrays, .base_reads = m_base_reads};
 
     auto res = to_z3_inner(m_ctx, e, cache);
+    if (m_arrays.size() > m_arrays_prune) {
+        std::erase_if(m_arrays,
+                      [](const auto& kv) { return kv.second.node.expired(); });
+        m_arrays_prune = std::max<size_t>(1024, m_arrays.size() * 2);
+    }
     return res;
 }
 
@@ -1,5 +1,9 @@
 #pragma once
 
+#include <memory>
+#include <optional>
+#include <unordered_map>
+
 #include "ConstraintManager.hpp"
 #include "z3++.h"
 
@@ -8,17 +12,44 @@ namespace naaz::solver
 
 enum CheckResult { SAT, UNSAT, UNKNOWN };
 
+// the z3 array of an update list node (see Z3Solver::to_z3). The weak pointer
+// tells if the node was freed, and its address possibly reused
+struct Z3ArrayTerm {
+    std::weak_ptr<const expr::ArrayUpdate> node;
+    z3::expr                               array;
+};
+
+// a read of an array with a symbolic base in the last query. The model holds
+// the value of the base at the index of the read (see expr::array_base_value)
+struct Z3BaseRead {
+    expr::SymExprPtr base;
+    z3::expr         array;
+    z3::expr         index;
+};
+
 class Z3Solver
 {
     z3::context m_ctx;
     z3::solver  m_solver;
 
+    // the update lists are shared by many reads (and states), every node is
+    // translated once. The entries of the freed nodes are dropped when the
+    // table doubles
+    std::unordered_map<const expr::ArrayUpdate*, Z3ArrayTerm> m_arrays;
+    size_t                                                    m_arrays_prune;
+    std::vector<Z3BaseRead>                                   m_base_reads;
+
     Z3Solver();
 
+    // m_solver.check(), every query of the solver goes through it. The
+    // queries are written in the QueryLog, if enabled
+    z3::check_result solve();
+
   public:
+    // every thread has its own context
     static Z3Solver& The()
     {
-        static Z3Solver solv;
+        thread_local Z3Solver solv;
         return solv;
     }
 
@@ -28,6 +59,14 @@ class Z3Solver
     std::vector<expr::BVConst> eval_upto(expr::BVExprPtr   val,
                                          expr::BoolExprPtr pi, int32_t n);
 
+    // unsigned minimum and maximum of val (at most 64 bits). Nothing if pi is
+    // not satisfiable, or if the values span more than max_span (found with
+    // a single query, the search is bounded by max_span). If the solver
+    // times out, the bounds are not tight
+    std::optional<std::pair<uint64_t, uint64_t>>
+    bounds(expr::BVExprPtr val, expr::BoolExprPtr pi,
+           uint64_t max_span = UINT64_MAX);
+
     std::map<uint32_t, expr::BVConst> model();
 };
 
@@ -30,6 +30,14 @@ expr::BVExprPtr File::read(uint64_t off, size_t size)
     return res;
 }
 
+void File::read_bytes(uint64_t off, std::span<expr::BVExprPtr> o_buf)
+{
+    m_content->read_bytes(off, o_buf);
+    off += o_buf.size();
+    if (off > m_size)
+        m_size = off;
+}
+
 expr::BVExprPtr File::read_all()
 {
     return m_content->read(0, m_size, Endianess::BIG);
@@ -50,6 +58,37 @@ std::unique_ptr<File> File::clone() const
 
 FileHandle File::gen_handle(int fd) { return FileHandle(m_filename, fd); }
 
+void File::serialize(expr::ExprWriter& w) const
+{
+    w.write_str(m_filename);
+    w.write_uint(m_size);
+    m_content->serialize(w);
+}
+
+std::shared_ptr<File> File::deserialize(expr::ExprReader& r)
+{
+    auto file    = std::make_shared<File>(r.read_str());
+    file->m_size = r.read_uint();
+    file->m_content->deserialize(r);
+    return file;
+}
+
+void FileHandle::serialize(expr::ExprWriter& w) const
+{
+    w.write_str(m_filename);
+    w.write_uint(m_descriptor);
+    w.write_uint(m_off);
+}
+
+FileHandle FileHandle::deserialize(expr::ExprReader& r)
+{
+    std::string filename = r.read_str();
+    int         fd       = r.read_uint();
+    FileHandle  h(filename, fd);
+    h.m_off = r.read_uint();
+    return h;
+}
+
 void FileHandle::seek(File& file, uint64_t off)
 {
     m_off = off;
@@ -63,6 +102,12 @@ expr::BVExprPtr FileHandle::read(File& file, size_t size)
     return res;
 }
 
+void FileHandle::read_bytes(File& file, std::span<expr::BVExprPtr> o_buf)
+{
+    file.read_bytes(m_off, o_buf);
+    m_off += o_buf.size();
+}
+
 void FileHandle::write(File& file, expr::BVExprPtr data)
 {
     file.write(m_off, data);
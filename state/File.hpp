@@ -21,6 +21,7 @@ class File
 
     void            enlarge(uint64_t off);
     expr::BVExprPtr read(uint64_t off, size_t size);
+    void            read_bytes(uint64_t off, std::span<expr::BVExprPtr> o_buf);
     expr::BVExprPtr read_all();
     void            write(uint64_t off, expr::BVExprPtr data);
 
@@ -29,6 +30,9 @@ class File
 
     FileHandle gen_handle(int fd);
 
+    void                         serialize(expr::ExprWriter& w) const;
+    static std::shared_ptr<File> deserialize(expr::ExprReader& r);
+
     std::unique_ptr<File> clone() const;
 };
 
@@ -46,12 +50,16 @@ class FileHandle
   public:
     void            seek(File& file, uint64_t off);
     expr::BVExprPtr read(File& file, size_t size);
+    void            read_bytes(File& file, std::span<expr::BVExprPtr> o_buf);
     void            write(File& file, expr::BVExprPtr data);
 
     int                fd() const { return m_descriptor; }
     uint64_t           off() const { return m_off; }
     const std::string& filename() const { return m_filename; }
 
+    void              serialize(expr::ExprWriter& w) const;
+    static FileHandle deserialize(expr::ExprReader& r);
+
     friend class File;
 };
 
@@ -7,7 +7,7 @@
 namespace naaz::state
 {
 
-FileSystem::FileSystem()
+FileSystem::FileSystem() : m_gen(new_generation())
 {
     m_free_fd = 0;
 
@@ -23,19 +23,32 @@ FileSystem::FileSystem()
 }
 
 FileSystem::FileSystem(const FileSystem& other)
-    : m_open_files(other.m_open_files), m_free_fd(other.m_free_fd)
+    : m_files(other.m_files), m_open_files(other.m_open_files),
+      m_free_fd(other.m_free_fd), m_gen(new_generation())
 {
-    for (const auto& pair : other.m_files)
-        m_files[pair.first] = pair.second->clone();
+    // the files are now shared, the original copies them as well
+    other.m_gen = new_generation();
+}
+
+File& FileSystem::get_file(const std::string& filename)
+{
+    // copy the file if it may be shared with another file system
+    FileEntry entry = m_files.at(filename);
+    if (entry.gen != m_gen) {
+        entry = {.file = entry.file->clone(), .gen = m_gen};
+        m_files.set(filename, entry);
+    }
+    return *entry.file;
 }
 
 int FileSystem::open(const std::string& filepath)
 {
     if (!m_files.contains(filepath))
-        m_files[filepath] = std::unique_ptr<File>(new File(filepath));
+        m_files.set(filepath, {.file = std::make_shared<File>(filepath),
+                               .gen  = m_gen});
 
-    FileHandle h = m_files[filepath]->gen_handle(m_free_fd++);
-    m_open_files.emplace(h.fd(), h);
+    FileHandle h = m_files.at(filepath).file->gen_handle(m_free_fd++);
+    m_open_files.set(h.fd(), h);
     return h.fd();
 }
 
@@ -58,8 +71,9 @@ void FileSystem::seek(int fd, uint64_t off)
         exit_fail();
     }
 
-    auto& handle = m_open_files.at(fd);
-    handle.seek(*m_files.at(handle.filename()), off);
+    FileHandle handle = m_open_files.at(fd);
+    handle.seek(get_file(handle.filename()), off);
+    m_open_files.set(fd, handle);
 }
 
 expr::BVExprPtr FileSystem::read(int fd, ssize_t size)
@@ -69,8 +83,23 @@ expr::BVExprPtr FileSystem::read(int fd, ssize_t size)
         exit_fail();
     }
 
-    auto& handle = m_open_files.at(fd);
-    return handle.read(*m_files.at(handle.filename()), size);
+    FileHandle      handle = m_open_files.at(fd);
+    expr::BVExprPtr res    = handle.read(get_file(handle.filename()), size);
+    m_open_files.set(fd, handle);
+    return res;
+}
+
+void FileSystem::read_bytes(int fd, std::span<expr::BVExprPtr> o_buf)
+{
+    if (!m_open_files.contains(fd)) {
+        err("FileSystem") << "read_bytes(): unknown descriptor " << fd
+                          << std::endl;
+        exit_fail();
+    }
+
+    FileHandle handle = m_open_files.at(fd);
+    handle.read_bytes(get_file(handle.filename()), o_buf);
+    m_open_files.set(fd, handle);
 }
 
 void FileSystem::write(int fd, expr::BVExprPtr data)
@@ -80,8 +109,48 @@ void FileSystem::write(int fd, expr::BVExprPtr data)
         exit_fail();
     }
 
-    auto& handle = m_open_files.at(fd);
-    handle.write(*m_files.at(handle.filename()), data);
+    FileHandle handle = m_open_files.at(fd);
+    handle.write(get_file(handle.filename()), data);
+    m_open_files.set(fd, handle);
+}
+
+void FileSystem::serialize(expr::ExprWriter& w) const
+{
+    w.write_uint(m_free_fd);
+    w.write_uint(m_files.size());
+    for (const auto& [name, entry] : m_files)
+        entry.file->serialize(w);
+    w.write_uint(m_open_files.size());
+    for (const auto& [fd, handle] : m_open_files)
+        handle.serialize(w);
+}
+
+void FileSystem::deserialize(expr::ExprReader& r)
+{
+    m_free_fd = r.read_uint();
+
+    PersistentMap<std::string, FileEntry> files;
+    uint64_t                              n = r.read_uint();
+    for (uint64_t i = 0; i < n; ++i) {
+        auto file = File::deserialize(r);
+        files.set(file->name(), {.file = file, .gen = m_gen});
+    }
+    m_files = std::move(files);
+
+    PersistentMap<int, FileHandle> open_files;
+    n = r.read_uint();
+    for (uint64_t i = 0; i < n; ++i) {
+        FileHandle h = FileHandle::deserialize(r);
+        open_files.set(h.fd(), h);
+    }
+    m_open_files = std::move(open_files);
+}
+
+bool FileSystem::shares_data(const FileSystem& other) const
+{
+    return m_files.shares(other.m_files) &&
+           m_open_files.shares(other.m_open_files) &&
+           m_free_fd == other.m_free_fd;
 }
 
 std::unique_ptr<FileSystem> FileSystem::clone() const
@@ -92,9 +161,10 @@ std::unique_ptr<FileSystem> FileSystem::clone() const
 std::vector<File*> FileSystem::files()
 {
     std::vector<File*> res;
-    for (auto const& [name, file] : m_files) {
-        res.push_back(file.get());
-    }
+    // get_file() modifies the map, iterate on a (shared) copy
+    auto files = m_files;
+    for (auto const& [name, entry] : files)
+        res.push_back(&get_file(name));
     return res;
 }
 
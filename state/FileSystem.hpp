@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <cstdint>
 #include <memory>
 #include <string>
@@ -7,15 +8,27 @@
 
 #include "File.hpp"
 #include "../expr/Expr.hpp"
+#include "../util/persistent.hpp"
 
 namespace naaz::state
 {
 
 class FileSystem
 {
-    std::map<std::string, std::unique_ptr<File>> m_files;
-    std::map<int, FileHandle>                    m_open_files;
-    int                                          m_free_fd;
+    // the maps are persistent and the files are shared with the clones. A
+    // file tagged with another generation is copied when it is modified (see
+    // new_generation)
+    struct FileEntry {
+        std::shared_ptr<File> file;
+        uint64_t              gen;
+    };
+    PersistentMap<std::string, FileEntry> m_files;
+    PersistentMap<int, FileHandle>        m_open_files;
+    int                                   m_free_fd;
+    // a clone takes a new generation from a const original
+    mutable std::atomic<uint64_t>         m_gen;
+
+    File& get_file(const std::string& filename);
 
   public:
     FileSystem();
@@ -26,10 +39,15 @@ class FileSystem
     void            close(int fd);
     void            seek(int fd, uint64_t off);
     expr::BVExprPtr read(int fd, ssize_t size);
+    void            read_bytes(int fd, std::span<expr::BVExprPtr> o_buf);
     void            write(int fd, expr::BVExprPtr data);
 
     // other
+    void                        serialize(expr::ExprWriter& w) const;
+    void                        deserialize(expr::ExprReader& r);
     std::unique_ptr<FileSystem> clone() const;
+    // true if the files are shared with other (i.e., neither was modified)
+    bool                        shares_data(const FileSystem& other) const;
     std::vector<File*>          files();
 };
 
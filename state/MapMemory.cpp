@@ -2,19 +2,28 @@
 
 #include "../executor/Executor.hpp"
 #include "../expr/ExprBuilder.hpp"
+#include "../expr/util.hpp"
+#include "../solver/QueryLog.hpp"
 #include "../util/ioutil.hpp"
 #include "../util/strutil.hpp"
 
 #define exprBuilder ExprBuilder::The()
 
+// with array regions (sym_memory_arrays), a symbolic access with at most
+// MAX_ITE_CANDIDATES feasible addresses is an ite on the candidates, a wider
+// (bounded) one uses an array region
+#define MAX_ITE_CANDIDATES 16
+// the granularity of the write sets of the epochs (see MapMemory::WriteEpoch)
+#define WRITE_PAGE_BITS 12
+
 namespace naaz::state
 {
 
 using namespace naaz::expr;
 
-MapMemory::MapMemory(const std::string& name, loader::AddressSpace* as,
+MapMemory::MapMemory(const std::string& name, const loader::AddressSpace* as,
                      SymAccessBehavior ab, UninitReadBehavior b)
-    : m_name(name), m_as(as), m_uninit_behavior(b), m_sym_access_behavior(ab)
+    : m_uninit_behavior(b), m_sym_access_behavior(ab), m_as(as), m_name(name)
 {
     if (m_sym_access_behavior.max_n_eval_read == 0 ||
         m_sym_access_behavior.max_n_eval_write == 0) {
@@ -25,71 +34,308 @@ MapMemory::MapMemory(const std::string& name, loader::AddressSpace* as,
     }
 }
 
-BVExprPtr MapMemory::read(BVExprPtr addr, size_t len, Endianess end)
+static uint64_t add_offset(BVConst base, const BVConst& offset)
 {
-    if (addr->kind() != Expr::Kind::CONST) {
-        if (!m_solver) {
-            err("MapMemory")
-                << "read(): symbolic memory accesses without solver"
-                << std::endl;
-            exit_fail();
+    base.add(offset);
+    return base.as_u64();
+}
+
+// the range r moved by offset (modulo 2^bits), nothing if it wraps around
+static std::optional<std::pair<uint64_t, uint64_t>>
+shift_range(std::pair<uint64_t, uint64_t> r, uint64_t offset, size_t bits)
+{
+    uint64_t mask = bits == 64 ? UINT64_MAX : ((1UL << bits) - 1UL);
+    uint64_t lo   = (r.first + offset) & mask;
+    uint64_t hi   = (r.second + offset) & mask;
+    if (hi - lo != r.second - r.first)
+        return {};
+    return std::pair{lo, hi};
+}
+
+static uint64_t addr_stride(BVExprPtr addr)
+{
+    // the values of (c1 * t1 + ... + cn * tn + k) are all congruent modulo the
+    // biggest power of two that divides every coefficient
+    uint64_t stride = 0;
+    for (const auto& [term, coeff] : exprBuilder.linear_form(addr).terms)
+        stride |= coeff.as_u64();
+    return stride == 0 ? 1UL : stride & -stride;
+}
+
+void MapMemory::check_sym_access()
+{
+    if (!m_solver) {
+        err("MapMemory") << "symbolic memory accesses without solver"
+                         << std::endl;
+        exit_fail();
+    }
+    if (m_solver->satisfiable() != solver::CheckResult::SAT) {
+        // The current state is UNSAT
+        throw executor::UnsatStateException();
+    }
+}
+
+MapMemory::ArrayRegion*
+MapMemory::resolve_sym_access(BVExprPtr addr, size_t len, uint16_t max_n,
+                              std::vector<uint64_t>& o_addrs)
+{
+    check_sym_access();
+
+    // feasible range of the address. If it has a few (aligned) addresses in
+    // a single segment, they are the candidates, without enumerating the
+    // values with the solver. With use_arrays, a wider range (that fits in a
+    // region) becomes an array region
+    auto [base, offset] = split_base_offset(addr);
+    uint64_t off        = offset.as_u64();
+    uint64_t stride     = addr_stride(addr);
+    bool     use_arrays = m_sym_access_behavior.use_arrays;
+    uint64_t max_span   = use_arrays ? m_sym_access_behavior.max_array_size
+                                     : stride * (max_n - 1);
+
+    std::optional<std::pair<uint64_t, uint64_t>> range;
+    if (auto it = m_base_bounds.find(base); it != m_base_bounds.end()) {
+        range = shift_range(it->second, off, addr->size());
+    } else {
+        range = m_solver->bounds(addr, max_span);
+        if (range.has_value()) {
+            auto base_range = shift_range(*range, -off, addr->size());
+            if (base_range.has_value())
+                m_base_bounds.emplace(base, *base_range);
         }
-        if (m_solver->satisfiable() != solver::CheckResult::SAT) {
-            // The current state is UNSAT
-            throw executor::UnsatStateException();
+    }
+    if (range.has_value()) {
+        auto [min_addr, max_addr] = *range;
+        uint64_t max_candidates   = use_arrays ? MAX_ITE_CANDIDATES : max_n;
+        if ((max_addr - min_addr) / stride < max_candidates) {
+            const loader::Segment* min_seg =
+                m_as ? m_as->get_segment(min_addr) : nullptr;
+            const loader::Segment* max_seg =
+                m_as ? m_as->get_segment(max_addr + len - 1) : nullptr;
+            if (min_seg == max_seg) {
+                for (uint64_t a = min_addr;; a += stride) {
+                    o_addrs.push_back(a);
+                    if (max_addr - a < stride)
+                        break;
+                }
+                return nullptr;
+            }
+        }
+        if (use_arrays) {
+            if (ArrayRegion* region = mk_array_region(min_addr, max_addr, len))
+                return region;
         }
+    }
+
+    // unbounded pointer: at most max_n values of its symbolic base are
+    // enumerated, the constant offset is added to them
+    auto bases = m_solver->evaluate_upto(base, max_n).value();
+    if (bases.size() == max_n) {
+        // We have to add the constraint to PI
+        auto cond = exprBuilder.mk_eq(exprBuilder.mk_const(bases.at(0)), base);
+        for (int i = 1; i < bases.size(); ++i)
+            cond = exprBuilder.mk_bool_or(
+                exprBuilder.mk_eq(exprBuilder.mk_const(bases.at(i)), base),
+                cond);
+        m_solver->add(cond);
+    }
+
+    for (const auto& b : bases)
+        o_addrs.push_back(add_offset(b, offset));
+    return nullptr;
+}
+
+static BVExprPtr array_index(BVExprPtr addr)
+{
+    // the arrays are indexed by 64 bit addresses
+    if (addr->size() < 64)
+        return exprBuilder.mk_zext(addr, 64);
+    return addr;
+}
+
+MapMemory::ArrayRegion* MapMemory::get_array_region(uint64_t addr)
+{
+    if (m_arrays.empty())
+        return nullptr;
+
+    auto it = m_arrays.upper_bound(addr);
+    if (it == m_arrays.begin())
+        return nullptr;
+    --it;
+    if (addr > it->second.max_addr)
+        return nullptr;
+    return &it->second;
+}
+
+bool MapMemory::overlaps_array_region(uint64_t addr, size_t len) const
+{
+    if (m_arrays.empty())
+        return false;
+
+    auto it = m_arrays.upper_bound(addr + len - 1);
+    return it != m_arrays.begin() && std::prev(it)->second.max_addr >= addr;
+}
+
+MapMemory::ArrayRegion*
+MapMemory::mk_array_region(uint64_t min_addr, uint64_t max_addr, size_t len)
+{
+    // the region must contain every feasible address of the access
+    uint64_t last_addr = max_addr + len - 1;
+    if (last_addr < max_addr ||
+        last_addr - min_addr >= m_sym_access_behavior.max_array_size)
+        return nullptr;
+
+    ArrayRegion* region = get_array_region(min_addr);
+    if (region && region->max_addr >= last_addr)
+        return region;
+
+    // merge the overlapping regions
+    std::vector<uint64_t> merged;
+    auto                  it = m_arrays.lower_bound(min_addr);
+    if (it != m_arrays.begin() && std::prev(it)->second.max_addr >= min_addr)
+        --it;
+    for (; it != m_arrays.end() && it->first <= last_addr; ++it) {
+        min_addr  = std::min(min_addr, it->second.min_addr);
+        last_addr = std::max(last_addr, it->second.max_addr);
+        merged.push_back(it->first);
+    }
+    if (last_addr - min_addr >= m_sym_access_behavior.max_array_size)
+        return nullptr;
 
-        auto addrs =
-            m_solver->evaluate_upto(addr, m_sym_access_behavior.max_n_eval_read)
-                .value();
-        if (addrs.size() == m_sym_access_behavior.max_n_eval_read) {
-            // We have to add the constraint to PI
-            auto cond =
-                exprBuilder.mk_eq(exprBuilder.mk_const(addrs.at(0)), addr);
-            for (int i = 1; i < addrs.size(); ++i)
-                cond = exprBuilder.mk_bool_or(
-                    exprBuilder.mk_eq(exprBuilder.mk_const(addrs.at(i)), addr),
-                    cond);
-            m_solver->add(cond);
+    // the initial content of the array is the current content of the memory:
+    // the bytes of m_memory and of the AddressSpace, and the writes of the
+    // merged regions. With RET_SYM, the uninitialized bytes are the symbolic
+    // base of the array (the same for all the regions of the memory). The
+    // array is zero elsewhere, the zero bytes are left out of the update list
+    mark_written(min_addr, last_addr - min_addr + 1);
+    bool           sym_base = m_uninit_behavior == UninitReadBehavior::RET_SYM;
+    ArrayUpdatePtr updates  = nullptr;
+    if (sym_base)
+        updates = exprBuilder.mk_array_base(
+            exprBuilder.mk_sym(m_name + "[]", 8), 64);
+
+    for (uint64_t a = min_addr;; ++a) {
+        // the bytes of the merged regions are not in m_memory
+        BVExprPtr b = nullptr;
+        if (auto it = m_memory.find(a); it != m_memory.end()) {
+            b = it->second;
+            m_memory.erase(it);
+        } else if (get_array_region(a) == nullptr) {
+            auto v = m_as ? m_as->read_byte(a) : std::nullopt;
+            if (v.has_value())
+                b = exprBuilder.mk_const(*v, 8);
+            else if (!sym_base)
+                b = read_byte(a);
         }
+        bool is_zero =
+            b && b->kind() == Expr::Kind::CONST &&
+            std::static_pointer_cast<const ConstExpr>(b)->val().is_zero();
+        if (b && (sym_base || !is_zero))
+            updates = exprBuilder.mk_array_update(
+                updates, exprBuilder.mk_const(a, 64), b);
+        if (a == last_addr)
+            break;
+    }
+    for (auto key : merged) {
+        std::vector<ArrayUpdatePtr> writes;
+        for (auto u = m_arrays.at(key).updates; u && !u->is_base();
+             u = u->next())
+            writes.push_back(u);
+        for (auto it = writes.rbegin(); it != writes.rend(); ++it)
+            updates = exprBuilder.mk_array_update(updates, (*it)->index(),
+                                                  (*it)->value());
+        m_arrays.erase(key);
+    }
+    // a read needs a non-empty list
+    if (updates == nullptr)
+        updates = exprBuilder.mk_array_update(
+            nullptr, exprBuilder.mk_const(min_addr, 64),
+            exprBuilder.mk_const(0, 8));
+
+    m_arrays[min_addr] = {
+        .min_addr = min_addr, .max_addr = last_addr, .updates = updates};
+    return &m_arrays.at(min_addr);
+}
+
+BVExprPtr MapMemory::read(BVExprPtr addr, size_t len, Endianess end)
+{
+    if (addr->kind() == Expr::Kind::CONST) {
+        ConstExprPtr addr_ = std::static_pointer_cast<const ConstExpr>(addr);
+        return read(addr_->val().as_u64(), len, end);
+    }
 
-        auto res = read(addrs.at(0).as_u64(), len, end);
-        for (int i = 1; i < addrs.size(); ++i) {
-            res = exprBuilder.mk_ite(
-                exprBuilder.mk_eq(exprBuilder.mk_const(addrs.at(i)), addr),
-                read(addrs.at(i).as_u64(), len, end), res);
+    solver::QueryOriginScope origin(solver::QueryOrigin::SYM_READ);
+    std::vector<uint64_t>    addrs;
+    if (ArrayRegion* region = resolve_sym_access(
+            addr, len, m_sym_access_behavior.max_n_eval_read, addrs)) {
+        BVExprPtr index = array_index(addr);
+        BVExprPtr res   = nullptr;
+        for (size_t i = 0; i < len; ++i) {
+            BVExprPtr b = exprBuilder.mk_array_read(
+                region->updates,
+                exprBuilder.mk_add(index, exprBuilder.mk_const(i, 64)));
+            if (res == nullptr)
+                res = b;
+            else if (end == Endianess::BIG)
+                res = exprBuilder.mk_concat(res, b);
+            else
+                res = exprBuilder.mk_concat(b, res);
         }
         return res;
     }
 
-    ConstExprPtr addr_ = std::static_pointer_cast<const ConstExpr>(addr);
-    return read(addr_->val().as_u64(), len, end);
+    auto res = read(addrs.at(0), len, end);
+    for (int i = 1; i < addrs.size(); ++i) {
+        auto addr_conc = addrs.at(i);
+        res            = exprBuilder.mk_ite(
+            exprBuilder.mk_eq(addr,
+                              exprBuilder.mk_const(addr_conc, addr->size())),
+            read(addr_conc, len, end), res);
+    }
+    return res;
+}
+
+const loader::Segment* MapMemory::base_segment(uint64_t addr, size_t len) const
+{
+    // the segment that contains the bytes, if the state never wrote them
+    if (!m_as)
+        return nullptr;
+    const loader::Segment* seg = m_as->get_segment(addr);
+    if (seg == nullptr || !seg->contains(addr + len - 1))
+        return nullptr;
+
+    auto mem_it = m_memory.lower_bound(addr);
+    if (mem_it != m_memory.end() && mem_it->first <= addr + len - 1)
+        return nullptr;
+    if (overlaps_array_region(addr, len))
+        return nullptr;
+    return seg;
 }
 
 BVExprPtr MapMemory::read_byte(uint64_t addr)
 {
+    if (ArrayRegion* region = get_array_region(addr))
+        return exprBuilder.mk_array_read(region->updates,
+                                         exprBuilder.mk_const(addr, 64));
+
     if (!m_memory.contains(addr)) {
         if (m_as) {
             auto b = m_as->read_byte(addr);
             if (b.has_value()) {
-                // The value is in the AddressSpace
-                BVExprPtr c = expr::ExprBuilder::The().mk_const(b.value(), 8);
-                write_byte(addr, c);
-                return c;
+                // The value is in the AddressSpace. It is not copied in the
+                // state, the AddressSpace is never modified
+                return expr::ExprBuilder::The().mk_const(b.value(), 8);
             }
         }
 
         switch (m_uninit_behavior) {
             case UninitReadBehavior::RET_SYM: {
-                SymExprPtr sym = ExprBuilder::The().mk_sym(
-                    string_format("%s+0x%lx", m_name.c_str(), addr), 8);
+                SymExprPtr sym =
+                    ExprBuilder::The().mk_sym(uninit_name(addr), 8);
                 write_byte(addr, sym);
                 return sym;
             }
             case UninitReadBehavior::RET_ZERO: {
-                ConstExprPtr c = ExprBuilder::The().mk_const(0, 8);
-                write_byte(addr, c);
-                return c;
+                return ExprBuilder::The().mk_const(0, 8);
             }
             case UninitReadBehavior::THROW_ERR: {
                 err("MapMemory") << "read_byte(): address 0x" << std::hex
@@ -109,6 +355,18 @@ BVExprPtr MapMemory::read(uint64_t addr, size_t len, Endianess end)
         exit_fail();
     }
 
+    const loader::Segment* seg = len <= 8 ? base_segment(addr, len) : nullptr;
+    if (seg) {
+        // read the whole value from the base layer
+        uint64_t val = 0;
+        for (size_t i = 0; i < len; ++i) {
+            uint64_t b     = seg->read(addr + i).value();
+            size_t   shift = end == Endianess::BIG ? len - i - 1 : i;
+            val |= b << (shift * 8);
+        }
+        return exprBuilder.mk_const(val, len * 8);
+    }
+
     BVExprPtr res = read_byte(addr);
     for (size_t i = 1; i < len; ++i) {
         if (end == Endianess::BIG)
@@ -121,46 +379,39 @@ BVExprPtr MapMemory::read(uint64_t addr, size_t len, Endianess end)
 
 void MapMemory::write(BVExprPtr addr, BVExprPtr value, Endianess end)
 {
-    if (addr->kind() != Expr::Kind::CONST) {
-        if (!m_solver) {
-            err("MapMemory")
-                << "write(): symbolic memory accesses without solver"
-                << std::endl;
-            exit_fail();
-        }
-        if (m_solver->satisfiable() != solver::CheckResult::SAT) {
-            // The current state is UNSAT
-            throw executor::UnsatStateException();
-        }
-
-        auto addrs =
-            m_solver->evaluate_upto(addr, m_sym_access_behavior.max_n_eval_read)
-                .value();
-        if (addrs.size() == m_sym_access_behavior.max_n_eval_read) {
-            // We have to add the constraint to PI
-            auto cond =
-                exprBuilder.mk_eq(exprBuilder.mk_const(addrs.at(0)), addr);
-            for (int i = 1; i < addrs.size(); ++i)
-                cond = exprBuilder.mk_bool_or(
-                    exprBuilder.mk_eq(exprBuilder.mk_const(addrs.at(i)), addr),
-                    cond);
-            m_solver->add(cond);
-        }
+    if (addr->kind() == Expr::Kind::CONST) {
+        ConstExprPtr addr_ = std::static_pointer_cast<const ConstExpr>(addr);
+        return write(addr_->val().as_u64(), value, end);
+    }
 
-        for (int i = 0; i < addrs.size(); ++i) {
-            auto addr_conc = addrs.at(i).as_u64();
-            write(
-                addr_conc,
-                exprBuilder.mk_ite(
-                    exprBuilder.mk_eq(exprBuilder.mk_const(addrs.at(i)), addr),
-                    value, read(addr_conc, value->size() / 8, end)),
-                end);
+    solver::QueryOriginScope origin(solver::QueryOrigin::SYM_WRITE);
+    size_t                   len = value->size() / 8;
+    std::vector<uint64_t>    addrs;
+    if (ArrayRegion* region = resolve_sym_access(
+            addr, len, m_sym_access_behavior.max_n_eval_write, addrs)) {
+        BVExprPtr index = array_index(addr);
+        for (size_t i = 0; i < len; ++i) {
+            BVExprPtr b =
+                end == Endianess::BIG
+                    ? exprBuilder.mk_extract(value, (len - i - 1) * 8 + 7,
+                                             (len - i - 1) * 8)
+                    : exprBuilder.mk_extract(value, i * 8 + 7, i * 8);
+            region->updates = exprBuilder.mk_array_update(
+                region->updates,
+                exprBuilder.mk_add(index, exprBuilder.mk_const(i, 64)), b);
         }
         return;
     }
 
-    ConstExprPtr addr_ = std::static_pointer_cast<const ConstExpr>(addr);
-    return write(addr_->val().as_u64(), value, end);
+    for (int i = 0; i < addrs.size(); ++i) {
+        auto addr_conc = addrs.at(i);
+        write(addr_conc,
+              exprBuilder.mk_ite(
+                  exprBuilder.mk_eq(
+                      addr, exprBuilder.mk_const(addr_conc, addr->size())),
+                  value, read(addr_conc, len, end)),
+              end);
+    }
 }
 
 void MapMemory::write_byte(uint64_t addr, BVExprPtr value)
@@ -172,9 +423,34 @@ void MapMemory::write_byte(uint64_t addr, BVExprPtr value)
         exit_fail();
     }
 
+    if (ArrayRegion* region = get_array_region(addr)) {
+        region->updates = exprBuilder.mk_array_update(
+            region->updates, exprBuilder.mk_const(addr, 64), value);
+        return;
+    }
+    mark_written(addr, 1);
     m_memory[addr] = value;
 }
 
+void MapMemory::mark_written(uint64_t addr, size_t len)
+{
+    if (len == 0)
+        return;
+    // the epoch is shared with a copy
+    if (m_epoch->frozen)
+        m_epoch = std::make_shared<WriteEpoch>(m_epoch);
+
+    // most of the writes hit the page of the previous one
+    uint64_t last = std::max(addr, addr + len - 1);
+    for (uint64_t p = addr >> WRITE_PAGE_BITS; p <= last >> WRITE_PAGE_BITS;
+         ++p) {
+        if (p == m_epoch->last_page)
+            continue;
+        m_epoch->pages.insert(p);
+        m_epoch->last_page = p;
+    }
+}
+
 void MapMemory::write(uint64_t addr, BVExprPtr value, Endianess end)
 {
     size_t len = value->size();
@@ -195,6 +471,337 @@ void MapMemory::write(uint64_t addr, BVExprPtr value, Endianess end)
     }
 }
 
+void MapMemory::read_bytes(uint64_t addr, std::span<BVExprPtr> o_bytes)
+{
+    size_t len = o_bytes.size();
+    if (len == 0)
+        return;
+
+    if (overlaps_array_region(addr, len)) {
+        for (size_t i = 0; i < len; ++i)
+            o_bytes[i] = read_byte(addr + i);
+        return;
+    }
+
+    ConstExprPtr byte_consts[256];
+    uint8_t      buf[4096];
+    auto         it = m_memory.lower_bound(addr);
+    size_t       i  = 0;
+    while (i < len) {
+        if (it != m_memory.end() && it->first == addr + i) {
+            o_bytes[i++] = it->second;
+            ++it;
+            continue;
+        }
+
+        // the bytes up to the next one written by the state are read from the
+        // base, a page at a time
+        size_t n = std::min(len - i, sizeof(buf));
+        if (it != m_memory.end() && it->first - (addr + i) < n)
+            n = it->first - (addr + i);
+        if (m_as && m_as->read(addr + i, buf, n)) {
+            for (size_t j = 0; j < n; ++j) {
+                if (byte_consts[buf[j]] == nullptr)
+                    byte_consts[buf[j]] = exprBuilder.mk_const(buf[j], 8);
+                o_bytes[i + j] = byte_consts[buf[j]];
+            }
+            i += n;
+        } else {
+            // not in the base (e.g., uninitialized). read_byte() does not
+            // invalidate the iterator
+            o_bytes[i] = read_byte(addr + i);
+            i++;
+        }
+    }
+}
+
+void MapMemory::write_bytes(uint64_t addr, std::span<const BVExprPtr> bytes)
+{
+    for (const auto& b : bytes) {
+        if (b->size() != 8) {
+            err("MapMemory")
+                << "write_bytes(): the functions expects 8-bit values only"
+                << std::endl;
+            exit_fail();
+        }
+    }
+    if (bytes.empty())
+        return;
+
+    if (overlaps_array_region(addr, bytes.size())) {
+        for (size_t i = 0; i < bytes.size(); ++i)
+            write_byte(addr + i, bytes[i]);
+        return;
+    }
+
+    // the addresses are consecutive, the insertion after the previous one is
+    // amortized constant time
+    mark_written(addr, bytes.size());
+    auto hint = m_memory.lower_bound(addr);
+    for (size_t i = 0; i < bytes.size(); ++i)
+        hint = std::next(m_memory.insert_or_assign(hint, addr + i, bytes[i]));
+}
+
+void MapMemory::fill(uint64_t addr, BVExprPtr byte, size_t len)
+{
+    if (byte->size() != 8) {
+        err("MapMemory") << "fill(): the functions expects 8-bit values only"
+                         << std::endl;
+        exit_fail();
+    }
+    if (len == 0)
+        return;
+
+    if (overlaps_array_region(addr, len)) {
+        for (size_t i = 0; i < len; ++i)
+            write_byte(addr + i, byte);
+        return;
+    }
+
+    mark_written(addr, len);
+    auto hint = m_memory.lower_bound(addr);
+    for (size_t i = 0; i < len; ++i)
+        hint = std::next(m_memory.insert_or_assign(hint, addr + i, byte));
+}
+
+void MapMemory::zero_range(uint64_t addr, size_t len)
+{
+    fill(addr, exprBuilder.mk_const(0, 8), len);
+}
+
+void MapMemory::copy_range(uint64_t dst, uint64_t src, size_t len)
+{
+    std::vector<BVExprPtr> bytes(len);
+    read_bytes(src, bytes);
+    write_bytes(dst, bytes);
+}
+
+// the pages written in the epochs of e1 and e2 after their last common
+// ancestor, false if they have none (e.g., a deserialized memory)
+template <typename Epoch>
+static bool written_since_common_epoch(const Epoch* e1, const Epoch* e2,
+                                       std::set<uint64_t>& o_pages)
+{
+    while (e1 != e2) {
+        if (e1 == nullptr || e2 == nullptr)
+            return false;
+        if (e1->depth >= e2->depth) {
+            o_pages.insert(e1->pages.begin(), e1->pages.end());
+            e1 = e1->parent.get();
+        } else {
+            o_pages.insert(e2->pages.begin(), e2->pages.end());
+            e2 = e2->parent.get();
+        }
+    }
+    return true;
+}
+
+// the addresses in [first, last] written in m1 or m2 with different values
+static void diff_range(const std::map<uint64_t, BVExprPtr>& m1,
+                       const std::map<uint64_t, BVExprPtr>& m2, uint64_t first,
+                       uint64_t last, std::vector<uint64_t>& o_addrs)
+{
+    auto it1  = m1.lower_bound(first);
+    auto it2  = m2.lower_bound(first);
+    auto end1 = m1.upper_bound(last);
+    auto end2 = m2.upper_bound(last);
+    while (it1 != end1 || it2 != end2) {
+        if (it2 == end2 || (it1 != end1 && it1->first < it2->first)) {
+            o_addrs.push_back(it1->first);
+            ++it1;
+        } else if (it1 == end1 || it2->first < it1->first) {
+            o_addrs.push_back(it2->first);
+            ++it2;
+        } else {
+            // the expressions are unique, compare the pointers
+            if (it1->second != it2->second)
+                o_addrs.push_back(it1->first);
+            ++it1;
+            ++it2;
+        }
+    }
+}
+
+std::string MapMemory::uninit_name(uint64_t addr) const
+{
+    return string_format("%s+0x%lx", m_name.c_str(), addr);
+}
+
+bool MapMemory::implicit_byte_is(uint64_t addr, BVExprPtr value) const
+{
+    auto is_const = [&](uint64_t v) {
+        return value->kind() == Expr::Kind::CONST &&
+               std::static_pointer_cast<const ConstExpr>(value)
+                       ->val()
+                       .as_u64() == v;
+    };
+
+    if (m_as) {
+        auto b = m_as->read_byte(addr);
+        if (b.has_value())
+            return is_const(b.value());
+    }
+    switch (m_uninit_behavior) {
+        case UninitReadBehavior::RET_SYM:
+            return value->kind() == Expr::Kind::SYM &&
+                   std::static_pointer_cast<const SymExpr>(value)->name() ==
+                       uninit_name(addr);
+        case UninitReadBehavior::RET_ZERO:
+            return is_const(0);
+        default:
+            return false;
+    }
+}
+
+bool MapMemory::concrete_byte(uint64_t addr) const
+{
+    if (overlaps_array_region(addr, 1))
+        return false;
+
+    auto it = m_memory.find(addr);
+    if (it != m_memory.end())
+        return it->second->kind() == Expr::Kind::CONST;
+    if (m_as && m_as->read_byte(addr).has_value())
+        return true;
+    return m_uninit_behavior == UninitReadBehavior::RET_ZERO;
+}
+
+std::optional<std::vector<uint64_t>>
+MapMemory::diff(const MapMemory& other) const
+{
+    if (m_arrays.size() != other.m_arrays.size())
+        return {};
+    for (const auto& [min_addr, region] : m_arrays) {
+        auto it = other.m_arrays.find(min_addr);
+        if (it == other.m_arrays.end() ||
+            it->second.max_addr != region.max_addr ||
+            it->second.updates != region.updates)
+            return {};
+    }
+
+    // the addresses written by at least one of the two
+    std::vector<uint64_t> addrs;
+    std::set<uint64_t>    pages;
+    if (written_since_common_epoch(m_epoch.get(), other.m_epoch.get(),
+                                   pages)) {
+        for (auto p : pages)
+            diff_range(m_memory, other.m_memory, p << WRITE_PAGE_BITS,
+                       ((p + 1) << WRITE_PAGE_BITS) - 1, addrs);
+    } else {
+        diff_range(m_memory, other.m_memory, 0, UINT64_MAX, addrs);
+    }
+
+    // a byte written by only one of the two is compared with the value the
+    // other would read, without initializing it (the merge can be rejected)
+    std::vector<uint64_t> res;
+    for (auto addr : addrs) {
+        auto it1 = m_memory.find(addr);
+        auto it2 = other.m_memory.find(addr);
+        bool same;
+        if (it1 != m_memory.end() && it2 != other.m_memory.end())
+            same = it1->second == it2->second;
+        else if (it1 != m_memory.end())
+            same = other.implicit_byte_is(addr, it1->second);
+        else
+            same = implicit_byte_is(addr, it2->second);
+        if (!same)
+            res.push_back(addr);
+    }
+    return res;
+}
+
+void MapMemory::merge(MapMemory& other, const std::vector<uint64_t>& addrs,
+                      BoolExprPtr guard)
+{
+    // the path condition of the merged state is weaker
+    m_base_bounds.clear();
+    for (auto addr : addrs)
+        write_byte(addr, exprBuilder.mk_ite(guard, read_byte(addr),
+                                            other.read_byte(addr)));
+}
+
+void MapMemory::substitute(const std::map<uint32_t, BVConst>& values)
+{
+    for (auto& [addr, value] : m_memory) {
+        if (value->kind() == Expr::Kind::CONST)
+            continue;
+        auto new_value = std::static_pointer_cast<const BVExpr>(
+            evaluate(value, values, false));
+        if (new_value != value)
+            mark_written(addr, 1);
+        value = new_value;
+    }
+
+    for (auto& [min_addr, region] : m_arrays) {
+        std::vector<ArrayUpdatePtr> updates;
+        for (auto u = region.updates; u != nullptr; u = u->next())
+            updates.push_back(u);
+
+        region.updates = nullptr;
+        for (auto it = updates.rbegin(); it != updates.rend(); ++it) {
+            if ((*it)->is_base()) {
+                region.updates = *it;
+                continue;
+            }
+            region.updates = exprBuilder.mk_array_update(
+                region.updates,
+                std::static_pointer_cast<const BVExpr>(
+                    evaluate((*it)->index(), values, false)),
+                std::static_pointer_cast<const BVExpr>(
+                    evaluate((*it)->value(), values, false)));
+        }
+    }
+}
+
+void MapMemory::serialize(ExprWriter& w) const
+{
+    // the addresses are delta encoded, the written bytes are mostly contiguous
+    uint64_t prev = 0;
+    w.write_uint(m_memory.size());
+    for (const auto& [addr, value] : m_memory) {
+        w.write_uint(addr - prev);
+        w.write_expr(value);
+        prev = addr;
+    }
+
+    w.write_uint(m_arrays.size());
+    for (const auto& [min_addr, region] : m_arrays) {
+        w.write_uint(region.min_addr);
+        w.write_uint(region.max_addr);
+        w.write_updates(region.updates);
+    }
+}
+
+void MapMemory::deserialize(ExprReader& r)
+{
+    clear();
+
+    uint64_t addr = 0;
+    uint64_t n    = r.read_uint();
+    for (uint64_t i = 0; i < n; ++i) {
+        addr += r.read_uint();
+        m_memory.emplace_hint(m_memory.end(), addr, r.read_bv_expr());
+    }
+
+    n = r.read_uint();
+    for (uint64_t i = 0; i < n; ++i) {
+        ArrayRegion region;
+        region.min_addr = r.read_uint();
+        region.max_addr = r.read_uint();
+        region.updates  = r.read_updates();
+        m_arrays.emplace(region.min_addr, region);
+    }
+}
+
+void MapMemory::clear()
+{
+    m_memory.clear();
+    m_arrays.clear();
+    m_base_bounds.clear();
+    // unrelated to the previous content, diff() compares the whole memories
+    m_epoch = std::make_shared<WriteEpoch>(nullptr);
+}
+
 std::unique_ptr<MapMemory> MapMemory::clone()
 {
     return std::unique_ptr<MapMemory>(new MapMemory(*this));
@@ -1,10 +1,16 @@
 #pragma once
 
+#include <atomic>
 #include <map>
 #include <memory>
+#include <optional>
+#include <set>
+#include <span>
+#include <vector>
 
 #include "Solver.hpp"
 #include "../expr/Expr.hpp"
+#include "../expr/ExprSerializer.hpp"
 #include "../arch/Arch.hpp"
 #include "../loader/AddressSpace.hpp"
 #include "../util/config.hpp"
@@ -20,30 +26,104 @@ class MapMemory
     enum UninitReadBehavior { RET_SYM, RET_ZERO, THROW_ERR };
     struct SymAccessBehavior {
         uint16_t max_n_eval_read, max_n_eval_write;
+        bool     use_arrays;
+        uint32_t max_array_size;
     };
 
   private:
     UninitReadBehavior                  m_uninit_behavior;
     SymAccessBehavior                   m_sym_access_behavior;
-    loader::AddressSpace*               m_as;
+    const loader::AddressSpace*         m_as;
     std::map<uint64_t, expr::BVExprPtr> m_memory;
     std::string                         m_name;
     Solver*                             m_solver = nullptr;
 
-    expr::BVExprPtr read_byte(uint64_t addr);
-    void            write_byte(uint64_t addr, expr::BVExprPtr value);
+    // memory regions accessed with symbolic pointers, modeled as arrays
+    // indexed by the (64 bit) address. The bytes of a region are not in
+    // m_memory. The map is indexed by the first address of the region
+    struct ArrayRegion {
+        uint64_t             min_addr, max_addr;
+        expr::ArrayUpdatePtr updates;
+    };
+    std::map<uint64_t, ArrayRegion> m_arrays;
+
+    // feasible range of the symbolic bases of the pointers (see
+    // split_base_offset), the accesses with the same base and a different
+    // offset do not query the solver again. The constraints only grow, the
+    // ranges stay sound (but not tight) in the forked states, they are
+    // dropped on merge
+    std::map<expr::BVExprPtr, std::pair<uint64_t, uint64_t>> m_base_bounds;
+
+    // the pages of m_memory written in an epoch. A copy shares the epoch of
+    // the original, that is frozen: both start a new one (a child) on their
+    // next write. The chains of two memories meet at their last common
+    // ancestor, the pages written after it are the only ones that can
+    // differ (see diff)
+    struct WriteEpoch {
+        std::shared_ptr<WriteEpoch> parent;
+        size_t                      depth;
+        std::set<uint64_t>          pages;
+        uint64_t                    last_page;
+        std::atomic<bool>           frozen;
+
+        WriteEpoch(std::shared_ptr<WriteEpoch> p)
+            : parent(p), depth(p ? p->depth + 1 : 0), last_page(UINT64_MAX),
+              frozen(false)
+        {
+        }
+        ~WriteEpoch()
+        {
+            // the chains can be long, release them iteratively
+            auto p = std::move(parent);
+            while (p && p.use_count() == 1)
+                p = std::move(p->parent);
+        }
+    };
+    std::shared_ptr<WriteEpoch> m_epoch = std::make_shared<WriteEpoch>(nullptr);
+
+    void mark_written(uint64_t addr, size_t len);
+
+    // the memory is layered: the bytes of the AddressSpace are the immutable
+    // base shared by every state, m_memory and m_arrays contain only the bytes
+    // written (or initialized as symbols) by the state
+    const loader::Segment* base_segment(uint64_t addr, size_t len) const;
+    expr::BVExprPtr        read_byte(uint64_t addr);
+    void                   write_byte(uint64_t addr, expr::BVExprPtr value);
+    // the name of the symbol of an uninitialized byte (with RET_SYM)
+    std::string            uninit_name(uint64_t addr) const;
+    // true if the byte at addr, not in m_memory, reads as value. It does not
+    // initialize the byte
+    bool                   implicit_byte_is(uint64_t        addr,
+                                            expr::BVExprPtr value) const;
+
+    void check_sym_access();
+    // the array region of a symbolic access or, if it does not use one, the
+    // candidate addresses in o_addrs (at most max_n, if the address is
+    // concretized)
+    ArrayRegion* resolve_sym_access(expr::BVExprPtr addr, size_t len,
+                                    uint16_t               max_n,
+                                    std::vector<uint64_t>& o_addrs);
+
+    ArrayRegion* get_array_region(uint64_t addr);
+    // the region that contains [min_addr, max_addr + len), nullptr if it
+    // would be bigger than max_array_size
+    ArrayRegion* mk_array_region(uint64_t min_addr, uint64_t max_addr,
+                                 size_t len);
+    bool         overlaps_array_region(uint64_t addr, size_t len) const;
 
   public:
-    MapMemory(const std::string& name, loader::AddressSpace* as,
+    MapMemory(const std::string& name, const loader::AddressSpace* as,
               SymAccessBehavior  ab,
               UninitReadBehavior b = UninitReadBehavior::RET_SYM);
-    MapMemory(const std::string& name, loader::AddressSpace* as,
+    MapMemory(const std::string& name, const loader::AddressSpace* as,
               UninitReadBehavior b = UninitReadBehavior::RET_SYM)
-        : m_name(name), m_as(as), m_uninit_behavior(b)
+        : m_uninit_behavior(b), m_as(as), m_name(name)
     {
         m_sym_access_behavior = {
             .max_n_eval_read  = g_config.default_max_n_eval_sym_read,
-            .max_n_eval_write = g_config.default_max_n_eval_sym_write};
+            .max_n_eval_write = g_config.default_max_n_eval_sym_write,
+            .use_arrays       = g_config.sym_memory_arrays,
+            .max_array_size   = g_config.max_sym_array_size};
     }
     MapMemory(const std::string& name,
               UninitReadBehavior b = UninitReadBehavior::RET_SYM)
@@ -51,10 +131,13 @@ class MapMemory
     {
     }
     MapMemory(const MapMemory& other)
-        : m_name(other.m_name), m_memory(other.m_memory), m_as(other.m_as),
-          m_uninit_behavior(other.m_uninit_behavior),
-          m_sym_access_behavior(other.m_sym_access_behavior)
+        : m_uninit_behavior(other.m_uninit_behavior),
+          m_sym_access_behavior(other.m_sym_access_behavior),
+          m_as(other.m_as), m_memory(other.m_memory), m_name(other.m_name),
+          m_arrays(other.m_arrays), m_base_bounds(other.m_base_bounds),
+          m_epoch(other.m_epoch)
     {
+        m_epoch->frozen = true;
     }
 
     void set_solver(Solver* s) { m_solver = s; }
@@ -68,6 +151,34 @@ class MapMemory
     void            write(uint64_t addr, expr::BVExprPtr value,
                           Endianess end = Endianess::LITTLE);
 
+    // bulk operations on the bytes in [addr, addr + len), without building
+    // the concatenation of the bytes. The ranges can overlap (memmove)
+    void read_bytes(uint64_t addr, std::span<expr::BVExprPtr> o_bytes);
+    void write_bytes(uint64_t addr, std::span<const expr::BVExprPtr> bytes);
+    void fill(uint64_t addr, expr::BVExprPtr byte, size_t len);
+    void zero_range(uint64_t addr, size_t len);
+    void copy_range(uint64_t dst, uint64_t src, size_t len);
+
+    // addresses of the bytes that differ from the ones of other. The memories
+    // cannot be merged (nullopt) if their array regions differ. If they share
+    // a write epoch, only the pages written after it are compared
+    std::optional<std::vector<uint64_t>> diff(const MapMemory& other) const;
+    // true if the byte at addr is a constant. Unlike read(), it does not
+    // initialize the byte
+    bool concrete_byte(uint64_t addr) const;
+    // the bytes at addrs become ite(guard, this byte, byte of other)
+    void merge(MapMemory& other, const std::vector<uint64_t>& addrs,
+               expr::BoolExprPtr guard);
+
+    // replace the symbols with the given values in the whole memory
+    void substitute(const std::map<uint32_t, expr::BVConst>& values);
+
+    // write (read) the content of the memory. The configuration (e.g., the
+    // name, the AddressSpace) is not serialized
+    void serialize(expr::ExprWriter& w) const;
+    void deserialize(expr::ExprReader& r);
+    void clear();
+
     std::unique_ptr<MapMemory> clone();
 };
 
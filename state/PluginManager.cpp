@@ -6,9 +6,10 @@ namespace naaz::state
 {
 
 PluginManager::PluginManager(const PluginManager& other)
+    : m_plugins(other.m_plugins), m_gen(new_generation())
 {
-    for (auto [name, pl] : other.m_plugins)
-        m_plugins[name] = pl->clone();
+    // the plugins are now shared, the original copies them as well
+    other.m_gen = new_generation();
 }
 
 void PluginManager::register_plugin(PluginPtr plugin)
@@ -20,14 +21,27 @@ void PluginManager::register_plugin(PluginPtr plugin)
         exit_fail();
     }
 
-    m_plugins.emplace(plugin->name(), plugin);
+    m_plugins.set(plugin->name(), {.plugin = plugin, .gen = m_gen});
 }
 
 PluginPtr PluginManager::get_plugin(const std::string& name)
 {
-    if (!m_plugins.contains(name))
+    const PluginEntry* entry = m_plugins.find(name);
+    if (entry == nullptr)
         return nullptr;
-    return m_plugins.at(name);
+    if (entry->gen == m_gen)
+        return entry->plugin;
+
+    // the caller can modify the plugin, copy it if it may be shared with
+    // another manager
+    PluginPtr plugin = entry->plugin->clone();
+    m_plugins.set(name, {.plugin = plugin, .gen = m_gen});
+    return plugin;
+}
+
+bool PluginManager::shares_data(const PluginManager& other) const
+{
+    return m_plugins.shares(other.m_plugins);
 }
 
 std::unique_ptr<PluginManager> PluginManager::clone() const
@@ -1,9 +1,12 @@
 #pragma once
 
+#include <atomic>
 #include <memory>
 #include <string>
 #include <map>
 
+#include "../util/persistent.hpp"
+
 namespace naaz::state
 {
 
@@ -19,16 +22,27 @@ typedef std::shared_ptr<Plugin> PluginPtr;
 
 class PluginManager
 {
-    std::map<std::string, PluginPtr> m_plugins;
+    // the map is persistent and the plugins are shared with the clones. A
+    // plugin tagged with another generation is copied when it is fetched (see
+    // new_generation)
+    struct PluginEntry {
+        PluginPtr plugin;
+        uint64_t  gen;
+    };
+    PersistentMap<std::string, PluginEntry> m_plugins;
+    // a clone takes a new generation from a const original
+    mutable std::atomic<uint64_t>           m_gen;
 
   public:
-    PluginManager() {}
+    PluginManager() : m_gen(new_generation()) {}
     PluginManager(const PluginManager& other);
 
     void      register_plugin(PluginPtr plugin);
     PluginPtr get_plugin(const std::string& name);
 
     std::unique_ptr<PluginManager> clone() const;
+    // true if the plugins are shared with other (i.e., neither was accessed)
+    bool shares_data(const PluginManager& other) const;
 };
 
 } // namespace naaz::state
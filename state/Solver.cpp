@@ -1,8 +1,10 @@
+#include <algorithm>
 #include <cassert>
 
 #include "Solver.hpp"
 #include "../expr/util.hpp"
 #include "../expr/ExprBuilder.hpp"
+#include "../solver/QueryLog.hpp"
 #include "../util/ioutil.hpp"
 #include "../util/strutil.hpp"
 
@@ -11,30 +13,228 @@
 namespace naaz::state
 {
 
+// multiplicative inverse of an odd constant (modulo 2^size)
+static expr::BVConst odd_inverse(const expr::BVConst& k)
+{
+    // Newton iteration, each step doubles the number of correct bits
+    expr::BVConst inv = k;
+    for (ssize_t bits = 3; bits < k.size(); bits *= 2) {
+        expr::BVConst t = k;
+        t.mul(inv);
+        expr::BVConst two((uint64_t)2UL, k.size());
+        two.sub(t);
+        inv.mul(two);
+    }
+    return inv;
+}
+
+// collect the values of the symbols fixed by the constraint (e == v)
+static void find_implied_values(expr::BVExprPtr                    e,
+                                const expr::BVConst&               v,
+                                std::map<uint32_t, expr::BVConst>& o_values)
+{
+    switch (e->kind()) {
+        case expr::Expr::Kind::SYM: {
+            auto e_ = std::static_pointer_cast<const expr::SymExpr>(e);
+            // if the symbol is already there with a different value, the
+            // constraint is unsat. The substitution will figure it out
+            o_values.emplace(e_->id(), v);
+            break;
+        }
+        case expr::Expr::Kind::ZEXT: {
+            auto e_ = std::static_pointer_cast<const expr::ZextExpr>(e);
+            auto n  = e_->expr()->size();
+
+            expr::BVConst high = v;
+            high.extract(v.size() - 1, n);
+            if (!high.is_zero())
+                break;
+
+            expr::BVConst low = v;
+            low.extract(n - 1, 0);
+            find_implied_values(e_->expr(), low, o_values);
+            break;
+        }
+        case expr::Expr::Kind::SEXT: {
+            auto e_ = std::static_pointer_cast<const expr::SextExpr>(e);
+            auto n  = e_->expr()->size();
+
+            expr::BVConst low = v;
+            low.extract(n - 1, 0);
+            expr::BVConst low_ext = low;
+            low_ext.sext(v.size());
+            if (!low_ext.eq(v))
+                break;
+
+            find_implied_values(e_->expr(), low, o_values);
+            break;
+        }
+        case expr::Expr::Kind::CONCAT: {
+            auto e_ = std::static_pointer_cast<const expr::ConcatExpr>(e);
+
+            // the first element is the most significant one
+            uint32_t low = 0;
+            for (auto it = e_->els().rbegin(); it != e_->els().rend(); ++it) {
+                expr::BVConst slice = v;
+                slice.extract(low + (*it)->size() - 1, low);
+                find_implied_values(*it, slice, o_values);
+                low += (*it)->size();
+            }
+            break;
+        }
+        case expr::Expr::Kind::NEG: {
+            auto e_ = std::static_pointer_cast<const expr::NegExpr>(e);
+
+            expr::BVConst val = v;
+            val.neg();
+            find_implied_values(e_->expr(), val, o_values);
+            break;
+        }
+        case expr::Expr::Kind::NOT: {
+            auto e_ = std::static_pointer_cast<const expr::NotExpr>(e);
+
+            expr::BVConst val = v;
+            val.bnot();
+            find_implied_values(e_->expr(), val, o_values);
+            break;
+        }
+        case expr::Expr::Kind::ADD:
+        case expr::Expr::Kind::XOR:
+        case expr::Expr::Kind::MUL: {
+            // linear expressions with a single non-constant operand
+            bool            is_mul = e->kind() == expr::Expr::Kind::MUL;
+            expr::BVExprPtr term   = nullptr;
+            expr::BVConst   k((uint64_t)(is_mul ? 1UL : 0UL), e->size());
+            for (expr::ExprPtr child : e->children()) {
+                if (child->kind() != expr::Expr::Kind::CONST) {
+                    if (term != nullptr)
+                        return;
+                    term = std::static_pointer_cast<const expr::BVExpr>(child);
+                    continue;
+                }
+
+                auto child_ =
+                    std::static_pointer_cast<const expr::ConstExpr>(child);
+                if (e->kind() == expr::Expr::Kind::ADD)
+                    k.add(child_->val());
+                else if (e->kind() == expr::Expr::Kind::XOR)
+                    k.bxor(child_->val());
+                else
+                    k.mul(child_->val());
+            }
+            if (term == nullptr)
+                break;
+
+            expr::BVConst val = v;
+            if (e->kind() == expr::Expr::Kind::ADD) {
+                val.sub(k);
+            } else if (e->kind() == expr::Expr::Kind::XOR) {
+                val.bxor(k);
+            } else {
+                // only odd factors are invertible
+                if (k.get_bit(0) == 0)
+                    break;
+                val.mul(odd_inverse(k));
+            }
+            find_implied_values(term, val, o_values);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+static void find_implied_values(expr::BoolExprPtr                  c,
+                                std::map<uint32_t, expr::BVConst>& o_values)
+{
+    if (c->kind() == expr::Expr::Kind::BOOL_AND) {
+        auto c_ = std::static_pointer_cast<const expr::BoolAndExpr>(c);
+        for (auto e : c_->exprs())
+            find_implied_values(e, o_values);
+    } else if (c->kind() == expr::Expr::Kind::EQ) {
+        auto c_ = std::static_pointer_cast<const expr::EqExpr>(c);
+        if (c_->rhs()->kind() == expr::Expr::Kind::CONST)
+            find_implied_values(
+                c_->lhs(),
+                std::static_pointer_cast<const expr::ConstExpr>(c_->rhs())
+                    ->val(),
+                o_values);
+        else if (c_->lhs()->kind() == expr::Expr::Kind::CONST)
+            find_implied_values(
+                c_->rhs(),
+                std::static_pointer_cast<const expr::ConstExpr>(c_->lhs())
+                    ->val(),
+                o_values);
+    }
+}
+
+expr::ExprPtr Solver::substitute_implied_values(expr::ExprPtr e) const
+{
+    if (m_implied_values->empty())
+        return e;
+    return expr::evaluate(e, *m_implied_values, false);
+}
+
 void Solver::add(expr::BoolExprPtr c, bool invalidate_model)
 {
+    std::set<uint32_t> involved_symbols;
+    if (invalidate_model)
+        involved_symbols = m_manager.get_dependencies(c);
+
+    c = std::static_pointer_cast<const expr::BoolExpr>(
+        substitute_implied_values(c));
+
+    std::map<uint32_t, expr::BVConst> new_values;
+    find_implied_values(c, new_values);
+    if (!new_values.empty()) {
+        // rewrite the old constraints and the new one without the symbols.
+        // The equalities are kept, so that the PI is still complete
+        m_manager.substitute(new_values);
+        c = std::static_pointer_cast<const expr::BoolExpr>(
+            expr::evaluate(c, new_values, false));
+        for (const auto& [sym, val] : new_values) {
+            auto sym_expr =
+                exprBuilder.mk_sym(exprBuilder.get_sym_name(sym), val.size());
+            m_manager.add(
+                exprBuilder.mk_eq(sym_expr, exprBuilder.mk_const(val)));
+            m_implied_values.mut()[sym] = val;
+        }
+        m_new_implied_values = true;
+    }
+
     if (!is_true_const(c))
         m_manager.add(c);
 
     if (invalidate_model) {
-        std::set<uint32_t> involved_symbols = m_manager.get_dependencies(c);
         for (auto s_id : involved_symbols) {
-            m_model.erase(s_id);
+            if (m_model->contains(s_id))
+                m_model.mut().erase(s_id);
         }
     }
+    for (const auto& [sym, val] : new_values)
+        m_model.mut()[sym] = val;
+}
+
+bool Solver::consume_new_implied_values()
+{
+    bool res             = m_new_implied_values;
+    m_new_implied_values = false;
+    return res;
 }
 
 void Solver::add(expr::BoolExprPtr c) { add(c, true); }
 
 solver::CheckResult Solver::check_sat(expr::BoolExprPtr c, bool populate_model)
 {
+    c = std::static_pointer_cast<const expr::BoolExpr>(
+        substitute_implied_values(c));
     if (c->kind() == expr::Expr::Kind::BOOL_CONST) {
         auto c_ = std::static_pointer_cast<const expr::BoolConst>(c);
         return c_->is_true() ? solver::CheckResult::SAT
                              : solver::CheckResult::UNSAT;
     }
 
-    auto expr_in_current_model = expr::evaluate(c, m_model, false);
+    auto expr_in_current_model = expr::evaluate(c, *m_model, false);
     if (expr_in_current_model->kind() == expr::Expr::Kind::BOOL_CONST) {
         auto e_ = std::static_pointer_cast<const expr::BoolConst>(
             expr_in_current_model);
@@ -49,8 +249,9 @@ solver::CheckResult Solver::check_sat(expr::BoolExprPtr c, bool populate_model)
     if (res == solver::CheckResult::SAT && populate_model) {
         std::map<uint32_t, expr::BVConst> model =
             solver::Z3Solver::The().model();
+        auto& model_ = m_model.mut();
         for (const auto& [sym, val] : model)
-            m_model[sym] = val;
+            model_[sym] = val;
     }
 
     return res;
@@ -58,7 +259,8 @@ solver::CheckResult Solver::check_sat(expr::BoolExprPtr c, bool populate_model)
 
 solver::CheckResult Solver::satisfiable()
 {
-    auto expr_in_current_model = expr::evaluate(m_manager.pi(), m_model, false);
+    auto expr_in_current_model =
+        expr::evaluate(m_manager.pi(), *m_model, false);
     if (expr_in_current_model->kind() == expr::Expr::Kind::BOOL_CONST) {
         auto e_ = std::static_pointer_cast<const expr::BoolConst>(
             expr_in_current_model);
@@ -72,8 +274,9 @@ solver::CheckResult Solver::satisfiable()
     if (res == solver::CheckResult::SAT) {
         std::map<uint32_t, expr::BVConst> model =
             solver::Z3Solver::The().model();
+        auto& model_ = m_model.mut();
         for (const auto& [sym, val] : model)
-            m_model[sym] = val;
+            model_[sym] = val;
     }
 
     return res;
@@ -93,11 +296,26 @@ solver::CheckResult Solver::may_be_true(expr::BoolExprPtr c)
     return check_sat(c, false);
 }
 
+// value of e in a model that assigns all its symbols
+static expr::BVConst
+evaluate_in_model(expr::ExprPtr                            e,
+                  const std::map<uint32_t, expr::BVConst>& model)
+{
+    auto eval = expr::evaluate(e, model, true);
+    if (eval->kind() == expr::Expr::Kind::CONST)
+        return std::static_pointer_cast<const expr::ConstExpr>(eval)->val();
+    assert(eval->kind() == expr::Expr::Kind::BOOL_CONST &&
+           "Solver::evaluate(): unexpected expr::evaluate result");
+    return std::static_pointer_cast<const expr::BoolConst>(eval)->is_true()
+               ? expr::BVConst((uint64_t)1UL, 1)
+               : expr::BVConst((uint64_t)0UL, 1);
+}
+
 std::optional<expr::BVConst> Solver::evaluate(expr::ExprPtr e)
 {
     std::set<uint32_t> involved_symbols = m_manager.get_dependencies(e);
     for (auto s_id : involved_symbols) {
-        if (!m_model.contains(s_id)) {
+        if (!m_model->contains(s_id)) {
             solver::CheckResult r = check_sat(m_manager.pi(e));
             if (r != solver::CheckResult::SAT) {
                 return {};
@@ -106,22 +324,147 @@ std::optional<expr::BVConst> Solver::evaluate(expr::ExprPtr e)
         }
     }
 
-    auto eval = expr::evaluate(e, m_model, true);
-    if (eval->kind() == expr::Expr::Kind::CONST)
-        return std::static_pointer_cast<const expr::ConstExpr>(eval)->val();
-    assert(eval->kind() == expr::Expr::Kind::BOOL_CONST &&
-           "Solver::evaluate(): unexpected expr::evaluate result");
-    return std::static_pointer_cast<const expr::BoolConst>(eval)->is_true()
-               ? expr::BVConst((uint64_t)1UL, 1)
-               : expr::BVConst((uint64_t)0UL, 1);
+    return evaluate_in_model(e, *m_model);
+}
+
+std::optional<std::vector<expr::BVConst>>
+Solver::evaluate(const std::vector<expr::ExprPtr>& exprs)
+{
+    std::set<uint32_t> involved_symbols = m_manager.get_dependencies(exprs);
+    for (auto s_id : involved_symbols) {
+        if (!m_model->contains(s_id)) {
+            solver::CheckResult r =
+                check_sat(m_manager.pi_of_symbols(involved_symbols));
+            if (r != solver::CheckResult::SAT) {
+                return {};
+            }
+            break;
+        }
+    }
+
+    std::vector<expr::BVConst> res;
+    res.reserve(exprs.size());
+    for (auto e : exprs)
+        res.push_back(evaluate_in_model(e, *m_model));
+    return res;
 }
 
 std::optional<std::vector<expr::BVConst>>
 Solver::evaluate_upto(expr::BVExprPtr e, int n)
 {
-    if (check_sat(m_manager.pi(e)) != solver::CheckResult::SAT)
+    solver::QueryOriginScope origin(solver::QueryOrigin::EVAL_UPTO);
+    e = std::static_pointer_cast<const expr::BVExpr>(
+        substitute_implied_values(e));
+    if (e->kind() == expr::Expr::Kind::CONST)
+        return std::vector<expr::BVConst>{
+            std::static_pointer_cast<const expr::ConstExpr>(e)->val()};
+
+    // the first query of eval_upto checks the satisfiability of pi
+    auto res = solver::Z3Solver::The().eval_upto(e, m_manager.pi(e), n);
+    if (res.empty())
         return {};
-    return solver::Z3Solver::The().eval_upto(e, m_manager.pi(e), n);
+    return res;
+}
+
+// the symbols are written by name, their ids are not stable
+static void write_values(expr::ExprWriter&                        w,
+                         const std::map<uint32_t, expr::BVConst>& values)
+{
+    w.write_uint(values.size());
+    for (const auto& [sym, val] : values) {
+        w.write_str(exprBuilder.get_sym_name(sym));
+        w.write_const(val);
+    }
+}
+
+static std::map<uint32_t, expr::BVConst> read_values(expr::ExprReader& r)
+{
+    std::map<uint32_t, expr::BVConst> values;
+    uint64_t                          n = r.read_uint();
+    for (uint64_t i = 0; i < n; ++i) {
+        std::string   name = r.read_str();
+        expr::BVConst val  = r.read_const();
+        values.emplace(exprBuilder.mk_sym(name, val.size())->id(), val);
+    }
+    return values;
+}
+
+void Solver::serialize(expr::ExprWriter& w) const
+{
+    const auto& constraints = m_manager.constraints();
+    w.write_uint(constraints.size());
+    for (auto c : constraints)
+        w.write_expr(c);
+
+    write_values(w, *m_implied_values);
+    write_values(w, *m_model);
+}
+
+void Solver::deserialize(expr::ExprReader& r)
+{
+    // the constraints already have the implied values substituted
+    m_manager  = solver::ConstraintManager();
+    uint64_t n = r.read_uint();
+    for (uint64_t i = 0; i < n; ++i)
+        m_manager.add(r.read_bool_expr());
+
+    m_implied_values     = read_values(r);
+    m_model              = read_values(r);
+    m_new_implied_values = false;
+}
+
+expr::BoolExprPtr Solver::merge(const Solver& other)
+{
+    const auto& mine   = m_manager.constraints();
+    const auto& theirs = other.m_manager.constraints();
+
+    std::vector<expr::BoolExprPtr> common, only_mine, only_theirs;
+    std::set_intersection(mine.begin(), mine.end(), theirs.begin(),
+                          theirs.end(), std::back_inserter(common));
+    std::set_difference(mine.begin(), mine.end(), theirs.begin(), theirs.end(),
+                        std::back_inserter(only_mine));
+    std::set_difference(theirs.begin(), theirs.end(), mine.begin(), mine.end(),
+                        std::back_inserter(only_theirs));
+    if (only_mine.empty() && only_theirs.empty())
+        return nullptr;
+
+    expr::BoolExprPtr guard_mine   = exprBuilder.mk_bool_and(only_mine);
+    expr::BoolExprPtr guard_theirs = exprBuilder.mk_bool_and(only_theirs);
+
+    solver::ConstraintManager manager;
+    for (auto c : common)
+        manager.add(c);
+    auto disjunction = exprBuilder.mk_bool_or(guard_mine, guard_theirs);
+    if (!is_true_const(disjunction))
+        manager.add(disjunction);
+    m_manager = std::move(manager);
+
+    // only the values implied on both sides are still implied. The model of
+    // this side satisfies the new path constraint
+    std::map<uint32_t, expr::BVConst> implied_values;
+    for (const auto& [sym, val] : *m_implied_values) {
+        auto it = other.m_implied_values->find(sym);
+        if (it != other.m_implied_values->end() && it->second.eq(val))
+            implied_values.emplace(sym, val);
+    }
+    m_implied_values     = std::move(implied_values);
+    m_new_implied_values = false;
+
+    return only_mine.empty() ? exprBuilder.mk_not(guard_theirs) : guard_mine;
+}
+
+std::optional<std::pair<uint64_t, uint64_t>>
+Solver::bounds(expr::BVExprPtr e, uint64_t max_span)
+{
+    solver::QueryOriginScope origin(solver::QueryOrigin::BOUNDS);
+    e = std::static_pointer_cast<const expr::BVExpr>(
+        substitute_implied_values(e));
+    if (e->kind() == expr::Expr::Kind::CONST) {
+        auto v = std::static_pointer_cast<const expr::ConstExpr>(e)->val();
+        return std::pair{v.as_u64(), v.as_u64()};
+    }
+
+    return solver::Z3Solver::The().bounds(e, m_manager.pi(e), max_span);
 }
 
 } // namespace naaz::state
@@ -3,39 +3,78 @@
 #include <optional>
 
 #include "../expr/Expr.hpp"
+#include "../expr/ExprSerializer.hpp"
 #include "../solver/ConstraintManager.hpp"
 #include "../solver/Z3Solver.hpp"
+#include "../util/persistent.hpp"
 
 namespace naaz::state
 {
 
 class Solver
 {
-    solver::ConstraintManager         m_manager;
-    std::map<uint32_t, expr::BVConst> m_model;
+    solver::ConstraintManager                 m_manager;
+    CowPtr<std::map<uint32_t, expr::BVConst>> m_model;
+
+    // symbols whose value is fixed by the path constraint (e.g., sym == 42)
+    CowPtr<std::map<uint32_t, expr::BVConst>> m_implied_values;
+    bool                                      m_new_implied_values = false;
 
     solver::CheckResult check_sat(expr::BoolExprPtr c,
                                   bool              populate_model = true);
     void                add(expr::BoolExprPtr c, bool invalidate_model);
+    expr::ExprPtr       substitute_implied_values(expr::ExprPtr e) const;
 
   public:
     Solver() {}
     Solver(const Solver& other)
-        : m_manager(other.m_manager), m_model(other.m_model)
+        : m_manager(other.m_manager), m_model(other.m_model),
+          m_implied_values(other.m_implied_values),
+          m_new_implied_values(other.m_new_implied_values)
     {
     }
+    Solver(Solver&& other)                 = default;
+    Solver& operator=(const Solver& other) = default;
+    Solver& operator=(Solver&& other)      = default;
 
     const solver::ConstraintManager& manager() const { return m_manager; }
     solver::CheckResult              satisfiable();
 
+    const std::map<uint32_t, expr::BVConst>& implied_values() const
+    {
+        return *m_implied_values;
+    }
+    // true if some implied values were found since the last call
+    bool consume_new_implied_values();
+
     void                add(expr::BoolExprPtr c);
     solver::CheckResult check_sat_and_add_if_sat(expr::BoolExprPtr c);
     solver::CheckResult may_be_true(expr::BoolExprPtr c);
 
     // due to lazy constraints, PI could be unsat, and the evaluation can fail
     std::optional<expr::BVConst>              evaluate(expr::ExprPtr e);
+    // evaluate all the expressions in the same model, with at most one query
+    // on the constraints of their dependencies
+    std::optional<std::vector<expr::BVConst>>
+    evaluate(const std::vector<expr::ExprPtr>& exprs);
     std::optional<std::vector<expr::BVConst>> evaluate_upto(expr::BVExprPtr e,
                                                             int             n);
+
+    // join the path constraint with the one of other: the common constraints
+    // are kept, the others are replaced by the disjunction of the two sides.
+    // Return the condition that selects the values of this side, or nullptr
+    // if the two sides cannot be told apart (the solver is not modified)
+    expr::BoolExprPtr merge(const Solver& other);
+
+    // the path constraint, the implied values and the cached model
+    void serialize(expr::ExprWriter& w) const;
+    void deserialize(expr::ExprReader& r);
+
+    // unsigned minimum and maximum value of e. Nothing if the state is not
+    // satisfiable or if the values span more than max_span (see
+    // Z3Solver::bounds)
+    std::optional<std::pair<uint64_t, uint64_t>>
+    bounds(expr::BVExprPtr e, uint64_t max_span = UINT64_MAX);
 };
 
 } // namespace naaz::state
@@ -2,6 +2,7 @@
 
 #include <nlohmann/json.hpp>
 #include <algorithm>
+#include <atomic>
 #include <fstream>
 #include <memory>
 
@@ -9,9 +10,11 @@
 #include "UnknownPlatform.hpp"
 #include "../models/Linker.hpp"
 #include "../expr/ExprBuilder.hpp"
+#include "../solver/QueryLog.hpp"
 #include "../util/ioutil.hpp"
 #include "../util/strutil.hpp"
 #include "../util/parseutil.hpp"
+#include "../util/stats.hpp"
 
 namespace naaz::state
 {
@@ -21,7 +24,7 @@ State::State(std::shared_ptr<loader::AddressSpace> as,
              loader::SyscallABI abi)
     : m_as(as), m_lifter(lifter), m_pc(pc)
 {
-    m_linked_functions = std::make_shared<models::LinkedFunctions>();
+    m_hooks            = std::make_shared<models::HookTable>();
     m_regs             = std::unique_ptr<MapMemory>(new MapMemory("regs"));
     m_ram = std::unique_ptr<MapMemory>(new MapMemory("ram", as.get()));
     m_fs  = std::unique_ptr<FileSystem>(new FileSystem());
@@ -49,8 +52,11 @@ State::State(std::shared_ptr<loader::AddressSpace> as,
 State::State(const State& other)
     : m_as(other.m_as), m_lifter(other.m_lifter), m_pc(other.m_pc),
       m_platform(other.m_platform), m_heap_ptr(other.m_heap_ptr),
-      m_argv(other.m_argv), m_linked_functions(other.m_linked_functions),
-      m_solver(other.m_solver), m_config_symbols(other.m_config_symbols)
+      m_stacktrace(other.m_stacktrace), m_argv(other.m_argv),
+      m_hooks(other.m_hooks), m_solver(other.m_solver),
+      m_config_symbols(other.m_config_symbols),
+      m_libc_start_main_exit_wrapper(other.m_libc_start_main_exit_wrapper),
+      m_prev_location(other.m_prev_location), m_new_edges(other.m_new_edges)
 {
     m_ram  = other.m_ram->clone();
     m_regs = other.m_regs->clone();
@@ -59,9 +65,80 @@ State::State(const State& other)
     m_ram->set_solver(&m_solver);
 }
 
+StatePtr State::fork(StatePtr parent, uint64_t pc,
+                     expr::BoolExprPtr constraint)
+{
+    STATS_COUNT(FORKS);
+    parent->materialize();
+
+    StatePtr child(new State());
+    child->m_as               = parent->m_as;
+    child->m_lifter           = parent->m_lifter;
+    child->m_platform         = parent->m_platform;
+    child->m_hooks            = parent->m_hooks;
+    child->m_heap_ptr         = parent->m_heap_ptr;
+    child->m_libc_start_main_exit_wrapper =
+        parent->m_libc_start_main_exit_wrapper;
+    child->m_prev_location   = parent->m_prev_location;
+    child->m_new_edges       = parent->m_new_edges;
+    child->m_pc              = pc;
+    child->m_fork_parent     = parent;
+    child->m_fork_constraint = constraint;
+    return child;
+}
+
+StatePtr State::clone() const
+{
+    STATS_TIMER(CLONE);
+    if (!m_fork_parent)
+        return std::shared_ptr<State>(new State(*this));
+
+    // a pending child of the same parent, with the fields of this state
+    StatePtr res         = fork(m_fork_parent, m_pc, m_fork_constraint);
+    res->m_heap_ptr      = m_heap_ptr;
+    res->m_prev_location = m_prev_location;
+    res->m_new_edges     = m_new_edges;
+    return res;
+}
+
+void State::materialize()
+{
+    if (m_fork_parent == nullptr)
+        return;
+
+    StatePtr parent = std::move(m_fork_parent);
+    if (parent.use_count() == 1) {
+        // no other pending child (or anyone else) refers to the parent, take
+        // its data
+        m_stacktrace     = std::move(parent->m_stacktrace);
+        m_argv           = std::move(parent->m_argv);
+        m_config_symbols = std::move(parent->m_config_symbols);
+        m_regs           = std::move(parent->m_regs);
+        m_ram            = std::move(parent->m_ram);
+        m_fs             = std::move(parent->m_fs);
+        m_pm             = std::move(parent->m_pm);
+        m_solver         = std::move(parent->m_solver);
+    } else {
+        m_stacktrace     = parent->m_stacktrace;
+        m_argv           = parent->m_argv;
+        m_config_symbols = parent->m_config_symbols;
+        m_regs           = parent->m_regs->clone();
+        m_ram            = parent->m_ram->clone();
+        m_fs             = parent->m_fs->clone();
+        m_pm             = parent->m_pm->clone();
+        m_solver         = parent->m_solver;
+    }
+    m_ram->set_solver(&m_solver);
+
+    m_solver.add(m_fork_constraint);
+    m_fork_constraint = nullptr;
+    apply_implied_values();
+}
+
 loader::SyscallABI State::syscall_abi() const { return m_platform->abi(); }
 
-bool State::get_code_at(uint64_t addr, uint8_t** o_data, uint64_t* o_size)
+bool State::get_code_at(uint64_t addr, const uint8_t** o_data,
+                        uint64_t* o_size)
 {
     // FIXME: This should be changed... It's wrong in too many ways
     return m_as->get_ref(addr, o_data, (size_t*)o_size);
@@ -69,44 +146,82 @@ bool State::get_code_at(uint64_t addr, uint8_t** o_data, uint64_t* o_size)
 
 expr::BVExprPtr State::read(expr::BVExprPtr addr, size_t len)
 {
+    materialize();
     return m_ram->read(addr, len, arch().endianess());
 }
 
 expr::BVExprPtr State::read(uint64_t addr, size_t len)
 {
+    materialize();
     return m_ram->read(addr, len, arch().endianess());
 }
 
 void State::write(expr::BVExprPtr addr, expr::BVExprPtr data)
 {
+    materialize();
     m_ram->write(addr, data, arch().endianess());
 }
 
 void State::write(uint64_t addr, expr::BVExprPtr data)
 {
+    materialize();
     m_ram->write(addr, data, arch().endianess());
 }
 
 expr::BVExprPtr State::read_buf(expr::BVExprPtr addr, size_t len)
 {
+    materialize();
     return m_ram->read(addr, len, Endianess::BIG);
 }
 
 expr::BVExprPtr State::read_buf(uint64_t addr, size_t len)
 {
+    materialize();
     return m_ram->read(addr, len, Endianess::BIG);
 }
 
 void State::write_buf(expr::BVExprPtr addr, expr::BVExprPtr data)
 {
+    materialize();
     m_ram->write(addr, data, Endianess::BIG);
 }
 
 void State::write_buf(uint64_t addr, expr::BVExprPtr data)
 {
+    materialize();
     m_ram->write(addr, data, Endianess::BIG);
 }
 
+void State::read_bytes(uint64_t addr, std::span<expr::BVExprPtr> o_bytes)
+{
+    materialize();
+    m_ram->read_bytes(addr, o_bytes);
+}
+
+void State::write_bytes(uint64_t addr, std::span<const expr::BVExprPtr> bytes)
+{
+    materialize();
+    m_ram->write_bytes(addr, bytes);
+}
+
+void State::fill(uint64_t addr, expr::BVExprPtr byte, size_t len)
+{
+    materialize();
+    m_ram->fill(addr, byte, len);
+}
+
+void State::zero_range(uint64_t addr, size_t len)
+{
+    materialize();
+    m_ram->zero_range(addr, len);
+}
+
+void State::copy_range(uint64_t dst, uint64_t src, size_t len)
+{
+    materialize();
+    m_ram->copy_range(dst, src, len);
+}
+
 expr::BVExprPtr State::reg_read(const std::string& name)
 {
     csleigh_Register reg = m_lifter->reg(name);
@@ -115,6 +230,7 @@ expr::BVExprPtr State::reg_read(const std::string& name)
 
 expr::BVExprPtr State::reg_read(uint64_t offset, size_t size)
 {
+    materialize();
     return m_regs->read(offset, size, Endianess::LITTLE);
 }
 
@@ -126,6 +242,7 @@ void State::reg_write(const std::string& name, expr::BVExprPtr data)
 
 void State::reg_write(uint64_t offset, expr::BVExprPtr data)
 {
+    materialize();
     m_regs->write(offset, data, Endianess::LITTLE);
 }
 
@@ -141,29 +258,235 @@ expr::BVExprPtr State::get_int_param(CallConv cv, uint64_t i)
 
 void State::register_linked_function(uint64_t addr, const models::Model* m)
 {
-    m_linked_functions->links[addr] = m;
+    m_hooks->set_model(addr, m);
     if (m->name() == "libc_start_main_exit_wrapper")
         m_libc_start_main_exit_wrapper = addr;
 }
 
 bool State::is_linked_function(uint64_t addr)
 {
-    return m_linked_functions->links.contains(addr);
+    return get_linked_model(addr) != nullptr;
 }
 
 const models::Model* State::get_linked_model(uint64_t addr)
 {
-    return m_linked_functions->links[addr];
+    const models::HookTable::Hook* hook = m_hooks->lookup(addr);
+    return hook ? hook->model : nullptr;
+}
+
+void State::hook(uint64_t addr, const models::Model* m)
+{
+    m_hooks->set_model(addr, m);
+}
+
+void State::hook(uint64_t addr, const std::string& name,
+                 models::CallbackModel::Callback callback)
+{
+    m_hooks->set_model(addr,
+                       std::make_shared<models::CallbackModel>(name, callback));
+}
+
+void State::unhook(uint64_t addr) { m_hooks->set_model(addr, nullptr); }
+
+expr::BoolExprPtr State::pi() const
+{
+    if (m_fork_parent)
+        return expr::ExprBuilder::The().mk_bool_and(m_fork_parent->pi(),
+                                                    m_fork_constraint);
+    return m_solver.manager().pi();
+}
+
+solver::CheckResult State::satisfiable()
+{
+    materialize();
+    return m_solver.satisfiable();
+}
+
+void State::apply_implied_values()
+{
+    // pending children apply them when materialized
+    if (m_fork_parent)
+        return;
+    if (!m_solver.consume_new_implied_values())
+        return;
+
+    m_regs->substitute(m_solver.implied_values());
+    m_ram->substitute(m_solver.implied_values());
+}
+
+// cost of the merge of the differing bytes. The bytes concrete in both states
+// become symbolic, and they could be used later as pointers or branch
+// conditions, so they are the expensive ones
+static size_t merge_cost(const MapMemory& m1, const MapMemory& m2,
+                         const std::vector<uint64_t>& addrs)
+{
+    static const size_t CONCRETE_BYTE_COST = 8;
+
+    size_t cost = 0;
+    for (auto addr : addrs) {
+        if (m1.concrete_byte(addr) && m2.concrete_byte(addr))
+            cost += CONCRETE_BYTE_COST;
+        else
+            cost += 1;
+    }
+    return cost;
+}
+
+bool State::merge(State& other, size_t max_cost)
+{
+    // the cheap checks first, the pending children are materialized only if
+    // they pass
+    if (m_pc != other.m_pc || m_heap_ptr != other.m_heap_ptr ||
+        exited || other.exited || !(stacktrace() == other.stacktrace()))
+        return false;
+
+    materialize();
+    other.materialize();
+    if (*m_argv != *other.m_argv ||
+        *m_config_symbols != *other.m_config_symbols)
+        return false;
+    if (!m_fs->shares_data(*other.m_fs) || !m_pm->shares_data(*other.m_pm))
+        return false;
+
+    auto regs_diff = m_regs->diff(*other.m_regs);
+    auto ram_diff  = m_ram->diff(*other.m_ram);
+    if (!regs_diff.has_value() || !ram_diff.has_value())
+        return false;
+    if (merge_cost(*m_regs, *other.m_regs, regs_diff.value()) +
+            merge_cost(*m_ram, *other.m_ram, ram_diff.value()) >
+        max_cost)
+        return false;
+
+    expr::BoolExprPtr guard = m_solver.merge(other.m_solver);
+    if (guard == nullptr)
+        return false;
+
+    for (const auto& [edge, _] : other.m_new_edges)
+        add_new_edge(edge);
+
+    m_regs->merge(*other.m_regs, regs_diff.value(), guard);
+    m_ram->merge(*other.m_ram, ram_diff.value(), guard);
+    return true;
+}
+
+void State::serialize_data(expr::ExprWriter& w) const
+{
+    m_regs->serialize(w);
+    m_ram->serialize(w);
+    m_fs->serialize(w);
+    m_solver.serialize(w);
+}
+
+void State::deserialize_data(expr::ExprReader& r)
+{
+    m_regs->deserialize(r);
+    m_ram->deserialize(r);
+    m_fs->deserialize(r);
+    m_solver.deserialize(r);
+}
+
+void State::release_data()
+{
+    m_regs->clear();
+    m_ram->clear();
+    m_fs     = std::unique_ptr<FileSystem>(new FileSystem());
+    m_solver = Solver();
+}
+
+void State::spill(expr::ExprWriter& w)
+{
+    materialize();
+    serialize_data(w);
+    release_data();
+}
+
+void State::unspill(expr::ExprReader& r) { deserialize_data(r); }
+
+void State::serialize(expr::ExprWriter& w)
+{
+    if (!is_materialized()) {
+        // the pending child is serialized through a temporary copy, the
+        // state stays lazy
+        auto tmp = clone();
+        tmp->materialize();
+        tmp->serialize(w);
+        return;
+    }
+
+    serialize_shell(w);
+    serialize_data(w);
+}
+
+void State::deserialize(expr::ExprReader& r)
+{
+    deserialize_shell(r);
+    deserialize_data(r);
 }
 
-expr::BoolExprPtr State::pi() const { return m_solver.manager().pi(); }
+void State::serialize_shell(expr::ExprWriter& w)
+{
+    materialize();
+
+    w.write_uint(m_pc);
+    w.write_uint(m_heap_ptr);
+    w.write_uint(m_prev_location);
+    w.write_uint(m_new_edges.size());
+    for (const auto& [edge, _] : m_new_edges)
+        w.write_uint(edge);
+
+    // from the bottom of the stack
+    std::vector<uint64_t> stacktrace(m_stacktrace.begin(), m_stacktrace.end());
+    w.write_uint(stacktrace.size());
+    for (auto it = stacktrace.rbegin(); it != stacktrace.rend(); ++it)
+        w.write_uint(*it);
+
+    w.write_uint(m_argv->size());
+    for (auto arg : *m_argv)
+        w.write_expr(arg);
+
+    w.write_uint(m_config_symbols->size());
+    for (auto sym : *m_config_symbols)
+        w.write_expr(sym);
+}
 
-solver::CheckResult State::satisfiable() { return m_solver.satisfiable(); }
+void State::deserialize_shell(expr::ExprReader& r)
+{
+    materialize();
+
+    m_pc            = r.read_uint();
+    m_heap_ptr      = r.read_uint();
+    m_prev_location = r.read_uint();
+    clear_new_edges();
+    uint64_t n_edges = r.read_uint();
+    for (uint64_t i = 0; i < n_edges; ++i)
+        add_new_edge(r.read_uint());
+
+    PersistentStack<uint64_t> stacktrace;
+    uint64_t                  n = r.read_uint();
+    for (uint64_t i = 0; i < n; ++i)
+        stacktrace.push(r.read_uint());
+    m_stacktrace = std::move(stacktrace);
+
+    std::vector<expr::BVExprPtr> argv;
+    n = r.read_uint();
+    for (uint64_t i = 0; i < n; ++i)
+        argv.push_back(r.read_bv_expr());
+    m_argv = std::move(argv);
+
+    std::set<expr::SymExprPtr> config_symbols;
+    n = r.read_uint();
+    for (uint64_t i = 0; i < n; ++i)
+        config_symbols.insert(
+            std::static_pointer_cast<const expr::SymExpr>(r.read_expr()));
+    m_config_symbols = std::move(config_symbols);
+
+    release_data();
+}
 
 const lifter::PCodeBlock* State::curr_block()
 {
-    uint8_t* data;
-    uint64_t size;
+    const uint8_t* data;
+    uint64_t       size;
     if (!get_code_at(pc(), &data, &size))
         return nullptr;
 
@@ -173,6 +496,8 @@ const lifter::PCodeBlock* State::curr_block()
 
 bool State::dump(std::filesystem::path out_dir)
 {
+    solver::QueryOriginScope origin(solver::QueryOrigin::DUMP);
+    materialize();
     if (m_solver.satisfiable() != solver::CheckResult::SAT) {
         info("State") << "dump(): the state was not satisfiable" << std::endl;
         return false;
@@ -181,8 +506,9 @@ bool State::dump(std::filesystem::path out_dir)
     // dump stacktrace
     std::filesystem::path out_file = out_dir / "stacktrace.txt";
     auto stacktrace_file           = std::fstream(out_file, std::ios::out);
-    for (auto addr : m_stacktrace)
-        stacktrace_file << "0x" << std::hex << addr << std::endl;
+    std::vector<uint64_t> stacktrace(m_stacktrace.begin(), m_stacktrace.end());
+    for (auto it = stacktrace.rbegin(); it != stacktrace.rend(); ++it)
+        stacktrace_file << "0x" << std::hex << *it << std::endl;
     stacktrace_file.close();
 
     // dump exit code
@@ -191,14 +517,34 @@ bool State::dump(std::filesystem::path out_dir)
     exit_code_file << std::dec << retcode << std::endl;
     exit_code_file.close();
 
+    // the argv, the config symbols and the content of the files are evaluated
+    // in a single model
+    std::vector<File*> files;
+    for (File* f : m_fs->files()) {
+        if (f->size() != 0)
+            files.push_back(f);
+    }
+
+    std::vector<expr::ExprPtr> outputs(m_argv->begin(), m_argv->end());
+    outputs.insert(outputs.end(), m_config_symbols->begin(),
+                   m_config_symbols->end());
+    for (File* f : files)
+        outputs.push_back(f->read_all());
+
+    auto values = m_solver.evaluate(outputs);
+    if (!values.has_value()) {
+        info("State") << "dump(): unable to evaluate the outputs" << std::endl;
+        return false;
+    }
+    auto value_it = values->begin();
+
     // dump argv
     out_file       = out_dir / "argv.txt";
     auto argv_file = std::fstream(out_file, std::ios::out);
-    int  i         = 0;
-    for (auto arg : m_argv) {
-        argv_file << std::dec << i++ << ": ";
-        auto arg_eval = m_solver.evaluate(arg).value();
-        auto arg_data = arg_eval.as_data();
+    for (size_t i = 0; i < m_argv->size(); ++i) {
+        argv_file << std::dec << i << ": ";
+        const auto& arg_eval = *value_it++;
+        auto        arg_data = arg_eval.as_data();
         for (int j = 0; j < arg_eval.size() / 8U; ++j) {
             if ((int)arg_data[j] >= 32 && (int)arg_data[j] <= 126) {
                 argv_file << arg_data[j];
@@ -212,14 +558,14 @@ bool State::dump(std::filesystem::path out_dir)
     argv_file.close();
 
     // dump config symbols (if any)
-    if (!m_config_symbols.empty()) {
+    if (!m_config_symbols->empty()) {
         out_file           = out_dir / "cfg_syms.txt";
         auto cfg_syms_file = std::fstream(out_file, std::ios::out);
-        for (auto s : m_config_symbols) {
+        for (auto s : *m_config_symbols) {
             cfg_syms_file << s->name() << " (" << std::dec << s->size()
                           << ") : ";
-            auto s_eval = m_solver.evaluate(s).value();
-            auto s_data = s_eval.as_data();
+            const auto& s_eval = *value_it++;
+            auto        s_data = s_eval.as_data();
             for (int j = 0; j < s_eval.size() / 8U; ++j) {
                 if ((int)s_data[j] >= 32 && (int)s_data[j] <= 126) {
                     cfg_syms_file << s_data[j];
@@ -240,19 +586,14 @@ bool State::dump(std::filesystem::path out_dir)
     pi_file.close();
 #endif
 
-    for (File* f : m_fs->files()) {
-        if (f->size() == 0)
-            continue;
-
+    for (File* f : files) {
         std::string filename(f->name());
         std::replace(filename.begin(), filename.end(), '/', '_');
 
         out_file  = out_dir / (filename + ".bin");
         auto fout = std::fstream(out_file, std::ios::out | std::ios::binary);
 
-        auto data_expr = f->read_all();
-        auto data_eval = m_solver.evaluate(data_expr).value();
-        auto data      = data_eval.as_data();
+        auto data = (value_it++)->as_data();
         fout.write((const char*)data.data(), data.size());
         fout.close();
     }
@@ -280,9 +621,12 @@ uint64_t State::allocate(expr::ExprPtr size)
 
 void State::set_argv(const std::vector<std::string>& argv)
 {
-    m_argv.clear();
+    materialize();
+    auto& argv_ = m_argv.mut();
+    argv_.clear();
 
-    static int argv_sym_idx = 0;
+    // shared by the states of all the threads (e.g., the naaz_server jobs)
+    static std::atomic<int> argv_sym_idx = 0;
     for (const auto& s : argv) {
         if (s.starts_with("@@:")) {
             auto arg_tokens = split_at(s, ':');
@@ -324,10 +668,11 @@ void State::set_argv(const std::vector<std::string>& argv)
                 exit_fail();
             }
 
+            int             arg_idx  = argv_sym_idx++;
             expr::BVExprPtr arg_expr = nullptr;
             for (uint64_t i = 0; i < size; ++i) {
                 auto sym = expr::ExprBuilder::The().mk_sym(
-                    string_format("argv_%d[%lu]", argv_sym_idx, i), 8);
+                    string_format("argv_%d[%lu]", arg_idx, i), 8);
 
                 if (printable_only) {
                     m_solver.add(expr::ExprBuilder::The().mk_uge(
@@ -368,13 +713,12 @@ void State::set_argv(const std::vector<std::string>& argv)
                     arg_expr =
                         expr::ExprBuilder::The().mk_concat(arg_expr, sym);
             }
-            argv_sym_idx++;
 
             arg_expr = expr::ExprBuilder::The().mk_concat(
                 arg_expr, expr::ExprBuilder::The().mk_const(0UL, 8));
-            m_argv.push_back(arg_expr);
+            argv_.push_back(arg_expr);
         } else
-            m_argv.push_back(expr::ExprBuilder::The().mk_const(
+            argv_.push_back(expr::ExprBuilder::The().mk_const(
                 expr::BVConst((const uint8_t*)s.data(), s.size() + 1)));
     }
 }
@@ -383,6 +727,7 @@ using namespace nlohmann;
 
 void State::init_from_json(std::filesystem::path json_path)
 {
+    materialize();
     std::ifstream ifs(json_path);
     std::string   json_str((std::istreambuf_iterator<char>(ifs)),
                            (std::istreambuf_iterator<char>()));
@@ -412,7 +757,7 @@ void State::init_from_json(std::filesystem::path json_path)
             if (valj.contains("symbol") && valj["symbol"].get<bool>()) {
                 auto bv = expr::ExprBuilder::The().mk_sym(
                     valuej.get<std::string>(), reg.varnode.size * 8);
-                m_config_symbols.insert(bv);
+                m_config_symbols.mut().insert(bv);
                 reg_write(name, bv);
             } else {
                 if (valuej.is_number()) {
@@ -448,7 +793,7 @@ void State::init_from_json(std::filesystem::path json_path)
             if (valj.contains("symbol") && valj["symbol"].get<bool>()) {
                 auto bv = expr::ExprBuilder::The().mk_sym(
                     valuej.get<std::string>(), size * 8);
-                m_config_symbols.insert(bv);
+                m_config_symbols.mut().insert(bv);
                 write_buf(addr, bv);
             } else {
                 if (valuej.is_number()) {
@@ -14,6 +14,8 @@
 #include "../solver/ConstraintManager.hpp"
 #include "../expr/Expr.hpp"
 #include "../models/Linker.hpp"
+#include "../models/HookTable.hpp"
+#include "../util/persistent.hpp"
 
 namespace naaz::state
 {
@@ -26,24 +28,44 @@ class State
     uint64_t m_pc;
     uint64_t m_heap_ptr;
 
-    std::vector<uint64_t>        m_stacktrace;
-    std::vector<expr::BVExprPtr> m_argv;
-    std::set<expr::SymExprPtr>   m_config_symbols;
+    // the per-state containers are shared among the clones until modified
+    PersistentStack<uint64_t>            m_stacktrace;
+    CowPtr<std::vector<expr::BVExprPtr>> m_argv;
+    CowPtr<std::set<expr::SymExprPtr>>   m_config_symbols;
 
     std::unique_ptr<MapMemory>     m_regs;
     std::unique_ptr<MapMemory>     m_ram;
     std::unique_ptr<FileSystem>    m_fs;
     std::unique_ptr<PluginManager> m_pm;
 
-    std::shared_ptr<Platform>                m_platform;
-    std::shared_ptr<loader::AddressSpace>    m_as;
-    std::shared_ptr<lifter::PCodeLifter>     m_lifter;
-    std::shared_ptr<models::LinkedFunctions> m_linked_functions;
+    std::shared_ptr<Platform>             m_platform;
+    std::shared_ptr<loader::AddressSpace> m_as;
+    std::shared_ptr<lifter::PCodeLifter>  m_lifter;
+    std::shared_ptr<models::HookTable>    m_hooks;
 
     Solver m_solver;
 
     uint64_t m_libc_start_main_exit_wrapper = 0;
 
+    // edge coverage (see executor::EdgeCoverage): the location of the last
+    // executed block, and the edges of the path that were never hit when it
+    // traversed them. They are marked in the coverage map once the state is
+    // known to be satisfiable (see executor::StateEmitter)
+    uint64_t                      m_prev_location = 0;
+    PersistentMap<uint64_t, bool> m_new_edges;
+
+    // lazy fork (see State::fork). The state is a pending child of
+    // m_fork_parent, and its data is copied from the parent on the first
+    // access
+    StatePtr          m_fork_parent;
+    expr::BoolExprPtr m_fork_constraint;
+
+    State() {}
+
+    void serialize_data(expr::ExprWriter& w) const;
+    void deserialize_data(expr::ExprReader& r);
+    void release_data();
+
   public:
     State(std::shared_ptr<loader::AddressSpace> as,
           std::shared_ptr<lifter::PCodeLifter> lifter, uint64_t pc,
@@ -51,6 +73,17 @@ class State
     State(const State& other);
     ~State() {}
 
+    // a child of "parent" that continues at "pc" under "constraint". The
+    // child shares the data of the parent until it is accessed (and the last
+    // child to be accessed takes it without copying), so the parent must
+    // not be modified after the fork
+    static StatePtr fork(StatePtr parent, uint64_t pc,
+                         expr::BoolExprPtr constraint);
+    bool            is_materialized() const { return m_fork_parent == nullptr; }
+    // copy the data of the parent of a pending child. It is done on the first
+    // access, or explicitly before handing the state to another thread
+    void            materialize();
+
     void init_from_json(std::filesystem::path json);
 
     const Arch&               arch() const { return m_lifter->arch(); }
@@ -59,7 +92,7 @@ class State
     std::shared_ptr<lifter::PCodeLifter>  lifter() { return m_lifter; }
     std::shared_ptr<loader::AddressSpace> address_space() { return m_as; }
 
-    bool get_code_at(uint64_t addr, uint8_t** o_data, uint64_t* o_size);
+    bool get_code_at(uint64_t addr, const uint8_t** o_data, uint64_t* o_size);
 
     expr::BVExprPtr read(expr::BVExprPtr addr, size_t len);
     expr::BVExprPtr read(uint64_t addr, size_t len);
@@ -71,6 +104,13 @@ class State
     void            write_buf(expr::BVExprPtr addr, expr::BVExprPtr data);
     void            write_buf(uint64_t addr, expr::BVExprPtr data);
 
+    // bulk operations on the bytes of the memory (see MapMemory)
+    void read_bytes(uint64_t addr, std::span<expr::BVExprPtr> o_bytes);
+    void write_bytes(uint64_t addr, std::span<const expr::BVExprPtr> bytes);
+    void fill(uint64_t addr, expr::BVExprPtr byte, size_t len);
+    void zero_range(uint64_t addr, size_t len);
+    void copy_range(uint64_t dst, uint64_t src, size_t len);
+
     expr::BVExprPtr reg_read(const std::string& name);
     expr::BVExprPtr reg_read(uint64_t offset, size_t size);
     void            reg_write(const std::string& name, expr::BVExprPtr data);
@@ -87,38 +127,115 @@ class State
         return m_libc_start_main_exit_wrapper;
     }
 
-    FileSystem& fs() { return *m_fs; }
+    // execute the model (or the callback) in place of the code at addr. The
+    // hooks are shared by the state and all its successors
+    void hook(uint64_t addr, const models::Model* m);
+    void hook(uint64_t addr, const std::string& name,
+              models::CallbackModel::Callback callback);
+    void unhook(uint64_t addr);
+    std::shared_ptr<models::HookTable> hooks() { return m_hooks; }
+
+    FileSystem& fs()
+    {
+        materialize();
+        return *m_fs;
+    }
     bool        dump(std::filesystem::path out_dir);
 
-    PluginManager& pm() { return *m_pm; }
+    PluginManager& pm()
+    {
+        materialize();
+        return *m_pm;
+    }
 
-    Solver&             solver() { return m_solver; }
+    Solver& solver()
+    {
+        materialize();
+        return m_solver;
+    }
     expr::BoolExprPtr   pi() const;
     solver::CheckResult satisfiable();
 
+    // replace the symbols whose value is implied by the path constraint in
+    // registers and memory
+    void apply_implied_values();
+
     void     set_pc(uint64_t pc) { m_pc = pc; }
     uint64_t pc() const { return m_pc; }
 
     const lifter::PCodeBlock* curr_block();
 
-    const std::vector<uint64_t>& stacktrace() const { return m_stacktrace; }
+    uint64_t prev_location() const { return m_prev_location; }
+    void     set_prev_location(uint64_t loc) { m_prev_location = loc; }
+    const PersistentMap<uint64_t, bool>& new_edges() const
+    {
+        return m_new_edges;
+    }
+    void add_new_edge(uint64_t edge)
+    {
+        if (!m_new_edges.contains(edge))
+            m_new_edges.set(edge, true);
+    }
+    void clear_new_edges() { m_new_edges = PersistentMap<uint64_t, bool>(); }
+
+    // return addresses, from the innermost call
+    const PersistentStack<uint64_t>& stacktrace() const
+    {
+        return m_fork_parent ? m_fork_parent->stacktrace() : m_stacktrace;
+    }
 
-    void register_call(uint64_t retaddr) { m_stacktrace.push_back(retaddr); }
+    void register_call(uint64_t retaddr)
+    {
+        materialize();
+        m_stacktrace.push(retaddr);
+    }
     void register_ret()
     {
+        materialize();
         if (m_stacktrace.empty())
             return;
-        m_stacktrace.pop_back();
+        m_stacktrace.pop();
     }
 
-    StatePtr clone() const { return std::shared_ptr<State>(new State(*this)); }
+    // merge other, a state at the same program point, into this state. The
+    // values that differ are joined with ite expressions guarded by the path
+    // constraints, and the path constraints by disjunction. Return false
+    // (without modifying the states) if the states cannot be merged, or if
+    // the cost of the merge is above max_cost
+    bool merge(State& other, size_t max_cost);
+
+    // spill() writes the memory, the registers, the file system and the path
+    // constraint of the state, and releases them. The state cannot be used
+    // until unspill() reads them back. The other data is small, or shared
+    // with the other states, and it is kept in memory
+    void spill(expr::ExprWriter& w);
+    void unspill(expr::ExprReader& r);
+
+    // serialize() writes the whole state (for the checkpoints), except for
+    // the data of the binary (address space, hooks, platform) and the
+    // plugins. deserialize() reads it back into a clone of the entry state of
+    // the same binary. The shell is what spill() keeps in memory,
+    // deserialize_shell() releases the other data, as spill() does
+    void serialize(expr::ExprWriter& w);
+    void deserialize(expr::ExprReader& r);
+    void serialize_shell(expr::ExprWriter& w);
+    void deserialize_shell(expr::ExprReader& r);
+
+    StatePtr clone() const;
 
     uint64_t allocate(uint64_t size);
     uint64_t allocate(expr::ExprPtr size);
 
-    const std::vector<expr::BVExprPtr>& get_argv() const { return m_argv; }
+    const std::vector<expr::BVExprPtr>& get_argv() const
+    {
+        return m_fork_parent ? m_fork_parent->get_argv() : *m_argv;
+    }
     void set_argv(const std::vector<std::string>& argv);
-    void set_argv(const std::vector<expr::BVExprPtr>& argv) { m_argv = argv; }
+    void set_argv(const std::vector<expr::BVExprPtr>& argv)
+    {
+        materialize();
+        m_argv.mut() = argv;
+    }
 
     // exited stuff
     bool    exited  = false;
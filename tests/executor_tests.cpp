@@ -1,7 +1,16 @@
 #include <catch2/catch_all.hpp>
+#include <filesystem>
+#include <fstream>
 #include <memory>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <nlohmann/json.hpp>
 
 #include "../util/config.hpp"
+#include "../util/ioutil.hpp"
 #include "../arch/x86_64.hpp"
 #include "../expr/Expr.hpp"
 #include "../expr/ExprBuilder.hpp"
@@ -11,7 +20,15 @@
 #include "../executor/PCodeExecutor.hpp"
 #include "../executor/BFSExplorationTechnique.hpp"
 #include "../executor/DFSExplorationTechnique.hpp"
+#include "../executor/CovExplorationTechnique.hpp"
 #include "../executor/RandDFSExplorationTechnique.hpp"
+#include "../executor/DirectedExplorationTechnique.hpp"
+#include "../executor/RandomPathExplorationTechnique.hpp"
+#include "../executor/Checkpointer.hpp"
+#include "../executor/EdgeCoverage.hpp"
+#include "../executor/JobServer.hpp"
+#include "../executor/StateEmitter.hpp"
+#include "../models/libc/string_utils.hpp"
 
 #define exprBuilder naaz::expr::ExprBuilder::The()
 
@@ -180,3 +197,629 @@ TEST_CASE("Explore RandDFS 1", "[executor]")
     REQUIRE(s.has_value());
     REQUIRE(s.value()->solver().evaluate(sym).value().as_u64() == 3);
 }
+
+TEST_CASE("Explore RandomPath 1", "[executor]")
+{
+    const uint8_t code[] = "\x31\xC0"             // 0x400000:    xor eax, eax
+                                                  //           L:
+                           "\x83\xFF\x0A"         // 0x400002:    cmp edi, 0xa
+                           "\x73\x06"             // 0x400005:    jae OUT
+                           "\xFF\xC0"             // 0x400007:    inc eax
+                           "\xFF\xC7"             // 0x400009:    inc edi
+                           "\xEB\xF5"             // 0x40000b:    jmp L
+                                                  //         OUT:
+                           "\x83\xF8\x07"         // 0x40000d:    cmp eax, 7
+                           "\x75\x05"             // 0x400010:    jne RET
+                           "\xB8\x2A\x00\x00\x00" // 0x400012:    mov eax, 42
+                                                  //         RET:
+                           "\xC3";                // 0x400017:    ret
+
+    auto state = get_state_executing(get_x86_64_lifter(), code, sizeof(code));
+    auto sym   = exprBuilder.mk_sym("sym", 32);
+    state->reg_write("EDI", sym);
+
+    executor::RandomPathExecutorManager em(state);
+
+    std::vector<uint64_t> find;
+    find.push_back(0x400012);
+    std::vector<uint64_t> avoid;
+    avoid.push_back(0x400017);
+    std::optional<state::StatePtr> s = em.explore(find, avoid);
+
+    REQUIRE(s.has_value());
+    REQUIRE(s.value()->solver().evaluate(sym).value().as_u64() == 3);
+}
+
+TEST_CASE("RandomPath Technique 1", "[executor]")
+{
+    const uint8_t code[] = "\xC3"; // 0x400000:    ret
+
+    auto lifter = get_x86_64_lifter();
+    auto s0     = get_state_executing(lifter, code, sizeof(code));
+    auto a      = get_state_executing(lifter, code, sizeof(code));
+    auto b      = get_state_executing(lifter, code, sizeof(code));
+    auto c      = get_state_executing(lifter, code, sizeof(code));
+    auto d      = get_state_executing(lifter, code, sizeof(code));
+
+    executor::RandomPathExplorationTechnique rp(s0);
+    REQUIRE(rp.get_next().value() == s0);
+
+    // b is held by the merger, only a can be selected
+    rp.add_successors({a}, {b});
+    REQUIRE(rp.queued() == std::vector<state::StatePtr>{a});
+    REQUIRE(rp.get_next().value() == a);
+    rp.add_actives({c, d});
+
+    // released after the successors of a, b goes back to its own leaf (the
+    // sibling of a) instead of the subtree of the selected state
+    rp.add_actives({b});
+    REQUIRE(rp.queued() == std::vector<state::StatePtr>{c, d, b});
+    REQUIRE(rp.num_states() == 3);
+
+    // b is at depth 1, c and d at depth 2
+    size_t num_b = 0;
+    for (int i = 0; i < 1000; ++i) {
+        auto s = rp.get_next().value();
+        if (s == b)
+            num_b++;
+        rp.add_actives({s});
+    }
+    REQUIRE(num_b > 350);
+    REQUIRE(num_b < 650);
+}
+
+TEST_CASE("Cov Technique Coverage 1", "[executor]")
+{
+    const uint8_t code[] = "\xC3"; // 0x400000:    ret
+
+    auto lifter = get_x86_64_lifter();
+    auto s0     = get_state_executing(lifter, code, sizeof(code));
+    auto a      = s0->clone();
+    auto b      = s0->clone();
+    a->set_pc(0x400100);
+    b->set_pc(0x400200);
+
+    executor::CovExplorationTechnique remote(s0);
+    executor::CovExplorationTechnique local(s0);
+    REQUIRE(remote.get_next().value() == s0);
+    REQUIRE(local.get_next().value() == s0);
+
+    // the first call shares all the coverage, the next ones only the new one
+    std::stringstream ss;
+    {
+        expr::ExprWriter w(ss);
+        REQUIRE(remote.save_coverage(w));
+        remote.add_actives({b});
+        REQUIRE(remote.save_coverage(w));
+        REQUIRE(!remote.save_coverage(w));
+    }
+    expr::ExprReader r(ss, [](int32_t) -> FloatFormatPtr { return nullptr; });
+    local.merge_coverage(r);
+    local.merge_coverage(r);
+
+    // b reaches the code visited by the other worker, a goes first
+    local.add_actives({a, b});
+    REQUIRE(local.get_next().value() == a);
+    REQUIRE(local.get_next().value() == b);
+}
+
+TEST_CASE("Explore Directed 1", "[executor]")
+{
+    const uint8_t code[] = "\x31\xC0"             // 0x400000:    xor eax, eax
+                                                  //           L:
+                           "\x83\xFF\x0A"         // 0x400002:    cmp edi, 0xa
+                           "\x73\x06"             // 0x400005:    jae OUT
+                           "\xFF\xC0"             // 0x400007:    inc eax
+                           "\xFF\xC7"             // 0x400009:    inc edi
+                           "\xEB\xF5"             // 0x40000b:    jmp L
+                                                  //         OUT:
+                           "\x83\xF8\x07"         // 0x40000d:    cmp eax, 7
+                           "\x75\x05"             // 0x400010:    jne RET
+                           "\xB8\x2A\x00\x00\x00" // 0x400012:    mov eax, 42
+                                                  //         RET:
+                           "\xC3";                // 0x400017:    ret
+
+    auto state = get_state_executing(get_x86_64_lifter(), code, sizeof(code));
+    auto sym   = exprBuilder.mk_sym("sym", 32);
+    state->reg_write("EDI", sym);
+
+    // distances on the recovered CFG
+    executor::DirectedExplorationTechnique directed(state);
+    directed.set_targets({0x400012});
+    REQUIRE(directed.block_distance(0x400012) == 0);
+    REQUIRE(directed.block_distance(0x40000d) == 1);
+    REQUIRE(directed.block_distance(0x400002) == 2);
+    REQUIRE(directed.block_distance(0x400007) == 3);
+    REQUIRE(directed.block_distance(0x400017) == UINT64_MAX);
+
+    executor::DirectedExecutorManager em(state);
+
+    std::vector<uint64_t> find;
+    find.push_back(0x400012);
+    std::vector<uint64_t> avoid;
+    avoid.push_back(0x400017);
+    std::optional<state::StatePtr> s = em.explore(find, avoid);
+
+    REQUIRE(s.has_value());
+    REQUIRE(s.value()->solver().evaluate(sym).value().as_u64() == 3);
+}
+
+TEST_CASE("Explore Distributed 1", "[executor]")
+{
+    const uint8_t code[] = "\x31\xC0"             // 0x400000:    xor eax, eax
+                                                  //           L:
+                           "\x83\xFF\x0A"         // 0x400002:    cmp edi, 0xa
+                           "\x73\x06"             // 0x400005:    jae OUT
+                           "\xFF\xC0"             // 0x400007:    inc eax
+                           "\xFF\xC7"             // 0x400009:    inc edi
+                           "\xEB\xF5"             // 0x40000b:    jmp L
+                                                  //         OUT:
+                           "\x83\xF8\x07"         // 0x40000d:    cmp eax, 7
+                           "\x75\x05"             // 0x400010:    jne RET
+                           "\xB8\x2A\x00\x00\x00" // 0x400012:    mov eax, 42
+                                                  //         RET:
+                           "\xC3";                // 0x400017:    ret
+
+    auto state = get_state_executing(get_x86_64_lifter(), code, sizeof(code));
+    auto sym   = exprBuilder.mk_sym("sym", 32);
+    state->reg_write("EDI", sym);
+
+    executor::BFSExecutorManager em(state);
+
+    std::vector<uint64_t> find;
+    find.push_back(0x400012);
+    std::vector<uint64_t> avoid;
+    avoid.push_back(0x400017);
+    std::optional<state::StatePtr> s = em.explore_distributed(find, avoid, 3);
+
+    // the state found by a worker is sent back to this process
+    REQUIRE(s.has_value());
+    REQUIRE(s.value()->pc() == 0x400012);
+    REQUIRE(s.value()->solver().evaluate(sym).value().as_u64() == 3);
+    REQUIRE(em.num_states() > 0);
+}
+
+TEST_CASE("Explore Merge 1", "[executor]")
+{
+    const uint8_t code[] = "\x31\xC0"             // 0x400000:    xor eax, eax
+                                                  //           L:
+                           "\x83\xFF\x0A"         // 0x400002:    cmp edi, 0xa
+                           "\x73\x06"             // 0x400005:    jae OUT
+                           "\xFF\xC0"             // 0x400007:    inc eax
+                           "\xFF\xC7"             // 0x400009:    inc edi
+                           "\xEB\xF5"             // 0x40000b:    jmp L
+                                                  //         OUT:
+                           "\x83\xF8\x07"         // 0x40000d:    cmp eax, 7
+                           "\x75\x05"             // 0x400010:    jne RET
+                           "\xB8\x2A\x00\x00\x00" // 0x400012:    mov eax, 42
+                                                  //         RET:
+                           "\xC3";                // 0x400017:    ret
+
+    auto state = get_state_executing(get_x86_64_lifter(), code, sizeof(code));
+    auto sym   = exprBuilder.mk_sym("sym", 32);
+    state->reg_write("EDI", sym);
+
+    // the states of the different iterations are merged at the loop head
+    g_config.lazy_solving = false;
+    g_config.merge_states = true;
+    executor::DFSExecutorManager em(state);
+
+    std::vector<uint64_t> find;
+    find.push_back(0x400012);
+    std::vector<uint64_t> avoid;
+    avoid.push_back(0x400017);
+    std::optional<state::StatePtr> s = em.explore(find, avoid);
+
+    g_config.merge_states = false;
+
+    REQUIRE(s.has_value());
+    REQUIRE(s.value()->solver().evaluate(sym).value().as_u64() == 3);
+}
+
+TEST_CASE("Explore Checkpoint 1", "[executor]")
+{
+    const uint8_t code[] =
+        "\x31\xC9"                 // 0x400000:    xor ecx, ecx
+                                   //           L:
+        "\xFF\xC1"                 // 0x400002:    inc ecx
+        "\x81\xF9\xE8\x03\x00\x00" // 0x400004:    cmp ecx, 1000
+        "\x75\xF6"                 // 0x40000a:    jne L
+        "\x81\xFF\x34\x12\x00\x00" // 0x40000c:    cmp edi, 0x1234
+        "\x75\x05"                 // 0x400012:    jne RET
+        "\xB8\x2A\x00\x00\x00"     // 0x400014:    mov eax, 42
+                                   //         RET:
+        "\xC3";                    // 0x400019:    ret
+
+    auto state = get_state_executing(get_x86_64_lifter(), code, sizeof(code));
+    auto sym   = exprBuilder.mk_sym("sym", 32);
+    state->reg_write("EDI", sym);
+
+    std::vector<uint64_t> find;
+    find.push_back(0x400014);
+    std::vector<uint64_t> avoid;
+    avoid.push_back(0x400019);
+
+    auto dir = std::filesystem::temp_directory_path() / "naaz_checkpoint_test";
+    g_config.checkpoint_dir      = dir;
+    g_config.checkpoint_interval = 0;
+    {
+        // the loop takes more than PERIODIC_CHECK_INTERVAL blocks, a
+        // checkpoint is written in the middle of it
+        executor::DFSExecutorManager em(state);
+        REQUIRE(em.explore(find, avoid).has_value());
+    }
+    g_config.checkpoint_dir      = "";
+    g_config.checkpoint_interval = 300;
+
+    executor::Checkpointer::load_symbols(dir);
+    executor::DFSExecutorManager em(state);
+    em.resume(dir);
+    REQUIRE(em.num_states() == 1);
+
+    std::optional<state::StatePtr> s = em.explore(find, avoid);
+    REQUIRE(s.has_value());
+    REQUIRE(s.value()->reg_read("ECX") == exprBuilder.mk_const(1000, 32));
+    REQUIRE(s.value()->solver().evaluate(sym).value().as_u64() == 0x1234);
+
+    std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("Checkpointer Files 1", "[executor]")
+{
+    auto dir = std::filesystem::temp_directory_path() / "naaz_checkpoint_files";
+    std::filesystem::remove_all(dir);
+
+    executor::Checkpointer checkpointer;
+    checkpointer.enable(dir, "");
+    auto f1 = checkpointer.add_file("content 1");
+    auto f2 = checkpointer.add_file("content 2");
+    checkpointer.write("checkpoint 1");
+    checkpointer.wait();
+    REQUIRE(std::filesystem::exists(dir / f1));
+    REQUIRE(std::filesystem::exists(dir / f2));
+
+    // the second checkpoint refers to f1, f2 is dropped after it
+    REQUIRE(checkpointer.use_file(f1));
+    REQUIRE(!checkpointer.use_file("data_42.bin"));
+    checkpointer.write("checkpoint 2");
+    checkpointer.wait();
+    REQUIRE(executor::Checkpointer::load(dir) == "checkpoint 2");
+    REQUIRE(std::filesystem::exists(dir / f1));
+    REQUIRE(!std::filesystem::exists(dir / f2));
+    REQUIRE(!checkpointer.use_file(f2));
+
+    // the files of a resumed checkpoint are kept, the new names are unique
+    executor::Checkpointer resumed;
+    resumed.enable(dir, dir);
+    REQUIRE(resumed.use_file(f1));
+    auto f3 = resumed.add_file("content 3");
+    REQUIRE(f3 != f1);
+    REQUIRE(f3 != f2);
+
+    std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("State Emitter 1", "[executor]")
+{
+    static std::mutex         emitted_mutex;
+    static std::set<uint64_t> emitted;
+
+    const uint8_t code[] = "\xC3"; // ret
+
+    auto state = get_state_executing(get_x86_64_lifter(), code, sizeof(code));
+    auto sym   = exprBuilder.mk_sym("emit_sym", 32);
+
+    g_config.emit_workers    = 2;
+    g_config.emit_queue_size = 2;
+    executor::StateEmitter emitter;
+    emitter.start([](state::StatePtr s, uint64_t index) {
+        std::lock_guard<std::mutex> lock(emitted_mutex);
+        emitted.insert(index);
+    });
+
+    // the odd states are unsatisfiable, they are not emitted
+    for (uint32_t i = 0; i < 16; ++i) {
+        auto s = state->clone();
+        s->solver().add(exprBuilder.mk_eq(sym, exprBuilder.mk_const(i, 32)));
+        if (i % 2)
+            s->solver().add(
+                exprBuilder.mk_neq(sym, exprBuilder.mk_const(i, 32)));
+        emitter.push(s);
+    }
+    emitter.finish();
+    g_config.emit_workers    = 0;
+    g_config.emit_queue_size = 64;
+
+    REQUIRE(emitter.next_index() == 8);
+    REQUIRE(emitted == std::set<uint64_t>{0, 1, 2, 3, 4, 5, 6, 7});
+}
+
+TEST_CASE("Edge Coverage 1", "[executor]")
+{
+    const uint8_t code[] = "\x83\xFF\x0A" // 0x400000:    cmp edi, 0xa
+                           "\x73\x01"     // 0x400003:    jae OUT
+                           "\x90"         // 0x400005:    nop
+                                          //         OUT:
+                           "\xC3";        // 0x400006:    ret
+
+    auto state = get_state_executing(get_x86_64_lifter(), code, sizeof(code));
+    auto sym   = exprBuilder.mk_sym("sym", 32);
+    state->reg_write("EDI", sym);
+    auto again = state->clone();
+
+    executor::EdgeCoverage  coverage;
+    executor::PCodeExecutor executor(get_x86_64_lifter());
+    executor.set_coverage(&coverage);
+
+    // the new edge is marked only when a state that traversed it is known
+    // to be satisfiable, the successors carry it
+    uint64_t edge = executor::EdgeCoverage::edge(
+        state->prev_location(), executor::EdgeCoverage::block_id(0x400000));
+    auto successors = executor.execute_basic_block(state).active;
+    REQUIRE(successors.size() == 2);
+    REQUIRE(successors.at(0)->new_edges().contains(edge));
+    REQUIRE(successors.at(1)->new_edges().contains(edge));
+    REQUIRE(coverage.num_edges() == 0);
+    REQUIRE(coverage.blocks().at(0x400000) == 5);
+
+    REQUIRE(coverage.hit(edge));
+    successors = executor.execute_basic_block(again).active;
+    REQUIRE(successors.size() == 2);
+    REQUIRE(successors.at(0)->new_edges().empty());
+    REQUIRE(successors.at(1)->new_edges().empty());
+    REQUIRE(coverage.num_edges() == 1);
+
+    auto path = std::filesystem::temp_directory_path() / "naaz_test.drcov";
+    coverage.write_drcov(path, *state->address_space(), "test");
+    std::ifstream in(path, std::ios::binary);
+    std::string   line;
+    std::getline(in, line);
+    REQUIRE(line == "DRCOV VERSION: 2");
+    while (std::getline(in, line) && line.rfind("BB Table", 0) != 0)
+        ;
+    REQUIRE(line == "BB Table: 1 bbs");
+    in.close();
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("Edge Coverage Lazy 1", "[executor]")
+{
+    static uint64_t num_emitted;
+
+    const uint8_t code[] = "\x83\xFF\x05"         // 0x400000:    cmp edi, 5
+                           "\x73\x11"             // 0x400003:    jae OUT
+                           "\x83\xFF\x0A"         // 0x400005:    cmp edi, 10
+                           "\x73\x06"             // 0x400008:    jae DEAD
+                           "\xB8\x01\x00\x00\x00" // 0x40000a:    mov eax, 1
+                           "\xC3"                 // 0x40000f:    ret
+                                                  //        DEAD:
+                           "\xB8\x02\x00\x00\x00" // 0x400010:    mov eax, 2
+                           "\xC3"                 // 0x400015:    ret
+                                                  //         OUT:
+                           "\xB8\x03\x00\x00\x00" // 0x400016:    mov eax, 3
+                           "\xC3";                // 0x40001b:    ret
+
+    auto state = get_state_executing(get_x86_64_lifter(), code, sizeof(code));
+    auto sym   = exprBuilder.mk_sym("sym", 32);
+    state->reg_write("EDI", sym);
+
+    // DEAD is an infeasible pending child (edi < 5 and edi >= 10), it is
+    // executed but it does not take the credit of its edge
+    bool lazy_solving               = g_config.lazy_solving;
+    g_config.lazy_solving           = true;
+    g_config.emit_new_coverage_only = true;
+    num_emitted                     = 0;
+    executor::BFSExecutorManager em(state);
+    em.gen_paths([](state::StatePtr s, uint64_t index) { num_emitted++; });
+    g_config.lazy_solving           = lazy_solving;
+    g_config.emit_new_coverage_only = false;
+
+    using executor::EdgeCoverage;
+    auto edge = [](uint64_t from, uint64_t to) {
+        return EdgeCoverage::edge(
+            EdgeCoverage::prev_location(EdgeCoverage::block_id(from)),
+            EdgeCoverage::block_id(to));
+    };
+    REQUIRE(em.coverage().seen(edge(0x400000, 0x400016)));
+    REQUIRE(em.coverage().seen(edge(0x400005, 0x40000a)));
+    REQUIRE(!em.coverage().seen(edge(0x400005, 0x400010)));
+    REQUIRE(num_emitted == 2);
+
+    // without emit_new_coverage_only, the coverage is tracked on request
+    g_config.lazy_solving = true;
+    state = get_state_executing(get_x86_64_lifter(), code, sizeof(code));
+    state->reg_write("EDI", sym);
+    executor::BFSExecutorManager em_untracked(state);
+    em_untracked.gen_paths([](state::StatePtr s, uint64_t index) {});
+    REQUIRE(em_untracked.coverage().num_edges() == 0);
+
+    state = get_state_executing(get_x86_64_lifter(), code, sizeof(code));
+    state->reg_write("EDI", sym);
+    num_emitted = 0;
+    executor::BFSExecutorManager em_tracked(state);
+    em_tracked.track_coverage();
+    em_tracked.gen_paths(
+        [](state::StatePtr s, uint64_t index) { num_emitted++; });
+    g_config.lazy_solving = lazy_solving;
+    REQUIRE(em_tracked.coverage().seen(edge(0x400005, 0x40000a)));
+    REQUIRE(!em_tracked.coverage().seen(edge(0x400005, 0x400010)));
+    REQUIRE(num_emitted == 2);
+}
+
+TEST_CASE("Explore Hook 1", "[executor]")
+{
+    const uint8_t code[] = "\x31\xC0"             // 0x400000:    xor eax, eax
+                                                  //           L:
+                           "\x83\xFF\x0A"         // 0x400002:    cmp edi, 0xa
+                           "\x73\x06"             // 0x400005:    jae OUT
+                           "\xFF\xC0"             // 0x400007:    inc eax
+                           "\xFF\xC7"             // 0x400009:    inc edi
+                           "\xEB\xF5"             // 0x40000b:    jmp L
+                                                  //         OUT:
+                           "\x83\xF8\x07"         // 0x40000d:    cmp eax, 7
+                           "\x75\x05"             // 0x400010:    jne RET
+                           "\xB8\x2A\x00\x00\x00" // 0x400012:    mov eax, 42
+                                                  //         RET:
+                           "\xC3";                // 0x400017:    ret
+
+    auto state = get_state_executing(get_x86_64_lifter(), code, sizeof(code));
+    auto sym   = exprBuilder.mk_sym("sym", 32);
+    state->reg_write("EDI", sym);
+
+    // skip the code after OUT
+    int                n_calls  = 0;
+    auto               alive    = std::make_shared<int>(0);
+    std::weak_ptr<int> captured = alive;
+    state->hook(0x40000d, "skip_out",
+                [&n_calls, alive](state::StatePtr           s,
+                                  executor::ExecutorResult& o) {
+                    n_calls++;
+                    s->reg_write("EAX", exprBuilder.mk_const(43, 32));
+                    s->set_pc(0x400017);
+                    o.active.push_back(s);
+                });
+
+    executor::BFSExecutorManager em(state);
+
+    std::vector<uint64_t> find;
+    find.push_back(0x400017);
+    std::vector<uint64_t> avoid;
+    avoid.push_back(0x400012);
+    std::optional<state::StatePtr> s = em.explore(find, avoid);
+
+    REQUIRE(s.has_value());
+    REQUIRE(n_calls == 1);
+    REQUIRE(s.value()->reg_read("EAX") == exprBuilder.mk_const(43, 32));
+    REQUIRE(s.value()->is_linked_function(0x40000d));
+    // the targets are not in the hooks shared by the states
+    REQUIRE(state->hooks()->lookup(0x400012) == nullptr);
+    REQUIRE(state->hooks()->lookup(0x400017) == nullptr);
+
+    // the callback is released by unhook
+    alive = nullptr;
+    REQUIRE(!captured.expired());
+    state->unhook(0x40000d);
+    REQUIRE(!s.value()->is_linked_function(0x40000d));
+    REQUIRE(captured.expired());
+}
+
+TEST_CASE("Job Server 1", "[executor]")
+{
+    static const uint8_t code[] =
+        "\x31\xC0"             // 0x400000:    xor eax, eax
+                               //           L:
+        "\x83\xFF\x0A"         // 0x400002:    cmp edi, 0xa
+        "\x73\x06"             // 0x400005:    jae OUT
+        "\xFF\xC0"             // 0x400007:    inc eax
+        "\xFF\xC7"             // 0x400009:    inc edi
+        "\xEB\xF5"             // 0x40000b:    jmp L
+                               //         OUT:
+        "\x83\xF8\x07"         // 0x40000d:    cmp eax, 7
+        "\x75\x05"             // 0x400010:    jne RET
+        "\xB8\x2A\x00\x00\x00" // 0x400012:    mov eax, 42
+                               //         RET:
+        "\xC3";                // 0x400017:    ret
+
+    // every binary is the code above, with a symbolic EDI
+    executor::JobServer server([](const std::string& binary, bool* o_cached) {
+        static bool loaded = false;
+        *o_cached          = loaded;
+        loaded             = true;
+
+        auto state =
+            get_state_executing(get_x86_64_lifter(), code, sizeof(code));
+        state->reg_write("EDI", exprBuilder.mk_sym("job_sym", 32));
+        return state;
+    });
+
+    auto outdir = std::filesystem::temp_directory_path() / "naaz_job_test";
+    std::filesystem::remove_all(outdir);
+
+    // send the job on a socket and read the answer
+    auto run = [&server](const nlohmann::json& req) {
+        int fds[2];
+        REQUIRE(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+        std::string line = req.dump() + "\n";
+        REQUIRE(write(fds[0], line.data(), line.size()) ==
+                (ssize_t)line.size());
+        server.serve(fds[1], 7, executor::JobServer::clock_type::now());
+
+        std::string res;
+        char        buf[4096];
+        ssize_t     n;
+        while ((n = read(fds[0], buf, sizeof(buf))) > 0)
+            res.append(buf, n);
+        close(fds[0]);
+        REQUIRE(res.ends_with("\n"));
+        return nlohmann::json::parse(res);
+    };
+
+    nlohmann::json req = {{"type", "find"},
+                          {"binary", "code"},
+                          {"find", {"0x400012"}},
+                          {"avoid", {0x400017}},
+                          {"technique", "bfs"},
+                          {"output", outdir.string()}};
+    auto res = run(req);
+    REQUIRE(res["status"] == "ok");
+    REQUIRE(res["id"] == 7);
+    REQUIRE(res["found"] == true);
+    REQUIRE(res["cached"] == false);
+    REQUIRE(res["timing"].contains("explore_ms"));
+
+    // the second job reuses the binary
+    res = run(req);
+    REQUIRE(res["status"] == "ok");
+    REQUIRE(res["cached"] == true);
+
+    // an engine failure (an invalid argv directive) fails only the job
+    set_fail_throws(true);
+    req["args"] = {"@@:bad:4"};
+    res         = run(req);
+    set_fail_throws(false);
+    REQUIRE(res["status"] == "error");
+
+    req["type"] = "unknown";
+    REQUIRE(run(req)["status"] == "error");
+
+    std::filesystem::remove_all(outdir);
+}
+
+TEST_CASE("String Summary 1", "[executor]")
+{
+    const uint8_t code[] = "\xC3"; // ret
+
+    auto state = get_state_executing(get_x86_64_lifter(), code, sizeof(code));
+    auto sym   = exprBuilder.mk_sym("str_sym", 8);
+    state->write(0x1000, exprBuilder.mk_const(0x41, 8));
+    state->write(0x1001, sym);
+    state->write(0x1002, exprBuilder.mk_const(0x43, 8));
+    state->write(0x1003, exprBuilder.mk_const(0, 8));
+
+    // a single expression, no forks
+    auto len = models::libc::strlen_expr(state, 0x1000, 64);
+    auto c1  = state->clone();
+    c1->solver().add(exprBuilder.mk_eq(sym, exprBuilder.mk_const(0, 8)));
+    REQUIRE(c1->solver().evaluate(len).value().as_u64() == 1);
+    auto c2 = state->clone();
+    c2->solver().add(exprBuilder.mk_neq(sym, exprBuilder.mk_const(0, 8)));
+    REQUIRE(c2->solver().evaluate(len).value().as_u64() == 3);
+
+    // only the symbolic bytes are bounded
+    for (uint64_t i = 0; i < 300; ++i)
+        state->write(0x3000 + i, exprBuilder.mk_const(0x41, 8));
+    state->write(0x3000 + 300, exprBuilder.mk_const(0, 8));
+    REQUIRE(models::libc::strlen_expr(state, 0x3000, 64, 16) ==
+            exprBuilder.mk_const(300, 64));
+    // the uninitialized bytes are symbolic, there are too many of them
+    REQUIRE(models::libc::strlen_expr(state, 0x5000, 64, 16) == nullptr);
+
+    std::vector<expr::BVExprPtr> s1 = {exprBuilder.mk_const(0x41, 8), sym};
+    std::vector<expr::BVExprPtr> s2 = {exprBuilder.mk_const(0x41, 8),
+                                       exprBuilder.mk_const(0x42, 8)};
+    auto cmp = models::libc::compare_bytes_expr(s1, s2, true, 32);
+    c1->solver().add(exprBuilder.mk_eq(cmp, exprBuilder.mk_const(0, 32)));
+    REQUIRE(c1->satisfiable() == solver::CheckResult::UNSAT);
+    c2->solver().add(exprBuilder.mk_eq(cmp, exprBuilder.mk_const(0, 32)));
+    REQUIRE(c2->solver().evaluate(sym).value().as_u64() == 0x42);
+}
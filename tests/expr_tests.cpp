@@ -1,8 +1,10 @@
 #include <catch2/catch_all.hpp>
+#include <sstream>
 
 #include "../util/ioutil.hpp"
 #include "../expr/Expr.hpp"
 #include "../expr/ExprBuilder.hpp"
+#include "../expr/ExprSerializer.hpp"
 #include "../expr/util.hpp"
 
 using namespace naaz::expr;
@@ -297,3 +299,211 @@ TEST_CASE("fp_to_bv 1", "[expr]")
 
     REQUIRE(bv->to_string() == "0x404535c28f5c28f6");
 }
+
+TEST_CASE("Linear Form 1", "[expr]")
+{
+    BVExprPtr s1 = exprBuilder.mk_sym("sym1", 32);
+    BVExprPtr s2 = exprBuilder.mk_sym("sym2", 32);
+
+    // (sym1 + 4) * 2 + sym2 - sym1 == sym1 + sym2 + 8
+    BVExprPtr e1 = exprBuilder.mk_sub(
+        exprBuilder.mk_add(
+            exprBuilder.mk_mul(
+                exprBuilder.mk_add(s1, exprBuilder.mk_const(4, 32)),
+                exprBuilder.mk_const(2, 32)),
+            s2),
+        s1);
+    BVExprPtr e2 = exprBuilder.mk_add(
+        exprBuilder.mk_add(s2, exprBuilder.mk_const(8, 32)), s1);
+    REQUIRE(e1 == e2);
+
+    // sym1 * 3 - sym1 * 3 == 0
+    BVExprPtr e3 =
+        exprBuilder.mk_sub(exprBuilder.mk_mul(s1, exprBuilder.mk_const(3, 32)),
+                           exprBuilder.mk_add(s1, exprBuilder.mk_add(s1, s1)));
+    REQUIRE(e3 == exprBuilder.mk_const(0, 32));
+
+    auto lf = exprBuilder.linear_form(e1);
+    REQUIRE(lf.terms.size() == 2);
+    REQUIRE(lf.terms.at(0).first == s1);
+    REQUIRE(lf.terms.at(1).first == s2);
+    REQUIRE(lf.constant.as_u64() == 8);
+}
+
+TEST_CASE("Linear Form 2", "[expr]")
+{
+    BVExprPtr s1 = exprBuilder.mk_sym("sym1", 32);
+    BVExprPtr s2 = exprBuilder.mk_sym("sym2", 32);
+
+    // the operands are sorted by creation order, constants last
+    REQUIRE(exprBuilder.mk_add(exprBuilder.mk_const(42, 32), s2)->to_string() ==
+            "( sym2 + 0x2a )");
+    REQUIRE(exprBuilder.mk_and(s2, s1) == exprBuilder.mk_and(s1, s2));
+    REQUIRE(exprBuilder.mk_eq(s2, s1) == exprBuilder.mk_eq(s1, s2));
+
+    // sym1 + 3 == 10 => sym1 == 7
+    BoolExprPtr e1 = exprBuilder.mk_eq(
+        exprBuilder.mk_add(s1, exprBuilder.mk_const(3, 32)),
+        exprBuilder.mk_const(10, 32));
+    REQUIRE(e1 == exprBuilder.mk_eq(s1, exprBuilder.mk_const(7, 32)));
+
+    // sym1 - sym2 == 0 => sym1 == sym2
+    BoolExprPtr e2 = exprBuilder.mk_eq(exprBuilder.mk_sub(s1, s2),
+                                       exprBuilder.mk_const(0, 32));
+    REQUIRE(e2 == exprBuilder.mk_eq(s2, s1));
+}
+
+TEST_CASE("Split Base Offset 1", "[expr]")
+{
+    BVExprPtr s = exprBuilder.mk_sym("sym", 32);
+    BVExprPtr e = exprBuilder.mk_sub(
+        exprBuilder.mk_add(s, exprBuilder.mk_const(0x20, 32)),
+        exprBuilder.mk_const(0x8, 32));
+
+    auto [base, offset] = split_base_offset(e);
+    REQUIRE(base == s);
+    REQUIRE(offset.as_u64() == 0x18);
+}
+
+TEST_CASE("Array Read 1", "[expr]")
+{
+    BVExprPtr i = exprBuilder.mk_sym("idx", 64);
+    BVExprPtr v = exprBuilder.mk_sym("val", 8);
+
+    ArrayUpdatePtr updates = nullptr;
+    for (uint64_t a = 0x100; a < 0x110; ++a)
+        updates = exprBuilder.mk_array_update(
+            updates, exprBuilder.mk_const(a, 64), exprBuilder.mk_const(a, 8));
+    updates = exprBuilder.mk_array_update(updates, i, v);
+
+    // read-over-write
+    BVExprPtr e1 = exprBuilder.mk_array_read(updates, i);
+    REQUIRE(e1 == v);
+    BVExprPtr e2 = exprBuilder.mk_array_read(
+        updates, exprBuilder.mk_add(i, exprBuilder.mk_const(1, 64)));
+    REQUIRE(e2->kind() == Expr::Kind::ARRAY_READ);
+    auto e2_ = std::static_pointer_cast<const ArrayReadExpr>(e2);
+    REQUIRE(e2_->updates()->length() == 16);
+
+    // concrete indexes
+    updates = exprBuilder.mk_array_update(
+        updates, exprBuilder.mk_const(0x104, 64), exprBuilder.mk_const(0, 8));
+    BVExprPtr e3 =
+        exprBuilder.mk_array_read(updates, exprBuilder.mk_const(0x104, 64));
+    REQUIRE(e3 == exprBuilder.mk_const(0, 8));
+
+    std::map<uint32_t, BVConst> model = {
+        {exprBuilder.get_sym_id("idx"), BVConst(0x108UL, 64)},
+        {exprBuilder.get_sym_id("val"), BVConst(0x42UL, 8)}};
+    auto e4 = evaluate(exprBuilder.mk_array_read(
+                           updates, exprBuilder.mk_const(0x108, 64)),
+                       model);
+    REQUIRE(e4 == exprBuilder.mk_const(0x42, 8));
+    auto e5 = evaluate(e2, model);
+    REQUIRE(e5 == exprBuilder.mk_const(0x109, 8));
+}
+
+TEST_CASE("Array Base 1", "[expr]")
+{
+    SymExprPtr base = exprBuilder.mk_sym("array_base[]", 8);
+    BVExprPtr  i    = exprBuilder.mk_sym("array_base_idx", 64);
+
+    ArrayUpdatePtr updates = exprBuilder.mk_array_update(
+        exprBuilder.mk_array_base(base, 64), exprBuilder.mk_const(0x10, 64),
+        exprBuilder.mk_const(0x20, 8));
+    REQUIRE(updates->length() == 1);
+    REQUIRE(updates->base() == base);
+
+    // the unwritten bytes are reads of the base
+    BVExprPtr e1 =
+        exprBuilder.mk_array_read(updates, exprBuilder.mk_const(0x11, 64));
+    REQUIRE(e1->kind() == Expr::Kind::ARRAY_READ);
+    REQUIRE(std::static_pointer_cast<const ArrayReadExpr>(e1)
+                ->updates()
+                ->is_base());
+
+    // the model has the values of the base at the read indexes
+    BVExprPtr                   e2    = exprBuilder.mk_array_read(updates, i);
+    std::map<uint32_t, BVConst> model = {
+        {exprBuilder.get_sym_id("array_base_idx"), BVConst(0x11UL, 64)},
+        {array_base_value(base, 0x11)->id(), BVConst(0x33UL, 8)}};
+    REQUIRE(evaluate(e1, model) == exprBuilder.mk_const(0x33, 8));
+    REQUIRE(evaluate(e2, model) == exprBuilder.mk_const(0x33, 8));
+    REQUIRE(evaluate(exprBuilder.mk_array_read(
+                         updates, exprBuilder.mk_const(0x12, 64)),
+                     model, true) == exprBuilder.mk_const(0, 8));
+
+    std::stringstream ss;
+    {
+        ExprWriter w(ss);
+        w.write_expr(e2);
+        w.write_updates(updates);
+    }
+    ExprReader r(ss, [](int32_t size) { return nullptr; });
+    auto       e2_ = r.read_bv_expr();
+    REQUIRE(e2_->kind() == Expr::Kind::ARRAY_READ);
+    REQUIRE(std::static_pointer_cast<const ArrayReadExpr>(e2_)
+                ->updates()
+                ->base() == base);
+    REQUIRE(r.read_updates()->base() == base);
+}
+
+TEST_CASE("Serialize Expr 1", "[expr]")
+{
+    BVExprPtr x = exprBuilder.mk_sym("ser_x", 32);
+    BVExprPtr y = exprBuilder.mk_sym("ser_y", 64);
+
+    BVExprPtr e1 = exprBuilder.mk_add(x, exprBuilder.mk_const(0x42, 32));
+    BVExprPtr e2 = exprBuilder.mk_concat(e1, exprBuilder.mk_extract(y, 47, 16));
+    BVExprPtr e3 = exprBuilder.mk_ite(exprBuilder.mk_ult(e1, x), e2,
+                                      exprBuilder.mk_zext(e1, 64));
+
+    BoolExprPtr c = exprBuilder.mk_not(exprBuilder.mk_eq(e3, y));
+    BVConst     big("0x123456789abcdef0123456789abcdef", 128);
+
+    ArrayUpdatePtr updates = exprBuilder.mk_array_update(
+        nullptr, y, exprBuilder.mk_extract(x, 7, 0));
+    BVExprPtr e4 = exprBuilder.mk_array_read(
+        updates, exprBuilder.mk_add(y, exprBuilder.mk_const(1, 64)));
+
+    std::stringstream ss;
+    {
+        ExprWriter w(ss);
+        w.write_expr(e3);
+        w.write_expr(c);
+        w.write_uint(0xdeadbeefUL);
+        w.write_const(big);
+        w.write_str("ser_str");
+        w.write_expr(e4);
+        w.write_updates(nullptr);
+        // already written, only a reference
+        w.write_expr(e1);
+    }
+
+    size_t size_with_sharing = ss.str().size();
+
+    ExprReader r(ss, [](int32_t size) { return nullptr; });
+    REQUIRE(r.read_bv_expr() == e3);
+    REQUIRE(r.read_bool_expr() == c);
+    REQUIRE(r.read_uint() == 0xdeadbeefUL);
+    REQUIRE(r.read_const().eq(big));
+    REQUIRE(r.read_str() == "ser_str");
+    REQUIRE(r.read_bv_expr() == e4);
+    REQUIRE(r.read_updates() == nullptr);
+    REQUIRE(r.read_bv_expr() == e1);
+
+    // the shared subexpressions are written once
+    std::stringstream ss2;
+    {
+        ExprWriter w(ss2);
+        w.write_expr(e1);
+    }
+    std::stringstream ss3;
+    {
+        ExprWriter w(ss3);
+        w.write_expr(e1);
+        w.write_expr(e1);
+    }
+    REQUIRE(ss3.str().size() == ss2.str().size() + 2);
+    REQUIRE(size_with_sharing > ss2.str().size());
+}
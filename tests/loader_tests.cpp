@@ -0,0 +1,150 @@
+#include <catch2/catch_all.hpp>
+#include <memory>
+#include <thread>
+
+#include "../loader/AddressSpace.hpp"
+#include "../util/strutil.hpp"
+
+using namespace naaz;
+using namespace naaz::loader;
+
+TEST_CASE("AddressSpace Read 1", "[loader]")
+{
+    AddressSpace as;
+    uint8_t      text[] = {0x01, 0x02, 0x03, 0x04};
+    uint8_t      data[] = {0x05, 0x06, 0x07, 0x08, 0x09};
+    as.register_segment(".text", 0x1000, text, sizeof(text), PERM_READ);
+    as.register_segment(".data", 0x1004, data, sizeof(data), PERM_READ);
+
+    REQUIRE(as.read_byte(0x1003).value() == 0x04);
+    REQUIRE(as.read_byte(0x1004).value() == 0x05);
+    REQUIRE(!as.read_byte(0x1009).has_value());
+    REQUIRE(!as.read_byte(0xfff).has_value());
+
+    // the reads can cross adjacent segments
+    REQUIRE(as.read_qword(0x1000).value() == 0x0807060504030201UL);
+    REQUIRE(as.read_qword(0x1000, Endianess::BIG).value() ==
+            0x0102030405060708UL);
+    REQUIRE(as.read_dword(0x1002).value() == 0x06050403);
+    REQUIRE(!as.read_qword(0x1002).has_value());
+
+    uint8_t buf[3];
+    REQUIRE(as.read(0x1003, buf, sizeof(buf)));
+    REQUIRE(buf[0] == 0x04);
+    REQUIRE(buf[2] == 0x06);
+
+    REQUIRE(as.get_segment(0x1002)->name() == ".text");
+    REQUIRE(as.get_segment(0x1008)->name() == ".data");
+    REQUIRE(as.get_segment(0x2000) == nullptr);
+}
+
+TEST_CASE("AddressSpace Overlap 1", "[loader]")
+{
+    // the first registered segment wins
+    AddressSpace as;
+    as.register_segment("a", 0x1008, std::vector<uint8_t>(8, 0xaa), PERM_READ);
+    as.register_segment("b", 0x1000, std::vector<uint8_t>(32, 0xbb),
+                        PERM_READ);
+
+    REQUIRE(as.read_byte(0x1007).value() == 0xbb);
+    REQUIRE(as.read_byte(0x1008).value() == 0xaa);
+    REQUIRE(as.read_byte(0x100f).value() == 0xaa);
+    REQUIRE(as.read_byte(0x1010).value() == 0xbb);
+    REQUIRE(as.read_word(0x1007).value() == 0xaabb);
+    REQUIRE(as.get_segment(0x101f)->name() == "b");
+}
+
+TEST_CASE("AddressSpace Mapped Segment 1", "[loader]")
+{
+    // the segment references the buffer until a writable reference is taken
+    std::shared_ptr<uint8_t[]>     buf(new uint8_t[4]{0x01, 0x02, 0x03, 0x04});
+    std::shared_ptr<const uint8_t> data(buf, buf.get() + 1);
+
+    AddressSpace as;
+    Segment&     seg =
+        as.register_segment(".rodata", 0x1000, data, 3, PERM_READ);
+    REQUIRE(seg.is_mapped());
+    REQUIRE(as.read_word(0x1001).value() == 0x0403);
+
+    const uint8_t* ref;
+    size_t         ref_size;
+    REQUIRE(as.get_ref(0x1001, &ref, &ref_size));
+    REQUIRE(ref == buf.get() + 2);
+    REQUIRE(ref_size == 2);
+
+    uint8_t* mut_ref;
+    REQUIRE(seg.get_ref(0x1000, &mut_ref, &ref_size));
+    REQUIRE(!seg.is_mapped());
+    mut_ref[0] = 0xff;
+    REQUIRE(as.read_byte(0x1000).value() == 0xff);
+    REQUIRE(buf[1] == 0x02);
+}
+
+TEST_CASE("AddressSpace Zero Segment 1", "[loader]")
+{
+    // the content of a .bss-like segment is allocated on the first write
+    AddressSpace as;
+    Segment&     seg = as.register_segment(".bss", 0x2000, 0x10000, PERM_READ);
+    REQUIRE(seg.data() == nullptr);
+    REQUIRE(as.read_qword(0x2ff8).value() == 0);
+
+    const uint8_t* ref;
+    size_t         ref_size;
+    REQUIRE(as.get_ref(0x2000, &ref, &ref_size));
+    REQUIRE(ref[ref_size - 1] == 0);
+    REQUIRE(seg.data() == nullptr);
+
+    // the threads that race for the first writable reference get the same
+    // copy
+    std::vector<uint8_t*>    refs(4);
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < refs.size(); ++i)
+        threads.emplace_back([&, i]() {
+            size_t size;
+            seg.get_ref(0x2000, &refs[i], &size);
+        });
+    for (auto& t : threads)
+        t.join();
+    for (auto r : refs)
+        REQUIRE(r == refs[0]);
+
+    refs[0][8] = 0xaa;
+    REQUIRE(as.read_byte(0x2008).value() == 0xaa);
+    REQUIRE(as.read_byte(0x2009).value() == 0);
+}
+
+TEST_CASE("AddressSpace Lookup Benchmark", "[.][benchmark]")
+{
+    // the layout of a binary with many sections
+    AddressSpace as;
+    uint64_t     addr = 0x400000;
+    for (int i = 0; i < 48; ++i) {
+        size_t size = 0x40 + (i % 7) * 0x180;
+        as.register_segment(string_format(".sec%d", i), addr,
+                            std::vector<uint8_t>(size, i), PERM_READ);
+        addr += size + (i % 3) * 0x10;
+    }
+    uint64_t end = addr;
+
+    BENCHMARK("read_byte")
+    {
+        uint64_t sum = 0;
+        for (uint64_t a = 0x400000; a < end; ++a)
+            sum += as.read_byte(a).value_or(0);
+        return sum;
+    };
+    BENCHMARK("read_qword")
+    {
+        uint64_t sum = 0;
+        for (uint64_t a = 0x400000; a + 8 <= end; a += 8)
+            sum += as.read_qword(a).value_or(0);
+        return sum;
+    };
+    BENCHMARK("get_segment (strided)")
+    {
+        uint64_t n = 0;
+        for (uint64_t a = 0x400000; a < end; a += 0x97)
+            n += as.get_segment(a) != nullptr;
+        return n;
+    };
+}
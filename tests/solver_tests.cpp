@@ -1,9 +1,14 @@
 #include <catch2/catch_all.hpp>
+#include <filesystem>
+#include <unistd.h>
 
 #include "../expr/Expr.hpp"
 #include "../expr/ExprBuilder.hpp"
+#include "../expr/util.hpp"
 #include "../solver/ConstraintManager.hpp"
+#include "../solver/QueryLog.hpp"
 #include "../solver/Z3Solver.hpp"
+#include "../util/stats.hpp"
 
 using namespace naaz::solver;
 using namespace naaz::expr;
@@ -39,6 +44,131 @@ TEST_CASE("ConstraintManager constuctor 1", "[solver]")
 
     REQUIRE(query1 == expected1);
     REQUIRE(query2 == expected2);
+
+    // the conjuncts are in creation order, not in address order
+    auto pi1 = std::static_pointer_cast<const BoolAndExpr>(manager.pi(sym1));
+    REQUIRE(pi1->exprs().size() == 2);
+    REQUIRE(pi1->exprs().at(0) == exprBuilder.mk_sgt(sym1, sym2));
+    REQUIRE(pi1->exprs().at(1) == exprBuilder.mk_sgt(sym2, sym3));
+}
+
+TEST_CASE("ConstraintManager pi 1", "[solver]")
+{
+    ConstraintManager manager;
+
+    auto sym1 = exprBuilder.mk_sym("sym1", 32);
+    auto sym2 = exprBuilder.mk_sym("sym2", 32);
+    auto sym3 = exprBuilder.mk_sym("sym3", 32);
+
+    REQUIRE(manager.pi() == exprBuilder.mk_true());
+
+    auto c1 = exprBuilder.mk_sgt(sym1, sym2);
+    auto c2 = exprBuilder.mk_sgt(sym2, sym3);
+    auto c3 = exprBuilder.mk_sgt(sym3, exprBuilder.mk_const(10, 32));
+
+    manager.add(c1);
+    REQUIRE(manager.pi() == c1);
+
+    manager.add(c2);
+    manager.add(c3);
+    manager.add(c2);
+
+    // the cached conjunction is extended, not rebuilt
+    auto expected = exprBuilder.mk_bool_and_no_simpl(
+        {exprBuilder.mk_bool_and_no_simpl({c1, c2}), c3});
+    REQUIRE(manager.pi() == expected);
+
+    std::vector<BoolExprPtr> conjuncts = {c3, c1, c2, c1,
+                                          exprBuilder.mk_true()};
+    auto flat = exprBuilder.mk_bool_and(exprBuilder.mk_bool_and(c1, c2), c3);
+    REQUIRE(exprBuilder.mk_bool_and(conjuncts) == flat);
+
+    // a manager that never built pi() builds it with a single n-ary call
+    ConstraintManager fresh;
+    fresh.add(c1);
+    fresh.add(c2);
+    fresh.add(c3);
+    REQUIRE(fresh.pi() == flat);
+
+    ConstraintManager other(manager);
+    REQUIRE(other.pi() == expected);
+
+    auto c4 = exprBuilder.mk_sgt(sym1, exprBuilder.mk_const(20, 32));
+    other.add(c4);
+    REQUIRE(other.pi() == exprBuilder.mk_bool_and_no_simpl({expected, c4}));
+    REQUIRE(manager.pi() == expected);
+
+    REQUIRE(Z3Solver::The().check(other.pi()) == CheckResult::SAT);
+    other.add(exprBuilder.mk_sgt(exprBuilder.mk_const(5, 32), sym3));
+    REQUIRE(Z3Solver::The().check(other.pi()) == CheckResult::UNSAT);
+}
+
+TEST_CASE("ConstraintManager pi 2", "[solver]")
+{
+    auto sym = exprBuilder.mk_sym("sym_pi_deep", 32);
+
+    // a long path, with pi() extended after every constraint
+    std::map<uint32_t, naaz::expr::BVConst> model;
+    model.emplace(sym->id(), naaz::expr::BVConst(100000, 32));
+    {
+        ConstraintManager manager;
+        manager.pi();
+        for (uint64_t i = 0; i < 20000; ++i) {
+            manager.add(exprBuilder.mk_ult(exprBuilder.mk_const(i, 32), sym));
+            manager.pi();
+        }
+
+        // the nesting of the conjunctions stays bounded
+        uint32_t    depth = 0;
+        BoolExprPtr pi    = manager.pi();
+        while (pi->kind() == Expr::Kind::BOOL_AND) {
+            pi = std::static_pointer_cast<const BoolAndExpr>(pi)->exprs().at(0);
+            depth++;
+        }
+        REQUIRE(depth <= 65);
+
+        REQUIRE(naaz::expr::evaluate(manager.pi(), model, true) ==
+                exprBuilder.mk_true());
+    }
+
+    // a chain that is not flattened is evaluated and released without
+    // recursion
+    BoolExprPtr chain = exprBuilder.mk_true();
+    for (uint64_t i = 0; i < 100000; ++i)
+        chain = exprBuilder.mk_bool_and_no_simpl(
+            {chain, exprBuilder.mk_ult(exprBuilder.mk_const(i, 32), sym)});
+    REQUIRE(naaz::expr::evaluate(chain, model, true) == exprBuilder.mk_true());
+    chain = nullptr;
+}
+
+TEST_CASE("ConstraintManager garbage 1", "[solver]")
+{
+    WeakExprPtr constraint;
+    WeakExprPtr sym;
+    uint32_t    id;
+    {
+        ConstraintManager manager;
+
+        auto s = exprBuilder.mk_sym("sym_garbage", 32);
+        auto c = exprBuilder.mk_ugt(
+            exprBuilder.mk_add(s, exprBuilder.mk_const(1, 32)),
+            exprBuilder.mk_const(3, 32));
+        manager.add(c);
+        constraint = c;
+        sym        = s;
+        id         = s->id();
+    }
+
+    // the involved symbols cache keeps the constraint alive
+    REQUIRE(!constraint.expired());
+    ConstraintManager::collect_garbage();
+    REQUIRE(constraint.expired());
+    REQUIRE(sym.expired());
+
+    // the symbol is rebuilt with its id
+    REQUIRE(exprBuilder.mk_sym("sym_garbage", 32)->id() == id);
+    REQUIRE(exprBuilder.get_sym(id)->size() == 32);
+    REQUIRE(exprBuilder.get_sym_id("sym_garbage") == id);
 }
 
 TEST_CASE("Z3Solver 1", "[solver]")
@@ -76,3 +206,154 @@ TEST_CASE("Z3Solver eval_upto 1", "[solver]")
     auto vals = Z3Solver::The().eval_upto(sym, manager.pi(sym), 32);
     REQUIRE(vals.size() == 16);
 }
+
+TEST_CASE("Z3Solver bounds 1", "[solver]")
+{
+    ConstraintManager manager;
+
+    auto sym  = exprBuilder.mk_sym("sym_bounds", 32);
+    auto expr =
+        exprBuilder.mk_add(exprBuilder.mk_mul(sym, exprBuilder.mk_const(4, 32)),
+                           exprBuilder.mk_const(0x1000, 32));
+
+    manager.add(exprBuilder.mk_uge(sym, exprBuilder.mk_const(3, 32)));
+    manager.add(exprBuilder.mk_ult(sym, exprBuilder.mk_const(10, 32)));
+
+    auto [min, max] = Z3Solver::The().bounds(expr, manager.pi(expr)).value();
+    REQUIRE(min == 0x100c);
+    REQUIRE(max == 0x1024);
+
+    // the range is too wide
+    REQUIRE(!Z3Solver::The().bounds(expr, manager.pi(expr), 8).has_value());
+    auto [min2, max2] =
+        Z3Solver::The().bounds(expr, manager.pi(expr), 0x18).value();
+    REQUIRE(min2 == 0x100c);
+    REQUIRE(max2 == 0x1024);
+
+    // an unconstrained value is ruled out without searching the bounds
+    auto free = exprBuilder.mk_sym("sym_bounds_free", 64);
+    REQUIRE(!Z3Solver::The()
+                 .bounds(free, exprBuilder.mk_true(), 4096)
+                 .has_value());
+}
+
+TEST_CASE("Z3Solver arrays 1", "[solver]")
+{
+    auto idx = exprBuilder.mk_sym("arrays_idx", 64);
+    auto val = exprBuilder.mk_sym("arrays_val", 8);
+
+    ArrayUpdatePtr updates = nullptr;
+    for (uint64_t i = 0; i < 4; ++i)
+        updates = exprBuilder.mk_array_update(
+            updates, exprBuilder.mk_const(i, 64), exprBuilder.mk_const(i, 8));
+    auto r1 = exprBuilder.mk_array_read(updates, idx);
+
+    // the second list extends the (already translated) first one
+    auto updates2 = exprBuilder.mk_array_update(
+        updates, exprBuilder.mk_const(2, 64), val);
+    auto r2 = exprBuilder.mk_array_read(updates2, idx);
+
+    auto q1 = exprBuilder.mk_eq(r1, exprBuilder.mk_const(2, 8));
+    REQUIRE(Z3Solver::The().check(q1) == CheckResult::SAT);
+    REQUIRE(Z3Solver::The().model()[exprBuilder.get_sym_id("arrays_idx")]
+                .as_u64() == 2);
+
+    auto q2 = exprBuilder.mk_bool_and(
+        exprBuilder.mk_bool_and(q1, exprBuilder.mk_eq(r2, val)),
+        exprBuilder.mk_eq(val, exprBuilder.mk_const(7, 8)));
+    REQUIRE(Z3Solver::The().check(q2) == CheckResult::SAT);
+
+    // the unwritten indexes are zero
+    auto q3 = exprBuilder.mk_bool_and(
+        exprBuilder.mk_ugt(idx, exprBuilder.mk_const(3, 64)),
+        exprBuilder.mk_not(
+            exprBuilder.mk_eq(r2, exprBuilder.mk_const(0, 8))));
+    REQUIRE(Z3Solver::The().check(q3) == CheckResult::UNSAT);
+}
+
+TEST_CASE("Z3Solver arrays 2", "[solver]")
+{
+    auto idx  = exprBuilder.mk_sym("arrays_base_idx", 64);
+    auto base = exprBuilder.mk_sym("arrays_base[]", 8);
+
+    // the unwritten indexes are the bytes of the symbolic base
+    auto updates = exprBuilder.mk_array_update(
+        exprBuilder.mk_array_base(base, 64), exprBuilder.mk_const(0, 64),
+        exprBuilder.mk_const(5, 8));
+    auto r  = exprBuilder.mk_array_read(updates, idx);
+    auto r9 = exprBuilder.mk_array_read(updates, exprBuilder.mk_const(9, 64));
+    REQUIRE(r9->kind() == Expr::Kind::ARRAY_READ);
+    REQUIRE(exprBuilder.mk_array_read(updates, exprBuilder.mk_const(0, 64)) ==
+            exprBuilder.mk_const(5, 8));
+
+    auto q1 = exprBuilder.mk_bool_and(
+        exprBuilder.mk_ugt(idx, exprBuilder.mk_const(0, 64)),
+        exprBuilder.mk_eq(r, exprBuilder.mk_const(0x41, 8)));
+    REQUIRE(Z3Solver::The().check(q1) == CheckResult::SAT);
+    auto model = Z3Solver::The().model();
+    REQUIRE(evaluate(r, model, true) == exprBuilder.mk_const(0x41, 8));
+    REQUIRE(evaluate(q1, model, false) == exprBuilder.mk_true());
+
+    // the concrete reads are the same bytes
+    auto q2 = exprBuilder.mk_bool_and(
+        q1, exprBuilder.mk_bool_and(
+                exprBuilder.mk_eq(idx, exprBuilder.mk_const(9, 64)),
+                exprBuilder.mk_eq(r9, exprBuilder.mk_const(0x42, 8))));
+    REQUIRE(Z3Solver::The().check(q2) == CheckResult::UNSAT);
+}
+
+TEST_CASE("Stats Histogram 1", "[solver]")
+{
+    using naaz::stats::Histogram;
+
+    // the buckets cover the durations without gaps, 8 for every power of two
+    REQUIRE(Histogram::bucket(5) == 5);
+    REQUIRE(Histogram::bucket(8) == 8);
+    REQUIRE(Histogram::bucket(1000) == Histogram::bucket(1023));
+    REQUIRE(Histogram::bucket(1023) + 1 == Histogram::bucket(1024));
+    REQUIRE(Histogram::lower_bound(Histogram::bucket(1024)) == 1024);
+    REQUIRE(Histogram::bucket(UINT64_MAX) == Histogram::NUM_BUCKETS - 1);
+
+#ifdef NAAZ_STATS
+    uint64_t before = naaz::stats::report()["phases"]["solver_check"]["count"];
+
+    auto sym = exprBuilder.mk_sym("sym_stats", 32);
+    Z3Solver::The().check(exprBuilder.mk_ugt(sym, exprBuilder.mk_const(4, 32)));
+
+    uint64_t after = naaz::stats::report()["phases"]["solver_check"]["count"];
+    REQUIRE(after == before + 1);
+#endif
+}
+
+TEST_CASE("QueryLog 1", "[solver]")
+{
+    auto dir = std::filesystem::temp_directory_path() / "naaz_query_log_test";
+    std::filesystem::remove_all(dir);
+    QueryLog::The().open(dir);
+
+    auto sym = exprBuilder.mk_sym("sym_query_log", 32);
+    {
+        QueryOriginScope origin(QueryOrigin::CBRANCH);
+        // the inner scope does not override the origin
+        QueryOriginScope inner(QueryOrigin::DUMP);
+        Z3Solver::The().check(
+            exprBuilder.mk_ult(sym, exprBuilder.mk_const(4, 32)));
+    }
+    Z3Solver::The().check(exprBuilder.mk_bool_and(
+        exprBuilder.mk_ult(sym, exprBuilder.mk_const(4, 32)),
+        exprBuilder.mk_ugt(sym, exprBuilder.mk_const(8, 32))));
+
+    auto records = QueryLog::read(
+        dir / ("queries." + std::to_string(getpid()) + ".smt2.gz"));
+    REQUIRE(records.size() == 2);
+    REQUIRE(records[0].origin == QueryOrigin::CBRANCH);
+    REQUIRE(records[0].result == "sat");
+    REQUIRE(records[0].smt2.find("sym_query_log") != std::string::npos);
+    REQUIRE(records[1].origin == QueryOrigin::OTHER);
+    REQUIRE(records[1].result == "unsat");
+
+    // the queries of the following tests are not logged
+    QueryLog::The().close();
+    REQUIRE(!QueryLog::The().enabled());
+    std::filesystem::remove_all(dir);
+}
@@ -1,12 +1,15 @@
 #include <catch2/catch_all.hpp>
 #include <memory>
+#include <sstream>
 
 #include "../arch/x86_64.hpp"
 #include "../expr/Expr.hpp"
 #include "../expr/ExprBuilder.hpp"
+#include "../expr/ExprSerializer.hpp"
 #include "../state/State.hpp"
 #include "../loader/AddressSpace.hpp"
 #include "../lifter/PCodeLifter.hpp"
+#include "../util/strutil.hpp"
 
 using namespace naaz::state;
 using namespace naaz::expr;
@@ -96,3 +99,549 @@ TEST_CASE("State Read/Write Reg 1", "[state]")
 
     REQUIRE(expr == exprBuilder.mk_extract(sym, 7, 0));
 }
+
+TEST_CASE("State Implied Values 1", "[state]")
+{
+    auto lifter = get_x86_64_lifter();
+    auto as     = std::make_shared<AddressSpace>();
+
+    State s(as, lifter, 0);
+
+    BVExprPtr b0 = exprBuilder.mk_sym("implied_b0", 8);
+    BVExprPtr b1 = exprBuilder.mk_sym("implied_b1", 8);
+    BVExprPtr x  = exprBuilder.mk_sym("implied_x", 32);
+    s.write(0xaabbcc, exprBuilder.mk_concat(b1, b0));
+    s.reg_write("EAX", exprBuilder.mk_add(x, exprBuilder.mk_const(1, 32)));
+    s.solver().add(exprBuilder.mk_ugt(x, exprBuilder.mk_zext(b0, 32)));
+
+    // magic bytes check
+    s.solver().add(exprBuilder.mk_eq(exprBuilder.mk_concat(b1, b0),
+                                     exprBuilder.mk_const(0x4142, 16)));
+    // linear equality
+    s.solver().add(exprBuilder.mk_eq(
+        exprBuilder.mk_add(x, exprBuilder.mk_const(3, 32)),
+        exprBuilder.mk_const(0x50, 32)));
+    s.apply_implied_values();
+
+    REQUIRE(s.solver().implied_values().size() == 3);
+    REQUIRE(s.read(0xaabbcc, 2) == exprBuilder.mk_const(0x4142, 16));
+    REQUIRE(s.reg_read("EAX") == exprBuilder.mk_const(0x4e, 32));
+    REQUIRE(s.satisfiable() == naaz::solver::CheckResult::SAT);
+    REQUIRE(s.solver().evaluate(x).value().as_u64() == 0x4d);
+}
+
+TEST_CASE("State Evaluate Many 1", "[state]")
+{
+    auto lifter = get_x86_64_lifter();
+    auto as     = std::make_shared<AddressSpace>();
+
+    State s(as, lifter, 0);
+
+    BVExprPtr a = exprBuilder.mk_sym("many_a", 32);
+    BVExprPtr b = exprBuilder.mk_sym("many_b", 32);
+    BVExprPtr c = exprBuilder.mk_sym("many_c", 8);
+    s.solver().add(exprBuilder.mk_ugt(a, exprBuilder.mk_const(10, 32)));
+    s.solver().add(exprBuilder.mk_eq(
+        b, exprBuilder.mk_add(a, exprBuilder.mk_const(1, 32))));
+
+    // a and b share a single model, c is unconstrained
+    auto values = s.solver().evaluate(
+        std::vector<ExprPtr>{b, c, exprBuilder.mk_const(7, 16), a});
+    REQUIRE(values.has_value());
+    REQUIRE(values->size() == 4);
+    REQUIRE(values->at(3).as_u64() > 10);
+    REQUIRE(values->at(0).as_u64() == values->at(3).as_u64() + 1);
+    REQUIRE(values->at(1).size() == 8);
+    REQUIRE(values->at(2).as_u64() == 7);
+}
+
+TEST_CASE("State Symbolic Array 1", "[state]")
+{
+    auto lifter = get_x86_64_lifter();
+    auto as     = std::make_shared<AddressSpace>();
+
+    naaz::g_config.sym_memory_arrays = true;
+    State s(as, lifter, 0);
+    naaz::g_config.sym_memory_arrays = false;
+
+    for (uint64_t i = 0; i < 8; ++i)
+        s.write(0x1000 + 4 * i, exprBuilder.mk_const(i + 10, 32));
+
+    BVExprPtr idx  = exprBuilder.mk_sym("array_idx", 64);
+    BVExprPtr addr = exprBuilder.mk_add(
+        exprBuilder.mk_mul(idx, exprBuilder.mk_const(4, 64)),
+        exprBuilder.mk_const(0x1004, 64));
+    s.solver().add(exprBuilder.mk_ult(idx, exprBuilder.mk_const(4, 64)));
+
+    BVExprPtr v = s.read(addr, 4);
+    s.write(addr, exprBuilder.mk_const(0x99, 32));
+    BVExprPtr w = s.read(0x100c, 4);
+
+    s.solver().add(exprBuilder.mk_eq(idx, exprBuilder.mk_const(2, 64)));
+    s.apply_implied_values();
+    REQUIRE(s.satisfiable() == naaz::solver::CheckResult::SAT);
+    REQUIRE(s.solver().evaluate(v).value().as_u64() == 13);
+    REQUIRE(s.solver().evaluate(w).value().as_u64() == 0x99);
+    REQUIRE(s.read(0x1010, 4) == exprBuilder.mk_const(14, 32));
+}
+
+TEST_CASE("State Symbolic Array 2", "[state]")
+{
+    auto lifter = get_x86_64_lifter();
+    auto as     = std::make_shared<AddressSpace>();
+
+    naaz::g_config.sym_memory_arrays = true;
+    State s(as, lifter, 0);
+    naaz::g_config.sym_memory_arrays = false;
+    s.write(0x8010, exprBuilder.mk_const(0x77, 8));
+
+    // the uninitialized bytes of the region are its symbolic base, there is
+    // no symbol for every byte
+    BVExprPtr idx = exprBuilder.mk_sym("array_uninit_idx", 64);
+    s.solver().add(exprBuilder.mk_ult(idx, exprBuilder.mk_const(1000, 64)));
+    uint32_t  num_symbols = exprBuilder.num_symbols();
+    BVExprPtr v           = s.read(
+        exprBuilder.mk_add(idx, exprBuilder.mk_const(0x8000, 64)), 1);
+    REQUIRE(v->kind() == Expr::Kind::ARRAY_READ);
+    REQUIRE(exprBuilder.num_symbols() <= num_symbols + 1);
+    REQUIRE(s.read(0x8010, 1) == exprBuilder.mk_const(0x77, 8));
+
+    s.solver().add(exprBuilder.mk_eq(v, exprBuilder.mk_const(0x41, 8)));
+    s.solver().add(exprBuilder.mk_eq(idx, exprBuilder.mk_const(5, 64)));
+    REQUIRE(s.satisfiable() == naaz::solver::CheckResult::SAT);
+    REQUIRE(s.solver().evaluate(s.read(0x8005, 1)).value().as_u64() == 0x41);
+}
+
+TEST_CASE("State Symbolic Access 1", "[state]")
+{
+    auto lifter = get_x86_64_lifter();
+    auto as     = std::make_shared<AddressSpace>();
+
+    naaz::g_config.sym_memory_arrays = true;
+    State s(as, lifter, 0);
+    naaz::g_config.sym_memory_arrays = false;
+    State t(as, lifter, 0);
+    for (uint64_t i = 0; i < 200; ++i) {
+        s.write(0x1000 + i, exprBuilder.mk_const(i, 8));
+        t.write(0x1000 + i, exprBuilder.mk_const(i, 8));
+    }
+
+    // a few candidates: an ite on the addresses
+    BVExprPtr narrow = exprBuilder.mk_sym("access_narrow", 64);
+    s.solver().add(exprBuilder.mk_ult(narrow, exprBuilder.mk_const(4, 64)));
+    BVExprPtr v = s.read(
+        exprBuilder.mk_add(narrow, exprBuilder.mk_const(0x1000, 64)), 1);
+    REQUIRE(v->kind() == Expr::Kind::ITE);
+
+    // too many candidates: an array region, without enumerating the addresses
+    BVExprPtr wide = exprBuilder.mk_sym("access_wide", 64);
+    s.solver().add(exprBuilder.mk_ult(wide, exprBuilder.mk_const(200, 64)));
+    BVExprPtr w =
+        s.read(exprBuilder.mk_add(wide, exprBuilder.mk_const(0x1000, 64)), 1);
+    REQUIRE(w->kind() == Expr::Kind::ARRAY_READ);
+
+    // without array regions, the candidates come from the bounds
+    t.solver().add(exprBuilder.mk_ult(wide, exprBuilder.mk_const(200, 64)));
+    BVExprPtr u =
+        t.read(exprBuilder.mk_add(wide, exprBuilder.mk_const(0x1000, 64)), 1);
+    REQUIRE(u->kind() == Expr::Kind::ITE);
+
+    s.solver().add(exprBuilder.mk_eq(narrow, exprBuilder.mk_const(3, 64)));
+    s.solver().add(exprBuilder.mk_eq(wide, exprBuilder.mk_const(150, 64)));
+    REQUIRE(s.satisfiable() == naaz::solver::CheckResult::SAT);
+    REQUIRE(s.solver().evaluate(v).value().as_u64() == 3);
+    REQUIRE(s.solver().evaluate(w).value().as_u64() == 150);
+    t.solver().add(exprBuilder.mk_eq(wide, exprBuilder.mk_const(150, 64)));
+    REQUIRE(t.satisfiable() == naaz::solver::CheckResult::SAT);
+    REQUIRE(t.solver().evaluate(u).value().as_u64() == 150);
+}
+
+TEST_CASE("State Base Memory 1", "[state]")
+{
+    auto    lifter = get_x86_64_lifter();
+    auto    as     = std::make_shared<AddressSpace>();
+    uint8_t data[] = {0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88};
+    as->register_segment("data", 0x2000, data, sizeof(data), PERM_READ);
+
+    State s(as, lifter, 0);
+    REQUIRE(s.read(0x2000, 8) == exprBuilder.mk_const(0x8877665544332211, 64));
+
+    s.write(0x2002, exprBuilder.mk_const(0xaa, 8));
+    StatePtr c = s.clone();
+    c->write(0x2003, exprBuilder.mk_const(0xbb, 8));
+
+    REQUIRE(s.read(0x2000, 4) == exprBuilder.mk_const(0x44aa2211, 32));
+    REQUIRE(c->read(0x2000, 4) == exprBuilder.mk_const(0xbbaa2211, 32));
+    REQUIRE(s.read(0x2004, 4) == exprBuilder.mk_const(0x88776655, 32));
+
+    // the bytes after the segment are not initialized
+    REQUIRE(s.read(0x2007, 2) ==
+            exprBuilder.mk_concat(exprBuilder.mk_sym("ram+0x2008", 8),
+                                  exprBuilder.mk_const(0x88, 8)));
+}
+
+TEST_CASE("State Bulk Memory 1", "[state]")
+{
+    auto    lifter = get_x86_64_lifter();
+    auto    as     = std::make_shared<AddressSpace>();
+    uint8_t data[] = {0x11, 0x22, 0x33, 0x44};
+    as->register_segment("data", 0x2000, data, sizeof(data), PERM_READ);
+
+    State     s(as, lifter, 0);
+    BVExprPtr sym = exprBuilder.mk_sym("bulk_sym", 8);
+    s.write(0x2001, sym);
+
+    // the last two bytes are not initialized
+    s.copy_range(0x3000, 0x2000, 6);
+    REQUIRE(s.read(0x3000, 1) == exprBuilder.mk_const(0x11, 8));
+    REQUIRE(s.read(0x3001, 1) == sym);
+    REQUIRE(s.read_buf(0x3002, 2) == exprBuilder.mk_const(0x3344, 16));
+    REQUIRE(s.read(0x3004, 1) == exprBuilder.mk_sym("ram+0x2004", 8));
+
+    // overlapping ranges
+    s.copy_range(0x3001, 0x3000, 3);
+    REQUIRE(s.read_buf(0x3000, 2) == exprBuilder.mk_const(0x1111, 16));
+    REQUIRE(s.read(0x3002, 1) == sym);
+    REQUIRE(s.read(0x3003, 1) == exprBuilder.mk_const(0x33, 8));
+
+    s.fill(0x3001, exprBuilder.mk_const(0xaa, 8), 2);
+    s.zero_range(0x3003, 2);
+    REQUIRE(s.read_buf(0x3000, 5) == exprBuilder.mk_const(0x11aaaa0000, 40));
+
+    std::vector<BVExprPtr> bytes(3);
+    s.read_bytes(0x2000, bytes);
+    REQUIRE(bytes.at(0) == exprBuilder.mk_const(0x11, 8));
+    REQUIRE(bytes.at(1) == sym);
+    REQUIRE(bytes.at(2) == exprBuilder.mk_const(0x33, 8));
+}
+
+TEST_CASE("State Fork 1", "[state]")
+{
+    auto lifter = get_x86_64_lifter();
+    auto as     = std::make_shared<AddressSpace>();
+
+    StatePtr  s = std::make_shared<State>(as, lifter, 0);
+    BVExprPtr x = exprBuilder.mk_sym("fork_x", 32);
+    s->reg_write("EAX", x);
+
+    auto cond   = exprBuilder.mk_ult(x, exprBuilder.mk_const(5, 32));
+    auto child1 = State::fork(s, 0x10, cond);
+    auto child2 = State::fork(s, 0x20, exprBuilder.mk_not(cond));
+    s           = nullptr;
+
+    REQUIRE(!child1->is_materialized());
+    REQUIRE(child1->pc() == 0x10);
+    REQUIRE(child2->pc() == 0x20);
+
+    // the first child copies the parent, the last one takes it
+    child1->reg_write("EAX", exprBuilder.mk_const(1, 32));
+    REQUIRE(child1->is_materialized());
+    REQUIRE(!child2->is_materialized());
+    REQUIRE(child2->reg_read("EAX") == x);
+    REQUIRE(child2->is_materialized());
+
+    REQUIRE(child1->satisfiable() == naaz::solver::CheckResult::SAT);
+    REQUIRE(child2->solver().evaluate(x).value().as_u64() >= 5);
+}
+
+TEST_CASE("State Clone 1", "[state]")
+{
+    auto lifter = get_x86_64_lifter();
+    auto as     = std::make_shared<AddressSpace>();
+
+    StatePtr s = std::make_shared<State>(as, lifter, 0);
+    s->register_call(0x10);
+    s->register_call(0x20);
+    int fd = s->fs().open("clone_file");
+    s->fs().write(fd, exprBuilder.mk_const(0x41, 8));
+
+    StatePtr c = s->clone();
+    c->register_ret();
+    c->register_call(0x30);
+    c->fs().write(fd, exprBuilder.mk_const(0x42, 8));
+
+    REQUIRE(s->stacktrace().size() == 2);
+    REQUIRE(s->stacktrace().top() == 0x20);
+    REQUIRE(c->stacktrace().size() == 2);
+    REQUIRE(c->stacktrace().top() == 0x30);
+
+    s->fs().seek(fd, 0);
+    c->fs().seek(fd, 0);
+    REQUIRE(s->fs().read(fd, 2) ==
+            exprBuilder.mk_concat(exprBuilder.mk_const(0x41, 8),
+                                  exprBuilder.mk_sym("clone_file+0x1", 8)));
+    REQUIRE(c->fs().read(fd, 2) == exprBuilder.mk_const(0x4142, 16));
+}
+
+class CounterPlugin : public Plugin
+{
+    std::string m_name = "test::counter";
+
+  public:
+    int value = 0;
+
+    const std::string& name() { return m_name; }
+    PluginPtr          clone()
+    {
+        return std::make_shared<CounterPlugin>(*this);
+    }
+};
+
+TEST_CASE("State Clone 2", "[state]")
+{
+    auto lifter = get_x86_64_lifter();
+    auto as     = std::make_shared<AddressSpace>();
+
+    StatePtr s = std::make_shared<State>(as, lifter, 0);
+    s->pm().register_plugin(std::make_shared<CounterPlugin>());
+
+    // a plugin held by the caller is not copied again by the owner
+    auto p1 = std::static_pointer_cast<CounterPlugin>(
+        s->pm().get_plugin("test::counter"));
+    p1->value = 1;
+    REQUIRE(s->pm().get_plugin("test::counter") == p1);
+
+    StatePtr c = s->clone();
+    REQUIRE(c->pm().shares_data(s->pm()));
+
+    // after the clone, both the clone and the original copy it
+    auto p2 = std::static_pointer_cast<CounterPlugin>(
+        c->pm().get_plugin("test::counter"));
+    p2->value = 2;
+    auto p3 = std::static_pointer_cast<CounterPlugin>(
+        s->pm().get_plugin("test::counter"));
+    p3->value++;
+    REQUIRE(p1->value == 1);
+    REQUIRE(p2->value == 2);
+    REQUIRE(p3->value == 2);
+    REQUIRE(c->pm().get_plugin("test::counter") == p2);
+    REQUIRE(!c->pm().shares_data(s->pm()));
+}
+
+TEST_CASE("PersistentMap 1", "[state]")
+{
+    naaz::PersistentMap<int, int> m1;
+    for (int i = 0; i < 1000; ++i)
+        m1.set((i * 7919) % 1000, i);
+    REQUIRE(m1.size() == 1000);
+
+    auto m2 = m1;
+    REQUIRE(m2.shares(m1));
+    for (int i = 0; i < 1000; i += 2)
+        m2.erase(i);
+    m2.set(1, -1);
+    m2.set(2000, 2000);
+    REQUIRE(!m2.shares(m1));
+
+    REQUIRE(m1.size() == 1000);
+    REQUIRE(m1.at((5 * 7919) % 1000) == 5);
+    REQUIRE(m1.contains(4));
+    REQUIRE(m2.size() == 501);
+    REQUIRE(!m2.contains(4));
+    REQUIRE(m2.at(1) == -1);
+    REQUIRE(m2.find(2000) != nullptr);
+
+    // the iteration is in key order
+    int prev = -1;
+    for (const auto& [k, v] : m1) {
+        REQUIRE(k == prev + 1);
+        prev = k;
+    }
+    REQUIRE(prev == 999);
+}
+
+TEST_CASE("State Merge 1", "[state]")
+{
+    auto lifter = get_x86_64_lifter();
+    auto as     = std::make_shared<AddressSpace>();
+
+    StatePtr  s = std::make_shared<State>(as, lifter, 0);
+    BVExprPtr x = exprBuilder.mk_sym("merge_x", 32);
+    s->reg_write("EBX", x);
+
+    auto cond   = exprBuilder.mk_ult(x, exprBuilder.mk_const(5, 32));
+    auto child1 = State::fork(s, 0x10, cond);
+    auto child2 = State::fork(s, 0x10, exprBuilder.mk_not(cond));
+    auto child3 = State::fork(s, 0x20, exprBuilder.mk_not(cond));
+    s           = nullptr;
+
+    child1->reg_write("EAX", exprBuilder.mk_const(1, 32));
+    child2->reg_write("EAX", exprBuilder.mk_const(2, 32));
+
+    // different program point, or too expensive
+    REQUIRE(!child1->merge(*child3, 64));
+    REQUIRE(!child1->merge(*child2, 8));
+    REQUIRE(child1->merge(*child2, 64));
+
+    REQUIRE(child1->reg_read("EBX") == x);
+    REQUIRE(child1->satisfiable() == naaz::solver::CheckResult::SAT);
+
+    auto c1 = child1->clone();
+    c1->solver().add(exprBuilder.mk_eq(x, exprBuilder.mk_const(3, 32)));
+    REQUIRE(c1->solver().evaluate(c1->reg_read("EAX")).value().as_u64() == 1);
+
+    auto c2 = child1->clone();
+    c2->solver().add(exprBuilder.mk_eq(x, exprBuilder.mk_const(7, 32)));
+    REQUIRE(c2->solver().evaluate(c2->reg_read("EAX")).value().as_u64() == 2);
+}
+
+TEST_CASE("MapMemory Diff 1", "[state]")
+{
+    MapMemory mem("diff_mem", MapMemory::UninitReadBehavior::RET_ZERO);
+    for (uint64_t i = 0; i < 16; ++i)
+        mem.write(i * 0x1000, exprBuilder.mk_const(i, 8));
+
+    auto m1 = mem.clone();
+    auto m2 = mem.clone();
+    // the writes of the original after the copies are not seen by them
+    mem.write(0x3000, exprBuilder.mk_const(0xff, 8));
+    REQUIRE(m1->diff(*m2).value().empty());
+
+    m1->write(0x5000, exprBuilder.mk_const(0xaa, 8));
+    m1->write(0x7001, exprBuilder.mk_const(0, 8));
+    m2->write(0x9000, exprBuilder.mk_const(9, 8));
+    m2->write(0x5000, exprBuilder.mk_const(0xaa, 8));
+
+    // a write of the same value is not a difference, nor a write of the
+    // value of an uninitialized byte
+    auto m3 = m1->clone();
+    m3->write(0xb000, exprBuilder.mk_const(0, 8));
+    auto expected = std::vector<uint64_t>{0x9000};
+    REQUIRE(m1->diff(*m2).value() == expected);
+    REQUIRE(m2->diff(*m3).value() == expected);
+    REQUIRE(m1->diff(*m3).value().empty());
+
+    // without a common epoch the whole memories are compared
+    std::stringstream ss;
+    {
+        ExprWriter w(ss);
+        m2->serialize(w);
+    }
+    MapMemory  restored("diff_mem", MapMemory::UninitReadBehavior::RET_ZERO);
+    ExprReader r(ss, [](int32_t) -> FloatFormatPtr { return nullptr; });
+    restored.deserialize(r);
+    REQUIRE(m1->diff(restored).value() == expected);
+}
+
+TEST_CASE("MapMemory Diff 2", "[state]")
+{
+    MapMemory mem("diff_sym", MapMemory::UninitReadBehavior::RET_SYM);
+    auto      m1 = mem.clone();
+    auto      m2 = mem.clone();
+
+    // the symbol of a byte initialized by a read is not a difference
+    m1->read(0x10, 1);
+    m1->write(0x20, exprBuilder.mk_const(1, 8));
+    REQUIRE(m1->diff(*m2).value() == std::vector<uint64_t>{0x20});
+    REQUIRE(m2->diff(*m1).value() == std::vector<uint64_t>{0x20});
+
+    REQUIRE(m1->concrete_byte(0x20));
+    REQUIRE(!m1->concrete_byte(0x10));
+    REQUIRE(!m2->concrete_byte(0x20));
+}
+
+TEST_CASE("State Spill 1", "[state]")
+{
+    auto lifter = get_x86_64_lifter();
+    auto as     = std::make_shared<AddressSpace>();
+
+    StatePtr  s = std::make_shared<State>(as, lifter, 0);
+    BVExprPtr x = exprBuilder.mk_sym("spill_x", 32);
+    BVExprPtr y = exprBuilder.mk_add(x, exprBuilder.mk_const(1, 32));
+    s->reg_write("EAX", y);
+    s->write(0x1000, y);
+    s->write(0x2000, exprBuilder.mk_const(0x4142434445464748UL, 64));
+    s->solver().add(exprBuilder.mk_ult(x, exprBuilder.mk_const(10, 32)));
+
+    int fd = s->fs().open("spill_file");
+    s->fs().write(fd, exprBuilder.mk_concat(y, y));
+    s->fs().seek(fd, 4);
+
+    auto cond  = exprBuilder.mk_ugt(x, exprBuilder.mk_const(5, 32));
+    auto child = State::fork(s, 0x10, cond);
+    s          = nullptr;
+
+    std::stringstream ss;
+    {
+        ExprWriter w(ss);
+        child->spill(w);
+    }
+    // only the standard files are left
+    REQUIRE(child->fs().files().size() == 3);
+
+    ExprReader r(ss, [lifter](int32_t size) {
+        return lifter->get_float_format(size);
+    });
+    child->unspill(r);
+
+    REQUIRE(child->pc() == 0x10);
+    REQUIRE(child->reg_read("EAX") == y);
+    REQUIRE(child->read(0x1000, 4) == y);
+    REQUIRE(child->read(0x2000, 8) ==
+            exprBuilder.mk_const(0x4142434445464748UL, 64));
+    REQUIRE(child->fs().read(fd, 4) == y);
+
+    child->solver().add(exprBuilder.mk_neq(x, exprBuilder.mk_const(9, 32)));
+    REQUIRE(child->satisfiable() == naaz::solver::CheckResult::SAT);
+    REQUIRE(child->solver().evaluate(x).value().as_u64() >= 6);
+    REQUIRE(child->solver().evaluate(x).value().as_u64() <= 8);
+}
+
+TEST_CASE("State Clone Benchmark", "[.][benchmark]")
+{
+    auto lifter = get_x86_64_lifter();
+    auto as     = std::make_shared<AddressSpace>();
+
+    StatePtr s = std::make_shared<State>(as, lifter, 0);
+
+    // large model
+    for (int i = 0; i < 1000; ++i) {
+        auto sym =
+            exprBuilder.mk_sym(naaz::string_format("bench_sym_%d", i), 32);
+        s->solver().add(exprBuilder.mk_ugt(sym, exprBuilder.mk_const(i, 32)));
+    }
+    REQUIRE(s->satisfiable() == naaz::solver::CheckResult::SAT);
+
+    // many open files
+    for (int i = 0; i < 256; ++i) {
+        int fd = s->fs().open(naaz::string_format("bench_file_%d", i));
+        s->fs().write(fd, exprBuilder.mk_const(0x4142434445464748UL, 64));
+    }
+
+    // deep stack trace
+    for (uint64_t i = 0; i < 10000; ++i)
+        s->register_call(0x400000 + i);
+
+    BENCHMARK("clone") { return s->clone(); };
+    BENCHMARK("clone and modify")
+    {
+        auto c = s->clone();
+        c->register_call(0x1000);
+        c->fs().write(3, exprBuilder.mk_const(0, 8));
+        return c;
+    };
+}
+
+TEST_CASE("State Bulk Memory Benchmark", "[.][benchmark]")
+{
+    auto lifter = get_x86_64_lifter();
+    auto as     = std::make_shared<AddressSpace>();
+
+    const size_t size = 1024 * 1024;
+    StatePtr     s    = std::make_shared<State>(as, lifter, 0);
+    uint64_t     src  = s->allocate(size);
+    uint64_t     dst  = s->allocate(size);
+    s->zero_range(src, size);
+
+    BENCHMARK("calloc 1MB (byte writes)")
+    {
+        for (uint64_t i = 0; i < size; ++i)
+            s->write(dst + i, exprBuilder.mk_const(0, 8));
+    };
+    BENCHMARK("calloc 1MB (zero_range)") { s->zero_range(dst, size); };
+    BENCHMARK("memcpy 1MB (read_buf/write_buf)")
+    {
+        s->write_buf(dst, s->read_buf(src, size));
+    };
+    BENCHMARK("memcpy 1MB (copy_range)") { s->copy_range(dst, src, size); };
+}
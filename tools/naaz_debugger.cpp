@@ -310,13 +310,9 @@ static void cmd_pi(exec_context_t& ctx)
     if (!ctx.state)
         return;
 
-    auto pi = ctx.state->solver().manager().pi();
-    if (pi->kind() == naaz::expr::Expr::Kind::BOOL_AND) {
-        auto pi_ = std::static_pointer_cast<const naaz::expr::BoolAndExpr>(pi);
-        for (auto c : pi_->exprs())
-            printf(" * %s\n", c->to_string().c_str());
-    } else
-        printf(" * %s\n", pi->to_string().c_str());
+    // the constraints, pi() can be a chain of nested conjunctions
+    for (auto c : ctx.state->solver().manager().constraints())
+        printf(" * %s\n", c->to_string().c_str());
 }
 
 static void  cmd_help(exec_context_t& ctx);
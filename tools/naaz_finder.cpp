@@ -5,14 +5,19 @@
 
 #include "../util/config.hpp"
 #include "../util/strutil.hpp"
+#include "../util/stats.hpp"
 #include "../util/parseutil.hpp"
 #include "../loader/BFDLoader.hpp"
+#include "../solver/QueryLog.hpp"
 #include "../expr/ExprBuilder.hpp"
 #include "../executor/ExecutorManager.hpp"
+#include "../executor/Checkpointer.hpp"
 #include "../executor/RandDFSExplorationTechnique.hpp"
 #include "../executor/BFSExplorationTechnique.hpp"
 #include "../executor/DFSExplorationTechnique.hpp"
 #include "../executor/CovExplorationTechnique.hpp"
+#include "../executor/DirectedExplorationTechnique.hpp"
+#include "../executor/RandomPathExplorationTechnique.hpp"
 
 using namespace naaz;
 
@@ -21,7 +26,10 @@ struct parsed_args_t {
     std::string outdir;
 
     std::string state_config;
+    std::string resume_dir;
     std::string expl_technique;
+    std::string stats_path;
+    uint32_t    num_workers = 1;
 
     std::vector<uint64_t> find_addrs;
     std::vector<uint64_t> avoid_addrs;
@@ -50,13 +58,54 @@ static parsed_args_t parse_args_or_die(int argc, char const* argv[])
         .implicit_value(true)
         .nargs(0)
         .help("Disable 'lazy solving' optimization");
+    program.add_argument("--sym-arrays")
+        .default_value(false)
+        .implicit_value(true)
+        .nargs(0)
+        .help("Model memory accessed with symbolic pointers as SMT arrays");
+    program.add_argument("--fork-string-models")
+        .default_value(false)
+        .implicit_value(true)
+        .nargs(0)
+        .help("Fork on the position of the terminator in the string models");
+    program.add_argument("--merge-states")
+        .default_value(false)
+        .implicit_value(true)
+        .nargs(0)
+        .help("Merge the states that reach the same program point");
     program.add_argument("-E", "--exploration-technique")
         .default_value<std::string>("rand_dfs")
         .help("Exploration technique to use. One value among: "
-              "dfs, rand_dfs (default), bfs, cov");
+              "dfs, rand_dfs (default), bfs, cov, directed, random_path");
     program.add_argument("-T", "--z3_timeout")
         .scan<'i', uint32_t>()
         .help("Set Z3 timeout (ms)");
+    program.add_argument("--max-memory")
+        .scan<'u', uint64_t>()
+        .help("Memory budget (MB), queued states are spilled to disk above it");
+    program.add_argument("--spill-dir")
+        .default_value<std::string>("/tmp")
+        .help("Directory for the spilled states");
+    program.add_argument("--checkpoint")
+        .help("Directory for the periodic checkpoints of the exploration");
+    program.add_argument("--checkpoint-interval")
+        .scan<'u', uint32_t>()
+        .help("Seconds between two checkpoints (default: 300)");
+    program.add_argument("--resume")
+        .help("Resume the exploration from the checkpoint in this directory "
+              "(the checkpoints continue in it, unless --checkpoint is set)");
+    program.add_argument("--workers")
+        .scan<'u', uint32_t>()
+        .help("Explore on this many worker processes, that share the "
+              "queued states and the coverage (default: 1, no workers). Not "
+              "supported by the directed and random_path techniques");
+    program.add_argument("--dump-queries")
+        .help("Log the solver queries in this directory (SMT-LIB2, gzip), "
+              "see naaz_query_replay");
+    program.add_argument("--stats")
+        .help("Write the phase timers and counters to this file (JSON, needs "
+              "the STATS cmake option). With --workers, only the ones of the "
+              "coordinator");
     program.add_argument("-J", "--state-json")
         .help("JSON config file for the initial state");
     program.add_argument("-o", "--output")
@@ -73,13 +122,41 @@ static parsed_args_t parse_args_or_die(int argc, char const* argv[])
         exit(1);
     }
 
-    g_config.printable_stdin = program.get<bool>("--printable_stdin");
-    g_config.lazy_solving    = !program.get<bool>("--disable-lazy-solving");
+    g_config.printable_stdin    = program.get<bool>("--printable_stdin");
+    g_config.lazy_solving       = !program.get<bool>("--disable-lazy-solving");
+    g_config.sym_memory_arrays  = program.get<bool>("--sym-arrays");
+    g_config.fork_string_models = program.get<bool>("--fork-string-models");
+    g_config.merge_states       = program.get<bool>("--merge-states");
     if (auto z3_to = program.present<uint32_t>("--z3_timeout"))
         g_config.z3_timeout = *z3_to;
+    if (auto max_memory = program.present<uint64_t>("--max-memory"))
+        g_config.max_memory = *max_memory;
+    g_config.spill_dir = program.get("--spill-dir");
+    if (auto interval = program.present<uint32_t>("--checkpoint-interval"))
+        g_config.checkpoint_interval = *interval;
+    if (auto resume_dir = program.present("--resume")) {
+        res.resume_dir          = *resume_dir;
+        g_config.checkpoint_dir = *resume_dir;
+    }
+    if (auto checkpoint_dir = program.present("--checkpoint"))
+        g_config.checkpoint_dir = *checkpoint_dir;
+    if (auto num_workers = program.present<uint32_t>("--workers"))
+        res.num_workers = *num_workers;
+    if (res.num_workers == 0) {
+        fprintf(stderr, "the number of workers must be at least 1\n");
+        exit(1);
+    }
+    if (res.num_workers > 1 && g_config.checkpoint_dir != "") {
+        fprintf(stderr, "the checkpoints are not supported with workers\n");
+        exit(1);
+    }
 
     if (auto state_config = program.present("--state-json"))
         res.state_config = *state_config;
+    if (auto queries_dir = program.present("--dump-queries"))
+        solver::QueryLog::The().open(*queries_dir);
+    if (auto stats_path = program.present("--stats"))
+        res.stats_path = *stats_path;
 
     res.outdir = program.get("--output");
     if (!std::filesystem::is_directory(res.outdir) ||
@@ -95,12 +172,21 @@ static parsed_args_t parse_args_or_die(int argc, char const* argv[])
 
     res.expl_technique = program.get("--exploration-technique");
     std::set<std::string> admissible_techniques{"dfs", "rand_dfs", "bfs",
-                                                "cov"};
+                                                "cov", "directed",
+                                                "random_path"};
     if (!admissible_techniques.contains(res.expl_technique)) {
         fprintf(stderr, "%s is not an admissible exploration technique\n",
                 res.expl_technique.c_str());
         exit(1);
     }
+    // the workers share their states with evict(), that these techniques
+    // do not support
+    if (res.num_workers > 1 && (res.expl_technique == "directed" ||
+                                res.expl_technique == "random_path")) {
+        fprintf(stderr, "%s is not supported with workers\n",
+                res.expl_technique.c_str());
+        exit(1);
+    }
 
     res.binpath = program.get("program");
 
@@ -139,9 +225,14 @@ template <class ExplorationPolicy>
 void run(state::StatePtr state, parsed_args_t& args)
 {
     executor::ExecutorManager<ExplorationPolicy> em(state);
+    if (args.resume_dir != "")
+        em.resume(args.resume_dir);
 
     std::optional<state::StatePtr> s =
-        em.explore(args.find_addrs, args.avoid_addrs);
+        args.num_workers > 1
+            ? em.explore_distributed(args.find_addrs, args.avoid_addrs,
+                                     args.num_workers)
+            : em.explore(args.find_addrs, args.avoid_addrs);
     if (s.has_value()) {
         fprintf(stdout, "state found! dumping proof to %s\n",
                 args.outdir.c_str());
@@ -151,12 +242,21 @@ void run(state::StatePtr state, parsed_args_t& args)
 
     fprintf(stdout, "generated states: %lu\n",
             em.num_states() + (s.has_value() ? 1 : 0));
+    if (s.has_value())
+        fprintf(stdout, "concretized symbols: %lu\n",
+                s.value()->solver().implied_values().size());
+    if (args.stats_path != "")
+        stats::write_report(args.stats_path);
 }
 
 int main(int argc, char const* argv[])
 {
     auto res = parse_args_or_die(argc, argv);
 
+    // before any other symbol is created
+    if (res.resume_dir != "")
+        executor::Checkpointer::load_symbols(res.resume_dir);
+
     loader::BFDLoader loader(res.binpath);
     state::StatePtr   entry_state = loader.entry_state();
     entry_state->set_argv(res.program_args);
@@ -170,6 +270,10 @@ int main(int argc, char const* argv[])
         run<executor::DFSExplorationTechnique>(entry_state, res);
     else if (res.expl_technique == "rand_dfs")
         run<executor::RandDFSExplorationTechnique>(entry_state, res);
+    else if (res.expl_technique == "directed")
+        run<executor::DirectedExplorationTechnique>(entry_state, res);
+    else if (res.expl_technique == "random_path")
+        run<executor::RandomPathExplorationTechnique>(entry_state, res);
     else
         run<executor::CovExplorationTechnique>(entry_state, res);
     return 0;
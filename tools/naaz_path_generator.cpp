@@ -1,13 +1,17 @@
 #include <cstdio>
 #include <cstdint>
 #include <filesystem>
+#include <sys/shm.h>
 #include <argparse/argparse.hpp>
 
 #include "../util/config.hpp"
 #include "../util/strutil.hpp"
+#include "../util/stats.hpp"
 #include "../loader/BFDLoader.hpp"
+#include "../solver/QueryLog.hpp"
 #include "../expr/ExprBuilder.hpp"
 #include "../executor/ExecutorManager.hpp"
+#include "../executor/Checkpointer.hpp"
 #include "../executor/CovExplorationTechnique.hpp"
 
 using namespace naaz;
@@ -17,6 +21,10 @@ struct parsed_args_t {
     std::string outdir;
 
     std::string state_config;
+    std::string resume_dir;
+    std::string drcov_path;
+    std::string stats_path;
+    int         coverage_shm = -1;
 
     std::vector<std::string> program_args;
 };
@@ -39,9 +47,59 @@ static parsed_args_t parse_args_or_die(int argc, char const* argv[])
         .implicit_value(true)
         .nargs(0)
         .help("Disable 'lazy solving' optimization");
+    program.add_argument("--sym-arrays")
+        .default_value(false)
+        .implicit_value(true)
+        .nargs(0)
+        .help("Model memory accessed with symbolic pointers as SMT arrays");
+    program.add_argument("--fork-string-models")
+        .default_value(false)
+        .implicit_value(true)
+        .nargs(0)
+        .help("Fork on the position of the terminator in the string models");
     program.add_argument("-T", "--z3_timeout")
         .scan<'i', uint32_t>()
         .help("Set Z3 timeout (ms)");
+    program.add_argument("--max-memory")
+        .scan<'u', uint64_t>()
+        .help("Memory budget (MB), queued states are spilled to disk above it");
+    program.add_argument("--spill-dir")
+        .default_value<std::string>("/tmp")
+        .help("Directory for the spilled states");
+    program.add_argument("--checkpoint")
+        .help("Directory for the periodic checkpoints of the exploration");
+    program.add_argument("--checkpoint-interval")
+        .scan<'u', uint32_t>()
+        .help("Seconds between two checkpoints (default: 300)");
+    program.add_argument("--resume")
+        .help("Resume the exploration from the checkpoint in this directory "
+              "(the checkpoints continue in it, unless --checkpoint is set)");
+    program.add_argument("--emit-workers")
+        .scan<'u', uint32_t>()
+        .help("Threads that solve and dump the test cases (default: 0, "
+              "the exploration thread)");
+    program.add_argument("--emit-queue-size")
+        .scan<'u', uint32_t>()
+        .help("Maximum number of exited states waiting to be dumped "
+              "(default: 64)");
+    program.add_argument("--new-coverage-only")
+        .default_value(false)
+        .implicit_value(true)
+        .nargs(0)
+        .help("Emit only the test cases that hit new edges");
+    program.add_argument("--drcov")
+        .help("Write the coverage of the exploration to this file (drcov "
+              "format)");
+    program.add_argument("--coverage-shm")
+        .scan<'i', int>()
+        .help("Keep the edge coverage map in this shared memory segment "
+              "(AFL layout, 64 KB)");
+    program.add_argument("--dump-queries")
+        .help("Log the solver queries in this directory (SMT-LIB2, gzip), "
+              "see naaz_query_replay");
+    program.add_argument("--stats")
+        .help("Write the phase timers and counters to this file (JSON, needs "
+              "the STATS cmake option)");
     program.add_argument("-J", "--state-json")
         .help("JSON config file for the initial state");
     program.add_argument("program").help("Path to binary to analyze");
@@ -55,13 +113,44 @@ static parsed_args_t parse_args_or_die(int argc, char const* argv[])
         exit(1);
     }
 
-    g_config.lazy_solving    = !program.get<bool>("--disable-lazy-solving");
-    g_config.printable_stdin = program.get<bool>("--printable_stdin");
+    g_config.lazy_solving       = !program.get<bool>("--disable-lazy-solving");
+    g_config.sym_memory_arrays  = program.get<bool>("--sym-arrays");
+    g_config.fork_string_models = program.get<bool>("--fork-string-models");
+    g_config.printable_stdin    = program.get<bool>("--printable_stdin");
     if (auto z3_to = program.present<uint32_t>("--z3_timeout"))
         g_config.z3_timeout = *z3_to;
+    if (auto max_memory = program.present<uint64_t>("--max-memory"))
+        g_config.max_memory = *max_memory;
+    g_config.spill_dir = program.get("--spill-dir");
+    if (auto n = program.present<uint32_t>("--emit-workers"))
+        g_config.emit_workers = *n;
+    if (auto n = program.present<uint32_t>("--emit-queue-size")) {
+        if (*n == 0) {
+            fprintf(stderr, "the emit queue size must be at least 1\n");
+            exit(1);
+        }
+        g_config.emit_queue_size = *n;
+    }
+    g_config.emit_new_coverage_only = program.get<bool>("--new-coverage-only");
+    if (auto interval = program.present<uint32_t>("--checkpoint-interval"))
+        g_config.checkpoint_interval = *interval;
+    if (auto resume_dir = program.present("--resume")) {
+        res.resume_dir          = *resume_dir;
+        g_config.checkpoint_dir = *resume_dir;
+    }
+    if (auto checkpoint_dir = program.present("--checkpoint"))
+        g_config.checkpoint_dir = *checkpoint_dir;
 
     if (auto state_config = program.present("--state-json"))
         res.state_config = *state_config;
+    if (auto drcov_path = program.present("--drcov"))
+        res.drcov_path = *drcov_path;
+    if (auto queries_dir = program.present("--dump-queries"))
+        solver::QueryLog::The().open(*queries_dir);
+    if (auto stats_path = program.present("--stats"))
+        res.stats_path = *stats_path;
+    if (auto shm_id = program.present<int>("--coverage-shm"))
+        res.coverage_shm = *shm_id;
 
     res.outdir = program.get("--output");
     if (!std::filesystem::is_directory(res.outdir) ||
@@ -91,6 +180,10 @@ int main(int argc, char const* argv[])
 {
     auto args = parse_args_or_die(argc, argv);
 
+    // before any other symbol is created
+    if (args.resume_dir != "")
+        executor::Checkpointer::load_symbols(args.resume_dir);
+
     loader::BFDLoader loader(args.binpath);
     state::StatePtr   entry_state = loader.entry_state();
     entry_state->set_argv(args.program_args);
@@ -99,16 +192,34 @@ int main(int argc, char const* argv[])
         entry_state->init_from_json(args.state_config);
 
     executor::CovExecutorManager em(entry_state);
+    if (args.resume_dir != "")
+        em.resume(args.resume_dir);
+    if (args.drcov_path != "" || args.coverage_shm != -1)
+        em.track_coverage();
+    if (args.coverage_shm != -1) {
+        void* map = shmat(args.coverage_shm, nullptr, 0);
+        if (map == (void*)-1) {
+            fprintf(stderr, "unable to attach the shared memory segment %d\n",
+                    args.coverage_shm);
+            exit(1);
+        }
+        em.coverage().attach((uint8_t*)map);
+    }
 
     static std::string outdir = args.outdir;
-    em.gen_paths([](state::StatePtr s) {
-        static uint32_t n_testcase = 0;
-
-        std::string o = string_format("%s/%06u", outdir.c_str(), n_testcase++);
+    em.gen_paths([](state::StatePtr s, uint64_t n_testcase) {
+        std::string o = string_format("%s/%06lu", outdir.c_str(),
+                                      (unsigned long)n_testcase);
         if (!std::filesystem::is_directory(o) || !std::filesystem::exists(o)) {
             std::filesystem::create_directory(o);
         }
         s->dump(o);
     });
+
+    if (args.drcov_path != "")
+        em.coverage().write_drcov(args.drcov_path,
+                                  *entry_state->address_space(), args.binpath);
+    if (args.stats_path != "")
+        stats::write_report(args.stats_path);
     return 0;
 }
@@ -0,0 +1,270 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <thread>
+#include <argparse/argparse.hpp>
+#include <z3++.h>
+
+#include "../util/strutil.hpp"
+#include "../util/parseutil.hpp"
+#include "../solver/QueryLog.hpp"
+
+// Replays the queries logged with --dump-queries (see solver::QueryLog) on
+// fresh Z3 contexts, once for every solver configuration and thread count,
+// and prints the throughput and the latency distribution of each run. A
+// configuration is a list of Z3 parameters, e.g. "smt.arith.solver=2
+// sat.restart=luby". The results that differ from the logged ones (e.g., a
+// sat that becomes unknown) are counted as mismatches
+
+using namespace naaz;
+
+struct parsed_args_t {
+    std::vector<std::string> log_paths;
+    std::vector<std::string> configs;
+    std::vector<uint32_t>    thread_counts;
+    uint32_t                 timeout = 10000u;
+    uint32_t                 repeat  = 1;
+    std::string              origin;
+};
+
+static parsed_args_t parse_args_or_die(int argc, char const* argv[])
+{
+    parsed_args_t res;
+
+    argparse::ArgumentParser program("naaz_query_replay");
+
+    program.add_argument("-c", "--config")
+        .append()
+        .help("Z3 parameters of a configuration (space-separated key=value). "
+              "Repeat it to compare several configurations (default: the "
+              "Z3 defaults)");
+    program.add_argument("-t", "--threads")
+        .default_value<std::string>("1")
+        .help("Thread counts to run (comma-separated, default: 1)");
+    program.add_argument("-T", "--z3_timeout")
+        .scan<'i', uint32_t>()
+        .help("Set Z3 timeout (ms, default: 10000)");
+    program.add_argument("--origin")
+        .help("Replay only the queries with this origin (cbranch, sym_read, "
+              "sym_write, eval_upto, bounds, dump, other)");
+    program.add_argument("--repeat")
+        .scan<'u', uint32_t>()
+        .help("Replay every query this many times in each run (default: 1)");
+    program.add_argument("logs").remaining().help(
+        "Query logs, or directories with query logs");
+
+    try {
+        program.parse_args(argc, argv);
+    } catch (const std::runtime_error& err) {
+        std::cerr << err.what() << std::endl;
+        std::cerr << program;
+        exit(1);
+    }
+
+    if (auto z3_to = program.present<uint32_t>("--z3_timeout"))
+        res.timeout = *z3_to;
+    if (auto repeat = program.present<uint32_t>("--repeat"))
+        res.repeat = *repeat;
+    if (res.repeat == 0) {
+        fprintf(stderr, "the number of repetitions must be at least 1\n");
+        exit(1);
+    }
+    if (auto origin = program.present("--origin")) {
+        if (!solver::parse_origin(*origin).has_value()) {
+            fprintf(stderr, "%s is not a query origin\n", origin->c_str());
+            exit(1);
+        }
+        res.origin = *origin;
+    }
+
+    if (auto configs = program.present<std::vector<std::string>>("--config"))
+        res.configs = *configs;
+    else
+        res.configs.push_back("");
+
+    for (auto n : split_at(program.get("--threads"), ',')) {
+        uint64_t v;
+        if (!parse_uint(n.c_str(), &v) || v == 0) {
+            fprintf(stderr, "Invalid thread count %s\n", n.c_str());
+            exit(1);
+        }
+        res.thread_counts.push_back(v);
+    }
+
+    if (!program.present("logs")) {
+        fprintf(stderr, "no query log\n");
+        exit(1);
+    }
+    for (auto& path : program.get<std::vector<std::string>>("logs")) {
+        if (!std::filesystem::is_directory(path)) {
+            res.log_paths.push_back(path);
+            continue;
+        }
+        for (const auto& entry : std::filesystem::directory_iterator(path)) {
+            if (entry.path().string().ends_with(".smt2.gz"))
+                res.log_paths.push_back(entry.path());
+        }
+    }
+    std::sort(res.log_paths.begin(), res.log_paths.end());
+
+    return res;
+}
+
+static void set_param(z3::context& ctx, z3::params& p, const std::string& kv)
+{
+    size_t eq = kv.find('=');
+    if (eq == std::string::npos || eq == 0) {
+        fprintf(stderr, "Invalid Z3 parameter %s\n", kv.c_str());
+        exit(1);
+    }
+    std::string key = kv.substr(0, eq);
+    std::string val = kv.substr(eq + 1);
+
+    uint64_t v;
+    if (val == "true" || val == "false")
+        p.set(key.c_str(), val == "true");
+    else if (parse_uint(val.c_str(), &v))
+        p.set(key.c_str(), (unsigned)v);
+    else if (val.find_first_not_of("0123456789.") == std::string::npos)
+        p.set(key.c_str(), std::stod(val));
+    else
+        p.set(key.c_str(), ctx.str_symbol(val.c_str()));
+}
+
+struct run_result_t {
+    std::vector<uint64_t>         latencies_us;
+    std::map<std::string, size_t> results;
+    size_t                        num_mismatches = 0;
+    double                        wall_s         = 0;
+};
+
+static run_result_t run(const std::vector<solver::QueryLog::Record>& queries,
+                        const std::string& config, uint32_t num_threads,
+                        const parsed_args_t& args)
+{
+    size_t num_runs = queries.size() * args.repeat;
+
+    run_result_t             res;
+    std::vector<std::string> results(num_runs);
+    res.latencies_us.resize(num_runs);
+
+    // the queries are taken in order by the first free thread
+    std::atomic<size_t>      next_query(0);
+    std::vector<std::thread> threads;
+    auto                     start = std::chrono::steady_clock::now();
+    for (uint32_t t = 0; t < num_threads; ++t) {
+        threads.emplace_back([&]() {
+            z3::context ctx;
+            z3::solver  solver(ctx);
+            z3::params  p(ctx);
+            p.set(":timeout", args.timeout);
+            for (const auto& kv : split_at(config, ' ')) {
+                if (!kv.empty())
+                    set_param(ctx, p, kv);
+            }
+            solver.set(p);
+
+            size_t i;
+            while ((i = next_query++) < num_runs) {
+                const auto& query = queries[i / args.repeat];
+                solver.reset();
+                solver.add(ctx.parse_string(query.smt2.c_str()));
+
+                auto query_start = std::chrono::steady_clock::now();
+                auto r           = solver.check();
+                res.latencies_us[i] =
+                    std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::steady_clock::now() - query_start)
+                        .count();
+                results[i] = r == z3::sat ? "sat"
+                                          : (r == z3::unsat ? "unsat"
+                                                            : "unknown");
+            }
+        });
+    }
+    for (auto& t : threads)
+        t.join();
+    res.wall_s = std::chrono::duration<double>(
+                     std::chrono::steady_clock::now() - start)
+                     .count();
+
+    for (size_t i = 0; i < num_runs; ++i) {
+        res.results[results[i]]++;
+        if (results[i] != queries[i / args.repeat].result)
+            res.num_mismatches++;
+    }
+    return res;
+}
+
+static void print_latencies(std::vector<uint64_t> latencies_us)
+{
+    if (latencies_us.empty())
+        return;
+
+    std::sort(latencies_us.begin(), latencies_us.end());
+    auto percentile = [&](double p) {
+        size_t rank = (size_t)(p * (latencies_us.size() - 1) + 0.5);
+        return latencies_us[rank] / 1000.0;
+    };
+    uint64_t total = 0;
+    for (auto l : latencies_us)
+        total += l;
+    fprintf(stdout,
+            "  latency (ms): mean %.3f, p50 %.3f, p90 %.3f, p99 %.3f, "
+            "max %.3f\n",
+            total / 1000.0 / latencies_us.size(), percentile(0.5),
+            percentile(0.9), percentile(0.99), percentile(1.0));
+}
+
+int main(int argc, char const* argv[])
+{
+    auto args = parse_args_or_die(argc, argv);
+
+    std::vector<solver::QueryLog::Record> queries;
+    for (const auto& path : args.log_paths) {
+        for (auto& r : solver::QueryLog::read(path)) {
+            if (args.origin.empty() ||
+                args.origin == solver::origin_name(r.origin))
+                queries.push_back(std::move(r));
+        }
+    }
+    if (queries.empty()) {
+        fprintf(stderr, "no query to replay\n");
+        exit(1);
+    }
+
+    // the logged run, as a baseline
+    std::map<std::string, size_t> origins;
+    std::vector<uint64_t>         logged_latencies;
+    for (const auto& q : queries) {
+        origins[solver::origin_name(q.origin)]++;
+        logged_latencies.push_back(q.wall_us);
+    }
+    fprintf(stdout, "queries: %lu (from %lu logs)\n", queries.size(),
+            args.log_paths.size());
+    for (const auto& [origin, n] : origins)
+        fprintf(stdout, "  %s: %lu\n", origin.c_str(), n);
+    fprintf(stdout, "logged:\n");
+    print_latencies(logged_latencies);
+
+    for (const auto& config : args.configs) {
+        for (auto num_threads : args.thread_counts) {
+            run_result_t res = run(queries, config, num_threads, args);
+            fprintf(stdout, "config: \"%s\", threads: %u\n", config.c_str(),
+                    num_threads);
+            fprintf(stdout,
+                    "  wall: %.3f s, throughput: %.1f queries/s, "
+                    "mismatches: %lu\n",
+                    res.wall_s, res.latencies_us.size() / res.wall_s,
+                    res.num_mismatches);
+            for (const auto& [result, n] : res.results)
+                fprintf(stdout, "  %s: %lu\n", result.c_str(), n);
+            print_latencies(res.latencies_us);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,242 @@
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <argparse/argparse.hpp>
+#include <nlohmann/json.hpp>
+
+#include "../util/config.hpp"
+#include "../util/ioutil.hpp"
+#include "../loader/BFDLoader.hpp"
+#include "../executor/JobServer.hpp"
+
+// Long-lived analysis server. The jobs are JSON objects sent on a Unix
+// socket, one per connection and terminated by a newline:
+//
+//   {"type": "find", "binary": "/bin/x", "find": ["0x401234"],
+//    "avoid": ["0x401000"], "args": ["@@:print:8"], "technique": "rand_dfs",
+//    "state_json": "/cfg.json", "output": "/out/job1"}
+//   {"type": "gen_paths", "binary": "/bin/x", "output": "/out/job2"}
+//
+// "find" and "avoid" take hex strings or numbers. "technique" defaults to
+// rand_dfs for find and to cov for gen_paths. The answer is a JSON object on
+// a single line, with the result and the timing of the job (in ms).
+//
+// The jobs run concurrently on --jobs threads (see executor::JobServer). The
+// binaries are loaded once per process, their address space, lifter and
+// block cache are shared by the jobs. Every thread keeps its Z3 context warm
+// across the jobs. A job that fails answers with an error, the server keeps
+// running. The options of the exploration (e.g., --z3_timeout) are set at
+// startup and apply to all jobs
+
+using namespace naaz;
+using json = nlohmann::json;
+
+struct parsed_args_t {
+    std::string socket_path;
+    uint32_t    num_jobs;
+};
+
+static parsed_args_t parse_args_or_die(int argc, char const* argv[])
+{
+    parsed_args_t res;
+
+    argparse::ArgumentParser program("naaz_server");
+    program.add_argument("-s", "--socket")
+        .default_value<std::string>("/tmp/naaz.sock")
+        .help("Path of the Unix socket");
+    program.add_argument("-j", "--jobs")
+        .default_value<uint32_t>(4)
+        .scan<'u', uint32_t>()
+        .help("Number of jobs that run concurrently");
+    program.add_argument("-P", "--printable_stdin")
+        .default_value(false)
+        .implicit_value(true)
+        .nargs(0)
+        .help("Constraint stdin to be printable-only");
+    program.add_argument("--disable-lazy-solving")
+        .default_value(false)
+        .implicit_value(true)
+        .nargs(0)
+        .help("Disable 'lazy solving' optimization");
+    program.add_argument("--sym-arrays")
+        .default_value(false)
+        .implicit_value(true)
+        .nargs(0)
+        .help("Model memory accessed with symbolic pointers as SMT arrays");
+    program.add_argument("--fork-string-models")
+        .default_value(false)
+        .implicit_value(true)
+        .nargs(0)
+        .help("Fork on the position of the terminator in the string models");
+    program.add_argument("--merge-states")
+        .default_value(false)
+        .implicit_value(true)
+        .nargs(0)
+        .help("Merge the states that reach the same program point");
+    program.add_argument("-T", "--z3_timeout")
+        .scan<'i', uint32_t>()
+        .help("Set Z3 timeout (ms)");
+    program.add_argument("--max-memory")
+        .scan<'u', uint64_t>()
+        .help("Memory budget (MB), queued states are spilled to disk above it");
+    program.add_argument("--spill-dir")
+        .default_value<std::string>("/tmp")
+        .help("Directory for the spilled states");
+
+    try {
+        program.parse_args(argc, argv);
+    } catch (const std::runtime_error& err) {
+        std::cerr << err.what() << std::endl;
+        std::cerr << program;
+        exit(1);
+    }
+
+    g_config.printable_stdin    = program.get<bool>("--printable_stdin");
+    g_config.lazy_solving       = !program.get<bool>("--disable-lazy-solving");
+    g_config.sym_memory_arrays  = program.get<bool>("--sym-arrays");
+    g_config.fork_string_models = program.get<bool>("--fork-string-models");
+    g_config.merge_states       = program.get<bool>("--merge-states");
+    if (auto z3_to = program.present<uint32_t>("--z3_timeout"))
+        g_config.z3_timeout = *z3_to;
+    if (auto max_memory = program.present<uint64_t>("--max-memory"))
+        g_config.max_memory = *max_memory;
+    g_config.spill_dir = program.get("--spill-dir");
+
+    res.socket_path = program.get("--socket");
+    res.num_jobs    = program.get<uint32_t>("--jobs");
+    if (res.num_jobs == 0) {
+        fprintf(stderr, "the number of jobs must be at least 1\n");
+        exit(1);
+    }
+    return res;
+}
+
+typedef executor::JobServer::clock_type clock_type;
+
+// the binaries loaded by the process, by path. The loaders are shared by the
+// jobs of all the threads
+static std::map<std::string, std::unique_ptr<loader::BFDLoader>> g_loaders;
+
+// libbfd is not thread safe, the binaries are loaded one at a time
+static std::mutex g_loaders_mutex;
+
+static state::StatePtr entry_state(const std::string& binpath, bool* o_cached)
+{
+    std::lock_guard<std::mutex> lock(g_loaders_mutex);
+
+    auto it   = g_loaders.find(binpath);
+    *o_cached = it != g_loaders.end();
+    if (it == g_loaders.end()) {
+        if (!std::filesystem::is_regular_file(binpath))
+            throw std::invalid_argument("unable to find the binary " +
+                                        binpath);
+        it = g_loaders
+                 .emplace(binpath, std::make_unique<loader::BFDLoader>(binpath))
+                 .first;
+    }
+    return it->second->entry_state();
+}
+
+struct job_t {
+    uint64_t               id;
+    int                    fd;
+    clock_type::time_point received;
+};
+
+class JobQueue
+{
+    std::deque<job_t>       m_jobs;
+    std::mutex              m_mutex;
+    std::condition_variable m_not_empty;
+
+  public:
+    void push(job_t job)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_jobs.push_back(job);
+        }
+        m_not_empty.notify_one();
+    }
+
+    job_t pop()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_not_empty.wait(lock, [this] { return !m_jobs.empty(); });
+        job_t job = m_jobs.front();
+        m_jobs.pop_front();
+        return job;
+    }
+};
+
+static void serve(JobQueue& queue)
+{
+    executor::JobServer server(entry_state);
+    while (1) {
+        job_t job = queue.pop();
+        json  res = server.serve(job.fd, job.id, job.received);
+        info("naaz_server") << res.dump() << std::endl;
+    }
+}
+
+int main(int argc, char const* argv[])
+{
+    auto args = parse_args_or_die(argc, argv);
+
+    // a client that goes away must not kill the server, nor a failed job
+    signal(SIGPIPE, SIG_IGN);
+    set_fail_throws(true);
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (args.socket_path.size() >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "the socket path %s is too long\n",
+                args.socket_path.c_str());
+        exit(1);
+    }
+    strcpy(addr.sun_path, args.socket_path.c_str());
+
+    int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(args.socket_path.c_str());
+    if (sock < 0 || bind(sock, (struct sockaddr*)&addr, sizeof(addr)) < 0 ||
+        listen(sock, SOMAXCONN) < 0) {
+        fprintf(stderr, "unable to listen on %s: %s\n",
+                args.socket_path.c_str(), strerror(errno));
+        exit(1);
+    }
+
+    JobQueue                 queue;
+    std::vector<std::thread> workers;
+    for (uint32_t i = 0; i < args.num_jobs; ++i)
+        workers.emplace_back(serve, std::ref(queue));
+    info("naaz_server") << "listening on " << args.socket_path << " ("
+                        << args.num_jobs << " jobs)" << std::endl;
+
+    uint64_t next_id = 0;
+    while (1) {
+        int fd = accept(sock, nullptr, nullptr);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            fprintf(stderr, "accept failed: %s\n", strerror(errno));
+            exit(1);
+        }
+        queue.push(job_t{next_id++, fd, clock_type::now()});
+    }
+    return 0;
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cstdint>
+#include <string>
 
 namespace naaz
 {
@@ -12,6 +13,40 @@ struct Config {
     uint16_t default_max_n_eval_sym_read  = 256;
     uint16_t default_max_n_eval_sym_write = 64;
 
+    // model the memory regions accessed with symbolic pointers as arrays
+    // (at most max_sym_array_size bytes wide)
+    bool     sym_memory_arrays  = false;
+    uint32_t max_sym_array_size = 4096;
+
+    // the string models (e.g., strlen) fork a state for each feasible position
+    // of the terminator, instead of returning a single ite expression
+    bool fork_string_models = false;
+
+    // merge the states that reach the same program point (with the same
+    // stacktrace) within merge_window executed blocks, if the cost of the
+    // merge is at most merge_max_cost (see State::merge)
+    bool     merge_states   = false;
+    uint32_t merge_window   = 8;
+    uint32_t merge_max_cost = 64;
+
+    // when the process uses more than max_memory MB (0: no limit), the least
+    // promising queued states are spilled to files in spill_dir
+    uint64_t    max_memory = 0;
+    std::string spill_dir  = "/tmp";
+
+    // write a checkpoint of the exploration in checkpoint_dir (empty: never)
+    // every checkpoint_interval seconds
+    std::string checkpoint_dir      = "";
+    uint32_t    checkpoint_interval = 300;
+
+    // gen_paths emits the exited states on emit_workers threads (0: on the
+    // exploration thread), through a queue of at most emit_queue_size states
+    uint32_t emit_workers    = 0;
+    uint32_t emit_queue_size = 64;
+
+    // gen_paths emits only the states that hit new edges (see EdgeCoverage)
+    bool emit_new_coverage_only = false;
+
     bool printable_stdin = false;
 };
 
@@ -1,3 +1,4 @@
+#include <atomic>
 #include <cstdlib>
 #include "ioutil.hpp"
 
@@ -24,4 +25,13 @@ std::ostream& dbg(const char* module)
 
 std::ostream& pp_stream() { return std::cout; }
 
-[[noreturn]] void exit_fail() { exit(-1); }
+static std::atomic<bool> g_fail_throws = false;
+
+void set_fail_throws(bool throws) { g_fail_throws = throws; }
+
+[[noreturn]] void exit_fail()
+{
+    if (g_fail_throws)
+        throw fatal_error();
+    exit(-1);
+}
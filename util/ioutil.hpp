@@ -1,10 +1,20 @@
 #pragma once
 
 #include <iostream>
+#include <stdexcept>
 
 std::ostream& err(const char* module = nullptr);
 std::ostream& info(const char* module = nullptr);
 std::ostream& dbg(const char* module = nullptr);
 std::ostream& pp_stream();
 
+// raised by exit_fail() when set_fail_throws(true) was called, e.g., by
+// naaz_server, where a failed job must not kill the other ones. The error
+// was already printed with err()
+struct fatal_error : public std::runtime_error {
+    fatal_error() : std::runtime_error("fatal error (see the log)") {}
+};
+
+void set_fail_throws(bool throws);
+
 [[ noreturn ]] void exit_fail();
@@ -0,0 +1,325 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace naaz
+{
+
+// Copy-on-write pointer. Copies share the pointed object, that is copied
+// only when a copy that is not the only owner is modified (mut()). Every
+// modification of a shared object copies it whole, use it for the objects
+// that are small or modified in bulk (otherwise, see PersistentMap)
+template <typename T> class CowPtr
+{
+    std::shared_ptr<T> m_ptr;
+
+  public:
+    CowPtr() : m_ptr(std::make_shared<T>()) {}
+    CowPtr(const T& v) : m_ptr(std::make_shared<T>(v)) {}
+    CowPtr(T&& v) : m_ptr(std::make_shared<T>(std::move(v))) {}
+
+    const T& operator*() const { return *m_ptr; }
+    const T* operator->() const { return m_ptr.get(); }
+
+    T& mut()
+    {
+        if (m_ptr.use_count() > 1)
+            m_ptr = std::make_shared<T>(*m_ptr);
+        return *m_ptr;
+    }
+
+    // true if the object is shared with other (i.e., neither was modified)
+    bool shares(const CowPtr& other) const { return m_ptr == other.m_ptr; }
+};
+
+// Persistent stack (a singly linked list). Copies, push and pop are O(1),
+// the nodes are shared among the copies. The iteration starts from the top
+template <typename T> class PersistentStack
+{
+    struct Node {
+        T                           value;
+        std::shared_ptr<const Node> next;
+    };
+    typedef std::shared_ptr<const Node> NodePtr;
+
+    NodePtr m_top;
+    size_t  m_size = 0;
+
+  public:
+    PersistentStack() {}
+    PersistentStack(const PersistentStack& other)            = default;
+    PersistentStack(PersistentStack&& other)                 = default;
+    PersistentStack& operator=(const PersistentStack& other) = default;
+    PersistentStack& operator=(PersistentStack&& other)      = default;
+    ~PersistentStack()
+    {
+        // release the nodes that are not shared iteratively, the recursive
+        // destruction of a long list could overflow the stack
+        while (m_top && m_top.use_count() == 1)
+            m_top = m_top->next;
+    }
+
+    void push(const T& v)
+    {
+        m_top = std::make_shared<const Node>(Node{v, m_top});
+        m_size++;
+    }
+    void pop()
+    {
+        m_top = m_top->next;
+        m_size--;
+    }
+    const T& top() const { return m_top->value; }
+    bool     empty() const { return m_top == nullptr; }
+    size_t   size() const { return m_size; }
+
+    class iterator
+    {
+        const Node* m_node;
+
+      public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type        = T;
+        using difference_type   = std::ptrdiff_t;
+        using pointer           = const T*;
+        using reference         = const T&;
+
+        iterator(const Node* node) : m_node(node) {}
+
+        reference operator*() const { return m_node->value; }
+        iterator& operator++()
+        {
+            m_node = m_node->next.get();
+            return *this;
+        }
+        bool operator==(const iterator& other) const
+        {
+            return m_node == other.m_node;
+        }
+        bool operator!=(const iterator& other) const
+        {
+            return m_node != other.m_node;
+        }
+    };
+
+    iterator begin() const { return iterator(m_top.get()); }
+    iterator end() const { return iterator(nullptr); }
+
+    bool operator==(const PersistentStack& other) const
+    {
+        if (m_size != other.m_size)
+            return false;
+
+        // stop at the first node shared by the two stacks
+        const Node* n1 = m_top.get();
+        const Node* n2 = other.m_top.get();
+        while (n1 != n2) {
+            if (!(n1->value == n2->value))
+                return false;
+            n1 = n1->next.get();
+            n2 = n2->next.get();
+        }
+        return true;
+    }
+};
+
+// A new generation of an owner of shared objects. The objects modified by
+// the owner are tagged with its generation, the owner takes a new one when it
+// is copied (both the copy and the original): an object tagged with another
+// generation may be shared, and it is copied before being modified
+inline uint64_t new_generation()
+{
+    static std::atomic<uint64_t> last(0);
+    return ++last;
+}
+
+// Persistent ordered map (a treap). Copies are O(1), lookups, insertions and
+// removals are O(log n) and copy only the path to the modified node, the
+// other nodes are shared among the copies. The iteration is in key order
+template <typename K, typename V> class PersistentMap
+{
+    struct Node {
+        std::pair<K, V>             kv;
+        uint64_t                    prio;
+        std::shared_ptr<const Node> left, right;
+    };
+    typedef std::shared_ptr<const Node> NodePtr;
+
+    NodePtr m_root;
+    size_t  m_size = 0;
+
+    static uint64_t priority(const K& k)
+    {
+        // the heap order of the treap, a hash of the key (mixed, std::hash
+        // of integers is the identity)
+        uint64_t h = std::hash<K>{}(k);
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdUL;
+        h ^= h >> 33;
+        return h;
+    }
+
+    static NodePtr with_children(const NodePtr& n, NodePtr left, NodePtr right)
+    {
+        return std::make_shared<const Node>(
+            Node{n->kv, n->prio, std::move(left), std::move(right)});
+    }
+
+    // the keys smaller and bigger than k, that is not in the tree
+    static std::pair<NodePtr, NodePtr> split(const NodePtr& n, const K& k)
+    {
+        if (!n)
+            return {nullptr, nullptr};
+        if (k < n->kv.first) {
+            auto [l, r] = split(n->left, k);
+            return {l, with_children(n, r, n->right)};
+        }
+        auto [l, r] = split(n->right, k);
+        return {with_children(n, n->left, l), r};
+    }
+
+    // the keys of l are smaller than the ones of r
+    static NodePtr join(const NodePtr& l, const NodePtr& r)
+    {
+        if (!l)
+            return r;
+        if (!r)
+            return l;
+        if (l->prio > r->prio)
+            return with_children(l, l->left, join(l->right, r));
+        return with_children(r, join(l, r->left), r->right);
+    }
+
+    static NodePtr insert(const NodePtr& n, const K& k, const V& v,
+                          uint64_t prio)
+    {
+        if (!n || prio > n->prio) {
+            auto [l, r] = split(n, k);
+            return std::make_shared<const Node>(
+                Node{{k, v}, prio, std::move(l), std::move(r)});
+        }
+        if (k < n->kv.first)
+            return with_children(n, insert(n->left, k, v, prio), n->right);
+        return with_children(n, n->left, insert(n->right, k, v, prio));
+    }
+
+    static NodePtr assign(const NodePtr& n, const K& k, const V& v)
+    {
+        if (k < n->kv.first)
+            return with_children(n, assign(n->left, k, v), n->right);
+        if (n->kv.first < k)
+            return with_children(n, n->left, assign(n->right, k, v));
+        return std::make_shared<const Node>(
+            Node{{k, v}, n->prio, n->left, n->right});
+    }
+
+    static NodePtr remove(const NodePtr& n, const K& k)
+    {
+        if (k < n->kv.first)
+            return with_children(n, remove(n->left, k), n->right);
+        if (n->kv.first < k)
+            return with_children(n, n->left, remove(n->right, k));
+        return join(n->left, n->right);
+    }
+
+  public:
+    const V* find(const K& k) const
+    {
+        const Node* n = m_root.get();
+        while (n) {
+            if (k < n->kv.first)
+                n = n->left.get();
+            else if (n->kv.first < k)
+                n = n->right.get();
+            else
+                return &n->kv.second;
+        }
+        return nullptr;
+    }
+    bool     contains(const K& k) const { return find(k) != nullptr; }
+    const V& at(const K& k) const
+    {
+        const V* v = find(k);
+        if (v == nullptr)
+            throw std::out_of_range("PersistentMap::at");
+        return *v;
+    }
+
+    // insert or replace the value of k
+    void set(const K& k, const V& v)
+    {
+        if (contains(k)) {
+            m_root = assign(m_root, k, v);
+            return;
+        }
+        m_root = insert(m_root, k, v, priority(k));
+        m_size++;
+    }
+    void erase(const K& k)
+    {
+        if (!contains(k))
+            return;
+        m_root = remove(m_root, k);
+        m_size--;
+    }
+    size_t size() const { return m_size; }
+    bool   empty() const { return m_size == 0; }
+
+    // true if the maps share the root (i.e., neither was modified)
+    bool shares(const PersistentMap& other) const
+    {
+        return m_root == other.m_root;
+    }
+
+    class iterator
+    {
+        // the nodes whose left subtree was visited, the top is the current
+        std::vector<const Node*> m_stack;
+
+        void push_left(const Node* n)
+        {
+            for (; n != nullptr; n = n->left.get())
+                m_stack.push_back(n);
+        }
+
+      public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type        = std::pair<K, V>;
+        using difference_type   = std::ptrdiff_t;
+        using pointer           = const value_type*;
+        using reference         = const value_type&;
+
+        iterator(const Node* root) { push_left(root); }
+
+        reference operator*() const { return m_stack.back()->kv; }
+        pointer   operator->() const { return &m_stack.back()->kv; }
+        iterator& operator++()
+        {
+            const Node* n = m_stack.back();
+            m_stack.pop_back();
+            push_left(n->right.get());
+            return *this;
+        }
+        bool operator==(const iterator& other) const
+        {
+            return m_stack == other.m_stack;
+        }
+        bool operator!=(const iterator& other) const
+        {
+            return m_stack != other.m_stack;
+        }
+    };
+
+    iterator begin() const { return iterator(m_root.get()); }
+    iterator end() const { return iterator(nullptr); }
+};
+
+} // namespace naaz
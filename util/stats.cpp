@@ -0,0 +1,183 @@
+#include <fstream>
+#include <mutex>
+#include <set>
+
+#include "stats.hpp"
+#include "ioutil.hpp"
+
+namespace naaz::stats
+{
+
+static const char* g_phase_names[]   = {"lift",      "execute",  "clone",
+                                        "hash_cons", "evaluate", "to_z3",
+                                        "solver_check"};
+static const char* g_counter_names[] = {"forks", "solver_unknown"};
+static const char* g_gauge_names[]   = {"peak_states", "expr_table_size"};
+
+static_assert(sizeof(g_phase_names) / sizeof(char*) == NUM_PHASES);
+static_assert(sizeof(g_counter_names) / sizeof(char*) == NUM_COUNTERS);
+static_assert(sizeof(g_gauge_names) / sizeof(char*) == NUM_GAUGES);
+
+// the stats of the live threads, and the merged ones of the exited threads
+static std::mutex              g_mutex;
+static std::set<ThreadStats*>& live_threads()
+{
+    static std::set<ThreadStats*> threads;
+    return threads;
+}
+
+struct Totals {
+    uint64_t phase_ns[NUM_PHASES];
+    uint64_t phase_count[NUM_PHASES];
+    uint64_t phase_hist[NUM_PHASES][Histogram::NUM_BUCKETS];
+    uint64_t counters[NUM_COUNTERS];
+    uint64_t gauges[NUM_GAUGES];
+};
+static Totals g_exited;
+
+Histogram::Histogram()
+{
+    for (auto& b : m_buckets)
+        b.store(0, std::memory_order_relaxed);
+}
+
+uint32_t Histogram::bucket(uint64_t ns)
+{
+    if (ns < 8)
+        return ns;
+    uint32_t e = 63 - __builtin_clzl(ns);
+    return (e - 2) * 8 + ((ns >> (e - 3)) & 7);
+}
+
+uint64_t Histogram::lower_bound(uint32_t bucket)
+{
+    if (bucket < 8)
+        return bucket;
+    uint32_t e = bucket / 8 + 2;
+    return (8UL + bucket % 8) << (e - 3);
+}
+
+void Histogram::add(uint64_t ns)
+{
+    std::atomic<uint64_t>& b = m_buckets[bucket(ns)];
+    b.store(b.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+ThreadStats::ThreadStats()
+{
+    for (uint32_t i = 0; i < NUM_PHASES; ++i) {
+        phase_ns[i].store(0, std::memory_order_relaxed);
+        phase_count[i].store(0, std::memory_order_relaxed);
+    }
+    for (auto& c : counters)
+        c.store(0, std::memory_order_relaxed);
+    for (auto& g : gauges)
+        g.store(0, std::memory_order_relaxed);
+
+    std::lock_guard<std::mutex> lock(g_mutex);
+    live_threads().insert(this);
+}
+
+ThreadStats::~ThreadStats()
+{
+    std::lock_guard<std::mutex> lock(g_mutex);
+    live_threads().erase(this);
+
+    for (uint32_t i = 0; i < NUM_PHASES; ++i) {
+        g_exited.phase_ns[i] += phase_ns[i].load(std::memory_order_relaxed);
+        g_exited.phase_count[i] +=
+            phase_count[i].load(std::memory_order_relaxed);
+        for (uint32_t b = 0; b < Histogram::NUM_BUCKETS; ++b)
+            g_exited.phase_hist[i][b] += phase_hist[i].count(b);
+    }
+    for (uint32_t i = 0; i < NUM_COUNTERS; ++i)
+        g_exited.counters[i] += counters[i].load(std::memory_order_relaxed);
+    for (uint32_t i = 0; i < NUM_GAUGES; ++i)
+        g_exited.gauges[i] = std::max(
+            g_exited.gauges[i], gauges[i].load(std::memory_order_relaxed));
+}
+
+ScopedTimer::~ScopedTimer()
+{
+    uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      std::chrono::steady_clock::now() - m_start)
+                      .count();
+
+    ThreadStats& stats = ThreadStats::The();
+    add(stats.phase_ns[m_phase], ns);
+    add(stats.phase_count[m_phase], 1);
+    stats.phase_hist[m_phase].add(ns);
+}
+
+static double percentile_us(const uint64_t* hist, uint64_t total, double p)
+{
+    if (total == 0)
+        return 0;
+
+    // the rank of the percentile, starting from 1
+    uint64_t rank = std::max<uint64_t>(1, (uint64_t)(p * total + 0.5));
+    uint64_t seen = 0;
+    for (uint32_t b = 0; b < Histogram::NUM_BUCKETS; ++b) {
+        seen += hist[b];
+        if (seen >= rank)
+            return Histogram::lower_bound(b) / 1000.0;
+    }
+    return Histogram::lower_bound(Histogram::NUM_BUCKETS - 1) / 1000.0;
+}
+
+nlohmann::json report()
+{
+#ifndef NAAZ_STATS
+    return {{"enabled", false}};
+#else
+    std::lock_guard<std::mutex> lock(g_mutex);
+
+    Totals merged = g_exited;
+    for (ThreadStats* t : live_threads()) {
+        for (uint32_t i = 0; i < NUM_PHASES; ++i) {
+            merged.phase_ns[i] += t->phase_ns[i].load();
+            merged.phase_count[i] += t->phase_count[i].load();
+            for (uint32_t b = 0; b < Histogram::NUM_BUCKETS; ++b)
+                merged.phase_hist[i][b] += t->phase_hist[i].count(b);
+        }
+        for (uint32_t i = 0; i < NUM_COUNTERS; ++i)
+            merged.counters[i] += t->counters[i].load();
+        for (uint32_t i = 0; i < NUM_GAUGES; ++i)
+            merged.gauges[i] = std::max(merged.gauges[i], t->gauges[i].load());
+    }
+
+    nlohmann::json res;
+    res["enabled"] = true;
+    for (uint32_t i = 0; i < NUM_PHASES; ++i) {
+        const uint64_t* hist  = merged.phase_hist[i];
+        uint64_t        count = merged.phase_count[i];
+
+        nlohmann::json phase;
+        phase["count"]    = count;
+        phase["total_ms"] = merged.phase_ns[i] / 1e6;
+        phase["p50_us"]   = percentile_us(hist, count, 0.50);
+        phase["p90_us"]   = percentile_us(hist, count, 0.90);
+        phase["p99_us"]   = percentile_us(hist, count, 0.99);
+        phase["max_us"]   = percentile_us(hist, count, 1.0);
+        res["phases"][g_phase_names[i]] = phase;
+    }
+    for (uint32_t i = 0; i < NUM_COUNTERS; ++i)
+        res["counters"][g_counter_names[i]] = merged.counters[i];
+    for (uint32_t i = 0; i < NUM_GAUGES; ++i)
+        res["gauges"][g_gauge_names[i]] = merged.gauges[i];
+    return res;
+#endif
+}
+
+void write_report(const std::filesystem::path& path)
+{
+    std::ofstream out(path);
+    out << report().dump(4) << std::endl;
+    out.close();
+    if (!out) {
+        err("stats") << "unable to write " << path << std::endl;
+        exit_fail();
+    }
+}
+
+} // namespace naaz::stats
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <nlohmann/json.hpp>
+
+// Phase timers, counters and gauges of the analysis. They are enabled by the
+// STATS cmake option (that defines NAAZ_STATS), otherwise the STATS_* macros
+// expand to nothing. Every thread updates its own copy of the stats, that are
+// merged only by report()
+#ifdef NAAZ_STATS
+#define STATS_CONCAT_(a, b) a##b
+#define STATS_CONCAT(a, b)  STATS_CONCAT_(a, b)
+// time the rest of the enclosing scope as an occurrence of phase
+#define STATS_TIMER(phase)                                                     \
+    naaz::stats::ScopedTimer STATS_CONCAT(stats_timer_, __LINE__)(             \
+        naaz::stats::Phase::phase)
+#define STATS_COUNT(counter) naaz::stats::count(naaz::stats::Counter::counter)
+#define STATS_MAX(gauge, v)                                                    \
+    naaz::stats::update_max(naaz::stats::Gauge::gauge, (v))
+#else
+// statements that do nothing, e.g., "if (c) STATS_COUNT(x);" has a body
+#define STATS_TIMER(phase)   ((void)0)
+#define STATS_COUNT(counter) ((void)0)
+#define STATS_MAX(gauge, v)  ((void)0)
+#endif
+
+namespace naaz::stats
+{
+
+// the times are inclusive, e.g., EXECUTE contains the LIFT of the block
+enum Phase {
+    LIFT,
+    EXECUTE,
+    CLONE,
+    HASH_CONS,
+    EVALUATE,
+    TO_Z3,
+    SOLVER_CHECK,
+    NUM_PHASES
+};
+
+// FORKS counts the calls to State::fork (including the clones of the pending
+// children), SOLVER_UNKNOWN the queries that timed out
+enum Counter { FORKS, SOLVER_UNKNOWN, NUM_COUNTERS };
+
+// the maximum of the values passed to update_max(): the states queued in
+// memory, and the entries of the hash-consing table of the ExprBuilder
+enum Gauge { PEAK_STATES, EXPR_TABLE_SIZE, NUM_GAUGES };
+
+// Log-linear histogram of durations in ns: 8 buckets for each power of two,
+// the percentiles are within 12.5% of the real ones
+class Histogram
+{
+  public:
+    static constexpr uint32_t NUM_BUCKETS = 62 * 8;
+
+  private:
+    std::atomic<uint64_t> m_buckets[NUM_BUCKETS];
+
+  public:
+    Histogram();
+
+    static uint32_t bucket(uint64_t ns);
+    // the smallest duration of the bucket
+    static uint64_t lower_bound(uint32_t bucket);
+
+    void     add(uint64_t ns);
+    uint64_t count(uint32_t bucket) const
+    {
+        return m_buckets[bucket].load(std::memory_order_relaxed);
+    }
+};
+
+// The stats of a thread. They are written only by the owning thread, the
+// atomics (relaxed) make the reads of report() safe
+struct ThreadStats {
+    std::atomic<uint64_t> phase_ns[NUM_PHASES];
+    std::atomic<uint64_t> phase_count[NUM_PHASES];
+    Histogram             phase_hist[NUM_PHASES];
+    std::atomic<uint64_t> counters[NUM_COUNTERS];
+    std::atomic<uint64_t> gauges[NUM_GAUGES];
+
+    ThreadStats();
+    // merge the stats in the ones of the exited threads
+    ~ThreadStats();
+
+    static ThreadStats& The()
+    {
+        thread_local ThreadStats stats;
+        return stats;
+    }
+};
+
+static inline void add(std::atomic<uint64_t>& v, uint64_t n)
+{
+    // a single writer, no need for an atomic increment
+    v.store(v.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+static inline void count(Counter c, uint64_t n = 1)
+{
+    add(ThreadStats::The().counters[c], n);
+}
+
+static inline void update_max(Gauge g, uint64_t v)
+{
+    std::atomic<uint64_t>& m = ThreadStats::The().gauges[g];
+    if (v > m.load(std::memory_order_relaxed))
+        m.store(v, std::memory_order_relaxed);
+}
+
+class ScopedTimer
+{
+    Phase                                 m_phase;
+    std::chrono::steady_clock::time_point m_start;
+
+  public:
+    ScopedTimer(Phase phase)
+        : m_phase(phase), m_start(std::chrono::steady_clock::now())
+    {
+    }
+    ~ScopedTimer();
+};
+
+// the stats of all the threads (including the exited ones): the total time,
+// the number of occurrences and the percentiles of the duration of every
+// phase, the counters and the gauges. Only {"enabled": false} without
+// NAAZ_STATS
+nlohmann::json report();
+void           write_report(const std::filesystem::path& path);
+
+} // namespace naaz::stats
@@ -0,0 +1,25 @@
+#include <fstream>
+#include <unistd.h>
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+#include "sysutil.hpp"
+
+uint64_t get_rss()
+{
+    // the second field of statm is the number of resident pages
+    std::ifstream statm("/proc/self/statm");
+    uint64_t      size, resident;
+    if (!(statm >> size >> resident))
+        return 0;
+    return resident * (uint64_t)sysconf(_SC_PAGESIZE);
+}
+
+void release_free_memory()
+{
+#if defined(__GLIBC__)
+    malloc_trim(0);
+#endif
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <cstdint>
+
+// resident set size of the process in bytes (0 if it is not available)
+uint64_t get_rss();
+
+// give the freed memory back to the system, if the allocator supports it
+void release_free_memory();